@@ -26,6 +26,42 @@
 #include "async.h"
 #include "server.h"
 
+static void prv_free_variant_array(GVariant **array, guint length)
+{
+	guint i;
+
+	if (!array)
+		return;
+
+	for (i = 0; i < length; ++i)
+		if (array[i])
+			g_variant_unref(array[i]);
+
+	g_free(array);
+}
+
+static void prv_free_upload_files(dls_async_upload_file_t *files,
+				  guint length)
+{
+	guint i;
+
+	if (!files)
+		return;
+
+	for (i = 0; i < length; ++i) {
+		g_free(files[i].file_path);
+		g_free(files[i].mime_type);
+
+		if (files[i].result)
+			g_variant_unref(files[i].result);
+
+		if (files[i].error)
+			g_error_free(files[i].error);
+	}
+
+	g_free(files);
+}
+
 void dls_async_task_delete(dls_async_task_t *cb_data)
 {
 	switch (cb_data->task.type) {
@@ -33,6 +69,9 @@ void dls_async_task_delete(dls_async_task_t *cb_data)
 	case DLS_TASK_SEARCH:
 		if (cb_data->ut.bas.vbs)
 			g_ptr_array_unref(cb_data->ut.bas.vbs);
+		g_free(cb_data->ut.bas.upnp_filter);
+		g_free(cb_data->ut.bas.sort_by);
+		g_list_free_full(cb_data->ut.bas.count_requests, g_free);
 		break;
 	case DLS_TASK_MANAGER_GET_ALL_PROPS:
 	case DLS_TASK_GET_ALL_PROPS:
@@ -45,10 +84,22 @@ void dls_async_task_delete(dls_async_task_t *cb_data)
 			g_variant_builder_unref(cb_data->ut.browse_objects.avb);
 		g_free(cb_data->ut.browse_objects.objects_id);
 		g_free(cb_data->ut.browse_objects.upnp_filter);
+		g_free(cb_data->ut.browse_objects.slots);
+		g_free(cb_data->ut.browse_objects.unique);
+		prv_free_variant_array(cb_data->ut.browse_objects.results,
+				       cb_data->ut.browse_objects.unique_count);
 		break;
 	case DLS_TASK_UPLOAD_TO_ANY:
 	case DLS_TASK_UPLOAD:
+	case DLS_TASK_UPLOAD_FD_TO_ANY:
+	case DLS_TASK_UPLOAD_FD:
 		g_free(cb_data->ut.upload.mime_type);
+		g_free(cb_data->ut.upload.profile_key);
+		break;
+	case DLS_TASK_UPLOAD_MANY_TO_ANY:
+	case DLS_TASK_UPLOAD_MANY:
+		prv_free_upload_files(cb_data->ut.upload_many.files,
+				      cb_data->ut.upload_many.file_count);
 		break;
 	case DLS_TASK_UPDATE_OBJECT:
 		g_free(cb_data->ut.update.current_tag_value);
@@ -78,6 +129,17 @@ gboolean dls_async_task_complete(gpointer user_data)
 	return FALSE;
 }
 
+/* Once completion is scheduled the task can no longer expire */
+void dls_async_task_complete_in_idle(dls_async_task_t *cb_data)
+{
+	if (cb_data->task.deadline_id) {
+		(void) g_source_remove(cb_data->task.deadline_id);
+		cb_data->task.deadline_id = 0;
+	}
+
+	(void) g_idle_add(dls_async_task_complete, cb_data);
+}
+
 void dls_async_task_cancelled_cb(GCancellable *cancellable, gpointer user_data)
 {
 	dls_async_task_t *cb_data = user_data;
@@ -90,7 +152,7 @@ void dls_async_task_cancelled_cb(GCancellable *cancellable, gpointer user_data)
 		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
 					     DLEYNA_ERROR_CANCELLED,
 					     "Operation cancelled.");
-	(void) g_idle_add(dls_async_task_complete, cb_data);
+	dls_async_task_complete_in_idle(cb_data);
 }
 
 void dls_async_task_cancel(dls_async_task_t *cb_data)
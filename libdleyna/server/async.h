@@ -28,6 +28,7 @@
 
 #include <libdleyna/core/task-atom.h>
 
+#include "matcher.h"
 #include "server.h"
 #include "task.h"
 #include "upnp.h"
@@ -41,17 +42,21 @@ typedef struct dls_async_bas_t_ dls_async_bas_t;
 struct dls_async_bas_t_ {
 	dls_upnp_prop_mask filter_mask;
 	GPtrArray *vbs;
-	const gchar *protocol_info;
+	const dls_matcher_t *protocol_info;
 	gboolean need_child_count;
 	guint retrieved;
 	guint max_count;
 	dls_async_cb_t get_children_cb;
+	gchar *upnp_filter;
+	gchar *sort_by;
+	GList *count_requests;
+	gboolean count_waiting;
 };
 
 typedef struct dls_async_get_prop_t_ dls_async_get_prop_t;
 struct dls_async_get_prop_t_ {
 	GCallback prop_func;
-	const gchar *protocol_info;
+	const dls_matcher_t *protocol_info;
 };
 
 typedef struct dls_async_get_all_t_ dls_async_get_all_t;
@@ -59,7 +64,7 @@ struct dls_async_get_all_t_ {
 	GCallback prop_func;
 	GVariantBuilder *vb;
 	dls_upnp_prop_mask filter_mask;
-	const gchar *protocol_info;
+	const dls_matcher_t *protocol_info;
 	gboolean need_child_count;
 	gboolean device_object;
 	GUPnPServiceProxy *proxy;
@@ -69,6 +74,27 @@ typedef struct dls_async_upload_t_ dls_async_upload_t;
 struct dls_async_upload_t_ {
 	const gchar *object_class;
 	gchar *mime_type;
+	const gchar *parent_id;
+	gchar *profile_key;
+};
+
+typedef struct dls_async_upload_file_t_ dls_async_upload_file_t;
+struct dls_async_upload_file_t_ {
+	const gchar *display_name;
+	gchar *file_path;
+	const gchar *object_class;
+	gchar *mime_type;
+	GVariant *result;
+	GError *error;
+};
+
+typedef struct dls_async_upload_many_t_ dls_async_upload_many_t;
+struct dls_async_upload_many_t_ {
+	const gchar *parent_id;
+	dls_async_upload_file_t *files;
+	guint file_count;
+	guint index;
+	GList *requests;
 };
 
 typedef struct dls_async_update_t_ dls_async_update_t;
@@ -83,10 +109,16 @@ struct dls_async_browse_objects_t_ {
 	dls_async_get_all_t get_all; /* pseudo inheritance - MUST be first */
 	GVariantBuilder *avb;
 	gchar *upnp_filter;
-	const dleyna_task_queue_key_t *queue_id;
 	const gchar **objects_id;
 	guint object_count;
+	guint *slots;
+	guint *unique;
+	guint unique_count;
+	GVariant **results;
+	GList *requests;
 	guint index;
+	guint search_index;
+	guint searches;
 };
 
 struct dls_async_task_t_ {
@@ -102,6 +134,7 @@ struct dls_async_task_t_ {
 		dls_async_get_prop_t get_prop;
 		dls_async_get_all_t get_all;
 		dls_async_upload_t upload;
+		dls_async_upload_many_t upload_many;
 		dls_async_update_t update;
 		dls_async_browse_objects_t browse_objects;
 	} ut;
@@ -111,6 +144,8 @@ void dls_async_task_delete(dls_async_task_t *cb_data);
 
 gboolean dls_async_task_complete(gpointer user_data);
 
+void dls_async_task_complete_in_idle(dls_async_task_t *cb_data);
+
 void dls_async_task_cancelled_cb(GCancellable *cancellable, gpointer user_data);
 
 void dls_async_task_cancel(dls_async_task_t *cb_data);
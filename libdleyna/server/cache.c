@@ -0,0 +1,119 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "cache.h"
+
+typedef struct dls_string_cache_entry_t_ dls_string_cache_entry_t;
+struct dls_string_cache_entry_t_ {
+	gchar *key;
+	gchar *value;
+	GList *link;
+};
+
+struct dls_string_cache_t_ {
+	GHashTable *entries;
+	GQueue lru;
+	guint max_entries;
+};
+
+static void prv_entry_delete(gpointer data)
+{
+	dls_string_cache_entry_t *entry = data;
+
+	g_free(entry->key);
+	g_free(entry->value);
+	g_free(entry);
+}
+
+dls_string_cache_t *dls_string_cache_new(guint max_entries)
+{
+	dls_string_cache_t *cache = g_new0(dls_string_cache_t, 1);
+
+	cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+					       prv_entry_delete);
+	cache->max_entries = MAX(max_entries, 1);
+
+	return cache;
+}
+
+void dls_string_cache_delete(dls_string_cache_t *cache)
+{
+	if (cache) {
+		g_queue_clear(&cache->lru);
+		g_hash_table_unref(cache->entries);
+		g_free(cache);
+	}
+}
+
+const gchar *dls_string_cache_lookup(dls_string_cache_t *cache,
+				     const gchar *key)
+{
+	dls_string_cache_entry_t *entry;
+
+	entry = g_hash_table_lookup(cache->entries, key);
+	if (!entry)
+		return NULL;
+
+	/* Most recently used entries live at the head of the queue */
+	g_queue_unlink(&cache->lru, entry->link);
+	g_queue_push_head_link(&cache->lru, entry->link);
+
+	return entry->value;
+}
+
+void dls_string_cache_insert(dls_string_cache_t *cache, const gchar *key,
+			     const gchar *value)
+{
+	dls_string_cache_entry_t *entry;
+
+	entry = g_hash_table_lookup(cache->entries, key);
+	if (entry) {
+		g_free(entry->value);
+		entry->value = g_strdup(value);
+		g_queue_unlink(&cache->lru, entry->link);
+		g_queue_push_head_link(&cache->lru, entry->link);
+		return;
+	}
+
+	if (g_hash_table_size(cache->entries) >= cache->max_entries) {
+		entry = g_queue_pop_tail(&cache->lru);
+		(void) g_hash_table_remove(cache->entries, entry->key);
+	}
+
+	entry = g_new0(dls_string_cache_entry_t, 1);
+	entry->key = g_strdup(key);
+	entry->value = g_strdup(value);
+
+	g_queue_push_head(&cache->lru, entry);
+	entry->link = cache->lru.head;
+
+	g_hash_table_insert(cache->entries, entry->key, entry);
+}
+
+void dls_string_cache_remove(dls_string_cache_t *cache, const gchar *key)
+{
+	dls_string_cache_entry_t *entry;
+
+	entry = g_hash_table_lookup(cache->entries, key);
+	if (entry) {
+		g_queue_delete_link(&cache->lru, entry->link);
+		(void) g_hash_table_remove(cache->entries, key);
+	}
+}
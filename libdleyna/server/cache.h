@@ -0,0 +1,40 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef DLS_CACHE_H__
+#define DLS_CACHE_H__
+
+#include <glib.h>
+
+typedef struct dls_string_cache_t_ dls_string_cache_t;
+
+dls_string_cache_t *dls_string_cache_new(guint max_entries);
+
+void dls_string_cache_delete(dls_string_cache_t *cache);
+
+const gchar *dls_string_cache_lookup(dls_string_cache_t *cache,
+				     const gchar *key);
+
+void dls_string_cache_insert(dls_string_cache_t *cache, const gchar *key,
+			     const gchar *value);
+
+void dls_string_cache_remove(dls_string_cache_t *cache, const gchar *key);
+
+#endif /* DLS_CACHE_H__ */
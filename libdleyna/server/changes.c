@@ -0,0 +1,202 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <string.h>
+
+#include "changes.h"
+#include "interface.h"
+
+static void prv_change_delete(dls_change_t *change)
+{
+	g_free(change->path);
+	if (change->dict)
+		g_variant_unref(change->dict);
+	g_free(change);
+}
+
+void dls_change_queue_clear(dls_change_queue_t *queue)
+{
+	dls_change_t *change;
+
+	g_clear_pointer(&queue->index, g_hash_table_unref);
+
+	while ((change = g_queue_pop_head(&queue->changes)))
+		prv_change_delete(change);
+}
+
+static void prv_change_queue_remove_link(dls_change_queue_t *queue,
+					 GList *link)
+{
+	dls_change_t *change = link->data;
+
+	(void) g_hash_table_remove(queue->index, change->path);
+	g_queue_delete_link(&queue->changes, link);
+	prv_change_delete(change);
+}
+
+static GList *prv_change_queue_lookup(dls_change_queue_t *queue,
+				      const gchar *path)
+{
+	if (!queue->index) {
+		queue->index = g_hash_table_new(g_str_hash, g_str_equal);
+		return NULL;
+	}
+
+	return g_hash_table_lookup(queue->index, path);
+}
+
+static void prv_change_queue_push(dls_change_queue_t *queue,
+				  dls_change_t *change, gboolean indexed)
+{
+	g_queue_push_tail(&queue->changes, change);
+
+	if (indexed)
+		g_hash_table_replace(queue->index, change->path,
+				     queue->changes.tail);
+}
+
+/* Gives the queued change the UpdateID of the later change dict */
+static void prv_change_fold_update_id(dls_change_t *change, GVariant *dict)
+{
+	GVariantBuilder vb;
+	GVariantIter iter;
+	GVariant *update_id;
+	GVariant *value;
+	const gchar *key;
+
+	update_id = g_variant_lookup_value(dict, DLS_INTERFACE_PROP_UPDATE_ID,
+					   NULL);
+	if (!update_id)
+		goto on_exit;
+
+	g_variant_builder_init(&vb, G_VARIANT_TYPE("a{sv}"));
+
+	g_variant_iter_init(&iter, change->dict);
+	while (g_variant_iter_next(&iter, "{&sv}", &key, &value)) {
+		if (strcmp(key, DLS_INTERFACE_PROP_UPDATE_ID))
+			g_variant_builder_add(&vb, "{sv}", key, value);
+		g_variant_unref(value);
+	}
+
+	g_variant_builder_add(&vb, "{sv}", DLS_INTERFACE_PROP_UPDATE_ID,
+			      update_id);
+	g_variant_unref(update_id);
+
+	g_variant_unref(change->dict);
+	change->dict = g_variant_ref_sink(g_variant_builder_end(&vb));
+
+on_exit:
+
+	return;
+}
+
+/* Queues a decoded LastChange element.  When coalescing, consecutive
+ * modifications of an object are merged, a modification of an object
+ * added in the same window is folded into the add, which takes its
+ * UpdateID, and an object added then removed in the same window is
+ * dropped altogether.
+ */
+void dls_change_queue_add(dls_change_queue_t *queue, GVariant *dict,
+			  gboolean coalesce)
+{
+	dls_change_t *change;
+	dls_change_t *last;
+	GList *link;
+	const gchar *path = NULL;
+	guint type = 0;
+
+	change = g_new0(dls_change_t, 1);
+	change->dict = g_variant_ref_sink(dict);
+
+	(void) g_variant_lookup(change->dict, DLS_INTERFACE_PROP_PATH, "&s",
+				&path);
+	(void) g_variant_lookup(change->dict, DLS_INTERFACE_PROP_CHANGE_TYPE,
+				"u", &type);
+
+	change->path = g_strdup(path);
+	change->type = type;
+
+	if (!coalesce || type == DLS_CHANGE_DONE) {
+		prv_change_queue_push(queue, change, FALSE);
+		goto on_exit;
+	}
+
+	link = prv_change_queue_lookup(queue, change->path);
+	if (link) {
+		last = link->data;
+
+		if (type == DLS_CHANGE_MOD && last->type == DLS_CHANGE_MOD) {
+			g_variant_unref(last->dict);
+			last->dict = g_variant_ref(change->dict);
+			prv_change_delete(change);
+			goto on_exit;
+		}
+
+		if (type == DLS_CHANGE_MOD && last->type == DLS_CHANGE_ADD) {
+			prv_change_fold_update_id(last, change->dict);
+			prv_change_delete(change);
+			goto on_exit;
+		}
+
+		if (type == DLS_CHANGE_DEL && last->type == DLS_CHANGE_ADD) {
+			prv_change_queue_remove_link(queue, link);
+			prv_change_delete(change);
+			goto on_exit;
+		}
+
+		if (type == DLS_CHANGE_DEL && last->type == DLS_CHANGE_MOD)
+			prv_change_queue_remove_link(queue, link);
+	}
+
+	prv_change_queue_push(queue, change, TRUE);
+
+on_exit:
+
+	return;
+}
+
+/* When coalescing, only the latest update ID of a container is kept */
+void dls_change_queue_add_container(dls_change_queue_t *queue,
+				    const gchar *path, guint update_id,
+				    gboolean coalesce)
+{
+	dls_change_t *change;
+	GList *link;
+
+	if (coalesce) {
+		link = prv_change_queue_lookup(queue, path);
+		if (link) {
+			change = link->data;
+			change->update_id = update_id;
+			goto on_exit;
+		}
+	}
+
+	change = g_new0(dls_change_t, 1);
+	change->path = g_strdup(path);
+	change->type = DLS_CHANGE_CONTAINER;
+	change->update_id = update_id;
+
+	prv_change_queue_push(queue, change, coalesce);
+
+on_exit:
+
+	return;
+}
@@ -0,0 +1,64 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef DLS_CHANGES_H__
+#define DLS_CHANGES_H__
+
+#include <glib.h>
+
+enum dls_change_type_t_ {
+	DLS_CHANGE_ADD = 1,
+	DLS_CHANGE_MOD,
+	DLS_CHANGE_DEL,
+	DLS_CHANGE_DONE,
+	DLS_CHANGE_CONTAINER,
+	DLS_CHANGE_SYSTEM_UPDATE
+};
+typedef enum dls_change_type_t_ dls_change_type_t;
+
+/* A Changed element, or a container update when dict is NULL */
+typedef struct dls_change_t_ dls_change_t;
+struct dls_change_t_ {
+	gchar *path;
+	dls_change_type_t type;
+	guint update_id;
+	GVariant *dict;
+};
+
+/* The changes of a device waiting for the end of its coalescing window,
+ * in the order they arrived.  index maps the paths of the changes that
+ * may still be coalesced to their link in changes.
+ */
+typedef struct dls_change_queue_t_ dls_change_queue_t;
+struct dls_change_queue_t_ {
+	GQueue changes;
+	GHashTable *index;
+};
+
+void dls_change_queue_clear(dls_change_queue_t *queue);
+
+void dls_change_queue_add(dls_change_queue_t *queue, GVariant *dict,
+			  gboolean coalesce);
+
+void dls_change_queue_add_container(dls_change_queue_t *queue,
+				    const gchar *path, guint update_id,
+				    gboolean coalesce);
+
+#endif /* DLS_CHANGES_H__ */
@@ -25,10 +25,13 @@
 
 #include <glib.h>
 
+#include "matcher.h"
+
 typedef struct dls_client_t_ dls_client_t;
 struct dls_client_t_ {
-	gchar *protocol_info;
+	dls_matcher_t *protocol_info;
 	gboolean prefer_local_addresses;
+	guint request_timeout;
 };
 
 #endif /* DLS_CLIENT_H__ */
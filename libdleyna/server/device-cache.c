@@ -0,0 +1,207 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <glib/gstdio.h>
+
+#include <libdleyna/core/log.h>
+
+#include "device-cache.h"
+
+#define DLS_DEVICE_CACHE_DIR "dleyna-server"
+#define DLS_DEVICE_CACHE_SUBDIR "devices"
+#define DLS_DEVICE_CACHE_GROUP "Device"
+#define DLS_DEVICE_CACHE_VERSION 1
+
+#define DLS_DEVICE_CACHE_KEY_VERSION "Version"
+#define DLS_DEVICE_CACHE_KEY_UDN "UDN"
+#define DLS_DEVICE_CACHE_KEY_CONFIG_ID "ConfigId"
+
+static const gchar *g_value_keys[DLS_DEVICE_CACHE_VALUE_COUNT] = {
+	"SearchCaps",
+	"SortCaps",
+	"SortExtensionCaps",
+	"FeatureList"
+};
+
+static gchar *prv_cache_dir(void)
+{
+	return g_build_filename(g_get_user_cache_dir(), DLS_DEVICE_CACHE_DIR,
+				DLS_DEVICE_CACHE_SUBDIR, NULL);
+}
+
+static gchar *prv_cache_file(const gchar *udn)
+{
+	gchar *dir;
+	gchar *name;
+	gchar *file;
+
+	/* UDNs are chosen by the servers, so keep only characters that
+	   are safe in a file name */
+	name = g_strcanon(g_strdup(udn), G_CSET_a_2_z G_CSET_A_2_Z
+			  G_CSET_DIGITS "-.", '_');
+	dir = prv_cache_dir();
+	file = g_build_filename(dir, name, NULL);
+
+	g_free(dir);
+	g_free(name);
+
+	return file;
+}
+
+dls_device_cache_entry_t *dls_device_cache_entry_new(void)
+{
+	return g_new0(dls_device_cache_entry_t, 1);
+}
+
+void dls_device_cache_entry_delete(dls_device_cache_entry_t *entry)
+{
+	unsigned int i;
+
+	if (entry) {
+		for (i = 0; i < DLS_DEVICE_CACHE_VALUE_COUNT; ++i)
+			g_free(entry->values[i]);
+
+		g_free(entry);
+	}
+}
+
+gboolean dls_device_cache_entry_equal(const dls_device_cache_entry_t *a,
+				      const dls_device_cache_entry_t *b)
+{
+	unsigned int i;
+
+	for (i = 0; i < DLS_DEVICE_CACHE_VALUE_COUNT; ++i)
+		if (g_strcmp0(a->values[i], b->values[i]))
+			return FALSE;
+
+	return TRUE;
+}
+
+dls_device_cache_entry_t *dls_device_cache_load(const gchar *udn,
+						const gchar *config_id)
+{
+	GKeyFile *key_file;
+	gchar *file;
+	gchar *str;
+	gboolean match;
+	unsigned int i;
+	dls_device_cache_entry_t *entry = NULL;
+
+	file = prv_cache_file(udn);
+	key_file = g_key_file_new();
+
+	if (!g_key_file_load_from_file(key_file, file, G_KEY_FILE_NONE, NULL))
+		goto on_exit;
+
+	if (g_key_file_get_integer(key_file, DLS_DEVICE_CACHE_GROUP,
+				   DLS_DEVICE_CACHE_KEY_VERSION, NULL) !=
+	    DLS_DEVICE_CACHE_VERSION)
+		goto on_exit;
+
+	str = g_key_file_get_string(key_file, DLS_DEVICE_CACHE_GROUP,
+				    DLS_DEVICE_CACHE_KEY_UDN, NULL);
+	match = !g_strcmp0(str, udn);
+	g_free(str);
+
+	if (!match)
+		goto on_exit;
+
+	str = g_key_file_get_string(key_file, DLS_DEVICE_CACHE_GROUP,
+				    DLS_DEVICE_CACHE_KEY_CONFIG_ID, NULL);
+	match = !g_strcmp0(str, config_id ? config_id : "");
+	g_free(str);
+
+	if (!match) {
+		DLEYNA_LOG_DEBUG("Cache for %s is stale: configId changed",
+				 udn);
+		goto on_exit;
+	}
+
+	entry = dls_device_cache_entry_new();
+
+	for (i = 0; i < DLS_DEVICE_CACHE_VALUE_COUNT; ++i)
+		entry->values[i] = g_key_file_get_string(key_file,
+							 DLS_DEVICE_CACHE_GROUP,
+							 g_value_keys[i],
+							 NULL);
+
+	DLEYNA_LOG_DEBUG("Loaded cached capabilities for %s", udn);
+
+on_exit:
+
+	g_key_file_free(key_file);
+	g_free(file);
+
+	return entry;
+}
+
+void dls_device_cache_save(const gchar *udn, const gchar *config_id,
+			   const dls_device_cache_entry_t *entry)
+{
+	GKeyFile *key_file;
+	gchar *dir;
+	gchar *file = NULL;
+	gchar *data = NULL;
+	gsize length;
+	unsigned int i;
+	GError *error = NULL;
+
+	key_file = g_key_file_new();
+
+	g_key_file_set_integer(key_file, DLS_DEVICE_CACHE_GROUP,
+			       DLS_DEVICE_CACHE_KEY_VERSION,
+			       DLS_DEVICE_CACHE_VERSION);
+	g_key_file_set_string(key_file, DLS_DEVICE_CACHE_GROUP,
+			      DLS_DEVICE_CACHE_KEY_UDN, udn);
+	g_key_file_set_string(key_file, DLS_DEVICE_CACHE_GROUP,
+			      DLS_DEVICE_CACHE_KEY_CONFIG_ID,
+			      config_id ? config_id : "");
+
+	for (i = 0; i < DLS_DEVICE_CACHE_VALUE_COUNT; ++i)
+		if (entry->values[i])
+			g_key_file_set_string(key_file, DLS_DEVICE_CACHE_GROUP,
+					      g_value_keys[i],
+					      entry->values[i]);
+
+	dir = prv_cache_dir();
+	if (g_mkdir_with_parents(dir, 0700) < 0) {
+		DLEYNA_LOG_WARNING("Unable to create cache directory %s", dir);
+		goto on_exit;
+	}
+
+	file = prv_cache_file(udn);
+	data = g_key_file_to_data(key_file, &length, NULL);
+
+	if (!g_file_set_contents(file, data, length, &error)) {
+		DLEYNA_LOG_WARNING("Unable to write cache file %s: %s", file,
+				   error->message);
+		g_error_free(error);
+		goto on_exit;
+	}
+
+	DLEYNA_LOG_DEBUG("Saved capabilities of %s to %s", udn, file);
+
+on_exit:
+
+	g_free(data);
+	g_free(file);
+	g_free(dir);
+	g_key_file_free(key_file);
+}
@@ -0,0 +1,55 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef DLS_DEVICE_CACHE_H__
+#define DLS_DEVICE_CACHE_H__
+
+#include <glib.h>
+
+enum dls_device_cache_value_t_ {
+	DLS_DEVICE_CACHE_SEARCH_CAPS,
+	DLS_DEVICE_CACHE_SORT_CAPS,
+	DLS_DEVICE_CACHE_SORT_EXT_CAPS,
+	DLS_DEVICE_CACHE_FEATURE_LIST,
+	DLS_DEVICE_CACHE_VALUE_COUNT
+};
+typedef enum dls_device_cache_value_t_ dls_device_cache_value_t;
+
+/* Raw ContentDirectory results, as returned by the server.  A NULL
+   value records an action the server failed or does not implement. */
+typedef struct dls_device_cache_entry_t_ dls_device_cache_entry_t;
+struct dls_device_cache_entry_t_ {
+	gchar *values[DLS_DEVICE_CACHE_VALUE_COUNT];
+};
+
+dls_device_cache_entry_t *dls_device_cache_entry_new(void);
+
+void dls_device_cache_entry_delete(dls_device_cache_entry_t *entry);
+
+gboolean dls_device_cache_entry_equal(const dls_device_cache_entry_t *a,
+				      const dls_device_cache_entry_t *b);
+
+dls_device_cache_entry_t *dls_device_cache_load(const gchar *udn,
+						const gchar *config_id);
+
+void dls_device_cache_save(const gchar *udn, const gchar *config_id,
+			   const dls_device_cache_entry_t *entry);
+
+#endif /* DLS_DEVICE_CACHE_H__ */
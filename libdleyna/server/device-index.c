@@ -0,0 +1,63 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "device-index.h"
+
+/* Maps the root path of every published server, awake or sleeping, to
+ * its device, so that resolving the target of a call does not scan the
+ * UDN maps.
+ */
+struct dls_device_index_t_ {
+	GHashTable *devices;
+};
+
+dls_device_index_t *dls_device_index_new(void)
+{
+	dls_device_index_t *index = g_new0(dls_device_index_t, 1);
+
+	index->devices = g_hash_table_new(g_str_hash, g_str_equal);
+
+	return index;
+}
+
+void dls_device_index_delete(dls_device_index_t *index)
+{
+	if (index) {
+		g_hash_table_unref(index->devices);
+		g_free(index);
+	}
+}
+
+gpointer dls_device_index_lookup(dls_device_index_t *index,
+				 const gchar *path)
+{
+	return g_hash_table_lookup(index->devices, path);
+}
+
+void dls_device_index_add(dls_device_index_t *index, const gchar *path,
+			  gpointer device)
+{
+	g_hash_table_insert(index->devices, (gpointer)path, device);
+}
+
+void dls_device_index_remove(dls_device_index_t *index, const gchar *path)
+{
+	(void) g_hash_table_remove(index->devices, path);
+}
@@ -0,0 +1,41 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef DLS_DEVICE_INDEX_H__
+#define DLS_DEVICE_INDEX_H__
+
+#include <glib.h>
+
+typedef struct dls_device_index_t_ dls_device_index_t;
+
+dls_device_index_t *dls_device_index_new(void);
+
+void dls_device_index_delete(dls_device_index_t *index);
+
+gpointer dls_device_index_lookup(dls_device_index_t *index,
+				 const gchar *path);
+
+/* The index borrows path, which must outlive the entry */
+void dls_device_index_add(dls_device_index_t *index, const gchar *path,
+			  gpointer device);
+
+void dls_device_index_remove(dls_device_index_t *index, const gchar *path);
+
+#endif /* DLS_DEVICE_INDEX_H__ */
@@ -33,8 +33,11 @@
 #endif
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <net/if.h>
 
+#include <glib/gstdio.h>
+
 #include <libgupnp/gupnp-error.h>
 #include <libgupnp-dlna/gupnp-dlna-profile.h>
 #include <libgupnp-dlna/gupnp-dlna-profile-guesser.h>
@@ -47,7 +50,10 @@
 #include <libdleyna/core/log.h>
 #include <libdleyna/core/service-task.h>
 
+#include "cache.h"
 #include "device.h"
+#include "device-cache.h"
+#include "didl.h"
 #include "interface.h"
 #include "path.h"
 #include "server.h"
@@ -62,6 +68,7 @@
 			"urn:schemas-upnp-org:service:ContentDirectory"
 #define DLS_ENERGY_MANAGEMENT_SERVICE_TYPE \
 			"urn:schemas-upnp-org:service:EnergyManagement:1"
+#define DLS_UPLOAD_STATUS_QUEUED "QUEUED"
 #define DLS_UPLOAD_STATUS_IN_PROGRESS "IN_PROGRESS"
 #define DLS_UPLOAD_STATUS_CANCELLED "CANCELLED"
 #define DLS_UPLOAD_STATUS_ERROR "ERROR"
@@ -70,6 +77,27 @@
 #define DLS_DEFAULT_WAKE_PORT 9
 #define DLS_DEFAULT_WAKE_ON_DELAY 30
 
+#define DLS_METADATA_CACHE_MAX_ENTRIES 256
+#define DLS_BROWSE_WINDOW_MAX_WINDOWS 8
+#define DLS_BROWSE_WINDOW_MAX_OBJECTS 2048
+#define DLS_CHILD_COUNT_CACHE_MAX_ENTRIES 1024
+#define DLS_DEFAULT_CHILD_COUNT_MAX_IN_FLIGHT 4
+#define DLS_DEFAULT_BROWSE_OBJECTS_MAX_IN_FLIGHT 4
+#define DLS_DEFAULT_BROWSE_OBJECTS_BATCH_SIZE 32
+#define DLS_DEFAULT_HTTP_MAX_CONNS_PER_HOST 4
+#define DLS_DEFAULT_MAX_CONCURRENT_UPLOADS 2
+#define DLS_DEFAULT_CHANGED_MAX_BATCH 256
+#define DLS_CHANGE_PARENTS_MAX_ENTRIES 4096
+#define DLS_CHANGE_PARENTS_MAX_DEPTH 32
+#define DLS_UPLOAD_CHUNK_SIZE (64 * 1024)
+#define DLS_UPLOAD_RETRY_DELAY 1000
+#define DLS_UPLOAD_RETRY_MAX_DELAY 60000
+#define DLS_DEFAULT_HTTP_IDLE_TIMEOUT 60
+#define DLS_PROFILE_CACHE_MAX_ENTRIES 128
+#define DLS_PROFILE_GUESS_TIMEOUT 5000
+#define DLS_PROFILE_GUESS_MAX_THREADS 2
+#define DLS_UPLOAD_MANY_MAX_IN_FLIGHT 4
+
 typedef gboolean(*dls_device_count_cb_t)(dls_async_task_t *cb_data,
 					 gint count);
 
@@ -77,6 +105,17 @@ typedef struct dls_device_count_data_t_ dls_device_count_data_t;
 struct dls_device_count_data_t_ {
 	dls_device_count_cb_t cb;
 	dls_async_task_t *cb_data;
+	gchar *id;
+};
+
+typedef struct dls_device_child_count_t_ dls_device_child_count_t;
+struct dls_device_child_count_t_ {
+	gchar *id;
+	GList *link;
+	guint count;
+	gboolean has_container_update_id;
+	guint container_update_id;
+	guint system_update_id;
 };
 
 typedef struct dls_device_object_builder_t_ dls_device_object_builder_t;
@@ -84,8 +123,28 @@ struct dls_device_object_builder_t_ {
 	GVariantBuilder *vb;
 	gchar *id;
 	gboolean needs_child_count;
+	gboolean has_container_update_id;
+	guint container_update_id;
+};
+
+typedef struct dls_device_count_request_t_ dls_device_count_request_t;
+struct dls_device_count_request_t_ {
+	dls_async_task_t *cb_data;
+	dls_device_object_builder_t *builder;
+	GUPnPServiceProxyAction *action;
+};
+
+typedef struct dls_device_upload_job_t_ dls_device_upload_job_t;
+struct dls_device_upload_job_t_ {
+	gint upload_id;
+	dls_device_t *device;
+	guint remove_idle;
 };
 
+/* The body is written in chunks of at most DLS_UPLOAD_CHUNK_SIZE bytes
+ * taken from data, or read from fd when the file was sent by descriptor,
+ * so that the rate limit can delay the next chunk.
+ */
 typedef struct dls_device_upload_t_ dls_device_upload_t;
 struct dls_device_upload_t_ {
 	SoupSession *soup_session;
@@ -93,16 +152,45 @@ struct dls_device_upload_t_ {
 	GMappedFile *mapped_file;
 	gchar *body;
 	gsize body_length;
+	gint fd;
+	gchar *mime_type;
+	const gchar *data;
+	gsize offset;
+	gsize start_offset;
+	guint resume_id;
+	guint retry_id;
+	guint retries;
+	gboolean probing;
+	gboolean verifying;
+	gboolean resume_unsupported;
+	gboolean read_error;
+	dls_device_upload_job_t *job;
 	const gchar *status;
 	guint64 bytes_uploaded;
 	guint64 bytes_to_upload;
+	guint64 bytes_reported;
 };
 
-typedef struct dls_device_upload_job_t_ dls_device_upload_job_t;
-struct dls_device_upload_job_t_ {
-	gint upload_id;
-	dls_device_t *device;
-	guint remove_idle;
+typedef struct dls_device_browse_request_t_ dls_device_browse_request_t;
+struct dls_device_browse_request_t_ {
+	dls_async_task_t *cb_data;
+	guint slot;
+	guint object;
+	gchar *id;
+	GUPnPServiceProxyAction *action;
+	GVariantBuilder *vb;
+	GHashTable *batch;
+};
+
+/* A file of an UploadMany call whose DLNA profile is being guessed, when
+ * action is NULL, or whose CreateObject is outstanding.
+ */
+typedef struct dls_device_upload_request_t_ dls_device_upload_request_t;
+struct dls_device_upload_request_t_ {
+	dls_async_task_t *cb_data;
+	guint file;
+	gchar *profile_key;
+	GUPnPServiceProxyAction *action;
 };
 
 typedef struct dls_device_download_t_ dls_device_download_t;
@@ -112,6 +200,47 @@ struct dls_device_download_t_ {
 	dls_async_task_t *task;
 };
 
+/* DIDL-Lite fragment returned by Browse(BrowseMetadata, "*") for an object,
+ * tagged with the SystemUpdateID that was current when it was retrieved.
+ */
+typedef struct dls_device_metadata_t_ dls_device_metadata_t;
+struct dls_device_metadata_t_ {
+	gchar *id;
+	gchar *didl;
+	guint system_update_id;
+};
+
+/* A Browse Result, kept as received and parsed again each time it is
+ * served.  count is the number of objects it holds.
+ */
+typedef struct dls_device_browse_page_t_ dls_device_browse_page_t;
+struct dls_device_browse_page_t_ {
+	guint start;
+	guint count;
+	gchar *didl;
+};
+
+/* Contiguous range [start, start + length) of the children of a
+ * container, as returned by BrowseDirectChildren for a given filter and
+ * sort order, held in consecutive pages.
+ */
+typedef struct dls_device_browse_window_t_ dls_device_browse_window_t;
+struct dls_device_browse_window_t_ {
+	gchar *id;
+	gchar *upnp_filter;
+	gchar *sort_by;
+	GPtrArray *pages;
+	guint start;
+	guint length;
+	guint total;
+	gboolean total_known;
+	guint system_update_id;
+	GUPnPServiceProxy *prefetch_proxy;
+	GUPnPServiceProxyAction *prefetch_action;
+	guint prefetch_start;
+	guint prefetch_count;
+};
+
 typedef struct dls_tcp_wake_t_ dls_tcp_wake_t;
 struct dls_tcp_wake_t_ {
 	GOutputStream *output_stream;
@@ -124,26 +253,43 @@ struct dls_tcp_wake_t_ {
 };
 
 /* Private structure used in chain task */
+typedef struct prv_capability_t_ prv_capability_t;
+struct prv_capability_t_ {
+	GUPnPServiceProxyAction *action;
+	dleyna_service_task_t *task;
+	gboolean done;
+	gchar *result;
+	gchar *error;
+};
+
 typedef struct prv_new_device_ct_t_ prv_new_device_ct_t;
 struct prv_new_device_ct_t_ {
 	dls_device_t *dev;
 	dleyna_connector_id_t connection;
 	const dleyna_connector_dispatch_cb_t *vtable;
 	GHashTable *property_map;
+	gchar *udn;
+	gchar *config_id;
+	dls_device_cache_entry_t *fetched;
+	dls_device_cache_entry_t *cached;
+	GUPnPServiceProxy *proxy;
+	prv_capability_t caps[DLS_DEVICE_CACHE_VALUE_COUNT];
 };
 
-enum prv_changed_event_type_t_ {
-	PRV_CHANGED_EVENT_ADD = 1,
-	PRV_CHANGED_EVENT_MOD,
-	PRV_CHANGED_EVENT_DEL,
-	PRV_CHANGED_EVENT_DONE,
-	PRV_CHANGED_EVENT_CONTAINER
+/* The objects a client asked SubscribeChanges to report, and the change
+ * types, as DLS_INTERFACE_CHANGES_* bits, it is interested in.
+ */
+typedef struct prv_change_subscription_t_ prv_change_subscription_t;
+struct prv_change_subscription_t_ {
+	GHashTable *paths;
+	guint flags;
 };
-typedef enum prv_changed_event_type_t_ prv_changed_event_type_t;
 
 static void prv_get_child_count(dls_async_task_t *cb_data,
 				dls_device_count_cb_t cb, const gchar *id);
 static void prv_retrieve_child_count_for_list(dls_async_task_t *cb_data);
+static void prv_child_count_for_list_fail(dls_async_task_t *cb_data,
+					  const gchar *message);
 static void prv_container_update_cb(GUPnPServiceProxy *proxy,
 				const char *variable,
 				GValue *value,
@@ -162,22 +308,54 @@ static void prv_network_interface_info_cb(GUPnPServiceProxy *proxy,
 				gpointer user_data);
 static void prv_upload_delete(gpointer up);
 static void prv_upload_job_delete(gpointer up);
+static void prv_browse_flights_cancel(dls_device_t *device);
 static void prv_get_sr_token_for_props(GUPnPServiceProxy *proxy,
 			     const dls_device_t *device,
 			     dls_async_task_t *cb_data);
-static void prv_browse_objects_end_action_cb(GUPnPServiceProxy *proxy,
-					     GUPnPServiceProxyAction *action,
-					     gpointer user_data);
-static GUPnPServiceProxyAction *prv_browse_objects_begin_action_cb(
-						dleyna_service_task_t *task,
-						GUPnPServiceProxy *proxy,
-						gboolean *failed);
+static void prv_browse_objects_next(dls_async_task_t *cb_data);
 
 static void prv_get_sleeping_for_props(GUPnPServiceProxy *proxy,
 			     const dls_device_t *device,
 			     dls_async_task_t *cb_data);
 
 static void prv_free_network_if_info(dls_network_if_info_t *info);
+static gboolean prv_cds_subscribed(const dls_device_t *device);
+static void prv_revalidate_delete(dls_device_revalidate_t *revalidate);
+static void prv_changed_clear(dls_device_t *device);
+
+static guint64 g_metadata_cache_hits;
+static guint64 g_metadata_cache_misses;
+static guint g_child_count_max_in_flight =
+					DLS_DEFAULT_CHILD_COUNT_MAX_IN_FLIGHT;
+static guint g_browse_objects_max_in_flight =
+					DLS_DEFAULT_BROWSE_OBJECTS_MAX_IN_FLIGHT;
+static guint g_browse_objects_batch_size =
+					DLS_DEFAULT_BROWSE_OBJECTS_BATCH_SIZE;
+static guint g_http_max_conns_per_host = DLS_DEFAULT_HTTP_MAX_CONNS_PER_HOST;
+static guint g_http_idle_timeout = DLS_DEFAULT_HTTP_IDLE_TIMEOUT;
+static guint g_http_settings_generation = 1;
+static guint64 g_http_requests;
+static guint64 g_http_connections;
+static guint g_max_concurrent_uploads = DLS_DEFAULT_MAX_CONCURRENT_UPLOADS;
+static guint g_upload_rate_limit;
+static gboolean g_upload_smallest_first;
+static guint g_upload_progress_interval;
+static guint g_upload_progress_step;
+static guint g_upload_max_retries;
+static guint g_changed_flush_interval;
+static guint g_changed_max_batch = DLS_DEFAULT_CHANGED_MAX_BATCH;
+static guint64 g_changed_events_received;
+static guint64 g_changed_signals_emitted;
+static guint64 g_subscribed_changes_emitted;
+
+/* The guesser loads every DLNA profile when created, so each thread of
+ * the profiling pool creates one and keeps it for its lifetime.  Guesses
+ * are cached by file identity; an empty string records that no profile
+ * matched.
+ */
+static GThreadPool *g_profile_pool;
+static GPrivate g_profile_guesser = G_PRIVATE_INIT(g_object_unref);
+static dls_string_cache_t *g_profile_cache;
 
 static void prv_object_builder_delete(void *dob)
 {
@@ -201,2512 +379,3295 @@ static void prv_count_data_new(dls_async_task_t *cb_data,
 	cd = g_new(dls_device_count_data_t, 1);
 	cd->cb = cb;
 	cd->cb_data = cb_data;
+	cd->id = NULL;
 
 	*count_data = cd;
 }
 
-static void prv_context_unsubscribe(dls_device_context_t *ctx)
+static void prv_metadata_delete(dls_device_metadata_t *metadata)
 {
-	if (ctx->cds.timeout_id) {
-		(void) g_source_remove(ctx->cds.timeout_id);
-		ctx->cds.timeout_id = 0;
-	}
+	g_free(metadata->id);
+	g_free(metadata->didl);
+	g_free(metadata);
+}
 
-	if (ctx->ems.timeout_id) {
-		(void) g_source_remove(ctx->ems.timeout_id);
-		ctx->ems.timeout_id = 0;
-	}
+static void prv_context_metadata_remove(dls_device_context_t *context,
+					const gchar *id)
+{
+	GList *link;
 
-	if (ctx->cds.subscribed) {
-		gupnp_service_proxy_remove_notify(ctx->cds.proxy,
-						  DLS_SYSTEM_UPDATE_VAR,
-						  prv_system_update_cb,
-						  ctx->device);
-		gupnp_service_proxy_remove_notify(ctx->cds.proxy,
-						  DLS_CONTAINER_UPDATE_VAR,
-						  prv_container_update_cb,
-						  ctx->device);
-		gupnp_service_proxy_remove_notify(ctx->cds.proxy,
-						  DLS_LAST_CHANGE_VAR,
-						  prv_last_change_cb,
-						  ctx->device);
+	if (!context->metadata_cache)
+		return;
 
-		gupnp_service_proxy_set_subscribed(ctx->cds.proxy, FALSE);
+	link = g_hash_table_lookup(context->metadata_cache, id);
+	if (!link)
+		return;
 
-		ctx->cds.subscribed = FALSE;
-	}
+	(void) g_hash_table_remove(context->metadata_cache, id);
+	g_queue_unlink(&context->metadata_lru, link);
+	prv_metadata_delete(link->data);
+	g_list_free_1(link);
+}
 
-	if (ctx->ems.subscribed) {
-		gupnp_service_proxy_remove_notify(
-						ctx->ems.proxy,
-						DLS_NETWORK_INTERFACE_INFO_VAR,
-						prv_network_interface_info_cb,
-						ctx->device);
+static void prv_context_metadata_clear(dls_device_context_t *context)
+{
+	if (!context->metadata_cache)
+		return;
 
-		gupnp_service_proxy_set_subscribed(ctx->ems.proxy, FALSE);
+	g_hash_table_remove_all(context->metadata_cache);
 
-		ctx->ems.subscribed = FALSE;
+	while (!g_queue_is_empty(&context->metadata_lru))
+		prv_metadata_delete(g_queue_pop_head(&context->metadata_lru));
+}
+
+static void prv_metadata_cache_remove(dls_device_t *device, const gchar *id)
+{
+	unsigned int i;
+
+	for (i = 0; i < device->contexts->len; ++i)
+		prv_context_metadata_remove(
+				g_ptr_array_index(device->contexts, i), id);
+}
+
+static void prv_metadata_cache_clear(dls_device_t *device)
+{
+	unsigned int i;
+
+	for (i = 0; i < device->contexts->len; ++i)
+		prv_context_metadata_clear(
+				g_ptr_array_index(device->contexts, i));
+}
+
+/* The DIDL of an object holds res URLs that depend on the network
+ * interface it was browsed through, so each context has its own cache.
+ * Entries are only trusted while we receive the CDS events that would tell
+ * us they are stale, and while the SystemUpdateID they were fetched under
+ * is still current.  Lookups made while unsubscribed could not have been
+ * served from the cache and are not counted as misses.
+ */
+static const gchar *prv_metadata_cache_lookup(dls_device_context_t *context,
+					      const gchar *id)
+{
+	dls_device_t *device = context->device;
+	GList *link = NULL;
+	dls_device_metadata_t *metadata;
+	const gchar *retval = NULL;
+
+	if (!prv_cds_subscribed(device))
+		return retval;
+
+	if (context->metadata_cache)
+		link = g_hash_table_lookup(context->metadata_cache, id);
+
+	if (!link)
+		goto on_miss;
+
+	metadata = link->data;
+
+	if (metadata->system_update_id != device->system_update_id) {
+		prv_context_metadata_remove(context, id);
+		goto on_miss;
 	}
+
+	g_queue_unlink(&context->metadata_lru, link);
+	g_queue_push_head_link(&context->metadata_lru, link);
+
+	device->metadata_cache_hits++;
+	g_metadata_cache_hits++;
+	retval = metadata->didl;
+
+	DLEYNA_LOG_DEBUG("Metadata cache hit for %s", id);
+
+	return retval;
+
+on_miss:
+
+	device->metadata_cache_misses++;
+	g_metadata_cache_misses++;
+
+	return retval;
 }
 
-void dls_device_delete_context(dls_device_context_t *ctx)
+static void prv_metadata_cache_insert(dls_device_context_t *context,
+				      const gchar *id, const gchar *didl)
 {
-	if (ctx) {
-		prv_context_unsubscribe(ctx);
+	dls_device_metadata_t *metadata;
 
-		if (ctx->device_info)
-			g_object_unref(ctx->device_info);
+	if (!prv_cds_subscribed(context->device))
+		return;
 
-		if (ctx->device_proxy)
-			g_object_unref(ctx->device_proxy);
+	if (!context->metadata_cache)
+		context->metadata_cache = g_hash_table_new(g_str_hash,
+							   g_str_equal);
+	else
+		prv_context_metadata_remove(context, id);
 
-		if (ctx->cds.proxy)
-			g_object_unref(ctx->cds.proxy);
+	metadata = g_new(dls_device_metadata_t, 1);
+	metadata->id = g_strdup(id);
+	metadata->didl = g_strdup(didl);
+	metadata->system_update_id = context->device->system_update_id;
 
-		if (ctx->ems.proxy)
-			g_object_unref(ctx->ems.proxy);
+	g_queue_push_head(&context->metadata_lru, metadata);
+	g_hash_table_insert(context->metadata_cache, metadata->id,
+			    context->metadata_lru.head);
 
-		g_free(ctx->ip_address);
-		g_free(ctx);
+	if (g_queue_get_length(&context->metadata_lru) >
+	    DLS_METADATA_CACHE_MAX_ENTRIES) {
+		metadata = g_queue_peek_tail(&context->metadata_lru);
+		prv_context_metadata_remove(context, metadata->id);
 	}
 }
 
+/* Unlike the per device counters, the totals also cover the servers that
+ * have since disappeared.
+ */
+void dls_device_get_metadata_cache_stats(guint64 *hits, guint64 *misses)
+{
+	*hits = g_metadata_cache_hits;
+	*misses = g_metadata_cache_misses;
+}
 
-static GUPnPServiceInfo *prv_lookup_em_service(GUPnPDeviceInfo *device_info)
+static void prv_browse_window_delete(dls_device_browse_window_t *window)
 {
-	GList *child_devices;
+	if (window->prefetch_proxy) {
+		gupnp_service_proxy_cancel_action(window->prefetch_proxy,
+						  window->prefetch_action);
+		g_object_remove_weak_pointer(
+				G_OBJECT(window->prefetch_proxy),
+				(gpointer *)&window->prefetch_proxy);
+	}
+
+	g_ptr_array_unref(window->pages);
+	g_free(window->id);
+	g_free(window->upnp_filter);
+	g_free(window->sort_by);
+	g_free(window);
+}
+
+static void prv_context_windows_remove(dls_device_context_t *context,
+				       const gchar *id)
+{
+	GList *link = context->browse_windows.head;
 	GList *next;
-	GUPnPDeviceInfo *child_info = NULL;
-	GUPnPServiceInfo *service_info = NULL;
+	dls_device_browse_window_t *window;
 
-	child_devices = gupnp_device_info_list_devices(device_info);
+	while (link) {
+		next = link->next;
+		window = link->data;
 
-	next = child_devices;
-	while (next != NULL) {
-		child_info = (GUPnPDeviceInfo *)next->data;
+		if (!strcmp(window->id, id)) {
+			g_queue_delete_link(&context->browse_windows, link);
+			prv_browse_window_delete(window);
+		}
 
-		service_info = gupnp_device_info_get_service(child_info,
-					  DLS_ENERGY_MANAGEMENT_SERVICE_TYPE);
+		link = next;
+	}
+}
 
-		if (service_info != NULL)
-			break;
+static void prv_context_windows_clear(dls_device_context_t *context)
+{
+	while (!g_queue_is_empty(&context->browse_windows))
+		prv_browse_window_delete(
+				g_queue_pop_head(&context->browse_windows));
+}
 
-		service_info = prv_lookup_em_service(child_info);
+static void prv_browse_window_remove_container(dls_device_t *device,
+					       const gchar *id)
+{
+	unsigned int i;
 
-		if (service_info != NULL)
+	for (i = 0; i < device->contexts->len; ++i)
+		prv_context_windows_remove(
+				g_ptr_array_index(device->contexts, i), id);
+}
+
+static void prv_browse_window_clear(dls_device_t *device)
+{
+	unsigned int i;
+
+	for (i = 0; i < device->contexts->len; ++i)
+		prv_context_windows_clear(
+				g_ptr_array_index(device->contexts, i));
+}
+
+/* Like the metadata cache, windows are kept per context: the objects they
+ * hold carry the res URLs of that context, and pages are prefetched
+ * through its CDS proxy.
+ */
+static dls_device_browse_window_t *prv_browse_window_find(
+						dls_device_context_t *context,
+						const gchar *id,
+						const gchar *upnp_filter,
+						const gchar *sort_by)
+{
+	dls_device_t *device = context->device;
+	GList *link;
+	dls_device_browse_window_t *window = NULL;
+
+	for (link = context->browse_windows.head; link; link = link->next) {
+		window = link->data;
+
+		if (!strcmp(window->id, id) &&
+		    !strcmp(window->upnp_filter, upnp_filter) &&
+		    !strcmp(window->sort_by, sort_by))
 			break;
+	}
 
-		next = g_list_next(next);
+	if (!link)
+		return NULL;
+
+	if (!prv_cds_subscribed(device) ||
+	    window->system_update_id != device->system_update_id) {
+		g_queue_delete_link(&context->browse_windows, link);
+		prv_browse_window_delete(window);
+
+		return NULL;
 	}
 
-	g_list_free_full(child_devices, g_object_unref);
+	g_queue_unlink(&context->browse_windows, link);
+	g_queue_push_head_link(&context->browse_windows, link);
 
-	return service_info;
+	return window;
 }
 
-static void prv_context_new(const gchar *ip_address,
-				GUPnPDeviceProxy *proxy,
-				GUPnPDeviceInfo *device_info,
-				dls_device_t *device,
-				dls_device_context_t **context)
+static gboolean prv_browse_window_covers(dls_device_browse_window_t *window,
+					 guint start, guint count)
 {
-	dls_device_context_t *ctx = g_new(dls_device_context_t, 1);
+	guint end = window->start + window->length;
 
-	ctx->ip_address = g_strdup(ip_address);
-	ctx->device_proxy = proxy;
-	ctx->device_info = device_info;
+	if (start < window->start)
+		return FALSE;
 
-	ctx->device = device;
-	ctx->cds.subscribed = FALSE;
-	ctx->cds.timeout_id = 0;
-	ctx->ems.subscribed = FALSE;
-	ctx->ems.timeout_id = 0;
+	if (window->total_known && (count == 0 || start + count > window->total))
+		return end >= window->total;
 
-	g_object_ref(proxy);
-	g_object_ref(device_info);
+	return count != 0 && start + count <= end;
+}
 
-	ctx->cds.proxy = (GUPnPServiceProxy *)
-				     gupnp_device_info_get_service(
-					   device_info,
-					   DLS_CONTENT_DIRECTORY_SERVICE_TYPE);
+static void prv_browse_page_delete(gpointer data)
+{
+	dls_device_browse_page_t *page = data;
 
-	ctx->ems.proxy = (GUPnPServiceProxy *)
-				     gupnp_device_info_get_service(
-					   (GUPnPDeviceInfo *)proxy,
-					   DLS_ENERGY_MANAGEMENT_SERVICE_TYPE);
+	g_free(page->didl);
+	g_free(page);
+}
 
-	if (ctx->ems.proxy == NULL)
-		ctx->ems.proxy = (GUPnPServiceProxy *)
-				     prv_lookup_em_service(
-					   (GUPnPDeviceInfo *)proxy);
+static void prv_browse_window_append(dls_device_browse_window_t *window,
+				     guint start, guint count,
+				     const gchar *didl, guint length,
+				     guint total_matches)
+{
+	dls_device_browse_page_t *page;
 
-	*context = ctx;
+	if (length) {
+		page = g_new(dls_device_browse_page_t, 1);
+		page->start = start;
+		page->count = length;
+		page->didl = g_strdup(didl);
+		g_ptr_array_add(window->pages, page);
+		window->length += length;
+	}
+
+	/* A short page tells us where the container ends.  Otherwise trust
+	 * TotalMatches, which servers may leave at 0 when unknown.
+	 */
+	if (count == 0 || length < count) {
+		window->total = start + length;
+		window->total_known = TRUE;
+	} else if (total_matches > 0) {
+		window->total = total_matches;
+		window->total_known = TRUE;
+	}
 }
 
-void dls_device_delete(void *device)
+/* Drops the pages that do not end by start.  Pages cannot be split, so
+ * this fails if start is not on a page boundary.
+ */
+static gboolean prv_browse_window_truncate(dls_device_browse_window_t *window,
+					   guint start)
 {
-	dls_device_t *dev = device;
+	dls_device_browse_page_t *page;
 
-	if (dev) {
-		DLEYNA_LOG_DEBUG("Deleting device");
+	while (window->pages->len) {
+		page = g_ptr_array_index(window->pages, window->pages->len - 1);
 
-		dev->shutting_down = TRUE;
-		g_hash_table_unref(dev->upload_jobs);
-		g_hash_table_unref(dev->uploads);
+		if (page->start + page->count <= start)
+			break;
 
-		if (dev->timeout_id)
-			(void) g_source_remove(dev->timeout_id);
+		window->length -= page->count;
+		g_ptr_array_set_size(window->pages, window->pages->len - 1);
+	}
 
-		if (dev->id)
-			(void) dls_server_get_connector()->unpublish_subtree(
-						dev->connection, dev->id);
+	return window->start + window->length == start;
+}
 
-		prv_free_network_if_info(dev->network_if_info);
+/* Merges a freshly browsed page into the window of its container.  Pages
+ * that neither overlap nor extend the cached range replace it.
+ */
+static dls_device_browse_window_t *prv_browse_window_store(
+						dls_device_context_t *context,
+						const gchar *id,
+						const gchar *upnp_filter,
+						const gchar *sort_by,
+						guint start, guint count,
+						const gchar *didl,
+						guint length,
+						guint total_matches)
+{
+	dls_device_t *device = context->device;
+	dls_device_browse_window_t *window;
+	guint end;
+
+	if (!prv_cds_subscribed(device))
+		return NULL;
+
+	window = prv_browse_window_find(context, id, upnp_filter, sort_by);
+
+	if (window) {
+		end = window->start + window->length;
+
+		if (start < window->start || start > end ||
+		    !prv_browse_window_truncate(window, start) ||
+		    start - window->start + length >
+		    DLS_BROWSE_WINDOW_MAX_OBJECTS) {
+			g_ptr_array_set_size(window->pages, 0);
+			window->start = start;
+			window->length = 0;
+			window->total_known = FALSE;
+		}
+	} else {
+		if (length > DLS_BROWSE_WINDOW_MAX_OBJECTS)
+			return NULL;
 
-		g_ptr_array_unref(dev->contexts);
-		dls_device_delete_context(dev->sleeping_context);
+		window = g_new0(dls_device_browse_window_t, 1);
+		window->id = g_strdup(id);
+		window->upnp_filter = g_strdup(upnp_filter);
+		window->sort_by = g_strdup(sort_by);
+		window->pages = g_ptr_array_new_with_free_func(
+						prv_browse_page_delete);
+		window->start = start;
+		window->system_update_id = device->system_update_id;
 
-		if (dev->wake_on_timeout_id)
-			(void) g_source_remove(dev->wake_on_timeout_id);
+		g_queue_push_head(&context->browse_windows, window);
 
-		g_free(dev->path);
-		g_variant_unref(dev->search_caps);
-		g_variant_unref(dev->sort_caps);
-		g_variant_unref(dev->sort_ext_caps);
-		g_variant_unref(dev->feature_list);
-		g_free(dev->icon.mime_type);
-		g_free(dev->icon.bytes);
-		g_free(dev);
+		if (g_queue_get_length(&context->browse_windows) >
+		    DLS_BROWSE_WINDOW_MAX_WINDOWS)
+			prv_browse_window_delete(
+				g_queue_pop_tail(&context->browse_windows));
 	}
+
+	prv_browse_window_append(window, start, count, didl, length,
+				 total_matches);
+
+	return window;
 }
 
-void dls_device_unsubscribe(void *device)
+static void prv_browse_window_count(const dls_didl_object_t *object,
+				    gpointer user_data)
 {
-	unsigned int i;
-	dls_device_t *dev = device;
-	dls_device_context_t *context;
+	guint *length = user_data;
 
-	if (dev) {
-		for (i = 0; i < dev->contexts->len; ++i) {
-			context = g_ptr_array_index(dev->contexts, i);
-			prv_context_unsubscribe(context);
-		}
-	}
+	(*length)++;
 }
 
-static void prv_last_change_decode(GUPnPCDSLastChangeEntry *entry,
-				   GVariantBuilder *array,
-				   const char *root_path)
+static void prv_browse_window_prefetch_cb(GUPnPServiceProxy *proxy,
+					  GUPnPServiceProxyAction *action,
+					  gpointer user_data)
 {
-	GUPnPCDSLastChangeEvent event;
-	const char *object_id;
-	const char *parent_id;
-	const char *mclass;
-	const char *media_class;
-	const char *media_class_ex;
-	char *parent_path;
-	char *path = NULL;
-	gboolean sub_update;
-	guint32 update_id;
-	GVariantBuilder *dict;
-	gboolean mod;
-
-	dict = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+	dls_device_browse_window_t *window = user_data;
+	GError *error = NULL;
+	gchar *result = NULL;
+	guint total_matches = 0;
+	guint length = 0;
+	guint start = window->prefetch_start;
+	guint count = window->prefetch_count;
+
+	g_object_remove_weak_pointer(G_OBJECT(window->prefetch_proxy),
+				     (gpointer *)&window->prefetch_proxy);
+	window->prefetch_proxy = NULL;
+	window->prefetch_action = NULL;
+
+	if (!gupnp_service_proxy_end_action(proxy, action, &error,
+					    "Result", G_TYPE_STRING, &result,
+					    "TotalMatches", G_TYPE_UINT,
+					    &total_matches,
+					    NULL) || (result == NULL)) {
+		DLEYNA_LOG_DEBUG("Prefetch of %s failed: %s", window->id,
+				 (error != NULL) ? error->message :
+				 "Invalid result");
+		goto on_error;
+	}
 
-	object_id = gupnp_cds_last_change_entry_get_object_id(entry);
-	if (!object_id)
+	/* The page is only parsed when served, so counting its objects is
+	 * all that is needed here.
+	 */
+	if (!dls_didl_parse(result, 0, prv_browse_window_count, &length,
+			    &error)) {
+		DLEYNA_LOG_DEBUG("Unable to parse prefetched page: %s",
+				 error->message);
 		goto on_error;
+	}
 
-	sub_update = gupnp_cds_last_change_entry_is_subtree_update(entry);
-	update_id = gupnp_cds_last_change_entry_get_update_id(entry);
-	path = dls_path_from_id(root_path, object_id);
-	event = gupnp_cds_last_change_entry_get_event(entry);
+	/* The window is deleted, and this action cancelled, as soon as the
+	 * container changes, so only the range needs checking here.
+	 */
+	if (start == window->start + window->length &&
+	    window->length + length <= DLS_BROWSE_WINDOW_MAX_OBJECTS)
+		prv_browse_window_append(window, start, count, result, length,
+					 total_matches);
 
-	switch (event) {
-	case GUPNP_CDS_LAST_CHANGE_EVENT_OBJECT_ADDED:
-		parent_id = gupnp_cds_last_change_entry_get_parent_id(entry);
-		if (!parent_id)
-			goto on_error;
+on_error:
 
-		mclass = gupnp_cds_last_change_entry_get_class(entry);
-		if (!mclass)
-			goto on_error;
+	if (error)
+		g_error_free(error);
 
-		media_class = dls_props_upnp_class_to_media_spec(mclass);
-		if (!media_class)
-			goto on_error;
+	g_free(result);
+}
 
-		media_class_ex = dls_props_upnp_class_to_media_spec_ex(mclass);
+static void prv_browse_window_prefetch(dls_device_browse_window_t *window,
+				       GUPnPServiceProxy *proxy,
+				       guint start, guint count)
+{
+	guint end = window->start + window->length;
+
+	if (window->prefetch_proxy || count == 0 || start + count < end ||
+	    (window->total_known && end >= window->total) ||
+	    window->length + count > DLS_BROWSE_WINDOW_MAX_OBJECTS)
+		return;
+
+	DLEYNA_LOG_DEBUG("Prefetching %u children of %s from %u", count,
+			 window->id, end);
+
+	window->prefetch_start = end;
+	window->prefetch_count = count;
+	window->prefetch_proxy = proxy;
+
+	g_object_add_weak_pointer(G_OBJECT(proxy),
+				  (gpointer *)&window->prefetch_proxy);
+
+	window->prefetch_action = gupnp_service_proxy_begin_action(
+					proxy, "Browse",
+					prv_browse_window_prefetch_cb,
+					window,
+					"ObjectID", G_TYPE_STRING, window->id,
+					"BrowseFlag", G_TYPE_STRING,
+					"BrowseDirectChildren",
+					"Filter", G_TYPE_STRING,
+					window->upnp_filter,
+					"StartingIndex", G_TYPE_INT, end,
+					"RequestedCount", G_TYPE_INT, count,
+					"SortCriteria", G_TYPE_STRING,
+					window->sort_by,
+					NULL);
+}
 
-		parent_path = dls_path_from_id(root_path, parent_id);
+static void prv_child_count_delete(gpointer data)
+{
+	dls_device_child_count_t *entry = data;
 
-		g_variant_builder_add(
-				dict, "{sv}",
-				DLS_INTERFACE_PROP_CHANGE_TYPE,
-				g_variant_new_uint32(PRV_CHANGED_EVENT_ADD));
-		g_variant_builder_add(
-				dict, "{sv}",
-				DLS_INTERFACE_PROP_PATH,
-				g_variant_new_string(path));
-		g_variant_builder_add(
-				dict, "{sv}",
-				DLS_INTERFACE_PROP_UPDATE_ID,
-				g_variant_new_uint32(update_id));
-		g_variant_builder_add(
-				dict, "{sv}",
-				DLS_INTERFACE_PROP_SUBTREE_UPDATE,
-				g_variant_new_boolean(sub_update));
-		g_variant_builder_add(
-				dict, "{sv}",
-				DLS_INTERFACE_PROP_PARENT,
-				g_variant_new_string(parent_path));
-		g_variant_builder_add(
-				dict, "{sv}",
-				DLS_INTERFACE_PROP_TYPE,
-				g_variant_new_string(media_class));
-		g_variant_builder_add(
-				dict, "{sv}",
-				DLS_INTERFACE_PROP_TYPE_EX,
-				g_variant_new_string(media_class_ex));
+	g_free(entry->id);
+	g_free(entry);
+}
 
-		g_free(parent_path);
-		break;
-	case GUPNP_CDS_LAST_CHANGE_EVENT_OBJECT_REMOVED:
-	case GUPNP_CDS_LAST_CHANGE_EVENT_OBJECT_MODIFIED:
-		mod = (event == GUPNP_CDS_LAST_CHANGE_EVENT_OBJECT_MODIFIED);
-		g_variant_builder_add(
-			dict, "{sv}",
-			DLS_INTERFACE_PROP_CHANGE_TYPE,
-			g_variant_new_uint32(mod ? PRV_CHANGED_EVENT_MOD :
-							PRV_CHANGED_EVENT_DEL));
-		g_variant_builder_add(
-				dict, "{sv}",
-				DLS_INTERFACE_PROP_PATH,
-				g_variant_new_string(path));
-		g_variant_builder_add(
-				dict, "{sv}",
-				DLS_INTERFACE_PROP_UPDATE_ID,
-				g_variant_new_uint32(update_id));
-		g_variant_builder_add(
-				dict, "{sv}",
-				DLS_INTERFACE_PROP_SUBTREE_UPDATE,
-				g_variant_new_boolean(sub_update));
-		break;
-	case GUPNP_CDS_LAST_CHANGE_EVENT_ST_DONE:
-		g_variant_builder_add(
-				dict, "{sv}",
-				DLS_INTERFACE_PROP_CHANGE_TYPE,
-				g_variant_new_uint32(PRV_CHANGED_EVENT_DONE));
-		g_variant_builder_add(
-				dict, "{sv}",
-				DLS_INTERFACE_PROP_PATH,
-				g_variant_new_string(path));
-		g_variant_builder_add(
-				dict, "{sv}",
-				DLS_INTERFACE_PROP_UPDATE_ID,
-				g_variant_new_uint32(update_id));
-		break;
-	case GUPNP_CDS_LAST_CHANGE_EVENT_INVALID:
-	default:
-		goto on_error;
-		break;
-	}
+/* A cached count stays valid while the container's ContainerUpdateID is
+ * unchanged or, for servers that do not expose it, while the device's
+ * SystemUpdateID has not moved.
+ */
+static gboolean prv_child_count_cache_lookup(dls_device_t *device,
+					     const gchar *id,
+					     gboolean has_container_update_id,
+					     guint container_update_id,
+					     guint *count)
+{
+	dls_device_child_count_t *entry = NULL;
 
-	g_variant_builder_add(array, "@a{sv}", g_variant_builder_end(dict));
+	if (device->child_counts)
+		entry = g_hash_table_lookup(device->child_counts, id);
 
+	if (!entry)
+		return FALSE;
 
-on_error:
+	g_queue_unlink(&device->child_count_lru, entry->link);
+	g_queue_push_head_link(&device->child_count_lru, entry->link);
 
-	g_variant_builder_unref(dict);
-	g_free(path);
+	if (has_container_update_id && entry->has_container_update_id) {
+		if (entry->container_update_id != container_update_id)
+			return FALSE;
+	} else if (!prv_cds_subscribed(device) ||
+		   entry->system_update_id != device->system_update_id) {
+		return FALSE;
+	}
+
+	*count = entry->count;
+
+	DLEYNA_LOG_DEBUG("Cached ChildCount for %s: %u", id, *count);
+
+	return TRUE;
 }
 
-static void prv_last_change_cb(GUPnPServiceProxy *proxy,
-			       const char *variable,
-			       GValue *value,
-			       gpointer user_data)
+static void prv_child_count_cache_insert(dls_device_t *device,
+					 const gchar *id,
+					 gboolean has_container_update_id,
+					 guint container_update_id,
+					 guint count)
 {
-	const gchar *last_change;
-	GVariantBuilder array;
-	GVariant *val;
-	dls_device_t *device = user_data;
-	GUPnPCDSLastChangeParser *parser;
-	GList *list;
-	GList *next;
-	GError *error = NULL;
-
-	last_change = g_value_get_string(value);
+	dls_device_child_count_t *entry;
 
-	DLEYNA_LOG_DEBUG_NL();
-	DLEYNA_LOG_DEBUG("LastChange XML: %s", last_change);
-	DLEYNA_LOG_DEBUG_NL();
+	if (!has_container_update_id && !prv_cds_subscribed(device))
+		return;
 
-	parser = gupnp_cds_last_change_parser_new();
-	list = gupnp_cds_last_change_parser_parse(parser, last_change, &error);
+	if (!device->child_counts) {
+		device->child_counts = g_hash_table_new_full(
+						g_str_hash, g_str_equal, NULL,
+						prv_child_count_delete);
+		entry = NULL;
+	} else {
+		entry = g_hash_table_lookup(device->child_counts, id);
+	}
 
-	if (error != NULL) {
-		DLEYNA_LOG_WARNING(
-			"gupnp_cds_last_change_parser_parse parsing failed: %s",
-			error->message);
-		goto on_error;
+	if (entry) {
+		g_queue_unlink(&device->child_count_lru, entry->link);
+		g_queue_push_head_link(&device->child_count_lru, entry->link);
+		goto on_update;
 	}
 
-	g_variant_builder_init(&array, G_VARIANT_TYPE("aa{sv}"));
-	next = list;
-	while (next) {
-		prv_last_change_decode(next->data, &array, device->path);
-		gupnp_cds_last_change_entry_unref(next->data);
-		next = g_list_next(next);
+	/* Only the least recently used count makes room for the new one */
+	if (g_hash_table_size(device->child_counts) >=
+	    DLS_CHILD_COUNT_CACHE_MAX_ENTRIES) {
+		entry = g_queue_pop_tail(&device->child_count_lru);
+		(void) g_hash_table_remove(device->child_counts, entry->id);
 	}
 
-	val = g_variant_new("(@aa{sv})", g_variant_builder_end(&array));
+	entry = g_new(dls_device_child_count_t, 1);
+	entry->id = g_strdup(id);
 
-	(void) dls_server_get_connector()->notify(device->connection,
-					   device->path,
-					   DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE,
-					   DLS_INTERFACE_CHANGED_EVENT,
-					   val,
-					   NULL);
+	g_queue_push_head(&device->child_count_lru, entry);
+	entry->link = device->child_count_lru.head;
 
-on_error:
+	g_hash_table_insert(device->child_counts, entry->id, entry);
 
-	g_list_free(list);
-	g_object_unref(parser);
+on_update:
 
-	if (error != NULL)
-		g_error_free(error);
+	entry->count = count;
+	entry->has_container_update_id = has_container_update_id;
+	entry->container_update_id = container_update_id;
+	entry->system_update_id = device->system_update_id;
 }
 
-static void prv_free_network_if_info(dls_network_if_info_t *info)
+static void prv_child_count_cache_remove(dls_device_t *device,
+					 const gchar *id)
 {
-	if (info != NULL) {
-		g_free(info->mac_address);
-		g_free(info->device_uuid);
-		g_free(info->network_if_mode);
-		g_free(info->wake_on_pattern);
-		g_free(info->wake_transport);
-		g_list_free_full(info->ip_addresses, g_free);
+	dls_device_child_count_t *entry = NULL;
 
-		g_free(info);
+	if (device->child_counts)
+		entry = g_hash_table_lookup(device->child_counts, id);
+
+	if (entry) {
+		g_queue_delete_link(&device->child_count_lru, entry->link);
+		(void) g_hash_table_remove(device->child_counts, id);
 	}
 }
 
-static dls_network_if_info_t *prv_get_network_if_info(xmlNode *device_if_node,
-						      const gchar *udn)
+guint dls_device_get_child_count_max_in_flight(void)
 {
-	dls_network_if_info_t *info = NULL;
-	GList *ipv4_addresses;
-	GList *ipv6_addresses;
-	gchar *wake_on_delay = NULL;
+	return g_child_count_max_in_flight;
+}
 
-	info = g_new0(dls_network_if_info_t, 1);
+void dls_device_set_child_count_max_in_flight(guint max_in_flight)
+{
+	g_child_count_max_in_flight = MAX(max_in_flight, 1);
+}
 
-	ipv4_addresses = xml_util_get_child_string_list_content_by_name(
-							device_if_node,
-							"NetworkInterface",
-							"AssociatedIpAddresses",
-							"Ipv4",
-							NULL);
+guint dls_device_get_browse_objects_max_in_flight(void)
+{
+	return g_browse_objects_max_in_flight;
+}
 
-	ipv6_addresses = xml_util_get_child_string_list_content_by_name(
-							device_if_node,
-							"NetworkInterface",
-							"AssociatedIpAddresses",
-							"Ipv6",
-							NULL);
+void dls_device_set_browse_objects_max_in_flight(guint max_in_flight)
+{
+	g_browse_objects_max_in_flight = MAX(max_in_flight, 1);
+}
 
-	info->ip_addresses = g_list_concat(ipv4_addresses, ipv6_addresses);
+guint dls_device_get_browse_objects_batch_size(void)
+{
+	return g_browse_objects_batch_size;
+}
 
-	info->device_uuid = xml_util_get_child_string_content_by_name(
-						device_if_node,
-						"DeviceUUID",
-						NULL);
+void dls_device_set_browse_objects_batch_size(guint batch_size)
+{
+	g_browse_objects_batch_size = MAX(batch_size, 1);
+}
 
-	info->mac_address = xml_util_get_child_string_content_by_name(
-						device_if_node,
-						"NetworkInterface",
-						"MacAddress",
-						NULL);
+guint dls_device_get_http_max_conns_per_host(void)
+{
+	return g_http_max_conns_per_host;
+}
 
-	info->network_if_mode = xml_util_get_child_string_content_by_name(
-						device_if_node,
-						"NetworkInterface",
-						"NetworkInterfaceMode",
-						NULL);
+void dls_device_set_http_max_conns_per_host(guint max_conns)
+{
+	g_http_max_conns_per_host = MAX(max_conns, 1);
+	g_http_settings_generation++;
+}
 
-	info->wake_on_pattern = xml_util_get_child_string_content_by_name(
-						device_if_node,
-						"NetworkInterface",
-						"WakeOnPattern",
-						NULL);
+guint dls_device_get_http_idle_timeout(void)
+{
+	return g_http_idle_timeout;
+}
 
-	info->wake_transport = xml_util_get_child_string_content_by_name(
-						device_if_node,
-						"NetworkInterface",
-						"WakeSupportedTransport",
-						NULL);
+void dls_device_set_http_idle_timeout(guint timeout)
+{
+	g_http_idle_timeout = MAX(timeout, 1);
+	g_http_settings_generation++;
+}
 
-	wake_on_delay = xml_util_get_child_string_content_by_name(
-						device_if_node,
-						"NetworkInterface",
-						"MaxWakeOnDelay",
-						NULL);
+void dls_device_get_http_stats(guint64 *requests, guint64 *connections)
+{
+	*requests = g_http_requests;
+	*connections = g_http_connections;
+}
 
-	if (wake_on_delay == NULL) {
-		info->max_wake_on_delay = DLS_DEFAULT_WAKE_ON_DELAY;
-	} else {
-		info->max_wake_on_delay = atoi(wake_on_delay);
+guint dls_device_get_max_concurrent_uploads(void)
+{
+	return g_max_concurrent_uploads;
+}
 
-		g_free(wake_on_delay);
-	}
+void dls_device_set_max_concurrent_uploads(guint max_uploads)
+{
+	g_max_concurrent_uploads = MAX(max_uploads, 1);
+}
 
-	if ((info->device_uuid == NULL || strlen(info->device_uuid) > 70) ||
-	    (info->mac_address == NULL || strlen(info->mac_address) != 17) ||
-	    (info->network_if_mode == NULL) || (info->ip_addresses == NULL) ||
-	    (info->wake_on_pattern == NULL))
-		goto on_error;
-
-	if (strcmp(info->device_uuid, udn))
-		goto on_error;
-
-	return info;
-
-on_error:
-	prv_free_network_if_info(info);
-
-	return NULL;
+guint dls_device_get_upload_rate_limit(void)
+{
+	return g_upload_rate_limit;
 }
 
-static GList *prv_network_if_info_decode(const gchar *info, const gchar *udn)
+void dls_device_set_upload_rate_limit(guint rate_limit)
 {
-	xmlDoc *doc;
-	xmlNode *node;
-	GList *info_list = NULL;
-	dls_network_if_info_t *if_info;
+	g_upload_rate_limit = rate_limit;
+}
 
-	DLEYNA_LOG_DEBUG("Enter");
+const gchar *dls_device_get_upload_order(void)
+{
+	return g_upload_smallest_first ?
+		DLS_INTERFACE_UPLOAD_ORDER_SMALLEST_FIRST :
+		DLS_INTERFACE_UPLOAD_ORDER_FIFO;
+}
 
-	DLEYNA_LOG_DEBUG_NL();
-	DLEYNA_LOG_DEBUG("NetworkInterfaceInfo XML: %s", info);
-	DLEYNA_LOG_DEBUG_NL();
+gboolean dls_device_set_upload_order(const gchar *order)
+{
+	if (!strcmp(order, DLS_INTERFACE_UPLOAD_ORDER_FIFO))
+		g_upload_smallest_first = FALSE;
+	else if (!strcmp(order, DLS_INTERFACE_UPLOAD_ORDER_SMALLEST_FIRST))
+		g_upload_smallest_first = TRUE;
+	else
+		return FALSE;
 
-	doc = xmlParseMemory(info, strlen(info) + 1);
-	if (doc == NULL) {
-		DLEYNA_LOG_WARNING("XML: invalid document");
+	return TRUE;
+}
 
-		goto on_exit;
-	}
+guint dls_device_get_upload_progress_interval(void)
+{
+	return g_upload_progress_interval;
+}
 
-	node = xmlDocGetRootElement(doc);
-	if (node == NULL) {
-		DLEYNA_LOG_WARNING("XML: empty document");
+void dls_device_set_upload_progress_interval(guint interval)
+{
+	g_upload_progress_interval = interval;
+}
 
-		goto on_exit;
-	}
+guint dls_device_get_upload_progress_step(void)
+{
+	return g_upload_progress_step;
+}
 
-	if (node->name == NULL) {
-		DLEYNA_LOG_WARNING("XML: empty document name");
+void dls_device_set_upload_progress_step(guint step)
+{
+	g_upload_progress_step = step;
+}
 
-		goto on_exit;
-	}
+guint dls_device_get_upload_max_retries(void)
+{
+	return g_upload_max_retries;
+}
 
-	if (strcmp((char *)node->name, "NetworkInterfaceInfo")) {
-		DLEYNA_LOG_WARNING("XML: invalid document name");
+void dls_device_set_upload_max_retries(guint max_retries)
+{
+	g_upload_max_retries = max_retries;
+}
 
-		goto on_exit;
-	}
+guint dls_device_get_changed_flush_interval(void)
+{
+	return g_changed_flush_interval;
+}
 
-	for (node = node->children; node; node = node->next) {
-		if (node->name != NULL &&
-		    !strcmp((char *)node->name, "DeviceInterface")) {
-			if_info = prv_get_network_if_info(node, udn);
+void dls_device_set_changed_flush_interval(guint interval)
+{
+	g_changed_flush_interval = interval;
+}
 
-			if (if_info != NULL)
-				info_list = g_list_prepend(info_list, if_info);
-		}
-	}
+guint dls_device_get_changed_max_batch(void)
+{
+	return g_changed_max_batch;
+}
 
-on_exit:
-	DLEYNA_LOG_DEBUG("Exit");
+void dls_device_set_changed_max_batch(guint max_batch)
+{
+	g_changed_max_batch = max_batch;
+}
 
-	if (doc != NULL)
-		xmlFreeDoc(doc);
+void dls_device_get_changed_stats(guint64 *received, guint64 *emitted,
+				  guint64 *subscribed)
+{
+	*received = g_changed_events_received;
+	*emitted = g_changed_signals_emitted;
+	*subscribed = g_subscribed_changes_emitted;
+}
 
-	return info_list;
+static void prv_http_request_queued(SoupSession *session, SoupMessage *msg,
+				    gpointer user_data)
+{
+	g_http_requests++;
 }
 
-static gboolean prv_get_device_sleeping_state(dls_device_t *device,
-					      const gchar *network_if_info_xml,
-					      gboolean *sleeping)
+static void prv_http_connection_created(SoupSession *session,
+					GObject *connection,
+					gpointer user_data)
 {
-	dls_network_if_info_t *info;
-	GList *info_list;
-	GList *next;
-	unsigned int i;
-	dls_device_context_t *ctx;
-	gboolean found = FALSE;
-	const gchar *udn;
-	GList *next_ip;
-	guint ip_idx;
-	gchar *ip_address;
+	g_http_connections++;
+}
 
-	DLEYNA_LOG_DEBUG("Enter");
+/* Uploads and icon downloads of a device share one session, so that
+ * connections to the server are kept alive and reused between requests.
+ * The session picks up changes of the HTTP settings on its next use.
+ */
+static SoupSession *prv_get_http_session(dls_device_t *device)
+{
+	if (!device->http_session) {
+		device->http_session = soup_session_async_new();
 
-	if (device->contexts->len == 0)
-		goto on_exit;
+		g_signal_connect(device->http_session, "request-queued",
+				 G_CALLBACK(prv_http_request_queued), NULL);
+		g_signal_connect(device->http_session, "connection-created",
+				 G_CALLBACK(prv_http_connection_created), NULL);
+	}
 
-	ctx = g_ptr_array_index(device->contexts, 0);
+	if (device->http_settings_generation != g_http_settings_generation) {
+		g_object_set(device->http_session,
+			     SOUP_SESSION_MAX_CONNS_PER_HOST,
+			     g_http_max_conns_per_host,
+			     SOUP_SESSION_MAX_CONNS,
+			     g_http_max_conns_per_host * 2,
+			     SOUP_SESSION_IDLE_TIMEOUT,
+			     g_http_idle_timeout,
+			     NULL);
 
-	udn = gupnp_device_info_get_udn((GUPnPDeviceInfo *)ctx->device_proxy);
+		device->http_settings_generation = g_http_settings_generation;
+	}
 
-	info_list = prv_network_if_info_decode(network_if_info_xml, udn);
-	if (info_list == NULL) {
-		DLEYNA_LOG_DEBUG("no UDN match found.");
+	return device->http_session;
+}
 
-		goto on_exit;
+static void prv_context_unsubscribe(dls_device_context_t *ctx)
+{
+	if (ctx->cds.timeout_id) {
+		(void) g_source_remove(ctx->cds.timeout_id);
+		ctx->cds.timeout_id = 0;
 	}
 
-	DLEYNA_LOG_DEBUG("Device UUID = %s", udn);
+	if (ctx->ems.timeout_id) {
+		(void) g_source_remove(ctx->ems.timeout_id);
+		ctx->ems.timeout_id = 0;
+	}
 
-	next = info_list;
-	while (next != NULL) {
-		info = (dls_network_if_info_t *)next->data;
-		for (i = 0; i < device->contexts->len; ++i) {
-			ctx = g_ptr_array_index(device->contexts, i);
+	if (ctx->cds.subscribed) {
+		gupnp_service_proxy_remove_notify(ctx->cds.proxy,
+						  DLS_SYSTEM_UPDATE_VAR,
+						  prv_system_update_cb,
+						  ctx->device);
+		gupnp_service_proxy_remove_notify(ctx->cds.proxy,
+						  DLS_CONTAINER_UPDATE_VAR,
+						  prv_container_update_cb,
+						  ctx->device);
+		gupnp_service_proxy_remove_notify(ctx->cds.proxy,
+						  DLS_LAST_CHANGE_VAR,
+						  prv_last_change_cb,
+						  ctx->device);
 
-			DLEYNA_LOG_DEBUG("Context[%u] - IP address = %s",
-					 i, ctx->ip_address);
+		gupnp_service_proxy_set_subscribed(ctx->cds.proxy, FALSE);
 
-			next_ip = info->ip_addresses;
-			ip_idx = 0;
-			while (next_ip != NULL) {
-				ip_address = (gchar *)next_ip->data;
+		ctx->cds.subscribed = FALSE;
+	}
 
-				DLEYNA_LOG_DEBUG(
-				 "Network Interface Info - IP address #%u = %s",
-				 ip_idx, ip_address);
+	if (ctx->ems.subscribed) {
+		gupnp_service_proxy_remove_notify(
+						ctx->ems.proxy,
+						DLS_NETWORK_INTERFACE_INFO_VAR,
+						prv_network_interface_info_cb,
+						ctx->device);
 
-				if (!strcmp(ctx->ip_address, ip_address)) {
-					found = TRUE;
+		gupnp_service_proxy_set_subscribed(ctx->ems.proxy, FALSE);
 
-					DLEYNA_LOG_DEBUG("IP+UDN match found");
+		ctx->ems.subscribed = FALSE;
+	}
+}
 
-					break;
-				}
+void dls_device_delete_context(dls_device_context_t *ctx)
+{
+	GQueue waiters;
+	dls_async_task_t *cb_data;
 
-				next_ip = g_list_next(next_ip);
+	if (ctx) {
+		prv_context_unsubscribe(ctx);
 
-				ip_idx++;
-			}
+		/* Detach the waiters first, so that failing one does not hand
+		 * a slot of this context to the next.
+		 */
+		waiters = ctx->child_count_waiters;
+		g_queue_init(&ctx->child_count_waiters);
 
-			if (found)
-				break;
+		while ((cb_data = g_queue_pop_head(&waiters))) {
+			cb_data->ut.bas.count_waiting = FALSE;
+			prv_child_count_for_list_fail(cb_data,
+						      "Server interface lost");
 		}
 
-		next = g_list_next(next);
-
-		if (found)
-			break;
-	}
+		if (ctx->device_info)
+			g_object_unref(ctx->device_info);
 
-	if (!found) {
-		DLEYNA_LOG_DEBUG("IP+UDN match not found, use UDN match only");
+		if (ctx->device_proxy)
+			g_object_unref(ctx->device_proxy);
 
-		ctx = g_ptr_array_index(device->contexts, 0);
+		if (ctx->cds.proxy)
+			g_object_unref(ctx->cds.proxy);
 
-		info = (dls_network_if_info_t *)info_list->data;
+		if (ctx->ems.proxy)
+			g_object_unref(ctx->ems.proxy);
 
-		ip_idx = 0;
+		prv_context_windows_clear(ctx);
+		prv_context_metadata_clear(ctx);
+		if (ctx->metadata_cache)
+			g_hash_table_unref(ctx->metadata_cache);
 
-		found = TRUE;
+		g_free(ctx->ip_address);
+		g_free(ctx);
 	}
+}
 
-	info->ip_address_position = ip_idx;
 
-	DLEYNA_LOG_DEBUG("Matching Network Interface Info:");
-	DLEYNA_LOG_DEBUG("- Mode = %s", info->network_if_mode);
-	DLEYNA_LOG_DEBUG("- Wake-on IP address = %s",
-			 (gchar *)g_list_nth_data(info->ip_addresses, ip_idx));
+static GUPnPServiceInfo *prv_lookup_em_service(GUPnPDeviceInfo *device_info)
+{
+	GList *child_devices;
+	GList *next;
+	GUPnPDeviceInfo *child_info = NULL;
+	GUPnPServiceInfo *service_info = NULL;
 
-	if (!strcmp(info->network_if_mode, "IP-up"))
-		*sleeping = FALSE;
-	else
-		*sleeping = TRUE;
+	child_devices = gupnp_device_info_list_devices(device_info);
 
-	prv_free_network_if_info(device->network_if_info);
+	next = child_devices;
+	while (next != NULL) {
+		child_info = (GUPnPDeviceInfo *)next->data;
 
-	device->network_if_info = info;
+		service_info = gupnp_device_info_get_service(child_info,
+					  DLS_ENERGY_MANAGEMENT_SERVICE_TYPE);
 
-	info_list = g_list_remove(info_list, info);
+		if (service_info != NULL)
+			break;
 
-	g_list_free_full(info_list, (GDestroyNotify)prv_free_network_if_info);
+		service_info = prv_lookup_em_service(child_info);
 
-on_exit:
-	DLEYNA_LOG_DEBUG("Exit");
+		if (service_info != NULL)
+			break;
 
-	return found;
+		next = g_list_next(next);
+	}
+
+	g_list_free_full(child_devices, g_object_unref);
+
+	return service_info;
 }
 
-static void prv_network_interface_info_cb(GUPnPServiceProxy *proxy,
-					  const char *variable,
-					  GValue *value,
-					  gpointer user_data)
+static void prv_context_new(const gchar *ip_address,
+				GUPnPDeviceProxy *proxy,
+				GUPnPDeviceInfo *device_info,
+				dls_device_t *device,
+				dls_device_context_t **context)
 {
-	dls_device_t *device = user_data;
-	GVariantBuilder *array;
-	GVariant *val;
-	gboolean sleeping;
+	dls_device_context_t *ctx = g_new(dls_device_context_t, 1);
 
-	if (prv_get_device_sleeping_state(device,
-					  g_value_get_string(value),
-					  &sleeping)) {
-		device->sleeping = sleeping;
+	ctx->ip_address = g_strdup(ip_address);
+	ctx->device_proxy = proxy;
+	ctx->device_info = device_info;
 
-		array = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
-		g_variant_builder_add(array, "{sv}",
-				      DLS_INTERFACE_PROP_SLEEPING,
-				      g_variant_new_boolean(sleeping));
-		val = g_variant_new("(s@a{sv}as)",
-				    DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE,
-				    g_variant_builder_end(array),
-				    NULL);
+	ctx->device = device;
+	ctx->cds.subscribed = FALSE;
+	ctx->cds.timeout_id = 0;
+	ctx->ems.subscribed = FALSE;
+	ctx->ems.timeout_id = 0;
+	ctx->metadata_cache = NULL;
+	g_queue_init(&ctx->metadata_lru);
+	g_queue_init(&ctx->browse_windows);
+	ctx->child_counts_in_flight = 0;
+	g_queue_init(&ctx->child_count_waiters);
 
-		(void) dls_server_get_connector()->notify(device->connection,
-					      device->path,
-					      DLS_INTERFACE_PROPERTIES,
-					      DLS_INTERFACE_PROPERTIES_CHANGED,
-					      val,
-					      NULL);
+	g_object_ref(proxy);
+	g_object_ref(device_info);
 
-		g_variant_builder_unref(array);
-	}
+	ctx->cds.proxy = (GUPnPServiceProxy *)
+				     gupnp_device_info_get_service(
+					   device_info,
+					   DLS_CONTENT_DIRECTORY_SERVICE_TYPE);
+
+	ctx->ems.proxy = (GUPnPServiceProxy *)
+				     gupnp_device_info_get_service(
+					   (GUPnPDeviceInfo *)proxy,
+					   DLS_ENERGY_MANAGEMENT_SERVICE_TYPE);
+
+	if (ctx->ems.proxy == NULL)
+		ctx->ems.proxy = (GUPnPServiceProxy *)
+				     prv_lookup_em_service(
+					   (GUPnPDeviceInfo *)proxy);
+
+	*context = ctx;
 }
 
-static void prv_build_container_update_array(const gchar *root_path,
-					     const gchar *value,
-					     GVariantBuilder *builder)
+void dls_device_delete(void *device)
 {
-	gchar **str_array;
-	int pos = 0;
-	gchar *path;
-	guint id;
+	dls_device_t *dev = device;
 
-	str_array = g_strsplit(value, ",", 0);
+	if (dev) {
+		DLEYNA_LOG_DEBUG("Deleting device");
 
-	DLEYNA_LOG_DEBUG_NL();
+		dev->shutting_down = TRUE;
+		g_queue_clear(&dev->upload_queue);
+		if (dev->upload_progress_id)
+			(void) g_source_remove(dev->upload_progress_id);
+		g_hash_table_unref(dev->upload_jobs);
+		g_hash_table_unref(dev->uploads);
 
-	while (str_array[pos] && str_array[pos + 1]) {
-		path = dls_path_from_id(root_path, str_array[pos++]);
-		id = atoi(str_array[pos++]);
-		g_variant_builder_add(builder, "(ou)", path, id);
-		DLEYNA_LOG_DEBUG("@Id [%s] - Path [%s] - id[%d]",
-				 str_array[pos-2], path, id);
-		g_free(path);
+		if (dev->http_session) {
+			soup_session_abort(dev->http_session);
+			g_object_unref(dev->http_session);
+		}
+
+		if (dev->timeout_id)
+			(void) g_source_remove(dev->timeout_id);
+
+		if (dev->revalidate)
+			prv_revalidate_delete(dev->revalidate);
+
+		prv_changed_clear(dev);
+		prv_browse_flights_cancel(dev);
+		if (dev->change_subscriptions)
+			g_hash_table_unref(dev->change_subscriptions);
+		dls_string_cache_delete(dev->change_parents);
+
+		if (dev->id)
+			(void) dls_server_get_connector()->unpublish_subtree(
+						dev->connection, dev->id);
+
+		prv_free_network_if_info(dev->network_if_info);
+
+		g_ptr_array_unref(dev->contexts);
+		dls_device_delete_context(dev->sleeping_context);
+
+		if (dev->wake_on_timeout_id)
+			(void) g_source_remove(dev->wake_on_timeout_id);
+
+		g_free(dev->path);
+		g_variant_unref(dev->search_caps);
+		g_variant_unref(dev->sort_caps);
+		g_variant_unref(dev->sort_ext_caps);
+		g_variant_unref(dev->feature_list);
+		g_free(dev->icon.mime_type);
+		g_free(dev->icon.bytes);
+
+		g_queue_clear(&dev->child_count_lru);
+		if (dev->child_counts)
+			g_hash_table_unref(dev->child_counts);
+
+		g_free(dev);
 	}
+}
 
-	DLEYNA_LOG_DEBUG_NL();
+void dls_device_unsubscribe(void *device)
+{
+	unsigned int i;
+	dls_device_t *dev = device;
+	dls_device_context_t *context;
 
-	g_strfreev(str_array);
+	if (dev) {
+		for (i = 0; i < dev->contexts->len; ++i) {
+			context = g_ptr_array_index(dev->contexts, i);
+			prv_context_unsubscribe(context);
+		}
+	}
 }
 
-static void prv_build_container_update_changed_array(const gchar *root_path,
-						     const gchar *value,
-						     GVariantBuilder *builder)
+static GVariant *prv_last_change_decode(GUPnPCDSLastChangeEntry *entry,
+					const char *root_path)
 {
-	gchar **str_array;
-	int pos = 0;
-	gchar *path;
-	guint id;
-	GVariantBuilder dict;
+	GUPnPCDSLastChangeEvent event;
+	const char *object_id;
+	const char *parent_id;
+	const char *mclass;
+	const char *media_class;
+	const char *media_class_ex;
+	char *parent_path;
+	char *path = NULL;
+	gboolean sub_update;
+	guint32 update_id;
+	GVariantBuilder *dict;
+	gboolean mod;
+	GVariant *retval = NULL;
 
-	str_array = g_strsplit(value, ",", 0);
+	dict = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
 
-	while (str_array[pos] && str_array[pos + 1]) {
-		g_variant_builder_init(&dict, G_VARIANT_TYPE("a{sv}"));
+	object_id = gupnp_cds_last_change_entry_get_object_id(entry);
+	if (!object_id)
+		goto on_error;
 
-		path = dls_path_from_id(root_path, str_array[pos++]);
-		id = atoi(str_array[pos++]);
+	sub_update = gupnp_cds_last_change_entry_is_subtree_update(entry);
+	update_id = gupnp_cds_last_change_entry_get_update_id(entry);
+	path = dls_path_from_id(root_path, object_id);
+	event = gupnp_cds_last_change_entry_get_event(entry);
+
+	switch (event) {
+	case GUPNP_CDS_LAST_CHANGE_EVENT_OBJECT_ADDED:
+		parent_id = gupnp_cds_last_change_entry_get_parent_id(entry);
+		if (!parent_id)
+			goto on_error;
+
+		mclass = gupnp_cds_last_change_entry_get_class(entry);
+		if (!mclass)
+			goto on_error;
+
+		media_class = dls_props_upnp_class_to_media_spec(mclass);
+		if (!media_class)
+			goto on_error;
+
+		media_class_ex = dls_props_upnp_class_to_media_spec_ex(mclass);
+
+		parent_path = dls_path_from_id(root_path, parent_id);
+
+		g_variant_builder_add(
+				dict, "{sv}",
+				DLS_INTERFACE_PROP_CHANGE_TYPE,
+				g_variant_new_uint32(DLS_CHANGE_ADD));
+		g_variant_builder_add(
+				dict, "{sv}",
+				DLS_INTERFACE_PROP_PATH,
+				g_variant_new_string(path));
+		g_variant_builder_add(
+				dict, "{sv}",
+				DLS_INTERFACE_PROP_UPDATE_ID,
+				g_variant_new_uint32(update_id));
+		g_variant_builder_add(
+				dict, "{sv}",
+				DLS_INTERFACE_PROP_SUBTREE_UPDATE,
+				g_variant_new_boolean(sub_update));
+		g_variant_builder_add(
+				dict, "{sv}",
+				DLS_INTERFACE_PROP_PARENT,
+				g_variant_new_string(parent_path));
+		g_variant_builder_add(
+				dict, "{sv}",
+				DLS_INTERFACE_PROP_TYPE,
+				g_variant_new_string(media_class));
+		g_variant_builder_add(
+				dict, "{sv}",
+				DLS_INTERFACE_PROP_TYPE_EX,
+				g_variant_new_string(media_class_ex));
 
+		g_free(parent_path);
+		break;
+	case GUPNP_CDS_LAST_CHANGE_EVENT_OBJECT_REMOVED:
+	case GUPNP_CDS_LAST_CHANGE_EVENT_OBJECT_MODIFIED:
+		mod = (event == GUPNP_CDS_LAST_CHANGE_EVENT_OBJECT_MODIFIED);
 		g_variant_builder_add(
-			&dict, "{sv}",
+			dict, "{sv}",
 			DLS_INTERFACE_PROP_CHANGE_TYPE,
-			g_variant_new_uint32(PRV_CHANGED_EVENT_CONTAINER));
-		g_variant_builder_add(&dict, "{sv}",
-				      DLS_INTERFACE_PROP_PATH,
-				      g_variant_new_string(path));
-		g_variant_builder_add(&dict, "{sv}",
-				      DLS_INTERFACE_PROP_UPDATE_ID,
-				      g_variant_new_uint32(id));
+			g_variant_new_uint32(mod ? DLS_CHANGE_MOD :
+							DLS_CHANGE_DEL));
+		g_variant_builder_add(
+				dict, "{sv}",
+				DLS_INTERFACE_PROP_PATH,
+				g_variant_new_string(path));
+		g_variant_builder_add(
+				dict, "{sv}",
+				DLS_INTERFACE_PROP_UPDATE_ID,
+				g_variant_new_uint32(update_id));
+		g_variant_builder_add(
+				dict, "{sv}",
+				DLS_INTERFACE_PROP_SUBTREE_UPDATE,
+				g_variant_new_boolean(sub_update));
+		break;
+	case GUPNP_CDS_LAST_CHANGE_EVENT_ST_DONE:
+		g_variant_builder_add(
+				dict, "{sv}",
+				DLS_INTERFACE_PROP_CHANGE_TYPE,
+				g_variant_new_uint32(DLS_CHANGE_DONE));
+		g_variant_builder_add(
+				dict, "{sv}",
+				DLS_INTERFACE_PROP_PATH,
+				g_variant_new_string(path));
+		g_variant_builder_add(
+				dict, "{sv}",
+				DLS_INTERFACE_PROP_UPDATE_ID,
+				g_variant_new_uint32(update_id));
+		break;
+	case GUPNP_CDS_LAST_CHANGE_EVENT_INVALID:
+	default:
+		goto on_error;
+		break;
+	}
+
+	retval = g_variant_builder_end(dict);
 
-		g_variant_builder_add(builder, "@a{sv}",
-				      g_variant_builder_end(&dict));
+on_error:
+
+	g_variant_builder_unref(dict);
+	g_free(path);
 
-		g_free(path);
+	return retval;
+}
+
+static void prv_changed_clear(dls_device_t *device)
+{
+	if (device->changed_flush_id) {
+		(void) g_source_remove(device->changed_flush_id);
+		device->changed_flush_id = 0;
 	}
 
-	g_strfreev(str_array);
+	dls_change_queue_clear(&device->changed_events);
+	dls_change_queue_clear(&device->container_updates);
 }
 
-static void prv_container_update_cb(GUPnPServiceProxy *proxy,
-				    const char *variable,
-				    GValue *value,
-				    gpointer user_data)
+/* Queues the ContainerUpdateIDs pairs of value */
+static void prv_container_updates_add(dls_device_t *device,
+				      const gchar *value)
 {
-	dls_device_t *device = user_data;
-	GVariantBuilder array;
+	gchar **str_array;
+	int pos = 0;
+	GString *path;
+	gsize root_len;
+	guint id;
 
-	g_variant_builder_init(&array, G_VARIANT_TYPE("a(ou)"));
+	str_array = g_strsplit(value, ",", 0);
+	path = g_string_new(device->path);
+	root_len = path->len;
 
-	prv_build_container_update_array(device->path,
-					 g_value_get_string(value),
-					 &array);
+	DLEYNA_LOG_DEBUG_NL();
 
-	(void) dls_server_get_connector()->notify(
-				device->connection,
-				device->path,
-				DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE,
-				DLS_INTERFACE_ESV_CONTAINER_UPDATE_IDS,
-				g_variant_new("(@a(ou))",
-					      g_variant_builder_end(&array)),
-				NULL);
+	while (str_array[pos] && str_array[pos + 1]) {
+		g_string_truncate(path, root_len);
+		dls_path_append_id(path, str_array[pos++]);
+		id = atoi(str_array[pos++]);
+		DLEYNA_LOG_DEBUG("@Id [%s] - Path [%s] - id[%d]",
+				 str_array[pos-2], path->str, id);
 
-	if (!device->has_last_change) {
-		g_variant_builder_init(&array, G_VARIANT_TYPE("aa{sv}"));
+		dls_change_queue_add_container(&device->container_updates,
+					       path->str, id,
+					       g_changed_flush_interval != 0);
+	}
+
+	DLEYNA_LOG_DEBUG_NL();
 
-		prv_build_container_update_changed_array(
-						device->path,
-						g_value_get_string(value),
-						&array);
+	(void) g_string_free(path, TRUE);
+	g_strfreev(str_array);
+}
 
-		(void) dls_server_get_connector()->notify(
+static void prv_changed_notify(dls_device_t *device, const gchar *signal,
+			       GVariant *params)
+{
+	(void) dls_server_get_connector()->notify(
 					device->connection,
 					device->path,
 					DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE,
-					DLS_INTERFACE_CHANGED_EVENT,
-					g_variant_new("(@aa{sv})",
-						      g_variant_builder_end(
-								      &array)),
+					signal,
+					params,
 					NULL);
-	}
+	g_changed_signals_emitted++;
 }
 
-static void prv_system_update_cb(GUPnPServiceProxy *proxy,
-				 const char *variable,
-				 GValue *value,
-				 gpointer user_data)
+static GVariant *prv_container_changed_dict(dls_change_t *entry)
 {
-	GVariantBuilder *array;
-	GVariant *val;
-	dls_device_t *device = user_data;
-	guint suid = g_value_get_uint(value);
-
-	DLEYNA_LOG_DEBUG("System Update %u", suid);
+	GVariantBuilder dict;
 
-	device->system_update_id = suid;
+	g_variant_builder_init(&dict, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add(&dict, "{sv}", DLS_INTERFACE_PROP_CHANGE_TYPE,
+			      g_variant_new_uint32(DLS_CHANGE_CONTAINER));
+	g_variant_builder_add(&dict, "{sv}", DLS_INTERFACE_PROP_PATH,
+			      g_variant_new_string(entry->path));
+	g_variant_builder_add(&dict, "{sv}", DLS_INTERFACE_PROP_UPDATE_ID,
+			      g_variant_new_uint32(entry->update_id));
 
-	array = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
-	g_variant_builder_add(array, "{sv}",
-			      DLS_INTERFACE_PROP_ESV_SYSTEM_UPDATE_ID,
-			      g_variant_new_uint32(suid));
-	val = g_variant_new("(s@a{sv}as)", DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE,
-			    g_variant_builder_end(array),
-			    NULL);
+	return g_variant_builder_end(&dict);
+}
 
-	(void) dls_server_get_connector()->notify(device->connection,
-					   device->path,
-					   DLS_INTERFACE_PROPERTIES,
-					   DLS_INTERFACE_PROPERTIES_CHANGED,
-					   val,
-					   NULL);
+static void prv_change_subscription_delete(gpointer subscription)
+{
+	prv_change_subscription_t *sub = subscription;
 
-	g_variant_builder_unref(array);
+	g_hash_table_unref(sub->paths);
+	g_free(sub);
 }
 
-static gboolean prv_re_enable_cd_subscription(gpointer user_data)
+/* Object paths carry no hierarchy, so the ancestors of an object are
+ * found by walking up the parents learnt from ADD events and from
+ * ListChildren results.  The walk stops at the first unknown parent.
+ */
+static gboolean prv_change_path_in_subtree(dls_device_t *device,
+					   GHashTable *paths,
+					   const gchar *path)
 {
-	dls_device_context_t *context = user_data;
+	guint depth;
 
-	context->cds.timeout_id = 0;
+	for (depth = 0; path && depth < DLS_CHANGE_PARENTS_MAX_DEPTH;
+	     depth++) {
+		if (g_hash_table_contains(paths, path))
+			return TRUE;
+
+		if (!device->change_parents)
+			break;
+
+		path = dls_string_cache_lookup(device->change_parents, path);
+	}
 
 	return FALSE;
 }
 
-static void prv_cd_subscription_lost_cb(GUPnPServiceProxy *proxy,
-				     const GError *reason,
-				     gpointer user_data)
+static gboolean prv_change_path_subscribed(dls_device_t *device,
+					   const gchar *path)
 {
-	dls_device_context_t *context = user_data;
+	GHashTableIter iter;
+	gpointer value;
+	prv_change_subscription_t *sub;
 
-	if (!context->cds.timeout_id) {
-		gupnp_service_proxy_set_subscribed(context->cds.proxy, TRUE);
-		context->cds.timeout_id = g_timeout_add_seconds(
-						10,
-						prv_re_enable_cd_subscription,
-						context);
-	} else {
-		g_source_remove(context->cds.timeout_id);
-		gupnp_service_proxy_remove_notify(context->cds.proxy,
-						  DLS_SYSTEM_UPDATE_VAR,
-						  prv_system_update_cb,
-						  context->device);
-		gupnp_service_proxy_remove_notify(context->cds.proxy,
-						  DLS_CONTAINER_UPDATE_VAR,
-						  prv_container_update_cb,
-						  context->device);
-		gupnp_service_proxy_remove_notify(context->cds.proxy,
-						  DLS_LAST_CHANGE_VAR,
-						  prv_last_change_cb,
-						  context->device);
+	if (!device->change_subscriptions)
+		return FALSE;
 
-		context->cds.timeout_id = 0;
-		context->cds.subscribed = FALSE;
+	g_hash_table_iter_init(&iter, device->change_subscriptions);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		sub = value;
+		if (prv_change_path_in_subtree(device, sub->paths, path))
+			return TRUE;
 	}
+
+	return FALSE;
 }
 
-static gboolean prv_re_enable_em_subscription(gpointer user_data)
+/* Only ADD events carry the Parent of an object, so the parents of the
+ * objects inside subscribed subtrees are kept to match their MOD and DEL
+ * events, and those of their own descendants.  The least recently used
+ * parents are forgotten once DLS_CHANGE_PARENTS_MAX_ENTRIES are known.
+ */
+static void prv_change_parent_record(dls_device_t *device,
+				     const gchar *path,
+				     const gchar *parent)
 {
-	dls_device_context_t *context = user_data;
+	if (!prv_change_path_subscribed(device, parent))
+		return;
 
-	context->cds.timeout_id = 0;
+	if (!device->change_parents)
+		device->change_parents = dls_string_cache_new(
+					DLS_CHANGE_PARENTS_MAX_ENTRIES);
 
-	return FALSE;
+	dls_string_cache_insert(device->change_parents, path, parent);
 }
 
-static void prv_em_subscription_lost_cb(GUPnPServiceProxy *proxy,
-					const GError *reason,
-					gpointer user_data)
+static gboolean prv_change_subscription_match(dls_device_t *device,
+					      prv_change_subscription_t *sub,
+					      dls_change_t *entry)
 {
-	dls_device_context_t *context = user_data;
+	const gchar *parent;
 
-	if (!context->ems.timeout_id) {
-		gupnp_service_proxy_set_subscribed(context->ems.proxy, TRUE);
-		context->ems.timeout_id = g_timeout_add_seconds(
-						10,
-						prv_re_enable_em_subscription,
-						context);
-	} else {
-		g_source_remove(context->ems.timeout_id);
-		gupnp_service_proxy_remove_notify(
-						context->ems.proxy,
-						DLS_NETWORK_INTERFACE_INFO_VAR,
-						prv_network_interface_info_cb,
-						context->device);
+	if (!(sub->flags & (1 << (entry->type - 1))))
+		return FALSE;
 
-		context->ems.timeout_id = 0;
-		context->ems.subscribed = FALSE;
-	}
+	if (prv_change_path_in_subtree(device, sub->paths, entry->path))
+		return TRUE;
+
+	return entry->dict &&
+		g_variant_lookup(entry->dict, DLS_INTERFACE_PROP_PARENT, "&s",
+				 &parent) &&
+		prv_change_path_in_subtree(device, sub->paths, parent);
 }
 
-void dls_device_subscribe_to_service_changes(dls_device_t *device)
+static void prv_changes_unicast(dls_device_t *device, const gchar *client,
+				GVariant *changes)
 {
-	dls_device_context_t *context;
+	GError *error = NULL;
 
-	context = dls_device_get_context(device, NULL);
+	if (!dls_server_notify_client(device->connection, client,
+				      device->path,
+				      DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE,
+				      DLS_INTERFACE_SUBSCRIBED_CHANGES,
+				      g_variant_new("(@aa{sv})", changes),
+				      &error)) {
+		DLEYNA_LOG_WARNING("Unable to notify %s: %s", client,
+				   error->message);
+		g_error_free(error);
+	} else {
+		g_subscribed_changes_emitted++;
+	}
+}
 
-	DLEYNA_LOG_DEBUG("Subscribe for events on context: %s",
-			 context->ip_address);
+static void prv_changed_notify_subscribers(dls_device_t *device)
+{
+	GHashTableIter iter;
+	gpointer client;
+	gpointer value;
+	prv_change_subscription_t *sub;
+	dls_change_t *entry;
+	GVariantBuilder array;
+	GList *link;
+	gboolean found;
+	const gchar *parent;
 
-	if (context->cds.proxy) {
-		gupnp_service_proxy_add_notify(context->cds.proxy,
-					       DLS_SYSTEM_UPDATE_VAR,
-					       G_TYPE_UINT,
-					       prv_system_update_cb,
-					       device);
+	if (!device->change_subscriptions)
+		goto on_exit;
 
-		gupnp_service_proxy_add_notify(context->cds.proxy,
-					       DLS_CONTAINER_UPDATE_VAR,
-					       G_TYPE_STRING,
-					       prv_container_update_cb,
-					       device);
+	for (link = device->changed_events.changes.head; link;
+	     link = link->next) {
+		entry = link->data;
+		if (entry->type == DLS_CHANGE_ADD && entry->dict &&
+		    g_variant_lookup(entry->dict, DLS_INTERFACE_PROP_PARENT,
+				     "&s", &parent))
+			prv_change_parent_record(device, entry->path, parent);
+	}
 
-		gupnp_service_proxy_add_notify(context->cds.proxy,
-					       DLS_LAST_CHANGE_VAR,
-					       G_TYPE_STRING,
-					       prv_last_change_cb,
-					       device);
+	g_hash_table_iter_init(&iter, device->change_subscriptions);
+	while (g_hash_table_iter_next(&iter, &client, &value)) {
+		sub = value;
+		found = FALSE;
+		g_variant_builder_init(&array, G_VARIANT_TYPE("aa{sv}"));
 
-		context->cds.subscribed = TRUE;
-		gupnp_service_proxy_set_subscribed(context->cds.proxy, TRUE);
+		for (link = device->changed_events.changes.head; link;
+		     link = link->next) {
+			entry = link->data;
+			if (prv_change_subscription_match(device, sub,
+							  entry)) {
+				g_variant_builder_add(&array, "@a{sv}",
+						      entry->dict);
+				found = TRUE;
+			}
+		}
 
-		g_signal_connect(context->cds.proxy, "subscription-lost",
-				 G_CALLBACK(prv_cd_subscription_lost_cb),
-				 context);
+		for (link = device->container_updates.changes.head; link;
+		     link = link->next) {
+			entry = link->data;
+			if (prv_change_subscription_match(device, sub,
+							  entry)) {
+				g_variant_builder_add(
+					&array, "@a{sv}",
+					prv_container_changed_dict(entry));
+				found = TRUE;
+			}
+		}
+
+		if (found)
+			prv_changes_unicast(device, client,
+					    g_variant_builder_end(&array));
+		else
+			g_variant_builder_clear(&array);
 	}
 
-	if (context->ems.proxy) {
-		gupnp_service_proxy_add_notify(context->ems.proxy,
-					       DLS_NETWORK_INTERFACE_INFO_VAR,
-					       G_TYPE_STRING,
-					       prv_network_interface_info_cb,
-					       device);
+	if (device->change_parents)
+		for (link = device->changed_events.changes.head; link;
+		     link = link->next) {
+			entry = link->data;
+			if (entry->type == DLS_CHANGE_DEL)
+				dls_string_cache_remove(device->change_parents,
+							entry->path);
+		}
 
-		context->ems.subscribed = TRUE;
-		gupnp_service_proxy_set_subscribed(context->ems.proxy, TRUE);
+on_exit:
 
-		g_signal_connect(context->ems.proxy, "subscription-lost",
-				 G_CALLBACK(prv_em_subscription_lost_cb),
-				 context);
-	}
+	return;
 }
 
-static void prv_feature_list_add_feature(gchar *root_path,
-					 GUPnPFeature *feature,
-					 GVariantBuilder *vb)
+/* Emits everything queued during the window: at most one
+ * ContainerUpdateIDs and one Changed signal.
+ */
+static void prv_changed_flush(dls_device_t *device)
 {
-	GVariantBuilder vbo;
-	GVariant *var_obj;
-	const char *name;
-	const char *version;
-	const char *obj_id;
-	gchar **obj;
-	gchar **saved;
-	gchar *path;
-
-	name = gupnp_feature_get_name(feature);
-	version = gupnp_feature_get_version(feature);
-	obj_id = gupnp_feature_get_object_ids(feature);
-
-	g_variant_builder_init(&vbo, G_VARIANT_TYPE("ao"));
+	GVariantBuilder array;
+	dls_change_t *entry;
+	GList *link;
 
-	if (obj_id != NULL && *obj_id) {
-		obj = g_strsplit(obj_id, ",", 0);
-		saved = obj;
+	if (!g_queue_is_empty(&device->container_updates.changes)) {
+		g_variant_builder_init(&array, G_VARIANT_TYPE("a(ou)"));
 
-		while (obj && *obj) {
-			path = dls_path_from_id(root_path, *obj);
-			g_variant_builder_add(&vbo, "o", path);
-			g_free(path);
-			obj++;
+		for (link = device->container_updates.changes.head; link;
+		     link = link->next) {
+			entry = link->data;
+			g_variant_builder_add(&array, "(ou)", entry->path,
+					      entry->update_id);
 		}
 
-		g_strfreev(saved);
+		prv_changed_notify(device,
+				   DLS_INTERFACE_ESV_CONTAINER_UPDATE_IDS,
+				   g_variant_new("(@a(ou))",
+						 g_variant_builder_end(&array)));
 	}
 
-	var_obj = g_variant_builder_end(&vbo);
-	g_variant_builder_add(vb, "(ss@ao)", name, version, var_obj);
-}
-
-static void prv_get_feature_list_analyze(dls_device_t *device, gchar *result)
-{
-	GUPnPFeatureListParser *parser;
-	GUPnPFeature *feature;
-	GList *list;
-	GList *item;
-	GError *error = NULL;
-	GVariantBuilder vb;
-#if DLEYNA_LOG_LEVEL & DLEYNA_LOG_LEVEL_DEBUG
-	char *str;
-#endif
-	parser = gupnp_feature_list_parser_new();
-	list = gupnp_feature_list_parser_parse_text(parser, result, &error);
+	prv_changed_notify_subscribers(device);
 
-	if (error != NULL) {
-		DLEYNA_LOG_WARNING("GetFeatureList parsing failed: %s",
-				   error->message);
+	if (g_queue_is_empty(&device->changed_events.changes) &&
+	    (device->has_last_change ||
+	     g_queue_is_empty(&device->container_updates.changes)))
 		goto on_exit;
-	}
 
-	g_variant_builder_init(&vb, G_VARIANT_TYPE("a(ssao)"));
-	item = list;
+	g_variant_builder_init(&array, G_VARIANT_TYPE("aa{sv}"));
 
-	while (item != NULL) {
-		feature = (GUPnPFeature *)item->data;
-		prv_feature_list_add_feature(device->path, feature, &vb);
-		g_object_unref(feature);
-		item = g_list_next(item);
+	for (link = device->changed_events.changes.head; link;
+	     link = link->next) {
+		entry = link->data;
+		g_variant_builder_add(&array, "@a{sv}", entry->dict);
 	}
 
-	device->feature_list = g_variant_ref_sink(g_variant_builder_end(&vb));
+	/* Servers without LastChange only report container updates */
+	for (link = device->container_updates.changes.head;
+	     link && !device->has_last_change; link = link->next)
+		g_variant_builder_add(&array, "@a{sv}",
+				      prv_container_changed_dict(link->data));
 
-#if DLEYNA_LOG_LEVEL & DLEYNA_LOG_LEVEL_DEBUG
-	str = g_variant_print(device->feature_list, FALSE);
-	DLEYNA_LOG_DEBUG("%s = %s", DLS_INTERFACE_PROP_SV_FEATURE_LIST, str);
-	g_free(str);
-#endif
+	prv_changed_notify(device, DLS_INTERFACE_CHANGED_EVENT,
+			   g_variant_new("(@aa{sv})",
+					 g_variant_builder_end(&array)));
 
 on_exit:
-	g_list_free(list);
-	g_object_unref(parser);
 
-	if (error != NULL)
-		g_error_free(error);
+	prv_changed_clear(device);
 }
 
-static void prv_get_feature_list_cb(GUPnPServiceProxy *proxy,
-				    GUPnPServiceProxyAction *action,
-				    gpointer user_data)
+static gboolean prv_changed_flush_cb(gpointer user_data)
 {
-	gchar *result = NULL;
-	gboolean end;
-	GError *error = NULL;
-	prv_new_device_ct_t *priv_t = (prv_new_device_ct_t *)user_data;
+	dls_device_t *device = user_data;
 
-	priv_t->dev->construct_step++;
-	end = gupnp_service_proxy_end_action(proxy, action, &error,
-					     "FeatureList", G_TYPE_STRING,
-					     &result, NULL);
+	device->changed_flush_id = 0;
+	prv_changed_flush(device);
 
-	if (!end || (result == NULL)) {
-		DLEYNA_LOG_WARNING("GetFeatureList operation failed: %s",
-				   ((error != NULL) ? error->message
-						    : "Invalid result"));
-		goto on_error;
-	}
+	return FALSE;
+}
 
-	DLEYNA_LOG_DEBUG("GetFeatureList result: %s", result);
+static void prv_changed_schedule(dls_device_t *device)
+{
+	guint count;
 
-	prv_get_feature_list_analyze(priv_t->dev, result);
+	count = g_queue_get_length(&device->changed_events.changes) +
+		g_queue_get_length(&device->container_updates.changes);
 
-on_error:
-	if (error != NULL)
-		g_error_free(error);
+	if (!count)
+		goto on_exit;
 
-	g_free(result);
-}
+	if (!g_changed_flush_interval || count >= g_changed_max_batch)
+		prv_changed_flush(device);
+	else if (!device->changed_flush_id)
+		device->changed_flush_id = g_timeout_add(
+						g_changed_flush_interval,
+						prv_changed_flush_cb,
+						device);
 
-static GUPnPServiceProxyAction *prv_get_feature_list(
-						dleyna_service_task_t *task,
-						GUPnPServiceProxy *proxy,
-						gboolean *failed)
-{
-	*failed = FALSE;
+on_exit:
 
-	return gupnp_service_proxy_begin_action(
-					proxy, "GetFeatureList",
-					dleyna_service_task_begin_action_cb,
-					task, NULL);
+	return;
 }
 
-static void prv_get_sort_ext_capabilities_analyze(dls_device_t *device,
-						  gchar *result)
+static void prv_last_change_cb(GUPnPServiceProxy *proxy,
+			       const char *variable,
+			       GValue *value,
+			       gpointer user_data)
 {
-	gchar **caps;
-	gchar **saved;
-#if DLEYNA_LOG_LEVEL & DLEYNA_LOG_LEVEL_DEBUG
-	gchar *props;
-#endif
-	GVariantBuilder sort_ext_caps_vb;
-
-	g_variant_builder_init(&sort_ext_caps_vb, G_VARIANT_TYPE("as"));
-
-	caps = g_strsplit(result, ",", 0);
-	saved = caps;
-
-	while (caps && *caps) {
-		g_variant_builder_add(&sort_ext_caps_vb, "s", *caps);
-		caps++;
-	}
-
-	g_strfreev(saved);
-
-	device->sort_ext_caps = g_variant_ref_sink(g_variant_builder_end(
-							&sort_ext_caps_vb));
+	const gchar *last_change;
+	GVariant *dict;
+	dls_device_t *device = user_data;
+	GUPnPCDSLastChangeParser *parser;
+	const gchar *object_id;
+	GList *list;
+	GList *next;
+	GError *error = NULL;
 
-#if DLEYNA_LOG_LEVEL & DLEYNA_LOG_LEVEL_DEBUG
-	props = g_variant_print(device->sort_ext_caps, FALSE);
-	DLEYNA_LOG_DEBUG("%s = %s",
-			 DLS_INTERFACE_PROP_SV_SORT_EXT_CAPABILITIES, props);
-	g_free(props);
-#endif
-}
+	last_change = g_value_get_string(value);
+	g_changed_events_received++;
 
-static void prv_get_sort_ext_capabilities_cb(GUPnPServiceProxy *proxy,
-					   GUPnPServiceProxyAction *action,
-					   gpointer user_data)
-{
-	gchar *result = NULL;
-	gboolean end;
-	GError *error = NULL;
-	prv_new_device_ct_t *priv_t = (prv_new_device_ct_t *)user_data;
+	DLEYNA_LOG_DEBUG_NL();
+	DLEYNA_LOG_DEBUG("LastChange XML: %s", last_change);
+	DLEYNA_LOG_DEBUG_NL();
 
-	priv_t->dev->construct_step++;
-	end = gupnp_service_proxy_end_action(proxy, action, &error,
-					     "SortExtensionCaps",
-					     G_TYPE_STRING, &result, NULL);
+	parser = gupnp_cds_last_change_parser_new();
+	list = gupnp_cds_last_change_parser_parse(parser, last_change, &error);
 
-	if (!end || (result == NULL)) {
+	if (error != NULL) {
 		DLEYNA_LOG_WARNING(
-			"GetSortExtensionCapabilities operation failed: %s",
-			((error != NULL) ? error->message : "Invalid result"));
+			"gupnp_cds_last_change_parser_parse parsing failed: %s",
+			error->message);
 		goto on_error;
 	}
 
-	DLEYNA_LOG_DEBUG("GetSortExtensionCapabilities result: %s", result);
+	next = list;
+	while (next) {
+		object_id = gupnp_cds_last_change_entry_get_object_id(
+								next->data);
+		if (object_id) {
+			prv_metadata_cache_remove(device, object_id);
+			prv_browse_window_remove_container(device, object_id);
+			prv_child_count_cache_remove(device, object_id);
+		}
+
+		object_id = gupnp_cds_last_change_entry_get_parent_id(
+								next->data);
+		if (object_id) {
+			prv_metadata_cache_remove(device, object_id);
+			prv_browse_window_remove_container(device, object_id);
+			prv_child_count_cache_remove(device, object_id);
+		}
+
+		dict = prv_last_change_decode(next->data, device->path);
+		if (dict)
+			dls_change_queue_add(&device->changed_events, dict,
+					     g_changed_flush_interval != 0);
+
+		gupnp_cds_last_change_entry_unref(next->data);
+		next = g_list_next(next);
+	}
 
-	prv_get_sort_ext_capabilities_analyze(priv_t->dev, result);
+	prv_changed_schedule(device);
 
 on_error:
 
-	if (error)
-		g_error_free(error);
+	g_list_free(list);
+	g_object_unref(parser);
 
-	g_free(result);
+	if (error != NULL)
+		g_error_free(error);
 }
 
-static GUPnPServiceProxyAction *prv_get_sort_ext_capabilities(
-						dleyna_service_task_t *task,
-						GUPnPServiceProxy *proxy,
-						gboolean *failed)
+static void prv_free_network_if_info(dls_network_if_info_t *info)
 {
-	*failed = FALSE;
+	if (info != NULL) {
+		g_free(info->mac_address);
+		g_free(info->device_uuid);
+		g_free(info->network_if_mode);
+		g_free(info->wake_on_pattern);
+		g_free(info->wake_transport);
+		g_list_free_full(info->ip_addresses, g_free);
 
-	return gupnp_service_proxy_begin_action(
-					proxy,
-					"GetSortExtensionCapabilities",
-					dleyna_service_task_begin_action_cb,
-					task, NULL);
+		g_free(info);
+	}
 }
 
-static void prv_get_capabilities_analyze(GHashTable *property_map,
-					 gchar *result,
-					 GVariant **variant)
+static dls_network_if_info_t *prv_get_network_if_info(xmlNode *device_if_node,
+						      const gchar *udn)
 {
-	gchar **caps;
-	gchar **saved;
-	gchar *prop_name;
-	GVariantBuilder caps_vb;
+	dls_network_if_info_t *info = NULL;
+	GList *ipv4_addresses;
+	GList *ipv6_addresses;
+	gchar *wake_on_delay = NULL;
 
-	g_variant_builder_init(&caps_vb, G_VARIANT_TYPE("as"));
+	info = g_new0(dls_network_if_info_t, 1);
 
-	if (!strcmp(result, "*")) {
-		g_variant_builder_add(&caps_vb, "s", "*");
-	} else {
-		caps = g_strsplit(result, ",", 0);
-		saved = caps;
+	ipv4_addresses = xml_util_get_child_string_list_content_by_name(
+							device_if_node,
+							"NetworkInterface",
+							"AssociatedIpAddresses",
+							"Ipv4",
+							NULL);
 
-		while (caps && *caps) {
-			prop_name = g_hash_table_lookup(property_map, *caps);
+	ipv6_addresses = xml_util_get_child_string_list_content_by_name(
+							device_if_node,
+							"NetworkInterface",
+							"AssociatedIpAddresses",
+							"Ipv6",
+							NULL);
 
-			if (prop_name) {
-				g_variant_builder_add(&caps_vb, "s", prop_name);
+	info->ip_addresses = g_list_concat(ipv4_addresses, ipv6_addresses);
 
-				/* TODO: Okay this is not very nice.  A better
-				   way to fix this would be to change the p_map
-				   to be many : many. */
+	info->device_uuid = xml_util_get_child_string_content_by_name(
+						device_if_node,
+						"DeviceUUID",
+						NULL);
 
-				if (!strcmp(*caps, "upnp:class"))
-					g_variant_builder_add(
-						&caps_vb, "s",
-						DLS_INTERFACE_PROP_TYPE_EX);
-			}
+	info->mac_address = xml_util_get_child_string_content_by_name(
+						device_if_node,
+						"NetworkInterface",
+						"MacAddress",
+						NULL);
 
-			caps++;
-		}
+	info->network_if_mode = xml_util_get_child_string_content_by_name(
+						device_if_node,
+						"NetworkInterface",
+						"NetworkInterfaceMode",
+						NULL);
 
-		g_strfreev(saved);
-	}
+	info->wake_on_pattern = xml_util_get_child_string_content_by_name(
+						device_if_node,
+						"NetworkInterface",
+						"WakeOnPattern",
+						NULL);
 
-	*variant = g_variant_ref_sink(g_variant_builder_end(&caps_vb));
+	info->wake_transport = xml_util_get_child_string_content_by_name(
+						device_if_node,
+						"NetworkInterface",
+						"WakeSupportedTransport",
+						NULL);
 
-#if DLEYNA_LOG_LEVEL & DLEYNA_LOG_LEVEL_DEBUG
-	prop_name = g_variant_print(*variant, FALSE);
-	DLEYNA_LOG_DEBUG("%s = %s", "   Variant", prop_name);
-	g_free(prop_name);
-#endif
-}
+	wake_on_delay = xml_util_get_child_string_content_by_name(
+						device_if_node,
+						"NetworkInterface",
+						"MaxWakeOnDelay",
+						NULL);
 
-static void prv_get_sort_capabilities_cb(GUPnPServiceProxy *proxy,
-					 GUPnPServiceProxyAction *action,
-					 gpointer user_data)
-{
-	gchar *result = NULL;
-	gboolean end;
-	GError *error = NULL;
-	prv_new_device_ct_t *priv_t = (prv_new_device_ct_t *)user_data;
+	if (wake_on_delay == NULL) {
+		info->max_wake_on_delay = DLS_DEFAULT_WAKE_ON_DELAY;
+	} else {
+		info->max_wake_on_delay = atoi(wake_on_delay);
 
-	priv_t->dev->construct_step++;
-	end = gupnp_service_proxy_end_action(proxy, action, &error, "SortCaps",
-					     G_TYPE_STRING, &result, NULL);
+		g_free(wake_on_delay);
+	}
 
-	if (!end || (result == NULL)) {
-		DLEYNA_LOG_WARNING("GetSortCapabilities operation failed: %s",
-				   ((error != NULL) ? error->message
-						    : "Invalid result"));
+	if ((info->device_uuid == NULL || strlen(info->device_uuid) > 70) ||
+	    (info->mac_address == NULL || strlen(info->mac_address) != 17) ||
+	    (info->network_if_mode == NULL) || (info->ip_addresses == NULL) ||
+	    (info->wake_on_pattern == NULL))
 		goto on_error;
-	}
 
-	DLEYNA_LOG_DEBUG("GetSortCapabilities result: %s", result);
+	if (strcmp(info->device_uuid, udn))
+		goto on_error;
 
-	prv_get_capabilities_analyze(priv_t->property_map, result,
-				     &priv_t->dev->sort_caps);
+	return info;
 
 on_error:
+	prv_free_network_if_info(info);
 
-	if (error)
-		g_error_free(error);
-
-	g_free(result);
+	return NULL;
 }
 
-static GUPnPServiceProxyAction *prv_get_sort_capabilities(
-					dleyna_service_task_t *task,
-					GUPnPServiceProxy *proxy,
-					gboolean *failed)
+static GList *prv_network_if_info_decode(const gchar *info, const gchar *udn)
 {
-	*failed = FALSE;
+	xmlDoc *doc;
+	xmlNode *node;
+	GList *info_list = NULL;
+	dls_network_if_info_t *if_info;
 
-	return gupnp_service_proxy_begin_action(
-					proxy,
-					"GetSortCapabilities",
-					dleyna_service_task_begin_action_cb,
-					task, NULL);
-}
+	DLEYNA_LOG_DEBUG("Enter");
 
-static void prv_get_search_capabilities_cb(GUPnPServiceProxy *proxy,
-					   GUPnPServiceProxyAction *action,
-					   gpointer user_data)
-{
-	gchar *result = NULL;
-	gboolean end;
-	GError *error = NULL;
-	prv_new_device_ct_t *priv_t = (prv_new_device_ct_t *)user_data;
+	DLEYNA_LOG_DEBUG_NL();
+	DLEYNA_LOG_DEBUG("NetworkInterfaceInfo XML: %s", info);
+	DLEYNA_LOG_DEBUG_NL();
 
-	priv_t->dev->construct_step++;
-	end = gupnp_service_proxy_end_action(proxy, action, &error,
-					     "SearchCaps", G_TYPE_STRING,
-					     &result, NULL);
+	doc = xmlParseMemory(info, strlen(info) + 1);
+	if (doc == NULL) {
+		DLEYNA_LOG_WARNING("XML: invalid document");
 
-	if (!end || (result == NULL)) {
-		DLEYNA_LOG_WARNING("GetSearchCapabilities operation failed: %s",
-				   ((error != NULL) ? error->message
-						    : "Invalid result"));
-		goto on_error;
+		goto on_exit;
 	}
 
-	DLEYNA_LOG_DEBUG("GetSearchCapabilities result: %s", result);
-
-	prv_get_capabilities_analyze(priv_t->property_map, result,
-				     &priv_t->dev->search_caps);
+	node = xmlDocGetRootElement(doc);
+	if (node == NULL) {
+		DLEYNA_LOG_WARNING("XML: empty document");
 
-	if (g_hash_table_lookup(priv_t->property_map, "upnp:objectUpdateID"))
-		priv_t->dev->has_last_change = TRUE;
+		goto on_exit;
+	}
 
-on_error:
+	if (node->name == NULL) {
+		DLEYNA_LOG_WARNING("XML: empty document name");
 
-	if (error)
-		g_error_free(error);
+		goto on_exit;
+	}
 
-	g_free(result);
-}
+	if (strcmp((char *)node->name, "NetworkInterfaceInfo")) {
+		DLEYNA_LOG_WARNING("XML: invalid document name");
 
-static GUPnPServiceProxyAction *prv_get_search_capabilities(
-					dleyna_service_task_t *task,
-					GUPnPServiceProxy *proxy,
-					gboolean *failed)
-{
-	*failed = FALSE;
+		goto on_exit;
+	}
 
-	return gupnp_service_proxy_begin_action(
-					proxy, "GetSearchCapabilities",
-					dleyna_service_task_begin_action_cb,
-					task, NULL);
-}
+	for (node = node->children; node; node = node->next) {
+		if (node->name != NULL &&
+		    !strcmp((char *)node->name, "DeviceInterface")) {
+			if_info = prv_get_network_if_info(node, udn);
 
-static GUPnPServiceProxyAction *prv_subscribe(dleyna_service_task_t *task,
-					      GUPnPServiceProxy *proxy,
-					      gboolean *failed)
-{
-	dls_device_t *device;
+			if (if_info != NULL)
+				info_list = g_list_prepend(info_list, if_info);
+		}
+	}
 
-	device = (dls_device_t *)dleyna_service_task_get_user_data(task);
+on_exit:
+	DLEYNA_LOG_DEBUG("Exit");
 
-	device->construct_step++;
-	dls_device_subscribe_to_service_changes(device);
+	if (doc != NULL)
+		xmlFreeDoc(doc);
 
-	*failed = FALSE;
-
-	return NULL;
+	return info_list;
 }
 
-static gboolean prv_subtree_interface_filter(const gchar *object_path,
-					     const gchar *node,
-					     const gchar *interface)
+static gboolean prv_get_device_sleeping_state(dls_device_t *device,
+					      const gchar *network_if_info_xml,
+					      gboolean *sleeping)
 {
-	gboolean root_object = FALSE;
-	const gchar *slash;
-	gboolean retval = TRUE;
+	dls_network_if_info_t *info;
+	GList *info_list;
+	GList *next;
+	unsigned int i;
+	dls_device_context_t *ctx;
+	gboolean found = FALSE;
+	const gchar *udn;
+	GList *next_ip;
+	guint ip_idx;
+	gchar *ip_address;
 
-	/* All objects in the hierarchy support the same interface.  Strictly
-	   speaking this is not correct as it will allow ListChildren to be
-	   executed on a mediaitem object.  However, returning the correct
-	   interface here would be too inefficient.  We would need to either
-	   cache the type of all objects encountered so far or issue a UPnP
-	   request here to determine the objects type.  Best to let the client
-	   call ListChildren on a item.  This will lead to an error when we
-	   execute the UPnP command and we can return an error then.
+	DLEYNA_LOG_DEBUG("Enter");
 
-	   We do know however that the root objects are containers.  Therefore
-	   we can remove the MediaItem2 interface from the root containers.  We
-	   also know that only the root objects suport the MediaDevice
-	   interface.
-	*/
+	if (device->contexts->len == 0)
+		goto on_exit;
 
-	if (dls_path_get_non_root_id(object_path, &slash))
-		root_object = !slash;
+	ctx = g_ptr_array_index(device->contexts, 0);
 
-	if (root_object && !strcmp(interface, DLS_INTERFACE_MEDIA_ITEM))
-		retval = FALSE;
-	else if (!root_object && !strcmp(interface,
-					 DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE))
-		retval = FALSE;
+	udn = gupnp_device_info_get_udn((GUPnPDeviceInfo *)ctx->device_proxy);
 
-	return retval;
-}
+	info_list = prv_network_if_info_decode(network_if_info_xml, udn);
+	if (info_list == NULL) {
+		DLEYNA_LOG_DEBUG("no UDN match found.");
 
-static GUPnPServiceProxyAction *prv_declare(dleyna_service_task_t *task,
-					    GUPnPServiceProxy *proxy,
-					    gboolean *failed)
-{
-	guint id;
-	dls_device_t *device;
-	prv_new_device_ct_t *priv_t;
+		goto on_exit;
+	}
 
-	priv_t = (prv_new_device_ct_t *)dleyna_service_task_get_user_data(task);
-	device = priv_t->dev;
-	device->construct_step++;
+	DLEYNA_LOG_DEBUG("Device UUID = %s", udn);
 
-	id = dls_server_get_connector()->publish_subtree(priv_t->connection,
-						  device->path,
-						  priv_t->vtable,
-						  DLS_INTERFACE_INFO_MAX,
-						  prv_subtree_interface_filter);
-	if (id) {
-		device->id = id;
+	next = info_list;
+	while (next != NULL) {
+		info = (dls_network_if_info_t *)next->data;
+		for (i = 0; i < device->contexts->len; ++i) {
+			ctx = g_ptr_array_index(device->contexts, i);
 
-		device->uploads = g_hash_table_new_full(
-						g_int_hash,
-						g_int_equal,
-						g_free,
-						prv_upload_delete);
-		device->upload_jobs = g_hash_table_new_full(
-						g_int_hash,
-						g_int_equal,
-						g_free,
-						prv_upload_job_delete);
+			DLEYNA_LOG_DEBUG("Context[%u] - IP address = %s",
+					 i, ctx->ip_address);
 
-	} else {
-		DLEYNA_LOG_WARNING("dleyna_connector_publish_subtree FAILED");
+			next_ip = info->ip_addresses;
+			ip_idx = 0;
+			while (next_ip != NULL) {
+				ip_address = (gchar *)next_ip->data;
+
+				DLEYNA_LOG_DEBUG(
+				 "Network Interface Info - IP address #%u = %s",
+				 ip_idx, ip_address);
+
+				if (!strcmp(ctx->ip_address, ip_address)) {
+					found = TRUE;
+
+					DLEYNA_LOG_DEBUG("IP+UDN match found");
+
+					break;
+				}
+
+				next_ip = g_list_next(next_ip);
+
+				ip_idx++;
+			}
+
+			if (found)
+				break;
+		}
+
+		next = g_list_next(next);
+
+		if (found)
+			break;
 	}
 
-	*failed = (!id);
+	if (!found) {
+		DLEYNA_LOG_DEBUG("IP+UDN match not found, use UDN match only");
 
-	return NULL;
-}
+		ctx = g_ptr_array_index(device->contexts, 0);
 
-void dls_device_construct(
-			dls_device_t *dev,
-			dls_device_context_t *context,
-			dleyna_connector_id_t connection,
-			const dleyna_connector_dispatch_cb_t *dispatch_table,
-			GHashTable *property_map,
-			const dleyna_task_queue_key_t *queue_id)
-{
-	prv_new_device_ct_t *priv_t;
-	GUPnPServiceProxy *s_proxy;
+		info = (dls_network_if_info_t *)info_list->data;
 
-	DLEYNA_LOG_DEBUG("Current step: %d", dev->construct_step);
+		ip_idx = 0;
 
-	priv_t = g_new0(prv_new_device_ct_t, 1);
+		found = TRUE;
+	}
 
-	priv_t->dev = dev;
-	priv_t->connection = connection;
-	priv_t->vtable = dispatch_table;
-	priv_t->property_map = property_map;
+	info->ip_address_position = ip_idx;
 
-	s_proxy = context->cds.proxy;
+	DLEYNA_LOG_DEBUG("Matching Network Interface Info:");
+	DLEYNA_LOG_DEBUG("- Mode = %s", info->network_if_mode);
+	DLEYNA_LOG_DEBUG("- Wake-on IP address = %s",
+			 (gchar *)g_list_nth_data(info->ip_addresses, ip_idx));
 
-	if (dev->construct_step < 1)
-		dleyna_service_task_add(queue_id, prv_get_search_capabilities,
-					s_proxy,
-					prv_get_search_capabilities_cb, NULL,
-					priv_t);
+	if (!strcmp(info->network_if_mode, "IP-up"))
+		*sleeping = FALSE;
+	else
+		*sleeping = TRUE;
 
-	if (dev->construct_step < 2)
-		dleyna_service_task_add(queue_id, prv_get_sort_capabilities,
-					s_proxy,
-					prv_get_sort_capabilities_cb, NULL,
-					priv_t);
+	prv_free_network_if_info(device->network_if_info);
 
-	if (dev->construct_step < 3)
-		dleyna_service_task_add(queue_id, prv_get_sort_ext_capabilities,
-					s_proxy,
-					prv_get_sort_ext_capabilities_cb, NULL,
-					priv_t);
+	device->network_if_info = info;
 
-	if (dev->construct_step < 4)
-		dleyna_service_task_add(queue_id, prv_get_feature_list, s_proxy,
-					prv_get_feature_list_cb, NULL, priv_t);
+	info_list = g_list_remove(info_list, info);
 
-	/* The following task should always be completed */
-	dleyna_service_task_add(queue_id, prv_subscribe, s_proxy,
-				NULL, NULL, dev);
+	g_list_free_full(info_list, (GDestroyNotify)prv_free_network_if_info);
 
-	if (dev->construct_step < 6)
-		dleyna_service_task_add(queue_id, prv_declare, s_proxy,
-					NULL, g_free, priv_t);
+on_exit:
+	DLEYNA_LOG_DEBUG("Exit");
 
-	dleyna_task_queue_start(queue_id);
+	return found;
 }
 
-dls_device_t *dls_device_new(
-			dleyna_connector_id_t connection,
-			GUPnPDeviceProxy *proxy,
-			GUPnPDeviceInfo *device_info,
-			const gchar *ip_address,
-			const dleyna_connector_dispatch_cb_t *dispatch_table,
-			GHashTable *property_map,
-			const char *udn,
-			const dleyna_task_queue_key_t *queue_id)
+static void prv_network_interface_info_cb(GUPnPServiceProxy *proxy,
+					  const char *variable,
+					  GValue *value,
+					  gpointer user_data)
 {
-	dls_device_t *dev;
-	gchar *new_path;
-	gchar *uuid;
-	dls_device_context_t *context;
+	dls_device_t *device = user_data;
+	GVariantBuilder *array;
+	GVariant *val;
+	gboolean sleeping;
 
-	DLEYNA_LOG_DEBUG("New Device on %s", ip_address);
+	if (prv_get_device_sleeping_state(device,
+					  g_value_get_string(value),
+					  &sleeping)) {
+		device->sleeping = sleeping;
 
-	uuid = dleyna_core_prv_convert_udn_to_path(udn);
-	new_path = g_strdup_printf("%s/%s", DLEYNA_SERVER_PATH, uuid);
-	g_free(uuid);
+		array = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+		g_variant_builder_add(array, "{sv}",
+				      DLS_INTERFACE_PROP_SLEEPING,
+				      g_variant_new_boolean(sleeping));
+		val = g_variant_new("(s@a{sv}as)",
+				    DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE,
+				    g_variant_builder_end(array),
+				    NULL);
 
-	DLEYNA_LOG_DEBUG("Server Path %s", new_path);
+		(void) dls_server_get_connector()->notify(device->connection,
+					      device->path,
+					      DLS_INTERFACE_PROPERTIES,
+					      DLS_INTERFACE_PROPERTIES_CHANGED,
+					      val,
+					      NULL);
 
-	dev = g_new0(dls_device_t, 1);
+		g_variant_builder_unref(array);
+	}
+}
 
-	dev->connection = connection;
-	dev->contexts = g_ptr_array_new_with_free_func((GDestroyNotify)
-						  dls_device_delete_context);
-	dev->path = new_path;
+static void prv_caches_remove_containers(dls_device_t *device,
+					 const gchar *value)
+{
+	gchar **str_array;
+	int pos = 0;
 
-	context = dls_device_append_new_context(dev, ip_address,
-						proxy, device_info);
+	str_array = g_strsplit(value, ",", 0);
 
-	dls_device_construct(dev, context, connection, dispatch_table,
-			     property_map, queue_id);
+	while (str_array[pos] && str_array[pos + 1]) {
+		prv_metadata_cache_remove(device, str_array[pos]);
+		prv_browse_window_remove_container(device, str_array[pos]);
+		prv_child_count_cache_remove(device, str_array[pos]);
+		pos += 2;
+	}
 
-	return dev;
+	g_strfreev(str_array);
 }
 
-dls_device_context_t *dls_device_append_new_context(dls_device_t *device,
-						  const gchar *ip_address,
-						  GUPnPDeviceProxy *proxy,
-						  GUPnPDeviceInfo *device_info)
+static void prv_container_update_cb(GUPnPServiceProxy *proxy,
+				    const char *variable,
+				    GValue *value,
+				    gpointer user_data)
 {
-	dls_device_context_t *context;
+	dls_device_t *device = user_data;
 
-	prv_context_new(ip_address, proxy, device_info, device, &context);
-	g_ptr_array_add(device->contexts, context);
+	g_changed_events_received++;
 
-	return context;
+	prv_caches_remove_containers(device, g_value_get_string(value));
+	prv_container_updates_add(device, g_value_get_string(value));
+	prv_changed_schedule(device);
 }
 
-dls_device_t *dls_device_from_path(const gchar *path, GHashTable *device_list)
+static void prv_system_update_notify_subscribers(dls_device_t *device)
 {
 	GHashTableIter iter;
+	gpointer client;
 	gpointer value;
-	dls_device_t *device;
-	dls_device_t *retval = NULL;
+	prv_change_subscription_t *sub;
+	GVariantBuilder array;
 
-	g_hash_table_iter_init(&iter, device_list);
+	if (!device->change_subscriptions)
+		goto on_exit;
 
-	while (g_hash_table_iter_next(&iter, NULL, &value)) {
-		device = value;
+	g_hash_table_iter_init(&iter, device->change_subscriptions);
+	while (g_hash_table_iter_next(&iter, &client, &value)) {
+		sub = value;
+		if (!(sub->flags & DLS_INTERFACE_CHANGES_SYSTEM_UPDATE))
+			continue;
 
-		if (!strcmp(device->path, path)) {
-			retval = device;
-			break;
-		}
+		g_variant_builder_init(&array, G_VARIANT_TYPE("aa{sv}"));
+		g_variant_builder_open(&array, G_VARIANT_TYPE("a{sv}"));
+		g_variant_builder_add(
+			&array, "{sv}", DLS_INTERFACE_PROP_CHANGE_TYPE,
+			g_variant_new_uint32(DLS_CHANGE_SYSTEM_UPDATE));
+		g_variant_builder_add(&array, "{sv}", DLS_INTERFACE_PROP_PATH,
+				      g_variant_new_string(device->path));
+		g_variant_builder_add(
+			&array, "{sv}", DLS_INTERFACE_PROP_UPDATE_ID,
+			g_variant_new_uint32(device->system_update_id));
+		g_variant_builder_close(&array);
+
+		prv_changes_unicast(device, client,
+				    g_variant_builder_end(&array));
 	}
 
-	return retval;
+on_exit:
+
+	return;
 }
 
-dls_device_context_t *dls_device_get_context(const dls_device_t *device,
-					     dls_client_t *client)
+static void prv_system_update_cb(GUPnPServiceProxy *proxy,
+				 const char *variable,
+				 GValue *value,
+				 gpointer user_data)
 {
-	dls_device_context_t *context;
-	unsigned int i;
-	const char ip4_local_prefix[] = "127.0.0.";
-	gboolean prefer_local;
-	gboolean is_local;
-
-	prefer_local = (client && client->prefer_local_addresses);
-
-	for (i = 0; i < device->contexts->len; ++i) {
-		context = g_ptr_array_index(device->contexts, i);
+	GVariantBuilder *array;
+	GVariant *val;
+	dls_device_t *device = user_data;
+	guint suid = g_value_get_uint(value);
 
-		is_local = (!strncmp(context->ip_address, ip4_local_prefix,
-						sizeof(ip4_local_prefix) - 1) ||
-			    !strcmp(context->ip_address, "::1") ||
-			    !strcmp(context->ip_address, "0:0:0:0:0:0:0:1"));
+	DLEYNA_LOG_DEBUG("System Update %u", suid);
 
-		if (prefer_local == is_local)
-			break;
+	if (device->system_update_id != suid) {
+		prv_metadata_cache_clear(device);
+		prv_browse_window_clear(device);
 	}
 
-	if (i == device->contexts->len)
-		context = g_ptr_array_index(device->contexts, 0);
+	device->system_update_id = suid;
 
-	return context;
-}
+	array = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add(array, "{sv}",
+			      DLS_INTERFACE_PROP_ESV_SYSTEM_UPDATE_ID,
+			      g_variant_new_uint32(suid));
+	val = g_variant_new("(s@a{sv}as)", DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE,
+			    g_variant_builder_end(array),
+			    NULL);
 
-static void prv_found_child(GUPnPDIDLLiteParser *parser,
-			    GUPnPDIDLLiteObject *object,
-			    gpointer user_data)
-{
-	dls_async_task_t *cb_data = user_data;
-	dls_task_t *task = &cb_data->task;
-	dls_task_get_children_t *task_data = &task->ut.get_children;
-	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
-	dls_device_object_builder_t *builder;
-	gboolean have_child_count;
+	(void) dls_server_get_connector()->notify(device->connection,
+					   device->path,
+					   DLS_INTERFACE_PROPERTIES,
+					   DLS_INTERFACE_PROPERTIES_CHANGED,
+					   val,
+					   NULL);
 
-	DLEYNA_LOG_DEBUG("Enter");
+	g_variant_builder_unref(array);
 
-	builder = g_new0(dls_device_object_builder_t, 1);
+	prv_system_update_notify_subscribers(device);
+}
 
-	if (GUPNP_IS_DIDL_LITE_CONTAINER(object)) {
-		if (!task_data->containers)
-			goto on_error;
-	} else {
-		if (!task_data->items)
-			goto on_error;
-	}
+static gboolean prv_re_enable_cd_subscription(gpointer user_data)
+{
+	dls_device_context_t *context = user_data;
 
-	builder->vb = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+	context->cds.timeout_id = 0;
 
-	if (!dls_props_add_object(builder->vb, object, task->target.root_path,
-				  task->target.path, cb_task_data->filter_mask))
-		goto on_error;
+	return FALSE;
+}
 
-	if (GUPNP_IS_DIDL_LITE_CONTAINER(object)) {
-		dls_props_add_container(builder->vb,
-					(GUPnPDIDLLiteContainer *)object,
-					cb_task_data->filter_mask,
-					cb_task_data->protocol_info,
-					&have_child_count);
+static void prv_cd_subscription_lost_cb(GUPnPServiceProxy *proxy,
+				     const GError *reason,
+				     gpointer user_data)
+{
+	dls_device_context_t *context = user_data;
 
-		if (!have_child_count && (cb_task_data->filter_mask &
-					  DLS_UPNP_MASK_PROP_CHILD_COUNT)) {
-			builder->needs_child_count = TRUE;
-			builder->id = g_strdup(
-				gupnp_didl_lite_object_get_id(object));
-			cb_task_data->need_child_count = TRUE;
-		}
+	if (!context->cds.timeout_id) {
+		gupnp_service_proxy_set_subscribed(context->cds.proxy, TRUE);
+		context->cds.timeout_id = g_timeout_add_seconds(
+						10,
+						prv_re_enable_cd_subscription,
+						context);
 	} else {
-		dls_props_add_item(builder->vb, object,
-				   task->target.root_path,
-				   cb_task_data->filter_mask,
-				   cb_task_data->protocol_info);
+		g_source_remove(context->cds.timeout_id);
+		gupnp_service_proxy_remove_notify(context->cds.proxy,
+						  DLS_SYSTEM_UPDATE_VAR,
+						  prv_system_update_cb,
+						  context->device);
+		gupnp_service_proxy_remove_notify(context->cds.proxy,
+						  DLS_CONTAINER_UPDATE_VAR,
+						  prv_container_update_cb,
+						  context->device);
+		gupnp_service_proxy_remove_notify(context->cds.proxy,
+						  DLS_LAST_CHANGE_VAR,
+						  prv_last_change_cb,
+						  context->device);
+
+		context->cds.timeout_id = 0;
+		context->cds.subscribed = FALSE;
 	}
+}
 
-	g_ptr_array_add(cb_task_data->vbs, builder);
+static gboolean prv_re_enable_em_subscription(gpointer user_data)
+{
+	dls_device_context_t *context = user_data;
 
-	DLEYNA_LOG_DEBUG("Exit with SUCCESS");
+	context->cds.timeout_id = 0;
 
-	return;
+	return FALSE;
+}
 
-on_error:
+static void prv_em_subscription_lost_cb(GUPnPServiceProxy *proxy,
+					const GError *reason,
+					gpointer user_data)
+{
+	dls_device_context_t *context = user_data;
 
-	prv_object_builder_delete(builder);
+	if (!context->ems.timeout_id) {
+		gupnp_service_proxy_set_subscribed(context->ems.proxy, TRUE);
+		context->ems.timeout_id = g_timeout_add_seconds(
+						10,
+						prv_re_enable_em_subscription,
+						context);
+	} else {
+		g_source_remove(context->ems.timeout_id);
+		gupnp_service_proxy_remove_notify(
+						context->ems.proxy,
+						DLS_NETWORK_INTERFACE_INFO_VAR,
+						prv_network_interface_info_cb,
+						context->device);
 
-	DLEYNA_LOG_DEBUG("Exit with FAIL");
+		context->ems.timeout_id = 0;
+		context->ems.subscribed = FALSE;
+	}
 }
 
-static GVariant *prv_children_result_to_variant(dls_async_task_t *cb_data)
+void dls_device_subscribe_to_service_changes(dls_device_t *device)
 {
-	guint i;
-	dls_device_object_builder_t *builder;
-	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
-	GVariantBuilder vb;
+	dls_device_context_t *context;
 
-	g_variant_builder_init(&vb, G_VARIANT_TYPE("aa{sv}"));
+	context = dls_device_get_context(device, NULL);
 
-	for (i = 0; i < cb_task_data->vbs->len; ++i) {
-		builder = g_ptr_array_index(cb_task_data->vbs, i);
-		g_variant_builder_add(&vb, "@a{sv}",
-				      g_variant_builder_end(builder->vb));
-	}
+	DLEYNA_LOG_DEBUG("Subscribe for events on context: %s",
+			 context->ip_address);
 
-	return  g_variant_builder_end(&vb);
-}
+	if (context->cds.proxy) {
+		gupnp_service_proxy_add_notify(context->cds.proxy,
+					       DLS_SYSTEM_UPDATE_VAR,
+					       G_TYPE_UINT,
+					       prv_system_update_cb,
+					       device);
 
-static void prv_get_search_ex_result(dls_async_task_t *cb_data)
-{
-	GVariant *out_params[2];
-	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+		gupnp_service_proxy_add_notify(context->cds.proxy,
+					       DLS_CONTAINER_UPDATE_VAR,
+					       G_TYPE_STRING,
+					       prv_container_update_cb,
+					       device);
 
-	out_params[0] = prv_children_result_to_variant(cb_data);
-	out_params[1] = g_variant_new_uint32(cb_task_data->max_count);
+		gupnp_service_proxy_add_notify(context->cds.proxy,
+					       DLS_LAST_CHANGE_VAR,
+					       G_TYPE_STRING,
+					       prv_last_change_cb,
+					       device);
 
-	cb_data->task.result = g_variant_ref_sink(
-					g_variant_new_tuple(out_params, 2));
-}
+		context->cds.subscribed = TRUE;
+		gupnp_service_proxy_set_subscribed(context->cds.proxy, TRUE);
 
-static void prv_get_children_result(dls_async_task_t *cb_data)
-{
-	GVariant *retval = prv_children_result_to_variant(cb_data);
-	cb_data->task.result =  g_variant_ref_sink(retval);
-}
+		g_signal_connect(context->cds.proxy, "subscription-lost",
+				 G_CALLBACK(prv_cd_subscription_lost_cb),
+				 context);
+	}
 
-static gboolean prv_child_count_for_list_cb(dls_async_task_t *cb_data,
-					    gint count)
-{
-	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
-	dls_device_object_builder_t *builder;
+	if (context->ems.proxy) {
+		gupnp_service_proxy_add_notify(context->ems.proxy,
+					       DLS_NETWORK_INTERFACE_INFO_VAR,
+					       G_TYPE_STRING,
+					       prv_network_interface_info_cb,
+					       device);
 
-	builder = g_ptr_array_index(cb_task_data->vbs, cb_task_data->retrieved);
-	dls_props_add_child_count(builder->vb, count);
-	cb_task_data->retrieved++;
-	prv_retrieve_child_count_for_list(cb_data);
+		context->ems.subscribed = TRUE;
+		gupnp_service_proxy_set_subscribed(context->ems.proxy, TRUE);
 
-	return cb_task_data->retrieved >= cb_task_data->vbs->len;
+		g_signal_connect(context->ems.proxy, "subscription-lost",
+				 G_CALLBACK(prv_em_subscription_lost_cb),
+				 context);
+	}
 }
 
-static void prv_retrieve_child_count_for_list(dls_async_task_t *cb_data)
+static void prv_new_device_ct_delete(gpointer data)
 {
-	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
-	dls_device_object_builder_t *builder = NULL;
-	guint i;
+	prv_new_device_ct_t *priv_t = data;
+	prv_capability_t *cap;
+	unsigned int i;
 
-	for (i = cb_task_data->retrieved; i < cb_task_data->vbs->len; ++i) {
-		builder = g_ptr_array_index(cb_task_data->vbs, i);
+	for (i = 0; i < DLS_DEVICE_CACHE_VALUE_COUNT; ++i) {
+		cap = &priv_t->caps[i];
 
-		if (builder->needs_child_count)
-			break;
+		/* Adopted actions are cancelled by the service task */
+		if (cap->action && !cap->task)
+			gupnp_service_proxy_cancel_action(priv_t->proxy,
+							  cap->action);
+
+		g_free(cap->result);
+		g_free(cap->error);
 	}
 
-	cb_task_data->retrieved = i;
+	if (priv_t->proxy)
+		g_object_unref(priv_t->proxy);
 
-	if (i < cb_task_data->vbs->len && builder)
-		prv_get_child_count(cb_data, prv_child_count_for_list_cb,
-				    builder->id);
-	else
-		cb_task_data->get_children_cb(cb_data);
+	g_free(priv_t->udn);
+	g_free(priv_t->config_id);
+	dls_device_cache_entry_delete(priv_t->fetched);
+	dls_device_cache_entry_delete(priv_t->cached);
+	g_free(priv_t);
 }
 
-static void prv_get_children_cb(GUPnPServiceProxy *proxy,
-				GUPnPServiceProxyAction *action,
-				gpointer user_data)
+static void prv_cache_store(prv_new_device_ct_t *priv_t,
+			    dls_device_cache_value_t value, const gchar *result)
 {
-	gchar *result = NULL;
-	const gchar *message;
-	gboolean end;
-	GUPnPDIDLLiteParser *parser = NULL;
-	GError *error = NULL;
-	dls_async_task_t *cb_data = user_data;
-	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
-
-	DLEYNA_LOG_DEBUG("Enter");
+	if (priv_t->fetched) {
+		g_free(priv_t->fetched->values[value]);
+		priv_t->fetched->values[value] = g_strdup(result);
+	}
+}
 
-	end = gupnp_service_proxy_end_action(cb_data->proxy, cb_data->action,
-					     &error, "Result",
-					     G_TYPE_STRING, &result, NULL);
+static void prv_feature_list_add_feature(gchar *root_path,
+					 GUPnPFeature *feature,
+					 GVariantBuilder *vb)
+{
+	GVariantBuilder vbo;
+	GVariant *var_obj;
+	const char *name;
+	const char *version;
+	const char *obj_id;
+	gchar **obj;
+	gchar **paths;
+	gchar **path;
 
-	if (!end || (result == NULL)) {
-		message = (error != NULL) ? error->message : "Invalid result";
-		DLEYNA_LOG_WARNING("Browse operation failed: %s", message);
+	name = gupnp_feature_get_name(feature);
+	version = gupnp_feature_get_version(feature);
+	obj_id = gupnp_feature_get_object_ids(feature);
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "Browse operation failed: %s",
-					     message);
-		goto on_error;
-	}
+	g_variant_builder_init(&vbo, G_VARIANT_TYPE("ao"));
 
-	DLEYNA_LOG_DEBUG("GetChildren result: %s", result);
+	if (obj_id != NULL && *obj_id) {
+		obj = g_strsplit(obj_id, ",", 0);
+		paths = dls_path_from_ids(root_path, obj);
 
-	parser = gupnp_didl_lite_parser_new();
+		for (path = paths; *path; path++)
+			g_variant_builder_add(&vbo, "o", *path);
 
-	g_signal_connect(parser, "object-available" ,
-			 G_CALLBACK(prv_found_child), cb_data);
+		g_strfreev(paths);
+		g_strfreev(obj);
+	}
 
-	cb_task_data->vbs = g_ptr_array_new_with_free_func(
-		prv_object_builder_delete);
+	var_obj = g_variant_builder_end(&vbo);
+	g_variant_builder_add(vb, "(ss@ao)", name, version, var_obj);
+}
 
-	if (!gupnp_didl_lite_parser_parse_didl(parser, result, &error) &&
-	    error->code != GUPNP_XML_ERROR_EMPTY_NODE) {
-		DLEYNA_LOG_WARNING("Unable to parse results of browse: %s",
-				   error->message);
+static void prv_get_feature_list_analyze(dls_device_t *device, gchar *result)
+{
+	GUPnPFeatureListParser *parser;
+	GUPnPFeature *feature;
+	GList *list;
+	GList *item;
+	GError *error = NULL;
+	GVariantBuilder vb;
+#if DLEYNA_LOG_LEVEL & DLEYNA_LOG_LEVEL_DEBUG
+	char *str;
+#endif
+	parser = gupnp_feature_list_parser_new();
+	list = gupnp_feature_list_parser_parse_text(parser, result, &error);
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "Unable to parse results of browse: %s",
-					     error->message);
-		goto on_error;
+	if (error != NULL) {
+		DLEYNA_LOG_WARNING("GetFeatureList parsing failed: %s",
+				   error->message);
+		goto on_exit;
 	}
 
-	if (cb_task_data->need_child_count) {
-		DLEYNA_LOG_DEBUG("Need to retrieve ChildCounts");
+	g_variant_builder_init(&vb, G_VARIANT_TYPE("a(ssao)"));
+	item = list;
 
-		cb_task_data->get_children_cb = prv_get_children_result;
-		prv_retrieve_child_count_for_list(cb_data);
-		goto no_complete;
-	} else {
-		prv_get_children_result(cb_data);
+	while (item != NULL) {
+		feature = (GUPnPFeature *)item->data;
+		prv_feature_list_add_feature(device->path, feature, &vb);
+		g_object_unref(feature);
+		item = g_list_next(item);
 	}
 
-on_error:
+	device->feature_list = g_variant_ref_sink(g_variant_builder_end(&vb));
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
-	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+#if DLEYNA_LOG_LEVEL & DLEYNA_LOG_LEVEL_DEBUG
+	str = g_variant_print(device->feature_list, FALSE);
+	DLEYNA_LOG_DEBUG("%s = %s", DLS_INTERFACE_PROP_SV_FEATURE_LIST, str);
+	g_free(str);
+#endif
 
-no_complete:
+on_exit:
+	g_list_free(list);
+	g_object_unref(parser);
 
-	if (error)
+	if (error != NULL)
 		g_error_free(error);
+}
 
-	if (parser)
-		g_object_unref(parser);
+static void prv_get_sort_ext_capabilities_analyze(dls_device_t *device,
+						  gchar *result)
+{
+	gchar **caps;
+	gchar **saved;
+#if DLEYNA_LOG_LEVEL & DLEYNA_LOG_LEVEL_DEBUG
+	gchar *props;
+#endif
+	GVariantBuilder sort_ext_caps_vb;
 
-	g_free(result);
+	g_variant_builder_init(&sort_ext_caps_vb, G_VARIANT_TYPE("as"));
 
-	DLEYNA_LOG_DEBUG("Exit");
+	caps = g_strsplit(result, ",", 0);
+	saved = caps;
+
+	while (caps && *caps) {
+		g_variant_builder_add(&sort_ext_caps_vb, "s", *caps);
+		caps++;
+	}
+
+	g_strfreev(saved);
+
+	device->sort_ext_caps = g_variant_ref_sink(g_variant_builder_end(
+							&sort_ext_caps_vb));
+
+#if DLEYNA_LOG_LEVEL & DLEYNA_LOG_LEVEL_DEBUG
+	props = g_variant_print(device->sort_ext_caps, FALSE);
+	DLEYNA_LOG_DEBUG("%s = %s",
+			 DLS_INTERFACE_PROP_SV_SORT_EXT_CAPABILITIES, props);
+	g_free(props);
+#endif
 }
 
-void dls_device_get_children(dls_client_t *client,
-			     dls_task_t *task,
-			     const gchar *upnp_filter, const gchar *sort_by)
+static void prv_get_capabilities_analyze(GHashTable *property_map,
+					 gchar *result,
+					 GVariant **variant)
 {
-	dls_async_task_t *cb_data = (dls_async_task_t *)task;
-	dls_device_context_t *context;
+	gchar **caps;
+	gchar **saved;
+	gchar *prop_name;
+	GVariantBuilder caps_vb;
 
-	DLEYNA_LOG_DEBUG("Enter");
+	g_variant_builder_init(&caps_vb, G_VARIANT_TYPE("as"));
 
-	context = dls_device_get_context(task->target.device, client);
+	if (!strcmp(result, "*")) {
+		g_variant_builder_add(&caps_vb, "s", "*");
+	} else {
+		caps = g_strsplit(result, ",", 0);
+		saved = caps;
 
-	cb_data->proxy = context->cds.proxy;
+		while (caps && *caps) {
+			prop_name = g_hash_table_lookup(property_map, *caps);
 
-	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
-				  (gpointer *)&cb_data->proxy);
+			if (prop_name) {
+				g_variant_builder_add(&caps_vb, "s", prop_name);
 
-	cb_data->action =
-		gupnp_service_proxy_begin_action(cb_data->proxy,
-						 "Browse",
-						 prv_get_children_cb,
-						 cb_data,
-						 "ObjectID", G_TYPE_STRING,
-						 task->target.id,
+				/* TODO: Okay this is not very nice.  A better
+				   way to fix this would be to change the p_map
+				   to be many : many. */
 
-						 "BrowseFlag", G_TYPE_STRING,
-						 "BrowseDirectChildren",
+				if (!strcmp(*caps, "upnp:class"))
+					g_variant_builder_add(
+						&caps_vb, "s",
+						DLS_INTERFACE_PROP_TYPE_EX);
+			}
 
-						 "Filter", G_TYPE_STRING,
-						 upnp_filter,
+			caps++;
+		}
 
-						 "StartingIndex", G_TYPE_INT,
-						 task->ut.get_children.start,
-						 "RequestedCount", G_TYPE_INT,
-						 task->ut.get_children.count,
-						 "SortCriteria", G_TYPE_STRING,
-						 sort_by,
-						 NULL);
+		g_strfreev(saved);
+	}
 
-	cb_data->cancel_id = g_cancellable_connect(
-					cb_data->cancellable,
-					G_CALLBACK(dls_async_task_cancelled_cb),
-					cb_data, NULL);
+	*variant = g_variant_ref_sink(g_variant_builder_end(&caps_vb));
 
-	DLEYNA_LOG_DEBUG("Exit");
+#if DLEYNA_LOG_LEVEL & DLEYNA_LOG_LEVEL_DEBUG
+	prop_name = g_variant_print(*variant, FALSE);
+	DLEYNA_LOG_DEBUG("%s = %s", "   Variant", prop_name);
+	g_free(prop_name);
+#endif
 }
 
-static void prv_get_item(GUPnPDIDLLiteParser *parser,
-			 GUPnPDIDLLiteObject *object,
-			 gpointer user_data)
-{
-	dls_async_task_t *cb_data = user_data;
-	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
+typedef struct prv_caps_action_t_ prv_caps_action_t;
+struct prv_caps_action_t_ {
+	const gchar *name;
+	const gchar *result;
+};
 
-	if (!GUPNP_IS_DIDL_LITE_CONTAINER(object))
-		dls_props_add_item(cb_task_data->vb, object,
-				   cb_data->task.target.root_path,
-				   cb_task_data->filter_mask,
-				   cb_task_data->protocol_info);
-	else
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_UNKNOWN_INTERFACE,
-					     "Interface not supported on container.");
-}
+static const prv_caps_action_t g_caps_actions[DLS_DEVICE_CACHE_VALUE_COUNT] = {
+	{ "GetSearchCapabilities", "SearchCaps" },
+	{ "GetSortCapabilities", "SortCaps" },
+	{ "GetSortExtensionCapabilities", "SortExtensionCaps" },
+	{ "GetFeatureList", "FeatureList" }
+};
 
-static void prv_get_container(GUPnPDIDLLiteParser *parser,
-		       GUPnPDIDLLiteObject *object,
-		       gpointer user_data)
+static void prv_apply_cached_caps(dls_device_t *device,
+				  GHashTable *property_map,
+				  dls_device_cache_entry_t *entry)
 {
-	dls_async_task_t *cb_data = user_data;
-	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
-	gboolean have_child_count;
+	gchar **values = entry->values;
 
-	if (GUPNP_IS_DIDL_LITE_CONTAINER(object)) {
-		dls_props_add_container(cb_task_data->vb,
-					(GUPnPDIDLLiteContainer *)object,
-					cb_task_data->filter_mask,
-					cb_task_data->protocol_info,
-					&have_child_count);
-		if (!have_child_count)
-			cb_task_data->need_child_count = TRUE;
-	} else {
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_UNKNOWN_INTERFACE,
-					     "Interface not supported on item.");
+	if (values[DLS_DEVICE_CACHE_SEARCH_CAPS]) {
+		g_clear_pointer(&device->search_caps, g_variant_unref);
+		prv_get_capabilities_analyze(
+					property_map,
+					values[DLS_DEVICE_CACHE_SEARCH_CAPS],
+					&device->search_caps);
+
+		if (g_hash_table_lookup(property_map, "upnp:objectUpdateID"))
+			device->has_last_change = TRUE;
+	}
+
+	if (values[DLS_DEVICE_CACHE_SORT_CAPS]) {
+		g_clear_pointer(&device->sort_caps, g_variant_unref);
+		prv_get_capabilities_analyze(property_map,
+					     values[DLS_DEVICE_CACHE_SORT_CAPS],
+					     &device->sort_caps);
+	}
+
+	if (values[DLS_DEVICE_CACHE_SORT_EXT_CAPS]) {
+		g_clear_pointer(&device->sort_ext_caps, g_variant_unref);
+		prv_get_sort_ext_capabilities_analyze(
+					device,
+					values[DLS_DEVICE_CACHE_SORT_EXT_CAPS]);
+	}
+
+	if (values[DLS_DEVICE_CACHE_FEATURE_LIST]) {
+		g_clear_pointer(&device->feature_list, g_variant_unref);
+		prv_get_feature_list_analyze(
+					device,
+					values[DLS_DEVICE_CACHE_FEATURE_LIST]);
 	}
 }
 
-static void prv_get_object(GUPnPDIDLLiteParser *parser,
-			   GUPnPDIDLLiteObject *object,
-			   gpointer user_data)
+static gchar *prv_get_config_id(GUPnPDeviceInfo *device_info)
 {
-	dls_async_task_t *cb_data = user_data;
-	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
-	const char *object_id;
-	const char *parent_id;
-	const char *parent_path;
-	gchar *path = NULL;
+	xmlNode *element = NULL;
+	xmlNode *root;
+	xmlChar *prop;
+	gchar *config_id = NULL;
 
-	object_id = gupnp_didl_lite_object_get_id(object);
-	if (!object_id)
-		goto on_error;
+	g_object_get(device_info, "element", &element, NULL);
 
-	parent_id = gupnp_didl_lite_object_get_parent_id(object);
-	if (!parent_id)
-		goto on_error;
+	if (!element || !element->doc)
+		goto on_exit;
 
-	if (!strcmp(object_id, "0") || !strcmp(parent_id, "-1")) {
-		parent_path = cb_data->task.target.root_path;
-	} else {
-		path = dls_path_from_id(cb_data->task.target.root_path,
-					parent_id);
-		parent_path = path;
+	root = xmlDocGetRootElement(element->doc);
+	if (!root)
+		goto on_exit;
+
+	prop = xmlGetProp(root, (const xmlChar *)"configId");
+	if (prop) {
+		config_id = g_strdup((const gchar *)prop);
+		xmlFree(prop);
 	}
 
-	if (!dls_props_add_object(cb_task_data->vb, object,
-				  cb_data->task.target.root_path,
-				  parent_path, cb_task_data->filter_mask))
-		goto on_error;
+on_exit:
 
-	g_free(path);
+	return config_id;
+}
 
-	return;
-
-on_error:
+struct dls_device_revalidate_t_ {
+	dls_device_t *device;
+	GUPnPServiceProxy *proxy;
+	GUPnPServiceProxyAction *action;
+	GHashTable *property_map;
+	gchar *udn;
+	gchar *config_id;
+	dls_device_cache_entry_t *cached;
+	dls_device_cache_entry_t *fetched;
+	guint step;
+};
 
-	cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-				     DLEYNA_ERROR_BAD_RESULT,
-				     "Unable to retrieve mandatory object properties");
-	g_free(path);
-}
+static void prv_revalidate_next(dls_device_revalidate_t *revalidate);
 
-static void prv_get_all(GUPnPDIDLLiteParser *parser,
-			GUPnPDIDLLiteObject *object,
-			gpointer user_data)
+static void prv_revalidate_delete(dls_device_revalidate_t *revalidate)
 {
-	dls_async_task_t *cb_data = user_data;
-	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
-	gboolean have_child_count;
-
-	prv_get_object(parser, object, user_data);
+	if (revalidate->action)
+		gupnp_service_proxy_cancel_action(revalidate->proxy,
+						  revalidate->action);
 
-	if (!cb_data->error) {
-		if (GUPNP_IS_DIDL_LITE_CONTAINER(object)) {
-			dls_props_add_container(
-				cb_task_data->vb,
-				(GUPnPDIDLLiteContainer *)
-				object, cb_task_data->filter_mask,
-				cb_task_data->protocol_info,
-				&have_child_count);
-			if (!have_child_count)
-				cb_task_data->need_child_count = TRUE;
-		} else {
-			dls_props_add_item(cb_task_data->vb,
-					   object,
-					   cb_data->task.target.root_path,
-					   cb_task_data->filter_mask,
-					   cb_task_data->protocol_info);
-		}
-	}
+	g_object_unref(revalidate->proxy);
+	g_free(revalidate->udn);
+	g_free(revalidate->config_id);
+	dls_device_cache_entry_delete(revalidate->cached);
+	dls_device_cache_entry_delete(revalidate->fetched);
+	g_free(revalidate);
 }
 
-static gboolean prv_cds_subscribed(const dls_device_t *device)
+static void prv_revalidate_finish(dls_device_revalidate_t *revalidate)
 {
-	dls_device_context_t *context;
-	unsigned int i;
-	gboolean subscribed = FALSE;
+	dls_device_t *device = revalidate->device;
 
-	for (i = 0; i < device->contexts->len; ++i) {
-		context = g_ptr_array_index(device->contexts, i);
-		if (context->cds.subscribed) {
-			subscribed = TRUE;
-			break;
-		}
+	if (!dls_device_cache_entry_equal(revalidate->cached,
+					  revalidate->fetched)) {
+		DLEYNA_LOG_DEBUG("Cached capabilities of %s are stale",
+				 device->path);
+
+		prv_apply_cached_caps(device, revalidate->property_map,
+				      revalidate->fetched);
+		dls_device_cache_save(revalidate->udn, revalidate->config_id,
+				      revalidate->fetched);
+	} else {
+		DLEYNA_LOG_DEBUG("Cached capabilities of %s are up to date",
+				 device->path);
 	}
 
-	return subscribed;
+	device->revalidate = NULL;
+	prv_revalidate_delete(revalidate);
 }
 
-static void prv_system_update_id_for_prop_cb(GUPnPServiceProxy *proxy,
-				    GUPnPServiceProxyAction *action,
-				    gpointer user_data)
+static void prv_revalidate_cb(GUPnPServiceProxy *proxy,
+			      GUPnPServiceProxyAction *action,
+			      gpointer user_data)
 {
-	GError *error = NULL;
-	const gchar *message;
+	gchar *result = NULL;
 	gboolean end;
-	guint id = G_MAXUINT32;
-	dls_async_task_t *cb_data = user_data;
+	GError *error = NULL;
+	dls_device_revalidate_t *revalidate = user_data;
+	guint step = revalidate->step;
 
-	DLEYNA_LOG_DEBUG("Enter");
+	revalidate->action = NULL;
 
 	end = gupnp_service_proxy_end_action(proxy, action, &error,
-					     "Id", G_TYPE_UINT, &id, NULL);
-
-	if (!end || (id == G_MAXUINT32)) {
-		message = (error != NULL) ? error->message : "Invalid result";
-		DLEYNA_LOG_WARNING("Unable to retrieve SystemUpdateID: %s",
-				   message);
+					     g_caps_actions[step].result,
+					     G_TYPE_STRING, &result, NULL);
 
-		cb_data->error = g_error_new(
-					DLEYNA_SERVER_ERROR,
-					DLEYNA_ERROR_OPERATION_FAILED,
-					"Unable to retrieve SystemUpdateID: %s",
-					message);
+	if (!end || (result == NULL)) {
+		DLEYNA_LOG_DEBUG("%s revalidation failed: %s",
+				 g_caps_actions[step].name,
+				 ((error != NULL) ? error->message
+						  : "Invalid result"));
 
-		goto on_complete;
+		/* A failed call is no proof that the cached value is wrong */
+		g_free(result);
+		result = g_strdup(revalidate->cached->values[step]);
 	}
 
-	cb_data->task.result = g_variant_ref_sink(g_variant_new_uint32(id));
+	revalidate->fetched->values[step] = result;
+	revalidate->step++;
 
-on_complete:
+	if (error != NULL)
+		g_error_free(error);
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
-	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+	prv_revalidate_next(revalidate);
+}
 
-	if (error)
-		g_error_free(error);
+static void prv_revalidate_next(dls_device_revalidate_t *revalidate)
+{
+	if (revalidate->step == DLS_DEVICE_CACHE_VALUE_COUNT) {
+		prv_revalidate_finish(revalidate);
+		goto on_exit;
+	}
 
-	DLEYNA_LOG_DEBUG("Exit");
+	revalidate->action = gupnp_service_proxy_begin_action(
+				revalidate->proxy,
+				g_caps_actions[revalidate->step].name,
+				prv_revalidate_cb, revalidate, NULL);
+
+on_exit:
+
+	return;
 }
 
-static void prv_get_system_update_id_for_prop(GUPnPServiceProxy *proxy,
-				     const dls_device_t *device,
-				     dls_async_task_t *cb_data)
+static void prv_revalidate_start(prv_new_device_ct_t *priv_t,
+				 GUPnPServiceProxy *proxy)
 {
-	guint suid;
+	dls_device_revalidate_t *revalidate;
 
-	DLEYNA_LOG_DEBUG("Enter");
+	DLEYNA_LOG_DEBUG("Revalidating cached capabilities of %s",
+			 priv_t->dev->path);
 
-	if (prv_cds_subscribed(device)) {
-		suid = device->system_update_id;
+	revalidate = g_new0(dls_device_revalidate_t, 1);
+	revalidate->device = priv_t->dev;
+	revalidate->proxy = g_object_ref(proxy);
+	revalidate->property_map = priv_t->property_map;
+	revalidate->udn = priv_t->udn;
+	revalidate->config_id = priv_t->config_id;
+	revalidate->cached = priv_t->cached;
+	revalidate->fetched = dls_device_cache_entry_new();
 
-		cb_data->task.result = g_variant_ref_sink(
-						g_variant_new_uint32(suid));
+	priv_t->udn = NULL;
+	priv_t->config_id = NULL;
+	priv_t->cached = NULL;
 
-		(void) g_idle_add(dls_async_task_complete, cb_data);
+	priv_t->dev->revalidate = revalidate;
+	prv_revalidate_next(revalidate);
+}
 
-		goto on_complete;
+static void prv_get_capability_analyze(prv_new_device_ct_t *priv_t)
+{
+	dls_device_t *device = priv_t->dev;
+	guint step = device->construct_step;
+	prv_capability_t *cap = &priv_t->caps[step];
+
+	device->construct_step++;
+
+	if (cap->result == NULL) {
+		DLEYNA_LOG_WARNING("%s operation failed: %s",
+				   g_caps_actions[step].name,
+				   ((cap->error != NULL) ? cap->error
+							 : "Invalid result"));
+		goto on_exit;
 	}
 
-	cb_data->action = gupnp_service_proxy_begin_action(
-					proxy, "GetSystemUpdateID",
-					prv_system_update_id_for_prop_cb,
-					cb_data,
-					NULL);
+	DLEYNA_LOG_DEBUG("%s result: %s", g_caps_actions[step].name,
+			 cap->result);
 
-	cb_data->proxy = proxy;
-	g_object_add_weak_pointer((G_OBJECT(proxy)),
-				  (gpointer *)&cb_data->proxy);
+	switch (step) {
+	case DLS_DEVICE_CACHE_SEARCH_CAPS:
+		prv_get_capabilities_analyze(priv_t->property_map, cap->result,
+					     &device->search_caps);
 
-	cb_data->cancel_id = g_cancellable_connect(
-					cb_data->cancellable,
-					G_CALLBACK(dls_async_task_cancelled_cb),
-					cb_data, NULL);
+		if (g_hash_table_lookup(priv_t->property_map,
+					"upnp:objectUpdateID"))
+			device->has_last_change = TRUE;
+		break;
+	case DLS_DEVICE_CACHE_SORT_CAPS:
+		prv_get_capabilities_analyze(priv_t->property_map, cap->result,
+					     &device->sort_caps);
+		break;
+	case DLS_DEVICE_CACHE_SORT_EXT_CAPS:
+		prv_get_sort_ext_capabilities_analyze(device, cap->result);
+		break;
+	case DLS_DEVICE_CACHE_FEATURE_LIST:
+		prv_get_feature_list_analyze(device, cap->result);
+		break;
+	default:
+		break;
+	}
 
-on_complete:
+	prv_cache_store(priv_t, step, cap->result);
 
-	DLEYNA_LOG_DEBUG("Exit");
+on_exit:
+
+	/* Last capability step: persist what the server told us */
+	if (step == DLS_DEVICE_CACHE_FEATURE_LIST && priv_t->fetched)
+		dls_device_cache_save(priv_t->udn, priv_t->config_id,
+				      priv_t->fetched);
 }
 
-static void prv_system_update_id_for_props_cb(GUPnPServiceProxy *proxy,
-				    GUPnPServiceProxyAction *action,
-				    gpointer user_data)
+static void prv_get_capability_cb(GUPnPServiceProxy *proxy,
+				  GUPnPServiceProxyAction *action,
+				  gpointer user_data)
 {
 	GError *error = NULL;
-	const gchar *message;
-	gboolean end;
-	guint id = G_MAXUINT32;
-	dls_async_task_t *cb_data = user_data;
-	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
-
-	DLEYNA_LOG_DEBUG("Enter");
-
-	end = gupnp_service_proxy_end_action(proxy, action, &error,
-					    "Id", G_TYPE_UINT, &id, NULL);
+	prv_capability_t *cap = NULL;
+	dleyna_service_task_t *task;
+	prv_new_device_ct_t *priv_t = (prv_new_device_ct_t *)user_data;
+	unsigned int i;
 
-	if (!end || (id == G_MAXUINT32)) {
-		message = (error != NULL) ? error->message : "Invalid result";
-		DLEYNA_LOG_WARNING("Unable to retrieve SystemUpdateID: %s",
-				   message);
+	for (i = 0; i < DLS_DEVICE_CACHE_VALUE_COUNT; ++i) {
+		if (priv_t->caps[i].action == action) {
+			cap = &priv_t->caps[i];
+			break;
+		}
+	}
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "Unable to retrieve SystemUpdateID: %s",
-					     message);
+	if (!cap)
+		goto on_exit;
 
-		goto on_complete;
+	if (!gupnp_service_proxy_end_action(proxy, action, &error,
+					    g_caps_actions[i].result,
+					    G_TYPE_STRING, &cap->result,
+					    NULL)) {
+		g_free(cap->result);
+		cap->result = NULL;
 	}
 
-	g_variant_builder_add(cb_task_data->vb, "{sv}",
-			      DLS_SYSTEM_UPDATE_VAR,
-			      g_variant_new_uint32(id));
-
-	cb_data->task.result = g_variant_ref_sink(g_variant_builder_end(
-							cb_task_data->vb));
+	if (error != NULL) {
+		cap->error = g_strdup(error->message);
+		g_error_free(error);
+	}
 
-on_complete:
+	cap->action = NULL;
+	cap->done = TRUE;
 
-	if (!cb_data->error)
-		prv_get_sr_token_for_props(proxy, cb_data->task.target.device,
-					   cb_data);
-	else {
-		(void) g_idle_add(dls_async_task_complete, cb_data);
-		g_cancellable_disconnect(cb_data->cancellable,
-					 cb_data->cancel_id);
+	/* The construction queue is already waiting for this step */
+	if (cap->task) {
+		task = cap->task;
+		cap->task = NULL;
+		dleyna_service_task_begin_action_cb(proxy, action, task);
 	}
 
-	if (error)
-		g_error_free(error);
+on_exit:
 
-	DLEYNA_LOG_DEBUG("Exit");
+	return;
 }
 
-static void prv_get_system_update_id_for_props(GUPnPServiceProxy *proxy,
-				     const dls_device_t *device,
-				     dls_async_task_t *cb_data)
+static void prv_get_capability_task_cb(GUPnPServiceProxy *proxy,
+				       GUPnPServiceProxyAction *action,
+				       gpointer user_data)
 {
-	dls_async_get_all_t *cb_task_data;
-	guint suid;
+	prv_get_capability_analyze((prv_new_device_ct_t *)user_data);
+}
 
-	DLEYNA_LOG_DEBUG("Enter");
+static void prv_get_capabilities_begin(prv_new_device_ct_t *priv_t,
+				       GUPnPServiceProxy *proxy)
+{
+	prv_capability_t *cap;
+	unsigned int i;
 
-	if (prv_cds_subscribed(device)) {
-		suid = device->system_update_id;
+	priv_t->proxy = g_object_ref(proxy);
 
-		cb_task_data = &cb_data->ut.get_all;
+	for (i = priv_t->dev->construct_step;
+	     i < DLS_DEVICE_CACHE_VALUE_COUNT; ++i) {
+		cap = &priv_t->caps[i];
+		cap->action = gupnp_service_proxy_begin_action(
+						proxy, g_caps_actions[i].name,
+						prv_get_capability_cb,
+						priv_t, NULL);
+		cap->done = !cap->action;
+	}
+}
 
-		g_variant_builder_add(cb_task_data->vb, "{sv}",
-				      DLS_SYSTEM_UPDATE_VAR,
-				      g_variant_new_uint32(suid));
+static GUPnPServiceProxyAction *prv_get_capability(
+						dleyna_service_task_t *task,
+						GUPnPServiceProxy *proxy,
+						gboolean *failed)
+{
+	prv_new_device_ct_t *priv_t;
+	prv_capability_t *cap;
+	GUPnPServiceProxyAction *action = NULL;
 
-		prv_get_sr_token_for_props(proxy, device, cb_data);
+	priv_t = (prv_new_device_ct_t *)dleyna_service_task_get_user_data(task);
+	*failed = FALSE;
 
-		goto on_complete;
-	}
+	/* The first capability step issues all the remaining queries at
+	   once.  Each step then consumes its own result in order, so that
+	   construct_step still only counts completed steps. */
+	if (!priv_t->proxy)
+		prv_get_capabilities_begin(priv_t, proxy);
 
-	cb_data->action = gupnp_service_proxy_begin_action(
-					proxy, "GetSystemUpdateID",
-					prv_system_update_id_for_props_cb,
-					cb_data,
-					NULL);
+	cap = &priv_t->caps[priv_t->dev->construct_step];
 
-	if (cb_data->proxy != NULL)
-		g_object_remove_weak_pointer((G_OBJECT(cb_data->proxy)),
-					     (gpointer *)&cb_data->proxy);
+	if (cap->done) {
+		prv_get_capability_analyze(priv_t);
+	} else {
+		cap->task = task;
+		action = cap->action;
+	}
 
-	cb_data->proxy = proxy;
+	return action;
+}
 
-	g_object_add_weak_pointer((G_OBJECT(proxy)),
-				  (gpointer *)&cb_data->proxy);
+static GUPnPServiceProxyAction *prv_subscribe(dleyna_service_task_t *task,
+					      GUPnPServiceProxy *proxy,
+					      gboolean *failed)
+{
+	dls_device_t *device;
 
-	if (!cb_data->cancel_id)
-		cb_data->cancel_id = g_cancellable_connect(
-					cb_data->cancellable,
-					G_CALLBACK(dls_async_task_cancelled_cb),
-					cb_data, NULL);
+	device = (dls_device_t *)dleyna_service_task_get_user_data(task);
 
-on_complete:
+	device->construct_step++;
+	dls_device_subscribe_to_service_changes(device);
 
-	DLEYNA_LOG_DEBUG("Exit");
+	*failed = FALSE;
+
+	return NULL;
 }
 
-static gboolean prv_ems_subscribed(const dls_device_t *device)
+static gboolean prv_subtree_interface_filter(const gchar *object_path,
+					     const gchar *node,
+					     const gchar *interface)
 {
-	dls_device_context_t *context;
-	unsigned int i;
-	gboolean subscribed = FALSE;
+	gboolean root_object = FALSE;
+	const gchar *slash;
+	gboolean retval = TRUE;
 
-	for (i = 0; i < device->contexts->len; ++i) {
-		context = g_ptr_array_index(device->contexts, i);
-		if (context->ems.subscribed) {
-			subscribed = TRUE;
-			break;
-		}
-	}
+	/* All objects in the hierarchy support the same interface.  Strictly
+	   speaking this is not correct as it will allow ListChildren to be
+	   executed on a mediaitem object.  However, returning the correct
+	   interface here would be too inefficient.  We would need to either
+	   cache the type of all objects encountered so far or issue a UPnP
+	   request here to determine the objects type.  Best to let the client
+	   call ListChildren on a item.  This will lead to an error when we
+	   execute the UPnP command and we can return an error then.
 
-	return subscribed;
+	   We do know however that the root objects are containers.  Therefore
+	   we can remove the MediaItem2 interface from the root containers.  We
+	   also know that only the root objects suport the MediaDevice
+	   interface.
+	*/
+
+	if (dls_path_get_non_root_id(object_path, &slash))
+		root_object = !slash;
+
+	if (root_object && !strcmp(interface, DLS_INTERFACE_MEDIA_ITEM))
+		retval = FALSE;
+	else if (!root_object && !strcmp(interface,
+					 DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE))
+		retval = FALSE;
+
+	return retval;
 }
 
-static void prv_sleeping_for_props_cb(GUPnPServiceProxy *proxy,
-				      GUPnPServiceProxyAction *action,
-				      gpointer user_data)
+static GUPnPServiceProxyAction *prv_declare(dleyna_service_task_t *task,
+					    GUPnPServiceProxy *proxy,
+					    gboolean *failed)
 {
-	GError *error = NULL;
-	const gchar *message;
-	gchar *info = NULL;
-	gboolean end;
-	dls_async_task_t *cb_data = user_data;
-	dls_async_get_all_t *cb_task_data;
-	gboolean sleeping;
+	guint id;
+	dls_device_t *device;
+	prv_new_device_ct_t *priv_t;
 
-	DLEYNA_LOG_DEBUG("Enter");
+	priv_t = (prv_new_device_ct_t *)dleyna_service_task_get_user_data(task);
+	device = priv_t->dev;
+	device->construct_step++;
 
-	end = gupnp_service_proxy_end_action(proxy, action, &error,
-					     "NetworkInterfaceInfo",
-					     G_TYPE_STRING,
-					     &info, NULL);
+	id = dls_server_get_connector()->publish_subtree(priv_t->connection,
+						  device->path,
+						  priv_t->vtable,
+						  DLS_INTERFACE_INFO_MAX,
+						  prv_subtree_interface_filter);
+	if (id) {
+		device->id = id;
 
-	if (!end || (info == NULL)) {
-		message = (error != NULL) ? error->message : "Invalid result";
-		DLEYNA_LOG_WARNING("NetworkInterfaceInfo retrieval failed: %s",
-				   message);
+		device->uploads = g_hash_table_new_full(
+						g_int_hash,
+						g_int_equal,
+						g_free,
+						prv_upload_delete);
+		device->upload_jobs = g_hash_table_new_full(
+						g_int_hash,
+						g_int_equal,
+						g_free,
+						prv_upload_job_delete);
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "GetInterfaceInfo failed: %s",
-					     message);
-		goto on_complete;
+		/* Published from the on-disk cache: check the server still
+		   agrees, without delaying the device announcement */
+		if (priv_t->cached)
+			prv_revalidate_start(priv_t, proxy);
+	} else {
+		DLEYNA_LOG_WARNING("dleyna_connector_publish_subtree FAILED");
 	}
 
-	if (prv_get_device_sleeping_state(cb_data->task.target.device,
-					  info,
-					  &sleeping)) {
-		cb_task_data = &cb_data->ut.get_all;
-		g_variant_builder_add(cb_task_data->vb, "{sv}",
-				      DLS_INTERFACE_PROP_SLEEPING,
-				      g_variant_new_boolean(sleeping));
+	*failed = (!id);
 
-		cb_data->task.result = g_variant_ref_sink(g_variant_builder_end(
-							     cb_task_data->vb));
-	}
+	return NULL;
+}
 
-	g_free(info);
+void dls_device_construct(
+			dls_device_t *dev,
+			dls_device_context_t *context,
+			dleyna_connector_id_t connection,
+			const dleyna_connector_dispatch_cb_t *dispatch_table,
+			GHashTable *property_map,
+			const dleyna_task_queue_key_t *queue_id)
+{
+	prv_new_device_ct_t *priv_t;
+	GUPnPServiceProxy *s_proxy;
+	unsigned int i;
 
-on_complete:
+	DLEYNA_LOG_DEBUG("Current step: %d", dev->construct_step);
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
-	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+	priv_t = g_new0(prv_new_device_ct_t, 1);
 
-	if (error)
-		g_error_free(error);
+	priv_t->dev = dev;
+	priv_t->connection = connection;
+	priv_t->vtable = dispatch_table;
+	priv_t->property_map = property_map;
 
-	DLEYNA_LOG_DEBUG("Exit");
-}
+	s_proxy = context->cds.proxy;
 
-static void prv_get_sleeping_for_props(GUPnPServiceProxy *proxy,
-				       const dls_device_t *device,
-				       dls_async_task_t *cb_data)
-{
-	dls_async_get_all_t *cb_task_data;
-	gboolean sleeping;
+	if (dev->construct_step == 0) {
+		priv_t->udn = g_strdup(gupnp_device_info_get_udn(
+							context->device_info));
+		priv_t->config_id = prv_get_config_id(context->device_info);
+		priv_t->cached = dls_device_cache_load(priv_t->udn,
+						       priv_t->config_id);
+
+		if (priv_t->cached) {
+			prv_apply_cached_caps(dev, property_map,
+					      priv_t->cached);
+			dev->construct_step = 4;
+		} else {
+			priv_t->fetched = dls_device_cache_entry_new();
+		}
+	}
 
-	DLEYNA_LOG_DEBUG("Enter");
+	for (i = dev->construct_step; i < DLS_DEVICE_CACHE_VALUE_COUNT; ++i)
+		dleyna_service_task_add(queue_id, prv_get_capability, s_proxy,
+					prv_get_capability_task_cb, NULL,
+					priv_t);
 
-	cb_task_data = &cb_data->ut.get_all;
+	/* The following task should always be completed */
+	dleyna_service_task_add(queue_id, prv_subscribe, s_proxy,
+				NULL, NULL, dev);
 
-	if (proxy == NULL)
-		goto on_complete;
+	if (dev->construct_step < 6)
+		dleyna_service_task_add(queue_id, prv_declare, s_proxy,
+					NULL, prv_new_device_ct_delete, priv_t);
 
-	if (prv_ems_subscribed(device)) {
-		sleeping = device->sleeping;
+	dleyna_task_queue_start(queue_id);
+}
 
-		g_variant_builder_add(cb_task_data->vb, "{sv}",
-				      DLS_INTERFACE_PROP_SLEEPING,
-				      g_variant_new_boolean(sleeping));
+dls_device_t *dls_device_new(
+			dleyna_connector_id_t connection,
+			GUPnPDeviceProxy *proxy,
+			GUPnPDeviceInfo *device_info,
+			const gchar *ip_address,
+			const dleyna_connector_dispatch_cb_t *dispatch_table,
+			GHashTable *property_map,
+			const char *udn,
+			const dleyna_task_queue_key_t *queue_id)
+{
+	dls_device_t *dev;
+	gchar *new_path;
+	gchar *uuid;
+	dls_device_context_t *context;
 
-		goto on_complete;
-	}
+	DLEYNA_LOG_DEBUG("New Device on %s", ip_address);
 
-	cb_data->action = gupnp_service_proxy_begin_action(
-					proxy, "GetInterfaceInfo",
-					prv_sleeping_for_props_cb,
-					cb_data,
-					NULL);
+	uuid = dleyna_core_prv_convert_udn_to_path(udn);
+	new_path = g_strdup_printf("%s/%s", DLEYNA_SERVER_PATH, uuid);
+	g_free(uuid);
 
-	if (cb_data->proxy != NULL)
-		g_object_remove_weak_pointer((G_OBJECT(cb_data->proxy)),
-					     (gpointer *)&cb_data->proxy);
+	DLEYNA_LOG_DEBUG("Server Path %s", new_path);
 
-	cb_data->proxy = proxy;
+	dev = g_new0(dls_device_t, 1);
 
-	g_object_add_weak_pointer((G_OBJECT(proxy)),
-				  (gpointer *)&cb_data->proxy);
+	dev->connection = connection;
+	dev->contexts = g_ptr_array_new_with_free_func((GDestroyNotify)
+						  dls_device_delete_context);
+	dev->path = new_path;
 
-	if (!cb_data->cancel_id)
-		cb_data->cancel_id = g_cancellable_connect(
-					cb_data->cancellable,
-					G_CALLBACK(dls_async_task_cancelled_cb),
-					cb_data, NULL);
+	context = dls_device_append_new_context(dev, ip_address,
+						proxy, device_info);
 
-	return;
+	dls_device_construct(dev, context, connection, dispatch_table,
+			     property_map, queue_id);
 
-on_complete:
+	return dev;
+}
 
-	cb_data->task.result = g_variant_ref_sink(g_variant_builder_end(
-						  cb_task_data->vb));
+dls_device_context_t *dls_device_append_new_context(dls_device_t *device,
+						  const gchar *ip_address,
+						  GUPnPDeviceProxy *proxy,
+						  GUPnPDeviceInfo *device_info)
+{
+	dls_device_context_t *context;
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
+	prv_context_new(ip_address, proxy, device_info, device, &context);
+	g_ptr_array_add(device->contexts, context);
 
-	DLEYNA_LOG_DEBUG("Exit");
+	return context;
 }
 
-static int prv_get_media_server_version(const dls_device_t *device)
+dls_device_context_t *dls_device_get_context(const dls_device_t *device,
+					     dls_client_t *client)
 {
 	dls_device_context_t *context;
-	const char *device_type;
-	const char *version;
+	unsigned int i;
+	const char ip4_local_prefix[] = "127.0.0.";
+	gboolean prefer_local;
+	gboolean is_local;
 
-	context = dls_device_get_context(device, NULL);
-	device_type = gupnp_device_info_get_device_type((GUPnPDeviceInfo *)
-							context->device_proxy);
+	prefer_local = (client && client->prefer_local_addresses);
 
-	if (!device_type || !g_str_has_prefix(device_type, DLS_DMS_DEVICE_TYPE))
-		goto on_error;
+	for (i = 0; i < device->contexts->len; ++i) {
+		context = g_ptr_array_index(device->contexts, i);
 
-	version = device_type + sizeof(DLS_DMS_DEVICE_TYPE) - 1;
+		is_local = (!strncmp(context->ip_address, ip4_local_prefix,
+						sizeof(ip4_local_prefix) - 1) ||
+			    !strcmp(context->ip_address, "::1") ||
+			    !strcmp(context->ip_address, "0:0:0:0:0:0:0:1"));
 
-	return atoi(version);
+		if (prefer_local == is_local)
+			break;
+	}
 
-on_error:
+	if (i == device->contexts->len)
+		context = g_ptr_array_index(device->contexts, 0);
 
-	return -1;
+	return context;
 }
 
-static void prv_service_reset_for_prop_cb(GUPnPServiceProxy *proxy,
-					  GUPnPServiceProxyAction *action,
-					  gpointer user_data)
+/* Returns NULL if the context of proxy was lost while it was in use. */
+static dls_device_context_t *prv_context_for_cds_proxy(
+						const dls_device_t *device,
+						GUPnPServiceProxy *proxy)
 {
-	GError *error = NULL;
-	const gchar *message;
-	gchar *token = NULL;
-	gboolean end;
-	dls_async_task_t *cb_data = user_data;
+	dls_device_context_t *context;
+	unsigned int i;
 
-	DLEYNA_LOG_DEBUG("Enter");
+	for (i = 0; i < device->contexts->len; ++i) {
+		context = g_ptr_array_index(device->contexts, i);
 
-	end = gupnp_service_proxy_end_action(proxy, action, &error,
-					     "ResetToken", G_TYPE_STRING,
-					     &token, NULL);
+		if (context->cds.proxy == proxy)
+			return context;
+	}
 
-	if (!end || (token == NULL)) {
-		message = (error != NULL) ? error->message : "Invalid result";
-		DLEYNA_LOG_WARNING("Unable to retrieve ServiceResetToken: %s",
-				   message);
+	return NULL;
+}
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "GetServiceResetToken failed: %s",
-					     message);
+static void prv_change_child_record(dls_task_t *task, const gchar *id)
+{
+	gchar *path;
 
-		goto on_complete;
+	if (!task->target.device->change_subscriptions)
+		return;
+
+	path = dls_path_from_id(task->target.root_path, id);
+	prv_change_parent_record(task->target.device, path,
+				 task->target.path);
+	g_free(path);
+}
+
+static void prv_found_child(GUPnPDIDLLiteParser *parser,
+			    GUPnPDIDLLiteObject *object,
+			    gpointer user_data)
+{
+	dls_async_task_t *cb_data = user_data;
+	dls_task_t *task = &cb_data->task;
+	dls_task_get_children_t *task_data = &task->ut.get_children;
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+	dls_device_object_builder_t *builder;
+	gboolean have_child_count;
+	const gchar *id;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	builder = g_new0(dls_device_object_builder_t, 1);
+
+	id = gupnp_didl_lite_object_get_id(object);
+	if (id)
+		prv_change_child_record(task, id);
+
+	if (GUPNP_IS_DIDL_LITE_CONTAINER(object)) {
+		if (!task_data->containers)
+			goto on_error;
+	} else {
+		if (!task_data->items)
+			goto on_error;
 	}
 
-	cb_data->task.result = g_variant_ref_sink(g_variant_new_string(token));
+	builder->vb = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
 
-	DLEYNA_LOG_DEBUG("Service Reset %s", token);
+	if (!dls_props_add_object(builder->vb, object, task->target.root_path,
+				  task->target.path, cb_task_data->filter_mask))
+		goto on_error;
 
-	g_free(token);
+	if (GUPNP_IS_DIDL_LITE_CONTAINER(object)) {
+		dls_props_add_container(builder->vb,
+					(GUPnPDIDLLiteContainer *)object,
+					cb_task_data->filter_mask,
+					cb_task_data->protocol_info,
+					&have_child_count);
 
-on_complete:
+		if (!have_child_count && (cb_task_data->filter_mask &
+					  DLS_UPNP_MASK_PROP_CHILD_COUNT)) {
+			builder->needs_child_count = TRUE;
+			builder->id = g_strdup(
+				gupnp_didl_lite_object_get_id(object));
+			builder->has_container_update_id =
+			gupnp_didl_lite_container_container_update_id_is_set(
+				(GUPnPDIDLLiteContainer *)object);
+			if (builder->has_container_update_id)
+				builder->container_update_id =
+				gupnp_didl_lite_container_get_container_update_id(
+					(GUPnPDIDLLiteContainer *)object);
+			cb_task_data->need_child_count = TRUE;
+		}
+	} else {
+		dls_props_add_item(builder->vb, object,
+				   task->target.root_path,
+				   cb_task_data->filter_mask,
+				   cb_task_data->protocol_info);
+	}
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
-	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+	g_ptr_array_add(cb_task_data->vbs, builder);
 
-	if (error)
-		g_error_free(error);
+	DLEYNA_LOG_DEBUG("Exit with SUCCESS");
 
-	DLEYNA_LOG_DEBUG("Exit");
+	return;
+
+on_error:
+
+	prv_object_builder_delete(builder);
+
+	DLEYNA_LOG_DEBUG("Exit with FAIL");
 }
 
-static void prv_get_sr_token_for_prop(GUPnPServiceProxy *proxy,
-			     const dls_device_t *device,
-			     dls_async_task_t *cb_data)
+static void prv_found_didl_child(const dls_didl_object_t *object,
+				 dls_async_task_t *cb_data)
 {
-	DLEYNA_LOG_DEBUG("Enter");
+	dls_task_t *task = &cb_data->task;
+	dls_task_get_children_t *task_data = &task->ut.get_children;
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+	const char *id = object->props[DLS_DIDL_PROP_ID];
+	const char *update_id;
+	dls_device_object_builder_t *builder;
+	gboolean have_child_count;
 
-	if (prv_get_media_server_version(device) < 3) {
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_UNKNOWN_PROPERTY,
-					     "Unknown property");
+	builder = g_new0(dls_device_object_builder_t, 1);
 
-		(void) g_idle_add(dls_async_task_complete, cb_data);
+	if (id)
+		prv_change_child_record(task, id);
 
+	if (object->container ? !task_data->containers : !task_data->items)
 		goto on_error;
-	}
 
-	cb_data->action = gupnp_service_proxy_begin_action(
-					proxy, "GetServiceResetToken",
-					prv_service_reset_for_prop_cb,
-					cb_data,
-					NULL);
+	builder->vb = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
 
-	cb_data->proxy = proxy;
-	g_object_add_weak_pointer((G_OBJECT(proxy)),
-				  (gpointer *)&cb_data->proxy);
+	if (!dls_props_add_didl_object(builder->vb, object,
+				       task->target.root_path,
+				       task->target.path,
+				       cb_task_data->filter_mask,
+				       &have_child_count))
+		goto on_error;
 
-	cb_data->cancel_id = g_cancellable_connect(
-					cb_data->cancellable,
-					G_CALLBACK(dls_async_task_cancelled_cb),
-					cb_data, NULL);
+	if (object->container && !have_child_count &&
+	    (cb_task_data->filter_mask & DLS_UPNP_MASK_PROP_CHILD_COUNT)) {
+		builder->needs_child_count = TRUE;
+		builder->id = g_strdup(id);
+		cb_task_data->need_child_count = TRUE;
+
+		update_id = object->props[DLS_DIDL_PROP_CONTAINER_UPDATE_ID];
+		if (update_id) {
+			builder->has_container_update_id = TRUE;
+			builder->container_update_id = (guint)
+				g_ascii_strtoull(update_id, NULL, 10);
+		}
+	}
+
+	g_ptr_array_add(cb_task_data->vbs, builder);
+
+	return;
 
 on_error:
 
-	DLEYNA_LOG_DEBUG("Exit");
+	prv_object_builder_delete(builder);
 }
 
-static void prv_service_reset_for_props_cb(GUPnPServiceProxy *proxy,
-					  GUPnPServiceProxyAction *action,
+/* ContainerUpdateID is always read with ChildCount so that computed counts
+ * can be cached.
+ */
+static dls_upnp_prop_mask prv_didl_parse_mask(dls_upnp_prop_mask filter_mask)
+{
+	if (filter_mask & DLS_UPNP_MASK_PROP_CHILD_COUNT)
+		filter_mask |= DLS_UPNP_MASK_PROP_CONTAINER_UPDATE_ID;
+
+	return filter_mask;
+}
+
+/* The objects of a Browse Result numbered from first to last, excluded,
+ * index being the number of the next object parsed.
+ */
+typedef struct prv_children_slice_t_ prv_children_slice_t;
+struct prv_children_slice_t_ {
+	dls_async_task_t *cb_data;
+	guint index;
+	guint first;
+	guint last;
+};
+
+static void prv_found_child_in_slice(GUPnPDIDLLiteParser *parser,
+				     GUPnPDIDLLiteObject *object,
+				     gpointer user_data)
+{
+	prv_children_slice_t *slice = user_data;
+
+	if (slice->index >= slice->first && slice->index < slice->last)
+		prv_found_child(parser, object, slice->cb_data);
+
+	slice->index++;
+}
+
+static void prv_found_didl_child_in_slice(const dls_didl_object_t *object,
 					  gpointer user_data)
 {
-	GError *error = NULL;
-	const gchar *message;
-	gchar *token = NULL;
-	gboolean end;
-	dls_async_task_t *cb_data = user_data;
-	dls_async_get_all_t *cb_task_data;
+	prv_children_slice_t *slice = user_data;
 
-	DLEYNA_LOG_DEBUG("Enter");
+	if (slice->index >= slice->first && slice->index < slice->last)
+		prv_found_didl_child(object, slice->cb_data);
 
-	cb_task_data = &cb_data->ut.get_all;
+	slice->index++;
+}
 
-	end = gupnp_service_proxy_end_action(proxy, action, &error,
-					    "ResetToken", G_TYPE_STRING,
-					    &token, NULL);
+/* Like Search results, children are parsed in a single streaming pass
+ * unless resource properties are requested.
+ */
+static gboolean prv_children_parse(dls_async_task_t *cb_data,
+				   const gchar *didl,
+				   prv_children_slice_t *slice,
+				   GError **error)
+{
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+	GUPnPDIDLLiteParser *parser;
+	gboolean retval;
 
-	if (!end || (token == NULL)) {
-		message = (error != NULL) ? error->message : "Invalid result";
-		DLEYNA_LOG_WARNING("Unable to retrieve ServiceResetToken: %s",
-				   message);
+	if (dls_didl_can_stream(cb_task_data->filter_mask))
+		return dls_didl_parse(
+				didl,
+				prv_didl_parse_mask(cb_task_data->filter_mask),
+				prv_found_didl_child_in_slice, slice, error);
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "GetServiceResetToken failed: %s",
-					     message);
-		goto on_complete;
-	}
+	parser = gupnp_didl_lite_parser_new();
 
-	g_variant_builder_add(cb_task_data->vb, "{sv}",
-			      DLS_INTERFACE_PROP_SV_SERVICE_RESET_TOKEN,
-			      g_variant_new_string(token));
+	g_signal_connect(parser, "object-available" ,
+			 G_CALLBACK(prv_found_child_in_slice), slice);
 
-	DLEYNA_LOG_DEBUG("Service Reset %s", token);
+	retval = gupnp_didl_lite_parser_parse_didl(parser, didl, error);
 
-	g_free(token);
+	g_object_unref(parser);
 
-on_complete:
+	return retval;
+}
 
-	if ((!cb_data->error) && (cb_task_data->proxy))
-		prv_get_sleeping_for_props(cb_task_data->proxy,
-					   cb_data->task.target.device,
-					   cb_data);
-	else {
-		cb_data->task.result = g_variant_ref_sink(g_variant_builder_end(
-							     cb_task_data->vb));
+static GVariant *prv_children_result_to_variant(dls_async_task_t *cb_data)
+{
+	guint i;
+	dls_device_object_builder_t *builder;
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+	GVariantBuilder vb;
 
-		(void) g_idle_add(dls_async_task_complete, cb_data);
-		g_cancellable_disconnect(cb_data->cancellable,
-					 cb_data->cancel_id);
-	}
+	g_variant_builder_init(&vb, G_VARIANT_TYPE("aa{sv}"));
 
-	if (error)
-		g_error_free(error);
+	for (i = 0; i < cb_task_data->vbs->len; ++i) {
+		builder = g_ptr_array_index(cb_task_data->vbs, i);
+		g_variant_builder_add(&vb, "@a{sv}",
+				      g_variant_builder_end(builder->vb));
+	}
 
-	DLEYNA_LOG_DEBUG("Exit");
+	return  g_variant_builder_end(&vb);
 }
 
-static void prv_get_sr_token_for_props(GUPnPServiceProxy *proxy,
-			     const dls_device_t *device,
-			     dls_async_task_t *cb_data)
+static void prv_get_search_ex_result(dls_async_task_t *cb_data)
 {
-	dls_async_get_all_t *cb_task_data;
+	GVariant *out_params[2];
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
 
-	DLEYNA_LOG_DEBUG("Enter");
+	out_params[0] = prv_children_result_to_variant(cb_data);
+	out_params[1] = g_variant_new_uint32(cb_task_data->max_count);
 
-	if (prv_get_media_server_version(device) < 3) {
-		cb_task_data = &cb_data->ut.get_all;
+	cb_data->task.result = g_variant_ref_sink(
+					g_variant_new_tuple(out_params, 2));
+}
 
-		prv_get_sleeping_for_props(cb_task_data->proxy,
-					   device, cb_data);
+static void prv_get_children_result(dls_async_task_t *cb_data)
+{
+	GVariant *retval = prv_children_result_to_variant(cb_data);
+	cb_data->task.result =  g_variant_ref_sink(retval);
+}
 
-		goto on_exit; /* No error here, just skip the property */
+/* Hands the ChildCount slots freed on context to the tasks waiting for
+ * one, oldest first.
+ */
+static void prv_child_count_wake(dls_device_context_t *context)
+{
+	dls_async_task_t *cb_data;
+
+	while (context->child_counts_in_flight < g_child_count_max_in_flight &&
+	       (cb_data = g_queue_pop_head(&context->child_count_waiters))) {
+		cb_data->ut.bas.count_waiting = FALSE;
+		prv_retrieve_child_count_for_list(cb_data);
 	}
+}
 
-	cb_data->action = gupnp_service_proxy_begin_action(
-					proxy, "GetServiceResetToken",
-					prv_service_reset_for_props_cb,
-					cb_data,
-					NULL);
+static void prv_child_count_for_list_abort(dls_async_task_t *cb_data)
+{
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+	dls_device_count_request_t *request;
+	dls_device_context_t *context;
+	GList *next;
 
-	if (cb_data->proxy != NULL)
-		g_object_remove_weak_pointer((G_OBJECT(cb_data->proxy)),
-					     (gpointer *)&cb_data->proxy);
+	context = prv_context_for_cds_proxy(cb_data->task.target.device,
+					    cb_data->proxy);
 
-	cb_data->proxy = proxy;
-	g_object_add_weak_pointer((G_OBJECT(proxy)),
-				  (gpointer *)&cb_data->proxy);
+	for (next = cb_task_data->count_requests; next; next = next->next) {
+		request = next->data;
 
-	if (!cb_data->cancel_id)
-		cb_data->cancel_id = g_cancellable_connect(
-					cb_data->cancellable,
-					G_CALLBACK(dls_async_task_cancelled_cb),
-					cb_data, NULL);
+		if (cb_data->proxy)
+			gupnp_service_proxy_cancel_action(cb_data->proxy,
+							  request->action);
+		if (context)
+			context->child_counts_in_flight--;
+		g_free(request);
+	}
 
-on_exit:
+	g_list_free(cb_task_data->count_requests);
+	cb_task_data->count_requests = NULL;
 
-	DLEYNA_LOG_DEBUG("Exit");
+	if (!context)
+		return;
 
-	return;
+	if (cb_task_data->count_waiting) {
+		g_queue_remove(&context->child_count_waiters, cb_data);
+		cb_task_data->count_waiting = FALSE;
+	}
+
+	prv_child_count_wake(context);
 }
 
-static void prv_sleeping_for_prop_cb(GUPnPServiceProxy *proxy,
-				     GUPnPServiceProxyAction *action,
-				     gpointer user_data)
+static void prv_child_count_for_list_fail(dls_async_task_t *cb_data,
+					  const gchar *message)
+{
+	DLEYNA_LOG_WARNING("Browse operation failed: %s", message);
+
+	cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+				     DLEYNA_ERROR_OPERATION_FAILED,
+				     "Browse operation failed: %s", message);
+
+	prv_child_count_for_list_abort(cb_data);
+
+	dls_async_task_complete_in_idle(cb_data);
+	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+}
+
+static void prv_child_count_for_list_cancelled(GCancellable *cancellable,
+					       gpointer user_data)
 {
-	GError *error = NULL;
-	const gchar *message;
-	gchar *info = NULL;
-	gboolean end;
 	dls_async_task_t *cb_data = user_data;
-	gboolean sleeping;
+
+	prv_child_count_for_list_abort(cb_data);
+
+	if (!cb_data->error)
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_CANCELLED,
+					     "Operation cancelled.");
+	dls_async_task_complete_in_idle(cb_data);
+}
+
+static void prv_child_count_for_list_cb(GUPnPServiceProxy *proxy,
+					GUPnPServiceProxyAction *action,
+					gpointer user_data)
+{
+	dls_device_count_request_t *request = user_data;
+	dls_async_task_t *cb_data = request->cb_data;
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+	dls_device_object_builder_t *builder = request->builder;
+	dls_device_context_t *context;
+	GError *error = NULL;
+	guint count = G_MAXUINT32;
+	gboolean end;
 
 	DLEYNA_LOG_DEBUG("Enter");
 
-	end = gupnp_service_proxy_end_action(proxy, action, &error,
-					     "NetworkInterfaceInfo",
-					     G_TYPE_STRING,
-					     &info, NULL);
+	cb_task_data->count_requests = g_list_remove(
+						cb_task_data->count_requests,
+						request);
+	g_free(request);
 
-	if (!end || (info == NULL)) {
-		message = (error != NULL) ? error->message : "Invalid result";
-		DLEYNA_LOG_WARNING("NetworkInterfaceInfo retrieval failed: %s",
-				   message);
+	context = prv_context_for_cds_proxy(cb_data->task.target.device, proxy);
+	if (context)
+		context->child_counts_in_flight--;
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "GetNetworkInterfaceInfo failed: %s",
-					     message);
+	end = gupnp_service_proxy_end_action(proxy, action, &error,
+					    "TotalMatches", G_TYPE_UINT, &count,
+					    NULL);
 
-		goto on_complete;
+	if (!end || (count == G_MAXUINT32)) {
+		prv_child_count_for_list_fail(cb_data,
+					      (error != NULL) ? error->message :
+					      "Invalid result");
+		goto on_error;
 	}
 
-	if (prv_get_device_sleeping_state(cb_data->task.target.device,
-					  info,
-					  &sleeping)) {
-		cb_data->task.result = g_variant_ref_sink(
-					      g_variant_new_boolean(sleeping));
-	}
+	dls_props_add_child_count(builder->vb, count);
+	prv_child_count_cache_insert(cb_data->task.target.device, builder->id,
+				     builder->has_container_update_id,
+				     builder->container_update_id, count);
 
-	g_free(info);
+	if (context)
+		prv_child_count_wake(context);
 
-on_complete:
+	prv_retrieve_child_count_for_list(cb_data);
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
-	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+on_error:
 
 	if (error)
 		g_error_free(error);
@@ -2714,743 +3675,2059 @@ on_complete:
 	DLEYNA_LOG_DEBUG("Exit");
 }
 
-static void prv_get_sleeping_for_prop(GUPnPServiceProxy *proxy,
-				      const dls_device_t *device,
-				      dls_async_task_t *cb_data)
+/* Issues the Browse requests that compute the missing ChildCounts of a
+ * page until every container has one, then completes the task.  At most
+ * g_child_count_max_in_flight of these requests are outstanding on a
+ * device context, whichever tasks they belong to.  A task that finds no
+ * free slot, and has no request of its own left to complete, waits in
+ * the queue of the context until one is released.
+ */
+static void prv_retrieve_child_count_for_list(dls_async_task_t *cb_data)
 {
-	gboolean sleeping;
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+	dls_device_t *device = cb_data->task.target.device;
+	dls_device_context_t *context;
+	dls_device_object_builder_t *builder;
+	dls_device_count_request_t *request;
+	guint count;
 
-	DLEYNA_LOG_DEBUG("Enter");
+	context = prv_context_for_cds_proxy(device, cb_data->proxy);
+	if (!context) {
+		prv_child_count_for_list_fail(cb_data,
+					      "Server interface lost");
+		return;
+	}
 
-	if (proxy == NULL) {
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_UNKNOWN_PROPERTY,
-					     "Unknown property");
+	while (cb_task_data->retrieved < cb_task_data->vbs->len) {
+		builder = g_ptr_array_index(cb_task_data->vbs,
+					    cb_task_data->retrieved);
 
-		(void) g_idle_add(dls_async_task_complete, cb_data);
+		if (!builder->needs_child_count) {
+			cb_task_data->retrieved++;
+			continue;
+		}
 
-		goto on_complete;
-	} else if ((device->contexts->len == 0) || prv_ems_subscribed(device)) {
-		sleeping = device->sleeping;
+		if (prv_child_count_cache_lookup(
+					device, builder->id,
+					builder->has_container_update_id,
+					builder->container_update_id,
+					&count)) {
+			dls_props_add_child_count(builder->vb, count);
+			cb_task_data->retrieved++;
+			continue;
+		}
 
-		cb_data->task.result = g_variant_ref_sink(
-					g_variant_new_boolean(sleeping));
+		if (context->child_counts_in_flight >=
+		    g_child_count_max_in_flight)
+			break;
 
-		(void) g_idle_add(dls_async_task_complete, cb_data);
+		cb_task_data->retrieved++;
+		context->child_counts_in_flight++;
+
+		request = g_new(dls_device_count_request_t, 1);
+		request->cb_data = cb_data;
+		request->builder = builder;
+		request->action = gupnp_service_proxy_begin_action(
+					cb_data->proxy, "Browse",
+					prv_child_count_for_list_cb, request,
+					"ObjectID", G_TYPE_STRING, builder->id,
+					"BrowseFlag", G_TYPE_STRING,
+					"BrowseDirectChildren",
+					"Filter", G_TYPE_STRING, "",
+					"StartingIndex", G_TYPE_INT, 0,
+					"RequestedCount", G_TYPE_INT, 1,
+					"SortCriteria", G_TYPE_STRING, "",
+					NULL);
 
-		goto on_complete;
+		cb_task_data->count_requests = g_list_prepend(
+						cb_task_data->count_requests,
+						request);
 	}
 
-	cb_data->action = gupnp_service_proxy_begin_action(
-					proxy, "GetInterfaceInfo",
-					prv_sleeping_for_prop_cb,
-					cb_data,
-					NULL);
+	if (cb_task_data->count_requests != NULL)
+		return;
 
-	cb_data->proxy = proxy;
+	if (cb_task_data->retrieved < cb_task_data->vbs->len) {
+		DLEYNA_LOG_DEBUG("Waiting for a ChildCount slot");
 
-	g_object_add_weak_pointer((G_OBJECT(proxy)),
-				  (gpointer *)&cb_data->proxy);
+		cb_task_data->count_waiting = TRUE;
+		g_queue_push_tail(&context->child_count_waiters, cb_data);
+	} else {
+		cb_task_data->get_children_cb(cb_data);
 
+		dls_async_task_complete_in_idle(cb_data);
+		g_cancellable_disconnect(cb_data->cancellable,
+					 cb_data->cancel_id);
+	}
+}
+
+static void prv_start_child_count_for_list(dls_async_task_t *cb_data)
+{
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+
+	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+
+	cb_task_data->retrieved = 0;
 	cb_data->cancel_id = g_cancellable_connect(
-					cb_data->cancellable,
-					G_CALLBACK(dls_async_task_cancelled_cb),
-					cb_data, NULL);
-on_complete:
+				cb_data->cancellable,
+				G_CALLBACK(prv_child_count_for_list_cancelled),
+				cb_data, NULL);
 
-	DLEYNA_LOG_DEBUG("Exit");
+	prv_retrieve_child_count_for_list(cb_data);
 }
 
-static gboolean prv_get_all_child_count_cb(dls_async_task_t *cb_data,
-				       gint count)
+static void prv_get_children_objects(dls_async_task_t *cb_data)
 {
-	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
 
-	dls_props_add_child_count(cb_task_data->vb, count);
-	if (cb_task_data->device_object)
-		prv_get_system_update_id_for_props(cb_data->proxy,
-						   cb_data->task.target.device,
-						   cb_data);
-	else
-		cb_data->task.result = g_variant_ref_sink(g_variant_builder_end(
-							cb_task_data->vb));
+	if (cb_task_data->need_child_count) {
+		DLEYNA_LOG_DEBUG("Need to retrieve ChildCounts");
 
-	return !cb_task_data->device_object;
+		cb_task_data->get_children_cb = prv_get_children_result;
+		prv_start_child_count_for_list(cb_data);
+	} else {
+		prv_get_children_result(cb_data);
+
+		dls_async_task_complete_in_idle(cb_data);
+		g_cancellable_disconnect(cb_data->cancellable,
+					 cb_data->cancel_id);
+	}
 }
 
-static void prv_get_all_ms2spec_props_cb(GUPnPServiceProxy *proxy,
-					 GUPnPServiceProxyAction *action,
-					 gpointer user_data)
+/* Identical Browse requests issued while one is in flight, typically by
+ * several clients opening the same server at once, share its SOAP action.
+ * The raw result is handed to every waiter, each of which parses it with
+ * its own filter and protocol info.
+ */
+typedef void (*prv_browse_flight_cb_t)(GUPnPServiceProxy *proxy,
+				       dls_async_task_t *cb_data,
+				       const gchar *result,
+				       guint total_matches,
+				       const GError *error);
+
+typedef struct prv_browse_waiter_t_ prv_browse_waiter_t;
+struct prv_browse_waiter_t_ {
+	dls_async_task_t *cb_data;
+	prv_browse_flight_cb_t cb;
+};
+
+typedef struct prv_browse_flight_t_ prv_browse_flight_t;
+struct prv_browse_flight_t_ {
+	dls_device_t *device;
+	gchar *key;
+	GUPnPServiceProxy *proxy;
+	GUPnPServiceProxyAction *action;
+	GQueue waiters;
+};
+
+static void prv_browse_flight_delete(gpointer data)
 {
-	GError *error = NULL;
-	const gchar *message;
-	gchar *result = NULL;
-	gboolean end;
-	GUPnPDIDLLiteParser *parser = NULL;
-	dls_async_task_t *cb_data = user_data;
-	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
+	prv_browse_flight_t *flight = data;
+	prv_browse_waiter_t *waiter;
 
-	DLEYNA_LOG_DEBUG("Enter");
+	if (flight->proxy)
+		g_object_remove_weak_pointer(G_OBJECT(flight->proxy),
+					     (gpointer *)&flight->proxy);
 
-	end = gupnp_service_proxy_end_action(cb_data->proxy, cb_data->action,
-					    &error, "Result",
-					    G_TYPE_STRING, &result, NULL);
+	while ((waiter = g_queue_pop_head(&flight->waiters)))
+		g_free(waiter);
 
-	if (!end || (result == NULL)) {
-		message = (error != NULL) ? error->message : "Invalid result";
-		DLEYNA_LOG_WARNING("Browse operation failed: %s", message);
+	g_free(flight->key);
+	g_free(flight);
+}
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "Browse operation failed: %s",
-					     message);
-		goto on_error;
-	}
+static void prv_browse_flights_cancel(dls_device_t *device)
+{
+	GHashTableIter iter;
+	gpointer value;
+	prv_browse_flight_t *flight;
 
-	DLEYNA_LOG_DEBUG("GetMS2SpecProps result: %s", result);
+	if (!device->browse_flights)
+		goto on_exit;
 
-	parser = gupnp_didl_lite_parser_new();
+	g_hash_table_iter_init(&iter, device->browse_flights);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		flight = value;
+		if (flight->proxy)
+			gupnp_service_proxy_cancel_action(flight->proxy,
+							  flight->action);
+	}
 
-	g_signal_connect(parser, "object-available" , cb_task_data->prop_func,
-			 cb_data);
+	g_hash_table_unref(device->browse_flights);
+	device->browse_flights = NULL;
 
-	if (!gupnp_didl_lite_parser_parse_didl(parser, result, &error)) {
-		if (error->code == GUPNP_XML_ERROR_EMPTY_NODE) {
-			DLEYNA_LOG_WARNING("Property not defined for object");
+on_exit:
 
-			cb_data->error =
-				g_error_new(DLEYNA_SERVER_ERROR,
-					    DLEYNA_ERROR_UNKNOWN_PROPERTY,
-					    "Property not defined for object");
-		} else {
-			DLEYNA_LOG_WARNING(
-				"Unable to parse results of browse: %s",
-				error->message);
+	return;
+}
 
-			cb_data->error =
-				g_error_new(DLEYNA_SERVER_ERROR,
-					    DLEYNA_ERROR_OPERATION_FAILED,
-					    "Unable to parse results of browse: %s",
-					    error->message);
-		}
-		goto on_error;
-	}
+static void prv_browse_flight_cb(GUPnPServiceProxy *proxy,
+				 GUPnPServiceProxyAction *action,
+				 gpointer user_data)
+{
+	prv_browse_flight_t *flight = user_data;
+	prv_browse_waiter_t *waiter;
+	dls_async_task_t *cb_data;
+	gchar *result = NULL;
+	guint total_matches = 0;
+	GError *error = NULL;
 
-	if (cb_data->error)
-		goto on_error;
+	DLEYNA_LOG_DEBUG("Enter");
 
-	if (cb_task_data->need_child_count) {
-		DLEYNA_LOG_DEBUG("Need Child Count");
+	(void) gupnp_service_proxy_end_action(proxy, action, &error,
+					      "Result", G_TYPE_STRING, &result,
+					      "TotalMatches", G_TYPE_UINT,
+					      &total_matches, NULL);
 
-		prv_get_child_count(cb_data, prv_get_all_child_count_cb,
-				    cb_data->task.target.id);
+	/* Requests made from now on need a fresh Browse */
+	(void) g_hash_table_steal(flight->device->browse_flights,
+				  flight->key);
 
-		goto no_complete;
-	} else if (cb_data->task.type == DLS_TASK_GET_ALL_PROPS &&
-						cb_task_data->device_object) {
-		prv_get_system_update_id_for_props(proxy,
-						   cb_data->task.target.device,
-						   cb_data);
+	DLEYNA_LOG_DEBUG("Browse shared by %u requests",
+			 g_queue_get_length(&flight->waiters));
 
-		goto no_complete;
-	} else {
-		cb_data->task.result = g_variant_ref_sink(g_variant_builder_end(
-							cb_task_data->vb));
-	}
+	while ((waiter = g_queue_pop_head(&flight->waiters))) {
+		cb_data = waiter->cb_data;
 
-on_error:
+		/* Follow-up actions are cancelled by the task itself */
+		g_cancellable_disconnect(cb_data->cancellable,
+					 cb_data->cancel_id);
+		cb_data->action = NULL;
+		cb_data->cancel_id = g_cancellable_connect(
+					cb_data->cancellable,
+					G_CALLBACK(dls_async_task_cancelled_cb),
+					cb_data, NULL);
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
-	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+		waiter->cb(proxy, cb_data, result, total_matches, error);
+		g_free(waiter);
+	}
 
-no_complete:
+	prv_browse_flight_delete(flight);
 
 	if (error)
 		g_error_free(error);
 
-	if (parser)
-		g_object_unref(parser);
-
 	g_free(result);
 
 	DLEYNA_LOG_DEBUG("Exit");
 }
 
-static void prv_get_all_ms2spec_props(dls_device_context_t *context,
-				      dls_async_task_t *cb_data)
+/* The shared action is only cancelled with its last waiter */
+static void prv_browse_flight_cancelled_cb(GCancellable *cancellable,
+					   gpointer user_data)
 {
-	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
-	dls_task_t *task = &cb_data->task;
-	dls_task_get_props_t *task_data = &task->ut.get_props;
+	dls_async_task_t *cb_data = user_data;
+	dls_device_t *device = cb_data->task.target.device;
+	GHashTableIter iter;
+	gpointer value;
+	prv_browse_flight_t *flight;
+	prv_browse_waiter_t *waiter;
+	GList *link;
+	gboolean found = FALSE;
 
-	DLEYNA_LOG_DEBUG("Enter called");
+	if (!device->browse_flights)
+		goto on_complete;
 
-	if (!strcmp(DLS_INTERFACE_MEDIA_CONTAINER, task_data->interface_name)) {
-		cb_task_data->prop_func = G_CALLBACK(prv_get_container);
-	} else if (!strcmp(DLS_INTERFACE_MEDIA_ITEM,
-		   task_data->interface_name)) {
-		cb_task_data->prop_func = G_CALLBACK(prv_get_item);
-	} else if (!strcmp(DLS_INTERFACE_MEDIA_OBJECT,
-		   task_data->interface_name)) {
-		cb_task_data->prop_func = G_CALLBACK(prv_get_object);
-	} else  if (!strcmp("", task_data->interface_name)) {
-		cb_task_data->prop_func = G_CALLBACK(prv_get_all);
-	} else {
-		DLEYNA_LOG_WARNING("Interface is unknown.");
+	g_hash_table_iter_init(&iter, device->browse_flights);
+	while (!found && g_hash_table_iter_next(&iter, NULL, &value)) {
+		flight = value;
 
-		cb_data->error =
-			g_error_new(DLEYNA_SERVER_ERROR,
-				    DLEYNA_ERROR_UNKNOWN_INTERFACE,
-				    "Interface is unknown.");
-		goto on_error;
+		for (link = flight->waiters.head; link; link = link->next) {
+			waiter = link->data;
+			if (waiter->cb_data == cb_data)
+				break;
+		}
+
+		if (!link)
+			continue;
+
+		found = TRUE;
+		g_queue_delete_link(&flight->waiters, link);
+		g_free(waiter);
+
+		if (g_queue_is_empty(&flight->waiters)) {
+			if (flight->proxy)
+				gupnp_service_proxy_cancel_action(
+						flight->proxy, flight->action);
+			g_hash_table_iter_remove(&iter);
+		}
 	}
 
-	cb_data->action = gupnp_service_proxy_begin_action(
-				context->cds.proxy, "Browse",
-				prv_get_all_ms2spec_props_cb, cb_data,
-				"ObjectID", G_TYPE_STRING, task->target.id,
-				"BrowseFlag", G_TYPE_STRING, "BrowseMetadata",
-				"Filter", G_TYPE_STRING, "*",
-				"StartingIndex", G_TYPE_INT, 0,
-				"RequestedCount", G_TYPE_INT, 0,
-				"SortCriteria", G_TYPE_STRING,
-				"", NULL);
+on_complete:
 
-	cb_data->proxy = context->cds.proxy;
+	if (!cb_data->error)
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_CANCELLED,
+					     "Operation cancelled.");
+	dls_async_task_complete_in_idle(cb_data);
+}
 
-	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
-				  (gpointer *)&cb_data->proxy);
+static void prv_browse_flight_join(dls_async_task_t *cb_data,
+				   GUPnPServiceProxy *proxy,
+				   prv_browse_flight_cb_t cb,
+				   const gchar *id, const gchar *browse_flag,
+				   const gchar *upnp_filter, guint start,
+				   guint count, const gchar *sort_by)
+{
+	dls_device_t *device = cb_data->task.target.device;
+	prv_browse_flight_t *flight;
+	prv_browse_waiter_t *waiter;
+	gchar *key;
 
-	cb_data->cancel_id = g_cancellable_connect(
-					cb_data->cancellable,
-					G_CALLBACK(dls_async_task_cancelled_cb),
-					cb_data, NULL);
+	key = g_strdup_printf("%p\n%s\n%s\n%s\n%u\n%u\n%s", (void *)proxy,
+			      id, browse_flag, upnp_filter, start, count,
+			      sort_by);
 
-	DLEYNA_LOG_DEBUG("Exit with SUCCESS");
+	if (!device->browse_flights)
+		device->browse_flights = g_hash_table_new_full(
+						g_str_hash, g_str_equal, NULL,
+						prv_browse_flight_delete);
 
-	return;
+	flight = g_hash_table_lookup(device->browse_flights, key);
 
-on_error:
+	if (flight) {
+		DLEYNA_LOG_DEBUG("Joining in-flight Browse of %s", id);
+		g_free(key);
+	} else {
+		flight = g_new0(prv_browse_flight_t, 1);
+		flight->device = device;
+		flight->key = key;
+		flight->proxy = proxy;
+		g_object_add_weak_pointer(G_OBJECT(proxy),
+					  (gpointer *)&flight->proxy);
+
+		flight->action = gupnp_service_proxy_begin_action(
+					proxy, "Browse",
+					prv_browse_flight_cb, flight,
+					"ObjectID", G_TYPE_STRING, id,
+					"BrowseFlag", G_TYPE_STRING, browse_flag,
+					"Filter", G_TYPE_STRING, upnp_filter,
+					"StartingIndex", G_TYPE_INT, start,
+					"RequestedCount", G_TYPE_INT, count,
+					"SortCriteria", G_TYPE_STRING, sort_by,
+					NULL);
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
+		g_hash_table_insert(device->browse_flights, flight->key,
+				    flight);
+	}
 
-	DLEYNA_LOG_DEBUG("Exit with FAIL");
+	waiter = g_new0(prv_browse_waiter_t, 1);
+	waiter->cb_data = cb_data;
+	waiter->cb = cb;
+	g_queue_push_tail(&flight->waiters, waiter);
 
-	return;
+	cb_data->action = flight->action;
+	cb_data->cancel_id = g_cancellable_connect(
+				cb_data->cancellable,
+				G_CALLBACK(prv_browse_flight_cancelled_cb),
+				cb_data, NULL);
 }
 
-void dls_device_get_all_props(dls_client_t *client,
-			      dls_task_t *task,
-			      gboolean root_object)
+static void prv_get_children_cb(GUPnPServiceProxy *proxy,
+				dls_async_task_t *cb_data,
+				const gchar *result,
+				guint total_matches,
+				const GError *browse_error)
 {
-	dls_async_task_t *cb_data = (dls_async_task_t *)task;
-	dls_async_get_all_t *cb_task_data;
-	dls_task_get_props_t *task_data = &task->ut.get_props;
+	const gchar *message;
+	GError *error = NULL;
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+	dls_task_get_children_t *task_data = &cb_data->task.ut.get_children;
+	dls_device_browse_window_t *window = NULL;
 	dls_device_context_t *context;
+	prv_children_slice_t slice;
 
 	DLEYNA_LOG_DEBUG("Enter");
 
-	context = dls_device_get_context(task->target.device, client);
-	cb_task_data = &cb_data->ut.get_all;
-
-	cb_task_data->vb = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
-	cb_task_data->device_object = root_object;
-	cb_task_data->proxy = context->ems.proxy;
+	if (result == NULL) {
+		message = (browse_error != NULL) ? browse_error->message :
+						   "Invalid result";
+		DLEYNA_LOG_WARNING("Browse operation failed: %s", message);
 
-	if (!strcmp(task_data->interface_name,
-		    DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE)) {
-		if (root_object) {
-			dls_props_add_device((GUPnPDeviceInfo *)
-					     context->device_proxy,
-					     context->device_info,
-					     context->ems.proxy,
-					     task->target.device,
-					     cb_task_data->vb);
-			prv_get_system_update_id_for_props(
-					context->cds.proxy,
-					task->target.device,
-					cb_data);
-		} else {
-			cb_data->error =
-				g_error_new(DLEYNA_SERVER_ERROR,
-					    DLEYNA_ERROR_UNKNOWN_INTERFACE,
-					    "Interface is only valid on root objects.");
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_OPERATION_FAILED,
+					     "Browse operation failed: %s",
+					     message);
+		goto on_error;
+	}
 
-			(void) g_idle_add(dls_async_task_complete, cb_data);
-		}
+	DLEYNA_LOG_DEBUG("GetChildren result: %s", result);
 
-	} else if (strcmp(task_data->interface_name, "")) {
-		cb_task_data->device_object = FALSE;
-		prv_get_all_ms2spec_props(context, cb_data);
-	} else {
-		if (root_object)
-			dls_props_add_device((GUPnPDeviceInfo *)
-					     context->device_proxy,
-					     context->device_info,
-					     context->ems.proxy,
-					     task->target.device,
-					     cb_task_data->vb);
-		prv_get_all_ms2spec_props(context, cb_data);
-	}
+	cb_task_data->vbs = g_ptr_array_new_with_free_func(
+		prv_object_builder_delete);
 
-	DLEYNA_LOG_DEBUG("Exit");
-}
+	slice.cb_data = cb_data;
+	slice.index = 0;
+	slice.first = 0;
+	slice.last = G_MAXUINT;
 
-static void prv_get_object_property(GUPnPDIDLLiteParser *parser,
-				    GUPnPDIDLLiteObject *object,
-				    gpointer user_data)
-{
-	dls_async_task_t *cb_data = user_data;
-	dls_task_t *task = &cb_data->task;
-	dls_task_get_prop_t *task_data = &task->ut.get_prop;
+	if (!prv_children_parse(cb_data, result, &slice, &error) &&
+	    error->code != GUPNP_XML_ERROR_EMPTY_NODE) {
+		DLEYNA_LOG_WARNING("Unable to parse results of browse: %s",
+				   error->message);
 
-	if (cb_data->task.result)
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_OPERATION_FAILED,
+					     "Unable to parse results of browse: %s",
+					     error->message);
 		goto on_error;
+	}
 
-	cb_data->task.result = dls_props_get_object_prop(task_data->prop_name,
-							 task->target.root_path,
-							 object);
+	context = prv_context_for_cds_proxy(cb_data->task.target.device, proxy);
+	if (context)
+		window = prv_browse_window_store(context,
+						 cb_data->task.target.id,
+						 cb_task_data->upnp_filter,
+						 cb_task_data->sort_by,
+						 task_data->start,
+						 task_data->count,
+						 result, slice.index,
+						 total_matches);
+	if (window && cb_data->proxy)
+		prv_browse_window_prefetch(window, cb_data->proxy,
+					   task_data->start, task_data->count);
 
-on_error:
+	prv_get_children_objects(cb_data);
 
-	return;
-}
+	goto no_complete;
 
-static void prv_get_item_property(GUPnPDIDLLiteParser *parser,
-				  GUPnPDIDLLiteObject *object,
-				  gpointer user_data)
-{
-	dls_async_task_t *cb_data = user_data;
-	dls_task_t *task = &cb_data->task;
-	dls_task_get_prop_t *task_data = &task->ut.get_prop;
-	dls_async_get_prop_t *cb_task_data = &cb_data->ut.get_prop;
+on_error:
 
-	if (cb_data->task.result)
-		goto on_error;
+	dls_async_task_complete_in_idle(cb_data);
+	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
 
-	cb_data->task.result = dls_props_get_item_prop(
-						task_data->prop_name,
-						task->target.root_path,
-						object,
-						cb_task_data->protocol_info);
+no_complete:
 
-on_error:
+	if (error)
+		g_error_free(error);
 
-	return;
+	DLEYNA_LOG_DEBUG("Exit");
 }
 
-static void prv_get_container_property(GUPnPDIDLLiteParser *parser,
-				       GUPnPDIDLLiteObject *object,
-				       gpointer user_data)
+static gboolean prv_get_children_from_window(dls_async_task_t *cb_data,
+					     dls_device_context_t *context)
 {
-	dls_async_task_t *cb_data = user_data;
 	dls_task_t *task = &cb_data->task;
-	dls_task_get_prop_t *task_data = &task->ut.get_prop;
-	dls_async_get_prop_t *cb_task_data = &cb_data->ut.get_prop;
+	dls_task_get_children_t *task_data = &task->ut.get_children;
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+	dls_device_browse_window_t *window;
+	dls_device_browse_page_t *page;
+	prv_children_slice_t slice;
+	GError *error = NULL;
+	guint end;
+	guint i;
 
-	if (cb_data->task.result)
-		goto on_error;
+	window = prv_browse_window_find(context, task->target.id,
+					cb_task_data->upnp_filter,
+					cb_task_data->sort_by);
 
-	cb_data->task.result = dls_props_get_container_prop(
-						task_data->prop_name,
-						object,
-						cb_task_data->protocol_info);
+	if (!window || !prv_browse_window_covers(window, task_data->start,
+						 task_data->count))
+		return FALSE;
 
-on_error:
+	DLEYNA_LOG_DEBUG("Serving children of %s from window cache",
+			 task->target.id);
 
-	return;
-}
+	end = window->start + window->length;
+	if (task_data->count != 0 && task_data->start + task_data->count < end)
+		end = task_data->start + task_data->count;
 
-static void prv_get_all_property(GUPnPDIDLLiteParser *parser,
-				 GUPnPDIDLLiteObject *object,
-				 gpointer user_data)
-{
-	dls_async_task_t *cb_data = user_data;
+	cb_task_data->vbs = g_ptr_array_new_with_free_func(
+		prv_object_builder_delete);
 
-	prv_get_object_property(parser, object, user_data);
+	slice.cb_data = cb_data;
+	slice.first = task_data->start;
+	slice.last = end;
 
-	if (cb_data->task.result)
-		goto on_error;
+	for (i = 0; i < window->pages->len; ++i) {
+		page = g_ptr_array_index(window->pages, i);
 
-	if (GUPNP_IS_DIDL_LITE_CONTAINER(object))
-		prv_get_container_property(parser, object, user_data);
-	else
-		prv_get_item_property(parser, object, user_data);
+		if (page->start >= end)
+			break;
 
-on_error:
+		if (page->start + page->count <= task_data->start)
+			continue;
 
-	return;
-}
+		slice.index = page->start;
 
-static gboolean prv_get_child_count_cb(dls_async_task_t *cb_data,
-				   gint count)
-{
-	DLEYNA_LOG_DEBUG("Enter");
+		if (!prv_children_parse(cb_data, page->didl, &slice, &error)) {
+			DLEYNA_LOG_WARNING("Unable to parse cached page: %s",
+					   error->message);
+			g_error_free(error);
 
-	DLEYNA_LOG_DEBUG("Count %d", count);
+			g_ptr_array_unref(cb_task_data->vbs);
+			cb_task_data->vbs = NULL;
+			cb_task_data->need_child_count = FALSE;
 
-	cb_data->task.result =  g_variant_ref_sink(
-					g_variant_new_uint32((guint) count));
+			return FALSE;
+		}
+	}
 
-	DLEYNA_LOG_DEBUG("Exit");
+	prv_browse_window_prefetch(window, context->cds.proxy,
+				   task_data->start, task_data->count);
 
 	return TRUE;
 }
 
-static void prv_count_children_cb(GUPnPServiceProxy *proxy,
-				  GUPnPServiceProxyAction *action,
-				  gpointer user_data)
+void dls_device_get_children(dls_client_t *client,
+			     dls_task_t *task,
+			     const gchar *upnp_filter, const gchar *sort_by)
 {
-	dls_device_count_data_t *count_data = user_data;
-	dls_async_task_t *cb_data = count_data->cb_data;
-	GError *error = NULL;
-	const gchar *message;
-	guint count = G_MAXUINT32;
-	gboolean complete = FALSE;
-	gboolean end;
+	dls_async_task_t *cb_data = (dls_async_task_t *)task;
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+	dls_device_context_t *context;
 
 	DLEYNA_LOG_DEBUG("Enter");
 
-	end = gupnp_service_proxy_end_action(cb_data->proxy, cb_data->action,
-					    &error,
-					    "TotalMatches", G_TYPE_UINT, &count,
-					    NULL);
+	context = dls_device_get_context(task->target.device, client);
 
-	if (!end || (count == G_MAXUINT32)) {
-		message = (error != NULL) ? error->message : "Invalid result";
-		DLEYNA_LOG_WARNING("Browse operation failed: %s", message);
+	cb_data->proxy = context->cds.proxy;
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "Browse operation failed: %s",
-					     message);
-		goto on_error;
-	}
+	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
+				  (gpointer *)&cb_data->proxy);
 
-	complete = count_data->cb(cb_data, count);
+	cb_task_data->upnp_filter = g_strdup(upnp_filter);
+	cb_task_data->sort_by = g_strdup(sort_by);
 
-on_error:
+	if (prv_get_children_from_window(cb_data, context)) {
+		cb_data->cancel_id = g_cancellable_connect(
+					cb_data->cancellable,
+					G_CALLBACK(dls_async_task_cancelled_cb),
+					cb_data, NULL);
 
-	g_free(user_data);
+		prv_get_children_objects(cb_data);
 
-	if (cb_data->error || complete) {
-		(void) g_idle_add(dls_async_task_complete, cb_data);
-		g_cancellable_disconnect(cb_data->cancellable,
-					 cb_data->cancel_id);
+		goto on_exit;
 	}
 
-	if (error)
-		g_error_free(error);
+	prv_browse_flight_join(cb_data, context->cds.proxy,
+			       prv_get_children_cb, task->target.id,
+			       "BrowseDirectChildren", upnp_filter,
+			       task->ut.get_children.start,
+			       task->ut.get_children.count, sort_by);
+
+on_exit:
 
 	DLEYNA_LOG_DEBUG("Exit");
 }
 
-static void prv_get_child_count(dls_async_task_t *cb_data,
-				dls_device_count_cb_t cb, const gchar *id)
-{
-	dls_device_count_data_t *count_data;
+static void prv_get_item(GUPnPDIDLLiteParser *parser,
+			 GUPnPDIDLLiteObject *object,
+			 gpointer user_data)
+{
+	dls_async_task_t *cb_data = user_data;
+	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
 
-	DLEYNA_LOG_DEBUG("Enter");
+	if (!GUPNP_IS_DIDL_LITE_CONTAINER(object))
+		dls_props_add_item(cb_task_data->vb, object,
+				   cb_data->task.target.root_path,
+				   cb_task_data->filter_mask,
+				   cb_task_data->protocol_info);
+	else
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_UNKNOWN_INTERFACE,
+					     "Interface not supported on container.");
+}
 
-	prv_count_data_new(cb_data, cb, &count_data);
-	cb_data->action =
-		gupnp_service_proxy_begin_action(cb_data->proxy,
-						 "Browse",
-						 prv_count_children_cb,
-						 count_data,
-						 "ObjectID", G_TYPE_STRING, id,
+static void prv_get_container(GUPnPDIDLLiteParser *parser,
+		       GUPnPDIDLLiteObject *object,
+		       gpointer user_data)
+{
+	dls_async_task_t *cb_data = user_data;
+	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
+	gboolean have_child_count;
 
-						 "BrowseFlag", G_TYPE_STRING,
-						 "BrowseDirectChildren",
+	if (GUPNP_IS_DIDL_LITE_CONTAINER(object)) {
+		dls_props_add_container(cb_task_data->vb,
+					(GUPnPDIDLLiteContainer *)object,
+					cb_task_data->filter_mask,
+					cb_task_data->protocol_info,
+					&have_child_count);
+		if (!have_child_count)
+			cb_task_data->need_child_count = TRUE;
+	} else {
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_UNKNOWN_INTERFACE,
+					     "Interface not supported on item.");
+	}
+}
 
-						 "Filter", G_TYPE_STRING, "",
+static void prv_get_object(GUPnPDIDLLiteParser *parser,
+			   GUPnPDIDLLiteObject *object,
+			   gpointer user_data)
+{
+	dls_async_task_t *cb_data = user_data;
+	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
+	const char *object_id;
+	const char *parent_id;
+	const char *parent_path;
+	gchar *path = NULL;
 
-						 "StartingIndex", G_TYPE_INT,
-						 0,
+	object_id = gupnp_didl_lite_object_get_id(object);
+	if (!object_id)
+		goto on_error;
 
-						 "RequestedCount", G_TYPE_INT,
-						 1,
+	parent_id = gupnp_didl_lite_object_get_parent_id(object);
+	if (!parent_id)
+		goto on_error;
 
-						 "SortCriteria", G_TYPE_STRING,
-						 "",
+	if (!strcmp(object_id, "0") || !strcmp(parent_id, "-1")) {
+		parent_path = cb_data->task.target.root_path;
+	} else {
+		path = dls_path_from_id(cb_data->task.target.root_path,
+					parent_id);
+		parent_path = path;
+	}
 
-						 NULL);
+	if (!dls_props_add_object(cb_task_data->vb, object,
+				  cb_data->task.target.root_path,
+				  parent_path, cb_task_data->filter_mask))
+		goto on_error;
 
-	DLEYNA_LOG_DEBUG("Exit with SUCCESS");
+	g_free(path);
+
+	return;
+
+on_error:
+
+	cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+				     DLEYNA_ERROR_BAD_RESULT,
+				     "Unable to retrieve mandatory object properties");
+	g_free(path);
 }
 
-static void prv_get_ms2spec_prop_cb(GUPnPServiceProxy *proxy,
+static void prv_get_all(GUPnPDIDLLiteParser *parser,
+			GUPnPDIDLLiteObject *object,
+			gpointer user_data)
+{
+	dls_async_task_t *cb_data = user_data;
+	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
+	gboolean have_child_count;
+
+	prv_get_object(parser, object, user_data);
+
+	if (!cb_data->error) {
+		if (GUPNP_IS_DIDL_LITE_CONTAINER(object)) {
+			dls_props_add_container(
+				cb_task_data->vb,
+				(GUPnPDIDLLiteContainer *)
+				object, cb_task_data->filter_mask,
+				cb_task_data->protocol_info,
+				&have_child_count);
+			if (!have_child_count)
+				cb_task_data->need_child_count = TRUE;
+		} else {
+			dls_props_add_item(cb_task_data->vb,
+					   object,
+					   cb_data->task.target.root_path,
+					   cb_task_data->filter_mask,
+					   cb_task_data->protocol_info);
+		}
+	}
+}
+
+static gboolean prv_cds_subscribed(const dls_device_t *device)
+{
+	dls_device_context_t *context;
+	unsigned int i;
+	gboolean subscribed = FALSE;
+
+	for (i = 0; i < device->contexts->len; ++i) {
+		context = g_ptr_array_index(device->contexts, i);
+		if (context->cds.subscribed) {
+			subscribed = TRUE;
+			break;
+		}
+	}
+
+	return subscribed;
+}
+
+static void prv_system_update_id_for_prop_cb(GUPnPServiceProxy *proxy,
 				    GUPnPServiceProxyAction *action,
 				    gpointer user_data)
 {
 	GError *error = NULL;
 	const gchar *message;
-	gchar *result = NULL;
 	gboolean end;
-	GUPnPDIDLLiteParser *parser = NULL;
+	guint id = G_MAXUINT32;
 	dls_async_task_t *cb_data = user_data;
-	dls_async_get_prop_t *cb_task_data = &cb_data->ut.get_prop;
-	dls_task_get_prop_t *task_data = &cb_data->task.ut.get_prop;
 
 	DLEYNA_LOG_DEBUG("Enter");
 
-	end = gupnp_service_proxy_end_action(cb_data->proxy, cb_data->action,
-					    &error, "Result",
-					    G_TYPE_STRING, &result, NULL);
+	end = gupnp_service_proxy_end_action(proxy, action, &error,
+					     "Id", G_TYPE_UINT, &id, NULL);
 
-	if (!end || (result == NULL)) {
+	if (!end || (id == G_MAXUINT32)) {
 		message = (error != NULL) ? error->message : "Invalid result";
-		DLEYNA_LOG_WARNING("Browse operation failed: %s", message);
+		DLEYNA_LOG_WARNING("Unable to retrieve SystemUpdateID: %s",
+				   message);
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "Browse operation failed: %s",
-					     message);
-		goto on_error;
+		cb_data->error = g_error_new(
+					DLEYNA_SERVER_ERROR,
+					DLEYNA_ERROR_OPERATION_FAILED,
+					"Unable to retrieve SystemUpdateID: %s",
+					message);
+
+		goto on_complete;
 	}
 
-	DLEYNA_LOG_DEBUG("GetMS2SpecProp result: %s", result);
+	cb_data->task.result = g_variant_ref_sink(g_variant_new_uint32(id));
 
-	parser = gupnp_didl_lite_parser_new();
+on_complete:
 
-	g_signal_connect(parser, "object-available" , cb_task_data->prop_func,
-			 cb_data);
+	dls_async_task_complete_in_idle(cb_data);
+	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
 
-	if (!gupnp_didl_lite_parser_parse_didl(parser, result, &error)) {
-		if (error->code == GUPNP_XML_ERROR_EMPTY_NODE) {
-			DLEYNA_LOG_WARNING("Property not defined for object");
+	if (error)
+		g_error_free(error);
 
-			cb_data->error =
-				g_error_new(DLEYNA_SERVER_ERROR,
-					    DLEYNA_ERROR_UNKNOWN_PROPERTY,
-					    "Property not defined for object");
-		} else {
-			DLEYNA_LOG_WARNING(
-				"Unable to parse results of browse: %s",
-				error->message);
+	DLEYNA_LOG_DEBUG("Exit");
+}
 
-			cb_data->error =
-				g_error_new(DLEYNA_SERVER_ERROR,
-					    DLEYNA_ERROR_OPERATION_FAILED,
-					    "Unable to parse results of browse: %s",
-					    error->message);
-		}
-		goto on_error;
-	}
+static void prv_get_system_update_id_for_prop(GUPnPServiceProxy *proxy,
+				     const dls_device_t *device,
+				     dls_async_task_t *cb_data)
+{
+	guint suid;
 
-	if (!cb_data->task.result) {
-		DLEYNA_LOG_WARNING("Property not defined for object");
+	DLEYNA_LOG_DEBUG("Enter");
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_UNKNOWN_PROPERTY,
-					     "Property not defined for object");
-	}
+	if (prv_cds_subscribed(device)) {
+		suid = device->system_update_id;
 
-on_error:
+		cb_data->task.result = g_variant_ref_sink(
+						g_variant_new_uint32(suid));
 
-	if (cb_data->error && !strcmp(task_data->prop_name,
-				      DLS_INTERFACE_PROP_CHILD_COUNT)) {
-		DLEYNA_LOG_DEBUG("ChildCount not supported by server");
+		dls_async_task_complete_in_idle(cb_data);
 
-		g_error_free(cb_data->error);
-		cb_data->error = NULL;
-		prv_get_child_count(cb_data, prv_get_child_count_cb,
-				    cb_data->task.target.id);
-	} else {
-		(void) g_idle_add(dls_async_task_complete, cb_data);
-		g_cancellable_disconnect(cb_data->cancellable,
-					 cb_data->cancel_id);
+		goto on_complete;
 	}
 
-	if (error)
-		g_error_free(error);
+	cb_data->action = gupnp_service_proxy_begin_action(
+					proxy, "GetSystemUpdateID",
+					prv_system_update_id_for_prop_cb,
+					cb_data,
+					NULL);
 
-	if (parser)
-		g_object_unref(parser);
+	cb_data->proxy = proxy;
+	g_object_add_weak_pointer((G_OBJECT(proxy)),
+				  (gpointer *)&cb_data->proxy);
 
-	g_free(result);
+	cb_data->cancel_id = g_cancellable_connect(
+					cb_data->cancellable,
+					G_CALLBACK(dls_async_task_cancelled_cb),
+					cb_data, NULL);
+
+on_complete:
 
 	DLEYNA_LOG_DEBUG("Exit");
 }
 
-static void prv_get_ms2spec_prop(dls_device_context_t *context,
-				 dls_prop_map_t *prop_map,
-				 dls_task_get_prop_t *task_data,
-				 dls_async_task_t *cb_data)
+static void prv_system_update_id_for_props_cb(GUPnPServiceProxy *proxy,
+				    GUPnPServiceProxyAction *action,
+				    gpointer user_data)
 {
-	dls_async_get_prop_t *cb_task_data;
-	const gchar *filter;
+	GError *error = NULL;
+	const gchar *message;
+	gboolean end;
+	guint id = G_MAXUINT32;
+	dls_async_task_t *cb_data = user_data;
+	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
 
 	DLEYNA_LOG_DEBUG("Enter");
 
-	cb_task_data = &cb_data->ut.get_prop;
+	end = gupnp_service_proxy_end_action(proxy, action, &error,
+					    "Id", G_TYPE_UINT, &id, NULL);
+
+	if (!end || (id == G_MAXUINT32)) {
+		message = (error != NULL) ? error->message : "Invalid result";
+		DLEYNA_LOG_WARNING("Unable to retrieve SystemUpdateID: %s",
+				   message);
 
-	if (!prop_map) {
 		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_UNKNOWN_PROPERTY,
-					     "Unknown property");
-		goto on_error;
+					     DLEYNA_ERROR_OPERATION_FAILED,
+					     "Unable to retrieve SystemUpdateID: %s",
+					     message);
+
+		goto on_complete;
 	}
 
-	filter = prop_map->filter ? prop_map->upnp_prop_name : "";
+	g_variant_builder_add(cb_task_data->vb, "{sv}",
+			      DLS_SYSTEM_UPDATE_VAR,
+			      g_variant_new_uint32(id));
 
-	if (!strcmp(DLS_INTERFACE_MEDIA_CONTAINER, task_data->interface_name)) {
-		cb_task_data->prop_func =
-			G_CALLBACK(prv_get_container_property);
-	} else if (!strcmp(DLS_INTERFACE_MEDIA_ITEM,
-			   task_data->interface_name)) {
-		cb_task_data->prop_func = G_CALLBACK(prv_get_item_property);
-	} else if (!strcmp(DLS_INTERFACE_MEDIA_OBJECT,
-			   task_data->interface_name)) {
-		cb_task_data->prop_func = G_CALLBACK(prv_get_object_property);
-	} else  if (!strcmp("", task_data->interface_name)) {
-		cb_task_data->prop_func = G_CALLBACK(prv_get_all_property);
-	} else {
-		DLEYNA_LOG_WARNING("Interface is unknown.%s",
-				   task_data->interface_name);
+	cb_data->task.result = g_variant_ref_sink(g_variant_builder_end(
+							cb_task_data->vb));
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_UNKNOWN_INTERFACE,
-					     "Interface is unknown.");
-		goto on_error;
+on_complete:
+
+	if (!cb_data->error)
+		prv_get_sr_token_for_props(proxy, cb_data->task.target.device,
+					   cb_data);
+	else {
+		dls_async_task_complete_in_idle(cb_data);
+		g_cancellable_disconnect(cb_data->cancellable,
+					 cb_data->cancel_id);
 	}
 
-	cb_data->proxy = context->cds.proxy;
+	if (error)
+		g_error_free(error);
 
-	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
-				  (gpointer *)&cb_data->proxy);
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_get_system_update_id_for_props(GUPnPServiceProxy *proxy,
+				     const dls_device_t *device,
+				     dls_async_task_t *cb_data)
+{
+	dls_async_get_all_t *cb_task_data;
+	guint suid;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	if (prv_cds_subscribed(device)) {
+		suid = device->system_update_id;
+
+		cb_task_data = &cb_data->ut.get_all;
+
+		g_variant_builder_add(cb_task_data->vb, "{sv}",
+				      DLS_SYSTEM_UPDATE_VAR,
+				      g_variant_new_uint32(suid));
+
+		prv_get_sr_token_for_props(proxy, device, cb_data);
+
+		goto on_complete;
+	}
 
 	cb_data->action = gupnp_service_proxy_begin_action(
-			cb_data->proxy, "Browse",
-			prv_get_ms2spec_prop_cb,
-			cb_data,
-			"ObjectID", G_TYPE_STRING, cb_data->task.target.id,
-			"BrowseFlag", G_TYPE_STRING,
-			"BrowseMetadata",
-			"Filter", G_TYPE_STRING, filter,
-			"StartingIndex", G_TYPE_INT, 0,
-			"RequestedCount", G_TYPE_INT, 0,
-			"SortCriteria", G_TYPE_STRING,
-			"",
-			NULL);
+					proxy, "GetSystemUpdateID",
+					prv_system_update_id_for_props_cb,
+					cb_data,
+					NULL);
 
-	cb_data->cancel_id = g_cancellable_connect(
+	if (cb_data->proxy != NULL)
+		g_object_remove_weak_pointer((G_OBJECT(cb_data->proxy)),
+					     (gpointer *)&cb_data->proxy);
+
+	cb_data->proxy = proxy;
+
+	g_object_add_weak_pointer((G_OBJECT(proxy)),
+				  (gpointer *)&cb_data->proxy);
+
+	if (!cb_data->cancel_id)
+		cb_data->cancel_id = g_cancellable_connect(
 					cb_data->cancellable,
 					G_CALLBACK(dls_async_task_cancelled_cb),
 					cb_data, NULL);
 
-	DLEYNA_LOG_DEBUG("Exit with SUCCESS");
-
-	return;
+on_complete:
 
-on_error:
+	DLEYNA_LOG_DEBUG("Exit");
+}
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
+static gboolean prv_ems_subscribed(const dls_device_t *device)
+{
+	dls_device_context_t *context;
+	unsigned int i;
+	gboolean subscribed = FALSE;
 
-	DLEYNA_LOG_DEBUG("Exit with FAIL");
+	for (i = 0; i < device->contexts->len; ++i) {
+		context = g_ptr_array_index(device->contexts, i);
+		if (context->ems.subscribed) {
+			subscribed = TRUE;
+			break;
+		}
+	}
 
-	return;
+	return subscribed;
 }
 
-void dls_device_get_prop(dls_client_t *client,
-			 dls_task_t *task,
-			 dls_prop_map_t *prop_map, gboolean root_object)
+static void prv_sleeping_for_props_cb(GUPnPServiceProxy *proxy,
+				      GUPnPServiceProxyAction *action,
+				      gpointer user_data)
 {
-	dls_async_task_t *cb_data = (dls_async_task_t *)task;
-	dls_task_get_prop_t *task_data = &task->ut.get_prop;
-	dls_device_context_t *context;
-	gboolean complete = FALSE;
+	GError *error = NULL;
+	const gchar *message;
+	gchar *info = NULL;
+	gboolean end;
+	dls_async_task_t *cb_data = user_data;
+	dls_async_get_all_t *cb_task_data;
+	gboolean sleeping;
 
 	DLEYNA_LOG_DEBUG("Enter");
 
-	if (task->target.device->contexts->len != 0)
-		context = dls_device_get_context(task->target.device, client);
-	else
-		context = task->target.device->sleeping_context;
+	end = gupnp_service_proxy_end_action(proxy, action, &error,
+					     "NetworkInterfaceInfo",
+					     G_TYPE_STRING,
+					     &info, NULL);
 
-	if (!strcmp(task_data->interface_name,
-		    DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE)) {
-		if (root_object) {
-			if (!strcmp(
-				task_data->prop_name,
-				DLS_INTERFACE_PROP_ESV_SYSTEM_UPDATE_ID)) {
-				prv_get_system_update_id_for_prop(
-							context->cds.proxy,
-							task->target.device,
-							cb_data);
-			} else if (!strcmp(
-				task_data->prop_name,
-				DLS_INTERFACE_PROP_SV_SERVICE_RESET_TOKEN)) {
-				prv_get_sr_token_for_prop(
-							context->cds.proxy,
-							task->target.device,
-							cb_data);
-			} else if (!strcmp(
-				task_data->prop_name,
-				DLS_INTERFACE_PROP_SLEEPING)) {
-				prv_get_sleeping_for_prop(
-							context->ems.proxy,
-							task->target.device,
-							cb_data);
-			} else {
-				cb_data->task.result =
-					dls_props_get_device_prop(
-							(GUPnPDeviceInfo *)
-							context->device_proxy,
-							context->device_info,
-							task->target.device,
-							task_data->prop_name);
+	if (!end || (info == NULL)) {
+		message = (error != NULL) ? error->message : "Invalid result";
+		DLEYNA_LOG_WARNING("NetworkInterfaceInfo retrieval failed: %s",
+				   message);
 
-				if (!cb_data->task.result)
-					cb_data->error = g_error_new(
-						DLEYNA_SERVER_ERROR,
-						DLEYNA_ERROR_UNKNOWN_PROPERTY,
-						"Unknown property");
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_OPERATION_FAILED,
+					     "GetInterfaceInfo failed: %s",
+					     message);
+		goto on_complete;
+	}
 
-				(void) g_idle_add(dls_async_task_complete,
-						  cb_data);
-			}
+	if (prv_get_device_sleeping_state(cb_data->task.target.device,
+					  info,
+					  &sleeping)) {
+		cb_task_data = &cb_data->ut.get_all;
+		g_variant_builder_add(cb_task_data->vb, "{sv}",
+				      DLS_INTERFACE_PROP_SLEEPING,
+				      g_variant_new_boolean(sleeping));
 
-		} else {
-			cb_data->error =
-				g_error_new(DLEYNA_SERVER_ERROR,
-					    DLEYNA_ERROR_UNKNOWN_INTERFACE,
-					    "Interface is unknown.");
+		cb_data->task.result = g_variant_ref_sink(g_variant_builder_end(
+							     cb_task_data->vb));
+	}
 
-			(void) g_idle_add(dls_async_task_complete, cb_data);
-		}
+	g_free(info);
 
-	} else if (strcmp(task_data->interface_name, "")) {
-		prv_get_ms2spec_prop(context, prop_map, &task->ut.get_prop,
-				     cb_data);
-	} else {
-		if (root_object) {
-			if (!strcmp(
-				task_data->prop_name,
-				DLS_INTERFACE_PROP_ESV_SYSTEM_UPDATE_ID)) {
-				prv_get_system_update_id_for_prop(
-							context->cds.proxy,
-							task->target.device,
-							cb_data);
-				complete = TRUE;
-			} else if (!strcmp(
-				task_data->prop_name,
-				DLS_INTERFACE_PROP_SV_SERVICE_RESET_TOKEN)) {
-				prv_get_sr_token_for_prop(
-							context->cds.proxy,
-							task->target.device,
-							cb_data);
-				complete = TRUE;
-			} else if (!strcmp(
-				task_data->prop_name,
-				DLS_INTERFACE_PROP_SLEEPING)) {
-				prv_get_sleeping_for_prop(
-							context->ems.proxy,
-							task->target.device,
-							cb_data);
-				complete = TRUE;
-			} else {
-				cb_data->task.result =
+on_complete:
+
+	dls_async_task_complete_in_idle(cb_data);
+	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+
+	if (error)
+		g_error_free(error);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_get_sleeping_for_props(GUPnPServiceProxy *proxy,
+				       const dls_device_t *device,
+				       dls_async_task_t *cb_data)
+{
+	dls_async_get_all_t *cb_task_data;
+	gboolean sleeping;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	cb_task_data = &cb_data->ut.get_all;
+
+	if (proxy == NULL)
+		goto on_complete;
+
+	if (prv_ems_subscribed(device)) {
+		sleeping = device->sleeping;
+
+		g_variant_builder_add(cb_task_data->vb, "{sv}",
+				      DLS_INTERFACE_PROP_SLEEPING,
+				      g_variant_new_boolean(sleeping));
+
+		goto on_complete;
+	}
+
+	cb_data->action = gupnp_service_proxy_begin_action(
+					proxy, "GetInterfaceInfo",
+					prv_sleeping_for_props_cb,
+					cb_data,
+					NULL);
+
+	if (cb_data->proxy != NULL)
+		g_object_remove_weak_pointer((G_OBJECT(cb_data->proxy)),
+					     (gpointer *)&cb_data->proxy);
+
+	cb_data->proxy = proxy;
+
+	g_object_add_weak_pointer((G_OBJECT(proxy)),
+				  (gpointer *)&cb_data->proxy);
+
+	if (!cb_data->cancel_id)
+		cb_data->cancel_id = g_cancellable_connect(
+					cb_data->cancellable,
+					G_CALLBACK(dls_async_task_cancelled_cb),
+					cb_data, NULL);
+
+	return;
+
+on_complete:
+
+	cb_data->task.result = g_variant_ref_sink(g_variant_builder_end(
+						  cb_task_data->vb));
+
+	dls_async_task_complete_in_idle(cb_data);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static int prv_get_media_server_version(const dls_device_t *device)
+{
+	dls_device_context_t *context;
+	const char *device_type;
+	const char *version;
+
+	context = dls_device_get_context(device, NULL);
+	device_type = gupnp_device_info_get_device_type((GUPnPDeviceInfo *)
+							context->device_proxy);
+
+	if (!device_type || !g_str_has_prefix(device_type, DLS_DMS_DEVICE_TYPE))
+		goto on_error;
+
+	version = device_type + sizeof(DLS_DMS_DEVICE_TYPE) - 1;
+
+	return atoi(version);
+
+on_error:
+
+	return -1;
+}
+
+static void prv_service_reset_for_prop_cb(GUPnPServiceProxy *proxy,
+					  GUPnPServiceProxyAction *action,
+					  gpointer user_data)
+{
+	GError *error = NULL;
+	const gchar *message;
+	gchar *token = NULL;
+	gboolean end;
+	dls_async_task_t *cb_data = user_data;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	end = gupnp_service_proxy_end_action(proxy, action, &error,
+					     "ResetToken", G_TYPE_STRING,
+					     &token, NULL);
+
+	if (!end || (token == NULL)) {
+		message = (error != NULL) ? error->message : "Invalid result";
+		DLEYNA_LOG_WARNING("Unable to retrieve ServiceResetToken: %s",
+				   message);
+
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_OPERATION_FAILED,
+					     "GetServiceResetToken failed: %s",
+					     message);
+
+		goto on_complete;
+	}
+
+	cb_data->task.result = g_variant_ref_sink(g_variant_new_string(token));
+
+	DLEYNA_LOG_DEBUG("Service Reset %s", token);
+
+	g_free(token);
+
+on_complete:
+
+	dls_async_task_complete_in_idle(cb_data);
+	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+
+	if (error)
+		g_error_free(error);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_get_sr_token_for_prop(GUPnPServiceProxy *proxy,
+			     const dls_device_t *device,
+			     dls_async_task_t *cb_data)
+{
+	DLEYNA_LOG_DEBUG("Enter");
+
+	if (prv_get_media_server_version(device) < 3) {
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_UNKNOWN_PROPERTY,
+					     "Unknown property");
+
+		dls_async_task_complete_in_idle(cb_data);
+
+		goto on_error;
+	}
+
+	cb_data->action = gupnp_service_proxy_begin_action(
+					proxy, "GetServiceResetToken",
+					prv_service_reset_for_prop_cb,
+					cb_data,
+					NULL);
+
+	cb_data->proxy = proxy;
+	g_object_add_weak_pointer((G_OBJECT(proxy)),
+				  (gpointer *)&cb_data->proxy);
+
+	cb_data->cancel_id = g_cancellable_connect(
+					cb_data->cancellable,
+					G_CALLBACK(dls_async_task_cancelled_cb),
+					cb_data, NULL);
+
+on_error:
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_service_reset_for_props_cb(GUPnPServiceProxy *proxy,
+					  GUPnPServiceProxyAction *action,
+					  gpointer user_data)
+{
+	GError *error = NULL;
+	const gchar *message;
+	gchar *token = NULL;
+	gboolean end;
+	dls_async_task_t *cb_data = user_data;
+	dls_async_get_all_t *cb_task_data;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	cb_task_data = &cb_data->ut.get_all;
+
+	end = gupnp_service_proxy_end_action(proxy, action, &error,
+					    "ResetToken", G_TYPE_STRING,
+					    &token, NULL);
+
+	if (!end || (token == NULL)) {
+		message = (error != NULL) ? error->message : "Invalid result";
+		DLEYNA_LOG_WARNING("Unable to retrieve ServiceResetToken: %s",
+				   message);
+
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_OPERATION_FAILED,
+					     "GetServiceResetToken failed: %s",
+					     message);
+		goto on_complete;
+	}
+
+	g_variant_builder_add(cb_task_data->vb, "{sv}",
+			      DLS_INTERFACE_PROP_SV_SERVICE_RESET_TOKEN,
+			      g_variant_new_string(token));
+
+	DLEYNA_LOG_DEBUG("Service Reset %s", token);
+
+	g_free(token);
+
+on_complete:
+
+	if ((!cb_data->error) && (cb_task_data->proxy))
+		prv_get_sleeping_for_props(cb_task_data->proxy,
+					   cb_data->task.target.device,
+					   cb_data);
+	else {
+		cb_data->task.result = g_variant_ref_sink(g_variant_builder_end(
+							     cb_task_data->vb));
+
+		dls_async_task_complete_in_idle(cb_data);
+		g_cancellable_disconnect(cb_data->cancellable,
+					 cb_data->cancel_id);
+	}
+
+	if (error)
+		g_error_free(error);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_get_sr_token_for_props(GUPnPServiceProxy *proxy,
+			     const dls_device_t *device,
+			     dls_async_task_t *cb_data)
+{
+	dls_async_get_all_t *cb_task_data;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	if (prv_get_media_server_version(device) < 3) {
+		cb_task_data = &cb_data->ut.get_all;
+
+		prv_get_sleeping_for_props(cb_task_data->proxy,
+					   device, cb_data);
+
+		goto on_exit; /* No error here, just skip the property */
+	}
+
+	cb_data->action = gupnp_service_proxy_begin_action(
+					proxy, "GetServiceResetToken",
+					prv_service_reset_for_props_cb,
+					cb_data,
+					NULL);
+
+	if (cb_data->proxy != NULL)
+		g_object_remove_weak_pointer((G_OBJECT(cb_data->proxy)),
+					     (gpointer *)&cb_data->proxy);
+
+	cb_data->proxy = proxy;
+	g_object_add_weak_pointer((G_OBJECT(proxy)),
+				  (gpointer *)&cb_data->proxy);
+
+	if (!cb_data->cancel_id)
+		cb_data->cancel_id = g_cancellable_connect(
+					cb_data->cancellable,
+					G_CALLBACK(dls_async_task_cancelled_cb),
+					cb_data, NULL);
+
+on_exit:
+
+	DLEYNA_LOG_DEBUG("Exit");
+
+	return;
+}
+
+static void prv_sleeping_for_prop_cb(GUPnPServiceProxy *proxy,
+				     GUPnPServiceProxyAction *action,
+				     gpointer user_data)
+{
+	GError *error = NULL;
+	const gchar *message;
+	gchar *info = NULL;
+	gboolean end;
+	dls_async_task_t *cb_data = user_data;
+	gboolean sleeping;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	end = gupnp_service_proxy_end_action(proxy, action, &error,
+					     "NetworkInterfaceInfo",
+					     G_TYPE_STRING,
+					     &info, NULL);
+
+	if (!end || (info == NULL)) {
+		message = (error != NULL) ? error->message : "Invalid result";
+		DLEYNA_LOG_WARNING("NetworkInterfaceInfo retrieval failed: %s",
+				   message);
+
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_OPERATION_FAILED,
+					     "GetNetworkInterfaceInfo failed: %s",
+					     message);
+
+		goto on_complete;
+	}
+
+	if (prv_get_device_sleeping_state(cb_data->task.target.device,
+					  info,
+					  &sleeping)) {
+		cb_data->task.result = g_variant_ref_sink(
+					      g_variant_new_boolean(sleeping));
+	}
+
+	g_free(info);
+
+on_complete:
+
+	dls_async_task_complete_in_idle(cb_data);
+	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+
+	if (error)
+		g_error_free(error);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_get_sleeping_for_prop(GUPnPServiceProxy *proxy,
+				      const dls_device_t *device,
+				      dls_async_task_t *cb_data)
+{
+	gboolean sleeping;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	if (proxy == NULL) {
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_UNKNOWN_PROPERTY,
+					     "Unknown property");
+
+		dls_async_task_complete_in_idle(cb_data);
+
+		goto on_complete;
+	} else if ((device->contexts->len == 0) || prv_ems_subscribed(device)) {
+		sleeping = device->sleeping;
+
+		cb_data->task.result = g_variant_ref_sink(
+					g_variant_new_boolean(sleeping));
+
+		dls_async_task_complete_in_idle(cb_data);
+
+		goto on_complete;
+	}
+
+	cb_data->action = gupnp_service_proxy_begin_action(
+					proxy, "GetInterfaceInfo",
+					prv_sleeping_for_prop_cb,
+					cb_data,
+					NULL);
+
+	cb_data->proxy = proxy;
+
+	g_object_add_weak_pointer((G_OBJECT(proxy)),
+				  (gpointer *)&cb_data->proxy);
+
+	cb_data->cancel_id = g_cancellable_connect(
+					cb_data->cancellable,
+					G_CALLBACK(dls_async_task_cancelled_cb),
+					cb_data, NULL);
+on_complete:
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static gboolean prv_get_all_child_count_cb(dls_async_task_t *cb_data,
+				       gint count)
+{
+	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
+
+	dls_props_add_child_count(cb_task_data->vb, count);
+	if (cb_task_data->device_object)
+		prv_get_system_update_id_for_props(cb_data->proxy,
+						   cb_data->task.target.device,
+						   cb_data);
+	else
+		cb_data->task.result = g_variant_ref_sink(g_variant_builder_end(
+							cb_task_data->vb));
+
+	return !cb_task_data->device_object;
+}
+
+static gboolean prv_get_all_ms2spec_props_parse(GUPnPServiceProxy *proxy,
+						dls_async_task_t *cb_data,
+						const gchar *result)
+{
+	GError *error = NULL;
+	GUPnPDIDLLiteParser *parser;
+	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
+	gboolean parsed = FALSE;
+
+	parser = gupnp_didl_lite_parser_new();
+
+	g_signal_connect(parser, "object-available" , cb_task_data->prop_func,
+			 cb_data);
+
+	if (!gupnp_didl_lite_parser_parse_didl(parser, result, &error)) {
+		if (error->code == GUPNP_XML_ERROR_EMPTY_NODE) {
+			DLEYNA_LOG_WARNING("Property not defined for object");
+
+			cb_data->error =
+				g_error_new(DLEYNA_SERVER_ERROR,
+					    DLEYNA_ERROR_UNKNOWN_PROPERTY,
+					    "Property not defined for object");
+		} else {
+			DLEYNA_LOG_WARNING(
+				"Unable to parse results of browse: %s",
+				error->message);
+
+			cb_data->error =
+				g_error_new(DLEYNA_SERVER_ERROR,
+					    DLEYNA_ERROR_OPERATION_FAILED,
+					    "Unable to parse results of browse: %s",
+					    error->message);
+		}
+		goto on_error;
+	}
+
+	parsed = TRUE;
+
+	if (cb_data->error)
+		goto on_error;
+
+	if (cb_task_data->need_child_count) {
+		DLEYNA_LOG_DEBUG("Need Child Count");
+
+		prv_get_child_count(cb_data, prv_get_all_child_count_cb,
+				    cb_data->task.target.id);
+
+		goto no_complete;
+	} else if (cb_data->task.type == DLS_TASK_GET_ALL_PROPS &&
+						cb_task_data->device_object) {
+		prv_get_system_update_id_for_props(proxy,
+						   cb_data->task.target.device,
+						   cb_data);
+
+		goto no_complete;
+	} else {
+		cb_data->task.result = g_variant_ref_sink(g_variant_builder_end(
+							cb_task_data->vb));
+	}
+
+on_error:
+
+	dls_async_task_complete_in_idle(cb_data);
+	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+
+no_complete:
+
+	if (error)
+		g_error_free(error);
+
+	g_object_unref(parser);
+
+	return parsed;
+}
+
+static void prv_get_all_ms2spec_props_cb(GUPnPServiceProxy *proxy,
+					 dls_async_task_t *cb_data,
+					 const gchar *result,
+					 guint total_matches,
+					 const GError *error)
+{
+	const gchar *message;
+	dls_device_context_t *context;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	if (result == NULL) {
+		message = (error != NULL) ? error->message : "Invalid result";
+		DLEYNA_LOG_WARNING("Browse operation failed: %s", message);
+
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_OPERATION_FAILED,
+					     "Browse operation failed: %s",
+					     message);
+
+		dls_async_task_complete_in_idle(cb_data);
+		g_cancellable_disconnect(cb_data->cancellable,
+					 cb_data->cancel_id);
+		goto on_error;
+	}
+
+	DLEYNA_LOG_DEBUG("GetMS2SpecProps result: %s", result);
+
+	if (prv_get_all_ms2spec_props_parse(proxy, cb_data, result)) {
+		context = prv_context_for_cds_proxy(cb_data->task.target.device,
+						    proxy);
+		if (context)
+			prv_metadata_cache_insert(context,
+						  cb_data->task.target.id,
+						  result);
+	}
+
+on_error:
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_get_all_ms2spec_props(dls_device_context_t *context,
+				      dls_async_task_t *cb_data)
+{
+	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
+	dls_task_t *task = &cb_data->task;
+	dls_task_get_props_t *task_data = &task->ut.get_props;
+	const gchar *cached;
+
+	DLEYNA_LOG_DEBUG("Enter called");
+
+	if (!strcmp(DLS_INTERFACE_MEDIA_CONTAINER, task_data->interface_name)) {
+		cb_task_data->prop_func = G_CALLBACK(prv_get_container);
+	} else if (!strcmp(DLS_INTERFACE_MEDIA_ITEM,
+		   task_data->interface_name)) {
+		cb_task_data->prop_func = G_CALLBACK(prv_get_item);
+	} else if (!strcmp(DLS_INTERFACE_MEDIA_OBJECT,
+		   task_data->interface_name)) {
+		cb_task_data->prop_func = G_CALLBACK(prv_get_object);
+	} else  if (!strcmp("", task_data->interface_name)) {
+		cb_task_data->prop_func = G_CALLBACK(prv_get_all);
+	} else {
+		DLEYNA_LOG_WARNING("Interface is unknown.");
+
+		cb_data->error =
+			g_error_new(DLEYNA_SERVER_ERROR,
+				    DLEYNA_ERROR_UNKNOWN_INTERFACE,
+				    "Interface is unknown.");
+		goto on_error;
+	}
+
+	cached = prv_metadata_cache_lookup(context, task->target.id);
+
+	cb_data->proxy = context->cds.proxy;
+
+	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
+				  (gpointer *)&cb_data->proxy);
+
+	if (!cached) {
+		prv_browse_flight_join(cb_data, context->cds.proxy,
+				       prv_get_all_ms2spec_props_cb,
+				       task->target.id, "BrowseMetadata", "*",
+				       0, 0, "");
+	} else {
+		cb_data->cancel_id = g_cancellable_connect(
+					cb_data->cancellable,
+					G_CALLBACK(dls_async_task_cancelled_cb),
+					cb_data, NULL);
+
+		(void) prv_get_all_ms2spec_props_parse(context->cds.proxy,
+						       cb_data, cached);
+	}
+
+	DLEYNA_LOG_DEBUG("Exit with SUCCESS");
+
+	return;
+
+on_error:
+
+	dls_async_task_complete_in_idle(cb_data);
+
+	DLEYNA_LOG_DEBUG("Exit with FAIL");
+
+	return;
+}
+
+void dls_device_get_all_props(dls_client_t *client,
+			      dls_task_t *task,
+			      gboolean root_object)
+{
+	dls_async_task_t *cb_data = (dls_async_task_t *)task;
+	dls_async_get_all_t *cb_task_data;
+	dls_task_get_props_t *task_data = &task->ut.get_props;
+	dls_device_context_t *context;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	context = dls_device_get_context(task->target.device, client);
+	cb_task_data = &cb_data->ut.get_all;
+
+	cb_task_data->vb = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+	cb_task_data->device_object = root_object;
+	cb_task_data->proxy = context->ems.proxy;
+
+	if (!strcmp(task_data->interface_name,
+		    DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE)) {
+		if (root_object) {
+			dls_props_add_device((GUPnPDeviceInfo *)
+					     context->device_proxy,
+					     context->device_info,
+					     context->ems.proxy,
+					     task->target.device,
+					     cb_task_data->vb);
+			prv_get_system_update_id_for_props(
+					context->cds.proxy,
+					task->target.device,
+					cb_data);
+		} else {
+			cb_data->error =
+				g_error_new(DLEYNA_SERVER_ERROR,
+					    DLEYNA_ERROR_UNKNOWN_INTERFACE,
+					    "Interface is only valid on root objects.");
+
+			dls_async_task_complete_in_idle(cb_data);
+		}
+
+	} else if (strcmp(task_data->interface_name, "")) {
+		cb_task_data->device_object = FALSE;
+		prv_get_all_ms2spec_props(context, cb_data);
+	} else {
+		if (root_object)
+			dls_props_add_device((GUPnPDeviceInfo *)
+					     context->device_proxy,
+					     context->device_info,
+					     context->ems.proxy,
+					     task->target.device,
+					     cb_task_data->vb);
+		prv_get_all_ms2spec_props(context, cb_data);
+	}
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_get_object_property(GUPnPDIDLLiteParser *parser,
+				    GUPnPDIDLLiteObject *object,
+				    gpointer user_data)
+{
+	dls_async_task_t *cb_data = user_data;
+	dls_task_t *task = &cb_data->task;
+	dls_task_get_prop_t *task_data = &task->ut.get_prop;
+
+	if (cb_data->task.result)
+		goto on_error;
+
+	cb_data->task.result = dls_props_get_object_prop(task_data->prop_name,
+							 task->target.root_path,
+							 object);
+
+on_error:
+
+	return;
+}
+
+static void prv_get_item_property(GUPnPDIDLLiteParser *parser,
+				  GUPnPDIDLLiteObject *object,
+				  gpointer user_data)
+{
+	dls_async_task_t *cb_data = user_data;
+	dls_task_t *task = &cb_data->task;
+	dls_task_get_prop_t *task_data = &task->ut.get_prop;
+	dls_async_get_prop_t *cb_task_data = &cb_data->ut.get_prop;
+
+	if (cb_data->task.result)
+		goto on_error;
+
+	cb_data->task.result = dls_props_get_item_prop(
+						task_data->prop_name,
+						task->target.root_path,
+						object,
+						cb_task_data->protocol_info);
+
+on_error:
+
+	return;
+}
+
+static void prv_get_container_property(GUPnPDIDLLiteParser *parser,
+				       GUPnPDIDLLiteObject *object,
+				       gpointer user_data)
+{
+	dls_async_task_t *cb_data = user_data;
+	dls_task_t *task = &cb_data->task;
+	dls_task_get_prop_t *task_data = &task->ut.get_prop;
+	dls_async_get_prop_t *cb_task_data = &cb_data->ut.get_prop;
+
+	if (cb_data->task.result)
+		goto on_error;
+
+	cb_data->task.result = dls_props_get_container_prop(
+						task_data->prop_name,
+						object,
+						cb_task_data->protocol_info);
+
+on_error:
+
+	return;
+}
+
+static void prv_get_all_property(GUPnPDIDLLiteParser *parser,
+				 GUPnPDIDLLiteObject *object,
+				 gpointer user_data)
+{
+	dls_async_task_t *cb_data = user_data;
+
+	prv_get_object_property(parser, object, user_data);
+
+	if (cb_data->task.result)
+		goto on_error;
+
+	if (GUPNP_IS_DIDL_LITE_CONTAINER(object))
+		prv_get_container_property(parser, object, user_data);
+	else
+		prv_get_item_property(parser, object, user_data);
+
+on_error:
+
+	return;
+}
+
+static gboolean prv_get_child_count_cb(dls_async_task_t *cb_data,
+				   gint count)
+{
+	DLEYNA_LOG_DEBUG("Enter");
+
+	DLEYNA_LOG_DEBUG("Count %d", count);
+
+	cb_data->task.result =  g_variant_ref_sink(
+					g_variant_new_uint32((guint) count));
+
+	DLEYNA_LOG_DEBUG("Exit");
+
+	return TRUE;
+}
+
+static void prv_count_children_cb(GUPnPServiceProxy *proxy,
+				  GUPnPServiceProxyAction *action,
+				  gpointer user_data)
+{
+	dls_device_count_data_t *count_data = user_data;
+	dls_async_task_t *cb_data = count_data->cb_data;
+	GError *error = NULL;
+	const gchar *message;
+	guint count = G_MAXUINT32;
+	gboolean complete = FALSE;
+	gboolean end;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	end = gupnp_service_proxy_end_action(cb_data->proxy, cb_data->action,
+					    &error,
+					    "TotalMatches", G_TYPE_UINT, &count,
+					    NULL);
+
+	if (!end || (count == G_MAXUINT32)) {
+		message = (error != NULL) ? error->message : "Invalid result";
+		DLEYNA_LOG_WARNING("Browse operation failed: %s", message);
+
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_OPERATION_FAILED,
+					     "Browse operation failed: %s",
+					     message);
+		goto on_error;
+	}
+
+	prv_child_count_cache_insert(cb_data->task.target.device,
+				     count_data->id, FALSE, 0, count);
+
+	complete = count_data->cb(cb_data, count);
+
+on_error:
+
+	g_free(count_data->id);
+	g_free(user_data);
+
+	if (cb_data->error || complete) {
+		dls_async_task_complete_in_idle(cb_data);
+		g_cancellable_disconnect(cb_data->cancellable,
+					 cb_data->cancel_id);
+	}
+
+	if (error)
+		g_error_free(error);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_get_child_count(dls_async_task_t *cb_data,
+				dls_device_count_cb_t cb, const gchar *id)
+{
+	dls_device_count_data_t *count_data;
+	guint count;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	if (prv_child_count_cache_lookup(cb_data->task.target.device, id,
+					 FALSE, 0, &count)) {
+		if (cb(cb_data, count)) {
+			dls_async_task_complete_in_idle(cb_data);
+			g_cancellable_disconnect(cb_data->cancellable,
+						 cb_data->cancel_id);
+		}
+
+		DLEYNA_LOG_DEBUG("Exit with SUCCESS (cached)");
+
+		return;
+	}
+
+	prv_count_data_new(cb_data, cb, &count_data);
+	count_data->id = g_strdup(id);
+	cb_data->action =
+		gupnp_service_proxy_begin_action(cb_data->proxy,
+						 "Browse",
+						 prv_count_children_cb,
+						 count_data,
+						 "ObjectID", G_TYPE_STRING, id,
+
+						 "BrowseFlag", G_TYPE_STRING,
+						 "BrowseDirectChildren",
+
+						 "Filter", G_TYPE_STRING, "",
+
+						 "StartingIndex", G_TYPE_INT,
+						 0,
+
+						 "RequestedCount", G_TYPE_INT,
+						 1,
+
+						 "SortCriteria", G_TYPE_STRING,
+						 "",
+
+						 NULL);
+
+	DLEYNA_LOG_DEBUG("Exit with SUCCESS");
+}
+
+static void prv_get_ms2spec_prop_parse(dls_async_task_t *cb_data,
+				       const gchar *result)
+{
+	GError *error = NULL;
+	GUPnPDIDLLiteParser *parser;
+	dls_async_get_prop_t *cb_task_data = &cb_data->ut.get_prop;
+
+	parser = gupnp_didl_lite_parser_new();
+
+	g_signal_connect(parser, "object-available" , cb_task_data->prop_func,
+			 cb_data);
+
+	if (!gupnp_didl_lite_parser_parse_didl(parser, result, &error)) {
+		if (error->code == GUPNP_XML_ERROR_EMPTY_NODE) {
+			DLEYNA_LOG_WARNING("Property not defined for object");
+
+			cb_data->error =
+				g_error_new(DLEYNA_SERVER_ERROR,
+					    DLEYNA_ERROR_UNKNOWN_PROPERTY,
+					    "Property not defined for object");
+		} else {
+			DLEYNA_LOG_WARNING(
+				"Unable to parse results of browse: %s",
+				error->message);
+
+			cb_data->error =
+				g_error_new(DLEYNA_SERVER_ERROR,
+					    DLEYNA_ERROR_OPERATION_FAILED,
+					    "Unable to parse results of browse: %s",
+					    error->message);
+		}
+		goto on_error;
+	}
+
+	if (!cb_data->task.result) {
+		DLEYNA_LOG_WARNING("Property not defined for object");
+
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_UNKNOWN_PROPERTY,
+					     "Property not defined for object");
+	}
+
+on_error:
+
+	if (error)
+		g_error_free(error);
+
+	g_object_unref(parser);
+}
+
+static void prv_get_ms2spec_prop_complete(dls_async_task_t *cb_data)
+{
+	dls_task_get_prop_t *task_data = &cb_data->task.ut.get_prop;
+
+	if (cb_data->error && !strcmp(task_data->prop_name,
+				      DLS_INTERFACE_PROP_CHILD_COUNT)) {
+		DLEYNA_LOG_DEBUG("ChildCount not supported by server");
+
+		g_error_free(cb_data->error);
+		cb_data->error = NULL;
+		prv_get_child_count(cb_data, prv_get_child_count_cb,
+				    cb_data->task.target.id);
+	} else {
+		dls_async_task_complete_in_idle(cb_data);
+		g_cancellable_disconnect(cb_data->cancellable,
+					 cb_data->cancel_id);
+	}
+}
+
+static void prv_get_ms2spec_prop_cb(GUPnPServiceProxy *proxy,
+				    GUPnPServiceProxyAction *action,
+				    gpointer user_data)
+{
+	GError *error = NULL;
+	const gchar *message;
+	gchar *result = NULL;
+	gboolean end;
+	dls_async_task_t *cb_data = user_data;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	end = gupnp_service_proxy_end_action(cb_data->proxy, cb_data->action,
+					    &error, "Result",
+					    G_TYPE_STRING, &result, NULL);
+
+	if (!end || (result == NULL)) {
+		message = (error != NULL) ? error->message : "Invalid result";
+		DLEYNA_LOG_WARNING("Browse operation failed: %s", message);
+
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_OPERATION_FAILED,
+					     "Browse operation failed: %s",
+					     message);
+		goto on_error;
+	}
+
+	DLEYNA_LOG_DEBUG("GetMS2SpecProp result: %s", result);
+
+	prv_get_ms2spec_prop_parse(cb_data, result);
+
+on_error:
+
+	prv_get_ms2spec_prop_complete(cb_data);
+
+	if (error)
+		g_error_free(error);
+
+	g_free(result);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_get_ms2spec_prop(dls_device_context_t *context,
+				 dls_prop_map_t *prop_map,
+				 dls_task_get_prop_t *task_data,
+				 dls_async_task_t *cb_data)
+{
+	dls_async_get_prop_t *cb_task_data;
+	const gchar *filter;
+	const gchar *cached;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	cb_task_data = &cb_data->ut.get_prop;
+
+	if (!prop_map) {
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_UNKNOWN_PROPERTY,
+					     "Unknown property");
+		goto on_error;
+	}
+
+	filter = prop_map->filter ? prop_map->upnp_prop_name : "";
+
+	if (!strcmp(DLS_INTERFACE_MEDIA_CONTAINER, task_data->interface_name)) {
+		cb_task_data->prop_func =
+			G_CALLBACK(prv_get_container_property);
+	} else if (!strcmp(DLS_INTERFACE_MEDIA_ITEM,
+			   task_data->interface_name)) {
+		cb_task_data->prop_func = G_CALLBACK(prv_get_item_property);
+	} else if (!strcmp(DLS_INTERFACE_MEDIA_OBJECT,
+			   task_data->interface_name)) {
+		cb_task_data->prop_func = G_CALLBACK(prv_get_object_property);
+	} else  if (!strcmp("", task_data->interface_name)) {
+		cb_task_data->prop_func = G_CALLBACK(prv_get_all_property);
+	} else {
+		DLEYNA_LOG_WARNING("Interface is unknown.%s",
+				   task_data->interface_name);
+
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_UNKNOWN_INTERFACE,
+					     "Interface is unknown.");
+		goto on_error;
+	}
+
+	cb_data->proxy = context->cds.proxy;
+
+	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
+				  (gpointer *)&cb_data->proxy);
+
+	/* A cached "*" fragment is a superset of any single-property filter,
+	 * so it can serve Get() too.  Only GetAll() populates the cache.
+	 */
+	cached = prv_metadata_cache_lookup(context, cb_data->task.target.id);
+	if (cached) {
+		cb_data->cancel_id = g_cancellable_connect(
+					cb_data->cancellable,
+					G_CALLBACK(dls_async_task_cancelled_cb),
+					cb_data, NULL);
+
+		prv_get_ms2spec_prop_parse(cb_data, cached);
+		prv_get_ms2spec_prop_complete(cb_data);
+
+		DLEYNA_LOG_DEBUG("Exit with SUCCESS (cached)");
+
+		return;
+	}
+
+	cb_data->action = gupnp_service_proxy_begin_action(
+			cb_data->proxy, "Browse",
+			prv_get_ms2spec_prop_cb,
+			cb_data,
+			"ObjectID", G_TYPE_STRING, cb_data->task.target.id,
+			"BrowseFlag", G_TYPE_STRING,
+			"BrowseMetadata",
+			"Filter", G_TYPE_STRING, filter,
+			"StartingIndex", G_TYPE_INT, 0,
+			"RequestedCount", G_TYPE_INT, 0,
+			"SortCriteria", G_TYPE_STRING,
+			"",
+			NULL);
+
+	cb_data->cancel_id = g_cancellable_connect(
+					cb_data->cancellable,
+					G_CALLBACK(dls_async_task_cancelled_cb),
+					cb_data, NULL);
+
+	DLEYNA_LOG_DEBUG("Exit with SUCCESS");
+
+	return;
+
+on_error:
+
+	dls_async_task_complete_in_idle(cb_data);
+
+	DLEYNA_LOG_DEBUG("Exit with FAIL");
+
+	return;
+}
+
+void dls_device_get_prop(dls_client_t *client,
+			 dls_task_t *task,
+			 dls_prop_map_t *prop_map, gboolean root_object)
+{
+	dls_async_task_t *cb_data = (dls_async_task_t *)task;
+	dls_task_get_prop_t *task_data = &task->ut.get_prop;
+	dls_device_context_t *context;
+	gboolean complete = FALSE;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	if (task->target.device->contexts->len != 0)
+		context = dls_device_get_context(task->target.device, client);
+	else
+		context = task->target.device->sleeping_context;
+
+	if (!strcmp(task_data->interface_name,
+		    DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE)) {
+		if (root_object) {
+			if (!strcmp(
+				task_data->prop_name,
+				DLS_INTERFACE_PROP_ESV_SYSTEM_UPDATE_ID)) {
+				prv_get_system_update_id_for_prop(
+							context->cds.proxy,
+							task->target.device,
+							cb_data);
+			} else if (!strcmp(
+				task_data->prop_name,
+				DLS_INTERFACE_PROP_SV_SERVICE_RESET_TOKEN)) {
+				prv_get_sr_token_for_prop(
+							context->cds.proxy,
+							task->target.device,
+							cb_data);
+			} else if (!strcmp(
+				task_data->prop_name,
+				DLS_INTERFACE_PROP_SLEEPING)) {
+				prv_get_sleeping_for_prop(
+							context->ems.proxy,
+							task->target.device,
+							cb_data);
+			} else {
+				cb_data->task.result =
+					dls_props_get_device_prop(
+							(GUPnPDeviceInfo *)
+							context->device_proxy,
+							context->device_info,
+							task->target.device,
+							task_data->prop_name);
+
+				if (!cb_data->task.result)
+					cb_data->error = g_error_new(
+						DLEYNA_SERVER_ERROR,
+						DLEYNA_ERROR_UNKNOWN_PROPERTY,
+						"Unknown property");
+
+				dls_async_task_complete_in_idle(cb_data);
+			}
+
+		} else {
+			cb_data->error =
+				g_error_new(DLEYNA_SERVER_ERROR,
+					    DLEYNA_ERROR_UNKNOWN_INTERFACE,
+					    "Interface is unknown.");
+
+			dls_async_task_complete_in_idle(cb_data);
+		}
+
+	} else if (strcmp(task_data->interface_name, "")) {
+		prv_get_ms2spec_prop(context, prop_map, &task->ut.get_prop,
+				     cb_data);
+	} else {
+		if (root_object) {
+			if (!strcmp(
+				task_data->prop_name,
+				DLS_INTERFACE_PROP_ESV_SYSTEM_UPDATE_ID)) {
+				prv_get_system_update_id_for_prop(
+							context->cds.proxy,
+							task->target.device,
+							cb_data);
+				complete = TRUE;
+			} else if (!strcmp(
+				task_data->prop_name,
+				DLS_INTERFACE_PROP_SV_SERVICE_RESET_TOKEN)) {
+				prv_get_sr_token_for_prop(
+							context->cds.proxy,
+							task->target.device,
+							cb_data);
+				complete = TRUE;
+			} else if (!strcmp(
+				task_data->prop_name,
+				DLS_INTERFACE_PROP_SLEEPING)) {
+				prv_get_sleeping_for_prop(
+							context->ems.proxy,
+							task->target.device,
+							cb_data);
+				complete = TRUE;
+			} else {
+				cb_data->task.result =
 					dls_props_get_device_prop(
 							(GUPnPDeviceInfo *)
 							context->device_proxy,
@@ -3458,1372 +5735,2665 @@ void dls_device_get_prop(dls_client_t *client,
 							task->target.device,
 							task_data->prop_name);
 
-				if (cb_data->task.result) {
-					(void) g_idle_add(
-							dls_async_task_complete,
-							cb_data);
-					complete = TRUE;
-				}
-			}
+				if (cb_data->task.result) {
+					dls_async_task_complete_in_idle(
+								cb_data);
+					complete = TRUE;
+				}
+			}
+		}
+
+		if (!complete)
+			prv_get_ms2spec_prop(context, prop_map,
+					     &task->ut.get_prop,
+					     cb_data);
+	}
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_found_target(GUPnPDIDLLiteParser *parser,
+			     GUPnPDIDLLiteObject *object,
+			     gpointer user_data)
+{
+	dls_async_task_t *cb_data = user_data;
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+	const char *object_id;
+	const char *parent_id;
+	const char *parent_path;
+	gchar *path = NULL;
+	gboolean have_child_count;
+	dls_device_object_builder_t *builder;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	builder = g_new0(dls_device_object_builder_t, 1);
+
+	object_id = gupnp_didl_lite_object_get_id(object);
+	if (!object_id)
+		goto on_error;
+
+	parent_id = gupnp_didl_lite_object_get_parent_id(object);
+	if (!parent_id)
+		goto on_error;
+
+	if (!strcmp(object_id, "0") || !strcmp(parent_id, "-1")) {
+		parent_path = cb_data->task.target.root_path;
+	} else {
+		path = dls_path_from_id(cb_data->task.target.root_path,
+					parent_id);
+		parent_path = path;
+	}
+
+	builder->vb = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+
+	if (!dls_props_add_object(builder->vb, object,
+				  cb_data->task.target.root_path,
+				  parent_path, cb_task_data->filter_mask))
+		goto on_error;
+
+	if (GUPNP_IS_DIDL_LITE_CONTAINER(object)) {
+		dls_props_add_container(builder->vb,
+					(GUPnPDIDLLiteContainer *)object,
+					cb_task_data->filter_mask,
+					cb_task_data->protocol_info,
+					&have_child_count);
+
+		if (!have_child_count && (cb_task_data->filter_mask &
+					  DLS_UPNP_MASK_PROP_CHILD_COUNT)) {
+			builder->needs_child_count = TRUE;
+			builder->id = g_strdup(
+				gupnp_didl_lite_object_get_id(object));
+			cb_task_data->need_child_count = TRUE;
+		}
+	} else {
+		dls_props_add_item(builder->vb,
+				   object,
+				   cb_data->task.target.root_path,
+				   cb_task_data->filter_mask,
+				   cb_task_data->protocol_info);
+	}
+
+	g_ptr_array_add(cb_task_data->vbs, builder);
+	g_free(path);
+
+	DLEYNA_LOG_DEBUG("Exit with SUCCESS");
+
+	return;
+
+on_error:
+
+	g_free(path);
+	prv_object_builder_delete(builder);
+
+	DLEYNA_LOG_DEBUG("Exit with FAIL");
+}
+
+static void prv_found_didl_target(const dls_didl_object_t *object,
+				  gpointer user_data)
+{
+	dls_async_task_t *cb_data = user_data;
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+	const char *object_id = object->props[DLS_DIDL_PROP_ID];
+	const char *parent_id = object->props[DLS_DIDL_PROP_PARENT_ID];
+	const char *update_id;
+	const char *parent_path;
+	gchar *path = NULL;
+	gboolean have_child_count;
+	dls_device_object_builder_t *builder;
+
+	builder = g_new0(dls_device_object_builder_t, 1);
+
+	if (!object_id || !parent_id)
+		goto on_error;
+
+	if (!strcmp(object_id, "0") || !strcmp(parent_id, "-1")) {
+		parent_path = cb_data->task.target.root_path;
+	} else {
+		path = dls_path_from_id(cb_data->task.target.root_path,
+					parent_id);
+		parent_path = path;
+	}
+
+	builder->vb = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+
+	if (!dls_props_add_didl_object(builder->vb, object,
+				       cb_data->task.target.root_path,
+				       parent_path, cb_task_data->filter_mask,
+				       &have_child_count))
+		goto on_error;
+
+	if (object->container && !have_child_count &&
+	    (cb_task_data->filter_mask & DLS_UPNP_MASK_PROP_CHILD_COUNT)) {
+		builder->needs_child_count = TRUE;
+		builder->id = g_strdup(object_id);
+		cb_task_data->need_child_count = TRUE;
+	}
+
+	update_id = object->props[DLS_DIDL_PROP_CONTAINER_UPDATE_ID];
+	if (object->container && update_id) {
+		builder->has_container_update_id = TRUE;
+		builder->container_update_id = (guint) g_ascii_strtoull(
+							update_id, NULL, 10);
+	}
+
+	g_ptr_array_add(cb_task_data->vbs, builder);
+	g_free(path);
+
+	return;
+
+on_error:
+
+	g_free(path);
+	prv_object_builder_delete(builder);
+}
+
+static gboolean prv_search_parse_result(dls_async_task_t *cb_data,
+					const gchar *result, GError **error)
+{
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+	GUPnPDIDLLiteParser *parser;
+	gboolean retval;
+
+	/* Large results are parsed in a single streaming pass when no
+	 * resource properties are requested.
+	 */
+	if (dls_didl_can_stream(cb_task_data->filter_mask))
+		return dls_didl_parse(
+				result,
+				prv_didl_parse_mask(cb_task_data->filter_mask),
+				prv_found_didl_target, cb_data, error);
+
+	parser = gupnp_didl_lite_parser_new();
+
+	g_signal_connect(parser, "object-available" ,
+			 G_CALLBACK(prv_found_target), cb_data);
+
+	retval = gupnp_didl_lite_parser_parse_didl(parser, result, error);
+
+	g_object_unref(parser);
+
+	return retval;
+}
+
+static void prv_search_cb(GUPnPServiceProxy *proxy,
+			  GUPnPServiceProxyAction *action,
+			  gpointer user_data)
+{
+	gchar *result = NULL;
+	const gchar *message;
+	gboolean end;
+	guint count = G_MAXUINT32;
+	GError *error = NULL;
+	dls_async_task_t *cb_data = user_data;
+	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	end = gupnp_service_proxy_end_action(cb_data->proxy, cb_data->action,
+					     &error,
+					     "Result", G_TYPE_STRING, &result,
+					     "TotalMatches", G_TYPE_UINT,
+					     &count, NULL);
+
+	if (!end || (result == NULL) || (count == G_MAXUINT32)) {
+		message = (error != NULL) ? error->message : "Invalid result";
+		DLEYNA_LOG_WARNING("Search operation failed %s", message);
+
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_OPERATION_FAILED,
+					     "Search operation failed: %s",
+					     message);
+		goto on_error;
+	}
+
+	cb_task_data->max_count = count;
+
+	cb_task_data->vbs = g_ptr_array_new_with_free_func(
+		prv_object_builder_delete);
+
+	DLEYNA_LOG_DEBUG("Server Search result: %s", result);
+
+	if (!prv_search_parse_result(cb_data, result, &error) &&
+	    error->code != GUPNP_XML_ERROR_EMPTY_NODE) {
+		DLEYNA_LOG_WARNING("Unable to parse results of search: %s",
+				   error->message);
+
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_OPERATION_FAILED,
+					     "Unable to parse results of search: %s",
+					     error->message);
+		goto on_error;
+	}
+
+	if (cb_task_data->need_child_count) {
+		DLEYNA_LOG_DEBUG("Need to retrieve child count");
+
+		if (cb_data->task.multiple_retvals)
+			cb_task_data->get_children_cb =
+				prv_get_search_ex_result;
+		else
+			cb_task_data->get_children_cb = prv_get_children_result;
+		prv_start_child_count_for_list(cb_data);
+		goto no_complete;
+	} else {
+		if (cb_data->task.multiple_retvals)
+			prv_get_search_ex_result(cb_data);
+		else
+			prv_get_children_result(cb_data);
+	}
+
+on_error:
+
+	dls_async_task_complete_in_idle(cb_data);
+	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+
+no_complete:
+
+	g_free(result);
+
+	if (error)
+		g_error_free(error);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+void dls_device_search(dls_client_t *client,
+		       dls_task_t *task,
+		       const gchar *upnp_filter, const gchar *upnp_query,
+		       const gchar *sort_by)
+{
+	dls_async_task_t *cb_data = (dls_async_task_t *)task;
+	dls_device_context_t *context;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	context = dls_device_get_context(task->target.device, client);
+
+	cb_data->proxy = context->cds.proxy;
+
+	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
+				  (gpointer *)&cb_data->proxy);
+
+	cb_data->action = gupnp_service_proxy_begin_action(
+			cb_data->proxy, "Search",
+			prv_search_cb,
+			cb_data,
+			"ContainerID", G_TYPE_STRING, task->target.id,
+			"SearchCriteria", G_TYPE_STRING, upnp_query,
+			"Filter", G_TYPE_STRING, upnp_filter,
+			"StartingIndex", G_TYPE_INT, task->ut.search.start,
+			"RequestedCount", G_TYPE_INT, task->ut.search.count,
+			"SortCriteria", G_TYPE_STRING, sort_by,
+			NULL);
+
+	cb_data->cancel_id = g_cancellable_connect(
+					cb_data->cancellable,
+					G_CALLBACK(dls_async_task_cancelled_cb),
+					cb_data, NULL);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_get_resource(GUPnPDIDLLiteParser *parser,
+			     GUPnPDIDLLiteObject *object,
+			     gpointer user_data)
+{
+	dls_async_task_t *cb_data = user_data;
+	dls_task_t *task = &cb_data->task;
+	dls_task_get_resource_t *task_data = &task->ut.resource;
+	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	dls_props_add_resource(cb_task_data->vb, object,
+			       cb_task_data->filter_mask,
+			       task_data->matcher);
+}
+
+static GVariant *prv_browse_objects_error_result(dls_async_browse_objects_t *bo,
+						 const gchar *path,
+						 GError *error)
+{
+	GVariantBuilder evb;
+	GVariant *gv_result;
+
+	DLEYNA_LOG_WARNING("%s: %s", path, error->message);
+
+	g_variant_builder_init(&evb, G_VARIANT_TYPE("a{sv}"));
+
+	if (bo->get_all.filter_mask & DLS_UPNP_MASK_PROP_PATH)
+		g_variant_builder_add(
+			&evb, "{sv}", DLS_INTERFACE_PROP_PATH,
+			g_variant_new_object_path(path));
+
+	gv_result = dls_props_get_error_prop(error);
+
+	g_variant_builder_add(&evb, "{sv}",
+			      DLS_INTERFACE_PROP_ERROR, gv_result);
+
+	return g_variant_ref_sink(g_variant_builder_end(&evb));
+}
+
+static void prv_browse_objects_request_delete(
+				dls_device_browse_request_t *request)
+{
+	if (request->vb)
+		g_variant_builder_unref(request->vb);
+
+	if (request->batch)
+		g_hash_table_unref(request->batch);
+
+	g_free(request->id);
+	g_free(request);
+}
+
+static void prv_browse_objects_abort(dls_async_task_t *cb_data)
+{
+	dls_async_browse_objects_t *cb_task_data = &cb_data->ut.browse_objects;
+	dls_device_browse_request_t *request;
+	GList *next;
+
+	for (next = cb_task_data->requests; next; next = next->next) {
+		request = next->data;
+
+		if (cb_data->proxy)
+			gupnp_service_proxy_cancel_action(cb_data->proxy,
+							  request->action);
+		prv_browse_objects_request_delete(request);
+	}
+
+	g_list_free(cb_task_data->requests);
+	cb_task_data->requests = NULL;
+}
+
+static void prv_browse_objects_cancelled(GCancellable *cancellable,
+					 gpointer user_data)
+{
+	dls_async_task_t *cb_data = user_data;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	prv_browse_objects_abort(cb_data);
+
+	if (!cb_data->error)
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_CANCELLED,
+					     "Operation cancelled.");
+	dls_async_task_complete_in_idle(cb_data);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_browse_objects_end(dls_async_task_t *cb_data)
+{
+	dls_async_browse_objects_t *cb_task_data = &cb_data->ut.browse_objects;
+	guint i;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	/* Duplicated paths share the result of their first occurrence */
+	for (i = 0; i < cb_task_data->object_count; ++i)
+		g_variant_builder_add(
+			cb_task_data->avb, "@a{sv}",
+			cb_task_data->results[cb_task_data->slots[i]]);
+
+	cb_data->task.result = g_variant_ref_sink(
+				g_variant_builder_end(cb_task_data->avb));
+
+	dls_async_task_complete_in_idle(cb_data);
+	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_browse_objects_request_done(dls_device_browse_request_t *req,
+					    GError *error)
+{
+	dls_async_task_t *cb_data = req->cb_data;
+	dls_async_browse_objects_t *cb_task_data = &cb_data->ut.browse_objects;
+	const gchar *path = cb_task_data->objects_id[req->object];
+
+	if (error)
+		cb_task_data->results[req->slot] =
+			prv_browse_objects_error_result(cb_task_data, path,
+							error);
+	else
+		cb_task_data->results[req->slot] =
+			g_variant_ref_sink(g_variant_builder_end(req->vb));
+
+	cb_task_data->requests = g_list_remove(cb_task_data->requests, req);
+	prv_browse_objects_request_delete(req);
+
+	prv_browse_objects_next(cb_data);
+}
+
+static void prv_browse_objects_count_cb(GUPnPServiceProxy *proxy,
+					GUPnPServiceProxyAction *action,
+					gpointer user_data)
+{
+	dls_device_browse_request_t *request = user_data;
+	GError *error = NULL;
+	GError *result_error = NULL;
+	const gchar *message;
+	guint count = G_MAXUINT32;
+	gboolean end;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	end = gupnp_service_proxy_end_action(proxy, action, &error,
+					     "TotalMatches", G_TYPE_UINT,
+					     &count, NULL);
+
+	if (!end || (count == G_MAXUINT32)) {
+		message = (error != NULL) ? error->message : "Invalid result";
+		DLEYNA_LOG_WARNING("Browse operation failed: %s", message);
+
+		result_error = g_error_new(DLEYNA_SERVER_ERROR,
+					   DLEYNA_ERROR_OPERATION_FAILED,
+					   "Browse operation failed: %s",
+					   message);
+	} else {
+		DLEYNA_LOG_DEBUG("Child Count: %u", count);
+
+		dls_props_add_child_count(request->vb, count);
+		prv_child_count_cache_insert(
+				request->cb_data->task.target.device,
+				request->id, FALSE, 0, count);
+	}
+
+	prv_browse_objects_request_done(request, result_error);
+
+	if (result_error)
+		g_error_free(result_error);
+
+	if (error)
+		g_error_free(error);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_browse_objects_browse_cb(GUPnPServiceProxy *proxy,
+					 GUPnPServiceProxyAction *action,
+					 gpointer user_data)
+{
+	GError *error = NULL;
+	GError *result_error = NULL;
+	dls_device_browse_request_t *request = user_data;
+	dls_async_task_t *cb_data = request->cb_data;
+	dls_async_get_all_t *cb_all_data = &cb_data->ut.browse_objects.get_all;
+	GUPnPDIDLLiteParser *parser = NULL;
+	gchar *result = NULL;
+	const gchar *message;
+	gboolean end;
+	guint count;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	end = gupnp_service_proxy_end_action(proxy, action, &error,
+					     "Result", G_TYPE_STRING, &result,
+					     NULL);
+
+	if (!end || (result == NULL)) {
+		message = (error != NULL) ? error->message : "Invalid result";
+		DLEYNA_LOG_WARNING("Browse Object operation failed: %s",
+				   message);
+
+		result_error = g_error_new(DLEYNA_SERVER_ERROR,
+					   DLEYNA_ERROR_OPERATION_FAILED,
+					   "Browse operation failed: %s",
+					   message);
+		goto on_exit;
+	}
+
+	DLEYNA_LOG_DEBUG_NL();
+	DLEYNA_LOG_DEBUG("Result: %s", result);
+	DLEYNA_LOG_DEBUG_NL();
+
+	/* prv_get_all() works on the task's get_all builder.  Parsing is
+	 * synchronous, so lend it the builder of this request.
+	 */
+	request->vb = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+	cb_all_data->vb = request->vb;
+	cb_all_data->need_child_count = FALSE;
+
+	parser = gupnp_didl_lite_parser_new();
+
+	g_signal_connect(parser, "object-available",
+			 G_CALLBACK(prv_get_all),
+			 cb_data);
+
+	if (!gupnp_didl_lite_parser_parse_didl(parser, result, &error)) {
+		if (error->code == GUPNP_XML_ERROR_EMPTY_NODE) {
+			DLEYNA_LOG_WARNING("Property not defined for object");
+
+			result_error = g_error_new(
+						DLEYNA_SERVER_ERROR,
+						DLEYNA_ERROR_UNKNOWN_PROPERTY,
+						"Property not defined for object");
+		} else {
+			DLEYNA_LOG_WARNING(
+					"Unable to parse results of browse: %s",
+					error->message);
+
+			result_error = g_error_new(
+						DLEYNA_SERVER_ERROR,
+						DLEYNA_ERROR_OPERATION_FAILED,
+						"Unable to parse results of browse: %s",
+						error->message);
+		}
+	}
+
+	if (cb_data->error) {
+		if (!result_error)
+			result_error = cb_data->error;
+		else
+			g_error_free(cb_data->error);
+		cb_data->error = NULL;
+	}
+
+	cb_all_data->vb = NULL;
+
+	if (result_error || !cb_all_data->need_child_count ||
+	    !(cb_all_data->filter_mask & DLS_UPNP_MASK_PROP_CHILD_COUNT))
+		goto on_exit;
+
+	if (prv_child_count_cache_lookup(cb_data->task.target.device,
+					 request->id, FALSE, 0, &count)) {
+		dls_props_add_child_count(request->vb, count);
+		goto on_exit;
+	}
+
+	DLEYNA_LOG_DEBUG("Need Child Count");
+
+	request->action = gupnp_service_proxy_begin_action(
+			proxy, "Browse",
+			prv_browse_objects_count_cb, request,
+			"ObjectID", G_TYPE_STRING, request->id,
+			"BrowseFlag", G_TYPE_STRING, "BrowseDirectChildren",
+			"Filter", G_TYPE_STRING, "",
+			"StartingIndex", G_TYPE_INT, 0,
+			"RequestedCount", G_TYPE_INT, 1,
+			"SortCriteria", G_TYPE_STRING, "",
+			NULL);
+
+	goto no_complete;
+
+on_exit:
+
+	prv_browse_objects_request_done(request, result_error);
+
+no_complete:
+
+	if (parser)
+		g_object_unref(parser);
+
+	if (result_error)
+		g_error_free(result_error);
+
+	if (error)
+		g_error_free(error);
+
+	g_free(result);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static gboolean prv_can_search_by_id(const dls_device_t *device)
+{
+	GVariantIter iter;
+	const gchar *cap;
+	gboolean found = FALSE;
+
+	if (!device->search_caps)
+		goto on_exit;
+
+	(void) g_variant_iter_init(&iter, device->search_caps);
+
+	while (!found && g_variant_iter_next(&iter, "&s", &cap))
+		found = !strcmp(cap, "*") ||
+			!strcmp(cap, DLS_INTERFACE_PROP_PATH);
+
+on_exit:
+
+	return found;
+}
+
+static void prv_append_search_string(GString *criteria, const gchar *value)
+{
+	g_string_append_c(criteria, '"');
+
+	for (; *value; value++) {
+		if ((*value == '"') || (*value == '\\'))
+			g_string_append_c(criteria, '\\');
+		g_string_append_c(criteria, *value);
+	}
+
+	g_string_append_c(criteria, '"');
+}
+
+static void prv_browse_objects_search_found(GUPnPDIDLLiteParser *parser,
+					    GUPnPDIDLLiteObject *object,
+					    gpointer user_data)
+{
+	dls_device_browse_request_t *request = user_data;
+	dls_async_task_t *cb_data = request->cb_data;
+	dls_async_browse_objects_t *cb_task_data = &cb_data->ut.browse_objects;
+	dls_async_get_all_t *cb_all_data = &cb_task_data->get_all;
+	const gchar *id;
+	gpointer slot;
+	guint count;
+
+	id = gupnp_didl_lite_object_get_id(object);
+
+	if (!id || !g_hash_table_lookup_extended(request->batch, id, NULL,
+						 &slot))
+		return;
+
+	cb_all_data->vb = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+	cb_all_data->need_child_count = FALSE;
+
+	prv_get_all(parser, object, cb_data);
+
+	/* Objects we cannot complete here are left to the per-object
+	 * Browse, which reports errors and fetches missing child counts.
+	 */
+	if (cb_data->error) {
+		g_error_free(cb_data->error);
+		cb_data->error = NULL;
+		goto on_exit;
+	}
+
+	if (cb_all_data->need_child_count &&
+	    (cb_all_data->filter_mask & DLS_UPNP_MASK_PROP_CHILD_COUNT)) {
+		if (!prv_child_count_cache_lookup(cb_data->task.target.device,
+						  id, FALSE, 0, &count))
+			goto on_exit;
+
+		dls_props_add_child_count(cb_all_data->vb, count);
+	}
+
+	cb_task_data->results[GPOINTER_TO_UINT(slot)] =
+		g_variant_ref_sink(g_variant_builder_end(cb_all_data->vb));
+	(void) g_hash_table_remove(request->batch, id);
+
+on_exit:
+
+	g_variant_builder_unref(cb_all_data->vb);
+	cb_all_data->vb = NULL;
+}
+
+static void prv_browse_objects_search_cb(GUPnPServiceProxy *proxy,
+					 GUPnPServiceProxyAction *action,
+					 gpointer user_data)
+{
+	dls_device_browse_request_t *request = user_data;
+	dls_async_task_t *cb_data = request->cb_data;
+	dls_async_browse_objects_t *cb_task_data = &cb_data->ut.browse_objects;
+	GUPnPDIDLLiteParser *parser = NULL;
+	GError *error = NULL;
+	gchar *result = NULL;
+	gboolean end;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	end = gupnp_service_proxy_end_action(proxy, action, &error,
+					     "Result", G_TYPE_STRING, &result,
+					     NULL);
+
+	if (!end || (result == NULL)) {
+		DLEYNA_LOG_WARNING("Search by @id failed: %s",
+				   ((error != NULL) ? error->message
+						    : "Invalid result"));
+		goto on_exit;
+	}
+
+	parser = gupnp_didl_lite_parser_new();
+
+	g_signal_connect(parser, "object-available",
+			 G_CALLBACK(prv_browse_objects_search_found),
+			 request);
+
+	if (!gupnp_didl_lite_parser_parse_didl(parser, result, &error))
+		DLEYNA_LOG_WARNING("Unable to parse results of search: %s",
+				   error->message);
+
+on_exit:
+
+	DLEYNA_LOG_DEBUG("%u objects left for Browse",
+			 g_hash_table_size(request->batch));
+
+	cb_task_data->searches--;
+	cb_task_data->requests = g_list_remove(cb_task_data->requests,
+					       request);
+	prv_browse_objects_request_delete(request);
+
+	prv_browse_objects_next(cb_data);
+
+	if (parser)
+		g_object_unref(parser);
+
+	if (error)
+		g_error_free(error);
+
+	g_free(result);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+/* Folds up to g_browse_objects_batch_size objects into a single
+ * Search("@id = \"a\" or @id = \"b\" ...") request.
+ */
+static void prv_browse_objects_search_batch(dls_async_task_t *cb_data)
+{
+	dls_async_browse_objects_t *cb_task_data = &cb_data->ut.browse_objects;
+	dls_device_browse_request_t *request;
+	GString *criteria;
+	const gchar *path;
+	gchar *root_path;
+	gchar *id;
+	guint slot;
+	guint i;
+
+	request = g_new0(dls_device_browse_request_t, 1);
+	request->cb_data = cb_data;
+	request->batch = g_hash_table_new_full(g_str_hash, g_str_equal,
+					       g_free, NULL);
+
+	criteria = g_string_new("");
+
+	for (i = 0; (i < g_browse_objects_batch_size) &&
+		     (cb_task_data->search_index < cb_task_data->unique_count);
+	     i++) {
+		slot = cb_task_data->search_index++;
+		path = cb_task_data->objects_id[cb_task_data->unique[slot]];
+
+		if (!dls_path_get_path_and_id(path, &root_path, &id, NULL))
+			continue;
+
+		g_free(root_path);
+
+		/* The root container is not a descendant of itself */
+		if (!strcmp(id, "0") ||
+		    g_hash_table_contains(request->batch, id)) {
+			g_free(id);
+			continue;
+		}
+
+		if (criteria->len)
+			g_string_append(criteria, " or ");
+
+		g_string_append(criteria, "@id = ");
+		prv_append_search_string(criteria, id);
+
+		g_hash_table_insert(request->batch, id,
+				    GUINT_TO_POINTER(slot));
+	}
+
+	if (g_hash_table_size(request->batch) == 0) {
+		prv_browse_objects_request_delete(request);
+		goto on_exit;
+	}
+
+	DLEYNA_LOG_DEBUG("Search by @id: %s", criteria->str);
+
+	request->action = gupnp_service_proxy_begin_action(
+			cb_data->proxy, "Search",
+			prv_browse_objects_search_cb, request,
+			"ContainerID", G_TYPE_STRING, "0",
+			"SearchCriteria", G_TYPE_STRING, criteria->str,
+			"Filter", G_TYPE_STRING, cb_task_data->upnp_filter,
+			"StartingIndex", G_TYPE_INT, 0,
+			"RequestedCount", G_TYPE_INT, 0,
+			"SortCriteria", G_TYPE_STRING, "", NULL);
+
+	cb_task_data->requests = g_list_prepend(cb_task_data->requests,
+						request);
+	cb_task_data->searches++;
+
+on_exit:
+
+	(void) g_string_free(criteria, TRUE);
+}
+
+/* Keeps up to g_browse_objects_max_in_flight requests outstanding.  The
+ * @id searches, if any, are issued first.  Once they have all completed,
+ * the objects they did not resolve are fetched with BrowseMetadata.
+ * Results are stored by slot, so completion order does not matter.
+ */
+static void prv_browse_objects_next(dls_async_task_t *cb_data)
+{
+	dls_async_browse_objects_t *cb_task_data = &cb_data->ut.browse_objects;
+	dls_device_browse_request_t *request;
+	const gchar *path;
+	gchar *root_path = NULL;
+	gchar *id = NULL;
+	GError *error = NULL;
+	guint slot;
+
+	while (g_list_length(cb_task_data->requests) <
+	       g_browse_objects_max_in_flight) {
+		if (cb_task_data->search_index < cb_task_data->unique_count) {
+			prv_browse_objects_search_batch(cb_data);
+			continue;
+		}
+
+		if (cb_task_data->searches ||
+		    (cb_task_data->index >= cb_task_data->unique_count))
+			break;
+
+		slot = cb_task_data->index++;
+
+		if (cb_task_data->results[slot])
+			continue;
+
+		path = cb_task_data->objects_id[cb_task_data->unique[slot]];
+
+		/* Process anyway. We will add an entry with error */
+		if (!dls_path_get_path_and_id(path, &root_path, &id, &error)) {
+			cb_task_data->results[slot] =
+				prv_browse_objects_error_result(cb_task_data,
+								path, error);
+			g_error_free(error);
+			error = NULL;
+			continue;
+		}
+
+		g_free(root_path);
+
+		DLEYNA_LOG_DEBUG("Browse Metadata for path [id]: %s [%s]",
+				 path, id);
+
+		request = g_new0(dls_device_browse_request_t, 1);
+		request->cb_data = cb_data;
+		request->slot = slot;
+		request->object = cb_task_data->unique[slot];
+		request->id = id;
+		request->action = gupnp_service_proxy_begin_action(
+			cb_data->proxy, "Browse",
+			prv_browse_objects_browse_cb, request,
+			"ObjectID", G_TYPE_STRING, id,
+			"BrowseFlag", G_TYPE_STRING, "BrowseMetadata",
+			"Filter", G_TYPE_STRING, cb_task_data->upnp_filter,
+			"StartingIndex", G_TYPE_INT, 0,
+			"RequestedCount", G_TYPE_INT, 0,
+			"SortCriteria", G_TYPE_STRING, "", NULL);
+
+		cb_task_data->requests = g_list_prepend(cb_task_data->requests,
+							request);
+	}
+
+	if (cb_task_data->requests == NULL)
+		prv_browse_objects_end(cb_data);
+}
+
+void dls_device_browse_objects(dls_client_t *client, dls_task_t *task)
+{
+	dls_async_task_t *cb_data = (dls_async_task_t *)task;
+	dls_async_browse_objects_t *cb_task_data;
+	dls_device_context_t *context;
+	GHashTable *seen;
+	gpointer slot;
+	const gchar **objs;
+	gsize length;
+	guint i;
+	gboolean path_ok;
+	const char *message;
+
+	DLEYNA_LOG_DEBUG("Root Path %s", task->target.root_path)
+
+	objs = g_variant_get_objv(task->ut.browse_objects.objects, &length);
+
+	path_ok = (length > 0);
+
+	for (i = 0; (i < length) && path_ok; i++)
+		path_ok = g_str_has_prefix(objs[i], task->target.root_path);
+
+	if (!path_ok) {
+		g_free(objs);
+
+		message = (length > 0) ? "At least one root path is invalid."
+				       : "Object path array is empty";
+
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_BAD_PATH,
+					     "%s", message);
+		goto on_error;
+	}
+
+	context = dls_device_get_context(task->target.device, client);
+	cb_data->proxy = context->cds.proxy;
+
+	cb_task_data = &cb_data->ut.browse_objects;
+	cb_task_data->avb = g_variant_builder_new(G_VARIANT_TYPE("aa{sv}"));
+	cb_task_data->objects_id = objs;
+	cb_task_data->object_count = length;
+	cb_task_data->slots = g_new(guint, length);
+	cb_task_data->unique = g_new(guint, length);
+
+	/* Each distinct path is only browsed once */
+	seen = g_hash_table_new(g_str_hash, g_str_equal);
+
+	for (i = 0; i < length; i++) {
+		if (g_hash_table_lookup_extended(seen, objs[i], NULL, &slot)) {
+			cb_task_data->slots[i] = GPOINTER_TO_UINT(slot);
+		} else {
+			cb_task_data->slots[i] = cb_task_data->unique_count;
+			cb_task_data->unique[cb_task_data->unique_count++] = i;
+			g_hash_table_insert(seen, (gpointer)objs[i],
+					    GUINT_TO_POINTER(
+							cb_task_data->slots[i]));
+		}
+	}
+
+	g_hash_table_unref(seen);
+
+	cb_task_data->results = g_new0(GVariant *, cb_task_data->unique_count);
+
+	if ((cb_task_data->unique_count < 2) ||
+	    !prv_can_search_by_id(task->target.device))
+		cb_task_data->search_index = cb_task_data->unique_count;
+
+	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
+				  (gpointer *)&cb_data->proxy);
+
+	cb_data->cancel_id = g_cancellable_connect(
+				cb_data->cancellable,
+				G_CALLBACK(prv_browse_objects_cancelled),
+				cb_data, NULL);
+
+	prv_browse_objects_next(cb_data);
+
+on_error:
+
+	if (cb_data->error != NULL)
+		dls_async_task_complete_in_idle(cb_data);
+}
+
+void dls_device_get_resource(dls_client_t *client,
+			     dls_task_t *task,
+			     const gchar *upnp_filter)
+{
+	dls_async_task_t *cb_data = (dls_async_task_t *)task;
+	dls_async_get_all_t *cb_task_data;
+	dls_device_context_t *context;
+
+	context = dls_device_get_context(task->target.device, client);
+	cb_task_data = &cb_data->ut.get_all;
+
+	cb_task_data->vb = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+	cb_task_data->prop_func = G_CALLBACK(prv_get_resource);
+	cb_task_data->device_object = FALSE;
+	cb_task_data->proxy = context->ems.proxy;
+
+	cb_data->proxy = context->cds.proxy;
+
+	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
+				  (gpointer *)&cb_data->proxy);
+
+	prv_browse_flight_join(cb_data, context->cds.proxy,
+			       prv_get_all_ms2spec_props_cb, task->target.id,
+			       "BrowseMetadata", upnp_filter, 0, 0, "");
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static gchar *prv_create_new_container_didl(const gchar *parent_id,
+					    dls_task_t *task)
+{
+	GUPnPDIDLLiteWriter *writer;
+	GUPnPDIDLLiteObject *item;
+	GUPnPDIDLLiteContainer *container;
+	GVariantIter iter;
+	GVariant *child_type;
+	gchar *actual_type;
+	GUPnPOCMFlags flags;
+	gchar *retval = NULL;
+
+	actual_type = dls_props_media_spec_ex_to_upnp_class(
+						task->ut.create_container.type);
+	if (!actual_type)
+		goto on_error;
+
+	writer = gupnp_didl_lite_writer_new(NULL);
+	item = GUPNP_DIDL_LITE_OBJECT(
+				gupnp_didl_lite_writer_add_container(writer));
+	container = GUPNP_DIDL_LITE_CONTAINER(item);
+
+	gupnp_didl_lite_object_set_id(item, "");
+	gupnp_didl_lite_object_set_title(
+					item,
+					task->ut.create_container.display_name);
+	gupnp_didl_lite_object_set_parent_id(item, parent_id);
+	gupnp_didl_lite_object_set_upnp_class(item, actual_type);
+	g_free(actual_type);
+	gupnp_didl_lite_object_set_restricted(item, FALSE);
+
+	flags = GUPNP_OCM_FLAGS_UPLOAD |
+		GUPNP_OCM_FLAGS_CREATE_CONTAINER |
+		GUPNP_OCM_FLAGS_DESTROYABLE |
+		GUPNP_OCM_FLAGS_UPLOAD_DESTROYABLE |
+		GUPNP_OCM_FLAGS_CHANGE_METADATA;
+
+	gupnp_didl_lite_object_set_dlna_managed(item, flags);
+
+	g_variant_iter_init(&iter, task->ut.create_container.child_types);
+	while ((child_type = g_variant_iter_next_value(&iter))) {
+		actual_type = dls_props_media_spec_ex_to_upnp_class(
+					g_variant_get_string(child_type, NULL));
+		if (actual_type != NULL) {
+			gupnp_didl_lite_container_add_create_class(container,
+								   actual_type);
+			g_free(actual_type);
+		}
+		g_variant_unref(child_type);
+	}
+
+	retval = gupnp_didl_lite_writer_get_string(writer);
+
+	g_object_unref(item);
+	g_object_unref(writer);
+
+on_error:
+
+	return retval;
+}
+
+static gchar *prv_get_dlna_profile_name(const gchar *filename)
+{
+	gchar *uri;
+	GError *error = NULL;
+	gchar *profile_name = NULL;
+	GUPnPDLNAProfile *profile;
+	GUPnPDLNAProfileGuesser *guesser;
+	gboolean relaxed_mode = TRUE;
+	gboolean extended_mode = TRUE;
+
+	uri = g_filename_to_uri(filename, NULL, &error);
+	if (uri == NULL) {
+		DLEYNA_LOG_WARNING("Unable to convert filename: %s", filename);
+
+		if (error) {
+			DLEYNA_LOG_WARNING("Error: %s", error->message);
+
+			g_error_free(error);
+		}
+
+		goto on_error;
+	}
+
+	guesser = g_private_get(&g_profile_guesser);
+	if (!guesser) {
+		guesser = gupnp_dlna_profile_guesser_new(relaxed_mode,
+							 extended_mode);
+		g_private_set(&g_profile_guesser, guesser);
+	}
+
+	profile = gupnp_dlna_profile_guesser_guess_profile_sync(
+						guesser,
+						uri,
+						DLS_PROFILE_GUESS_TIMEOUT,
+						NULL,
+						&error);
+	if (profile)
+		profile_name = g_strdup(gupnp_dlna_profile_get_name(profile));
+
+	if (profile == NULL) {
+		DLEYNA_LOG_WARNING("Unable to guess profile for URI: %s", uri);
+
+		if (error) {
+			DLEYNA_LOG_WARNING("Error: %s", error->message);
+
+			g_error_free(error);
 		}
-
-		if (!complete)
-			prv_get_ms2spec_prop(context, prop_map,
-					     &task->ut.get_prop,
-					     cb_data);
 	}
 
-	DLEYNA_LOG_DEBUG("Exit");
+on_error:
+
+	g_free(uri);
+
+	return profile_name;
 }
 
-static void prv_found_target(GUPnPDIDLLiteParser *parser,
-			     GUPnPDIDLLiteObject *object,
-			     gpointer user_data)
+static void prv_guess_profile_thread(gpointer data, gpointer user_data)
 {
-	dls_async_task_t *cb_data = user_data;
-	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
-	const char *object_id;
-	const char *parent_id;
-	const char *parent_path;
-	gchar *path = NULL;
-	gboolean have_child_count;
-	dls_device_object_builder_t *builder;
+	GTask *guess = data;
 
-	DLEYNA_LOG_DEBUG("Enter");
+	if (!g_task_return_error_if_cancelled(guess))
+		g_task_return_pointer(guess,
+				      prv_get_dlna_profile_name(
+						g_task_get_task_data(guess)),
+				      g_free);
 
-	builder = g_new0(dls_device_object_builder_t, 1);
+	g_object_unref(guess);
+}
 
-	object_id = gupnp_didl_lite_object_get_id(object);
-	if (!object_id)
-		goto on_error;
+static gchar *prv_profile_cache_key(const gchar *filename)
+{
+	GStatBuf buf;
 
-	parent_id = gupnp_didl_lite_object_get_parent_id(object);
-	if (!parent_id)
-		goto on_error;
+	if (g_stat(filename, &buf))
+		return NULL;
 
-	if (!strcmp(object_id, "0") || !strcmp(parent_id, "-1")) {
-		parent_path = cb_data->task.target.root_path;
-	} else {
-		path = dls_path_from_id(cb_data->task.target.root_path,
-					parent_id);
-		parent_path = path;
-	}
+	return g_strdup_printf("%"G_GUINT64_FORMAT":%"G_GUINT64_FORMAT":"
+			       "%"G_GINT64_FORMAT":%"G_GINT64_FORMAT,
+			       (guint64)buf.st_dev, (guint64)buf.st_ino,
+			       (gint64)buf.st_mtime, (gint64)buf.st_size);
+}
 
-	builder->vb = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+static const gchar *prv_profile_cache_lookup(const gchar *key)
+{
+	if (!g_profile_cache)
+		g_profile_cache = dls_string_cache_new(
+						DLS_PROFILE_CACHE_MAX_ENTRIES);
 
-	if (!dls_props_add_object(builder->vb, object,
-				  cb_data->task.target.root_path,
-				  parent_path, cb_task_data->filter_mask))
-		goto on_error;
+	return key ? dls_string_cache_lookup(g_profile_cache, key) : NULL;
+}
 
-	if (GUPNP_IS_DIDL_LITE_CONTAINER(object)) {
-		dls_props_add_container(builder->vb,
-					(GUPnPDIDLLiteContainer *)object,
-					cb_task_data->filter_mask,
-					cb_task_data->protocol_info,
-					&have_child_count);
+/* Profiling runs GStreamer discovery, which must not block the main loop,
+ * so it runs on a pool of DLS_PROFILE_GUESS_MAX_THREADS threads.  The
+ * discovery cannot be interrupted: a guess cancelled while it runs
+ * completes with the cancellation error once it ends.
+ */
+static void prv_guess_profile(const gchar *file_path,
+			      GCancellable *cancellable,
+			      GAsyncReadyCallback callback,
+			      gpointer user_data)
+{
+	GTask *guess;
+	GError *error = NULL;
 
-		if (!have_child_count && (cb_task_data->filter_mask &
-					  DLS_UPNP_MASK_PROP_CHILD_COUNT)) {
-			builder->needs_child_count = TRUE;
-			builder->id = g_strdup(
-				gupnp_didl_lite_object_get_id(object));
-			cb_task_data->need_child_count = TRUE;
-		}
-	} else {
-		dls_props_add_item(builder->vb,
-				   object,
-				   cb_data->task.target.root_path,
-				   cb_task_data->filter_mask,
-				   cb_task_data->protocol_info);
+	if (!g_profile_pool)
+		g_profile_pool = g_thread_pool_new(
+					prv_guess_profile_thread, NULL,
+					DLS_PROFILE_GUESS_MAX_THREADS,
+					FALSE, NULL);
+
+	guess = g_task_new(NULL, cancellable, callback, user_data);
+	g_task_set_task_data(guess, g_strdup(file_path), g_free);
+
+	/* Without a thread the upload goes on without a profile, as when
+	 * none matches.
+	 */
+	if (!g_thread_pool_push(g_profile_pool, guess, &error)) {
+		DLEYNA_LOG_WARNING("Unable to guess profile: %s",
+				   error->message);
+
+		g_error_free(error);
+		g_task_return_pointer(guess, NULL, NULL);
+		g_object_unref(guess);
 	}
+}
 
-	g_ptr_array_add(cb_task_data->vbs, builder);
-	g_free(path);
+static gchar *prv_create_upload_didl(const gchar *parent_id,
+				     const gchar *display_name,
+				     const gchar *object_class,
+				     const gchar *mime_type,
+				     const gchar *profile)
+{
+	GUPnPDIDLLiteWriter *writer;
+	GUPnPDIDLLiteObject *item;
+	gchar *retval;
+	GUPnPProtocolInfo *protocol_info;
+	GUPnPDIDLLiteResource *res;
 
-	DLEYNA_LOG_DEBUG("Exit with SUCCESS");
+	writer = gupnp_didl_lite_writer_new(NULL);
+	item = GUPNP_DIDL_LITE_OBJECT(gupnp_didl_lite_writer_add_item(writer));
 
-	return;
+	gupnp_didl_lite_object_set_id(item, "");
+	gupnp_didl_lite_object_set_title(item, display_name);
+	gupnp_didl_lite_object_set_parent_id(item, parent_id);
+	gupnp_didl_lite_object_set_upnp_class(item, object_class);
+	gupnp_didl_lite_object_set_restricted(item, FALSE);
 
-on_error:
+	protocol_info = gupnp_protocol_info_new();
+	gupnp_protocol_info_set_mime_type(protocol_info, mime_type);
+	gupnp_protocol_info_set_protocol(protocol_info, "*");
+	gupnp_protocol_info_set_network(protocol_info, "*");
 
-	g_free(path);
-	prv_object_builder_delete(builder);
+	if (profile != NULL && profile[0])
+		gupnp_protocol_info_set_dlna_profile(protocol_info, profile);
 
-	DLEYNA_LOG_DEBUG("Exit with FAIL");
+	res = gupnp_didl_lite_object_add_resource(item);
+	gupnp_didl_lite_resource_set_protocol_info(res, protocol_info);
+
+	retval = gupnp_didl_lite_writer_get_string(writer);
+
+	g_object_unref(res);
+	g_object_unref(protocol_info);
+	g_object_unref(item);
+	g_object_unref(writer);
+
+	return retval;
 }
 
-static void prv_search_cb(GUPnPServiceProxy *proxy,
-			  GUPnPServiceProxyAction *action,
-			  gpointer user_data)
+static void prv_extract_import_uri(GUPnPDIDLLiteParser *parser,
+				   GUPnPDIDLLiteObject *object,
+				   gpointer user_data)
+{
+	gchar **import_uri = user_data;
+	GList *resources;
+	GList *ptr;
+	GUPnPDIDLLiteResource *res;
+	const gchar *uri;
+
+	if (!*import_uri) {
+		resources = gupnp_didl_lite_object_get_resources(object);
+		ptr = resources;
+		while (ptr) {
+			res = ptr->data;
+			if (!*import_uri) {
+				uri = gupnp_didl_lite_resource_get_import_uri(
+					res);
+				if (uri)
+					*import_uri = g_strdup(uri);
+			}
+			g_object_unref(res);
+			ptr = ptr->next;
+		}
+
+		g_list_free(resources);
+	}
+}
+
+static void prv_upload_delete_cb(GUPnPServiceProxy *proxy,
+				 GUPnPServiceProxyAction *action,
+				 gpointer user_data)
 {
-	gchar *result = NULL;
-	const gchar *message;
-	gboolean end;
-	guint count = G_MAXUINT32;
-	GUPnPDIDLLiteParser *parser = NULL;
-	GError *error = NULL;
 	dls_async_task_t *cb_data = user_data;
-	dls_async_bas_t *cb_task_data = &cb_data->ut.bas;
 
 	DLEYNA_LOG_DEBUG("Enter");
 
-	end = gupnp_service_proxy_end_action(cb_data->proxy, cb_data->action,
-					     &error,
-					     "Result", G_TYPE_STRING, &result,
-					     "TotalMatches", G_TYPE_UINT,
-					     &count, NULL);
+	(void) gupnp_service_proxy_end_action(cb_data->proxy, cb_data->action,
+					      NULL, NULL);
+	dls_async_task_complete_in_idle(cb_data);
+	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
 
-	if (!end || (result == NULL) || (count == G_MAXUINT32)) {
-		message = (error != NULL) ? error->message : "Invalid result";
-		DLEYNA_LOG_WARNING("Search operation failed %s", message);
+	DLEYNA_LOG_DEBUG("Exit");
+}
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "Search operation failed: %s",
-					     message);
-		goto on_error;
+static void prv_upload_job_delete(gpointer up_job)
+{
+	dls_device_upload_job_t *upload_job = up_job;
+
+	if (up_job) {
+		if (upload_job->remove_idle)
+			(void) g_source_remove(upload_job->remove_idle);
+
+		g_free(upload_job);
 	}
+}
 
-	cb_task_data->max_count = count;
+static gboolean prv_remove_update_job(gpointer user_data)
+{
+	dls_device_upload_job_t *upload_job = user_data;
+	dls_device_upload_t *upload;
 
-	parser = gupnp_didl_lite_parser_new();
+	upload = g_hash_table_lookup(upload_job->device->uploads,
+				     &upload_job->upload_id);
+	if (upload) {
+		g_hash_table_remove(upload_job->device->uploads,
+				    &upload_job->upload_id);
 
-	cb_task_data->vbs = g_ptr_array_new_with_free_func(
-		prv_object_builder_delete);
+		DLEYNA_LOG_DEBUG("Removing Upload Object: %d",
+				 upload_job->upload_id);
+	}
 
-	g_signal_connect(parser, "object-available" ,
-			 G_CALLBACK(prv_found_target), cb_data);
+	upload_job->remove_idle = 0;
+	g_hash_table_remove(upload_job->device->upload_jobs,
+			    &upload_job->upload_id);
 
-	DLEYNA_LOG_DEBUG("Server Search result: %s", result);
+	return FALSE;
+}
 
-	if (!gupnp_didl_lite_parser_parse_didl(parser, result, &error) &&
-	    error->code != GUPNP_XML_ERROR_EMPTY_NODE) {
-		DLEYNA_LOG_WARNING("Unable to parse results of search: %s",
-				   error->message);
+static void prv_generate_upload_update(dls_device_upload_job_t *upload_job,
+				       dls_device_upload_t *upload)
+{
+	GVariant *args;
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "Unable to parse results of search: %s",
-					     error->message);
-		goto on_error;
-	}
+	args = g_variant_new("(ustt)", upload_job->upload_id, upload->status,
+			     upload->bytes_uploaded, upload->bytes_to_upload);
 
-	if (cb_task_data->need_child_count) {
-		DLEYNA_LOG_DEBUG("Need to retrieve child count");
+	DLEYNA_LOG_DEBUG(
+		"Emitting: %s (%u %s %"G_GUINT64_FORMAT" %"G_GUINT64_FORMAT")"
+		" on %s",
+		DLS_INTERFACE_UPLOAD_UPDATE, upload_job->upload_id,
+		upload->status, upload->bytes_uploaded,
+		upload->bytes_to_upload, upload_job->device->path);
 
-		if (cb_data->task.multiple_retvals)
-			cb_task_data->get_children_cb =
-				prv_get_search_ex_result;
-		else
-			cb_task_data->get_children_cb = prv_get_children_result;
-		prv_retrieve_child_count_for_list(cb_data);
-		goto no_complete;
-	} else {
-		if (cb_data->task.multiple_retvals)
-			prv_get_search_ex_result(cb_data);
-		else
-			prv_get_children_result(cb_data);
+	(void) dls_server_get_connector()->notify(
+					upload_job->device->connection,
+					upload_job->device->path,
+					DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE,
+					DLS_INTERFACE_UPLOAD_UPDATE,
+					args,
+					NULL);
+}
+
+/* Releases the transfer resources of a finished upload and keeps its
+ * status around for 30 seconds.
+ */
+static void prv_upload_finished(dls_device_upload_job_t *upload_job,
+				dls_device_upload_t *upload)
+{
+	gint *upload_id;
+
+	upload_job->remove_idle =
+		g_timeout_add(30000, prv_remove_update_job, upload_job);
+
+	DLEYNA_LOG_DEBUG("Upload Status: %s", upload->status);
+
+	prv_generate_upload_update(upload_job, upload);
+
+	if (upload->resume_id) {
+		(void) g_source_remove(upload->resume_id);
+		upload->resume_id = 0;
 	}
 
-on_error:
+	if (upload->retry_id) {
+		(void) g_source_remove(upload->retry_id);
+		upload->retry_id = 0;
+	}
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
-	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+	g_object_unref(upload->msg);
+	upload->msg = NULL;
 
-no_complete:
+	g_object_unref(upload->soup_session);
+	upload->soup_session = NULL;
 
-	if (parser)
-		g_object_unref(parser);
+	if (upload->mapped_file) {
+		g_mapped_file_unref(upload->mapped_file);
+		upload->mapped_file = NULL;
+	}
 
-	g_free(result);
+	g_free(upload->body);
+	upload->body = NULL;
+	upload->data = NULL;
 
-	if (error)
-		g_error_free(error);
+	if (upload->fd >= 0) {
+		(void) close(upload->fd);
+		upload->fd = -1;
+	}
 
-	DLEYNA_LOG_DEBUG("Exit");
+	g_free(upload->mime_type);
+	upload->mime_type = NULL;
+
+	upload_id = g_new(gint, 1);
+	*upload_id = upload_job->upload_id;
+
+	g_hash_table_insert(upload_job->device->upload_jobs, upload_id,
+			    upload_job);
 }
 
-void dls_device_search(dls_client_t *client,
-		       dls_task_t *task,
-		       const gchar *upnp_filter, const gchar *upnp_query,
-		       const gchar *sort_by)
+static void prv_post_finished(SoupSession *session, SoupMessage *msg,
+			      gpointer user_data);
+static void prv_upload_prepare_post(dls_device_upload_t *upload,
+				    SoupMessage *msg, guint64 offset);
+
+static dls_device_upload_t *prv_upload_queue_pop(GQueue *queue)
 {
-	dls_async_task_t *cb_data = (dls_async_task_t *)task;
-	dls_device_context_t *context;
+	GList *best = queue->head;
+	GList *link;
+	dls_device_upload_t *upload;
 
-	DLEYNA_LOG_DEBUG("Enter");
+	if (g_upload_smallest_first)
+		for (link = best->next; link; link = link->next) {
+			upload = link->data;
+			if (upload->bytes_to_upload <
+			    ((dls_device_upload_t *)best->data)->bytes_to_upload)
+				best = link;
+		}
 
-	context = dls_device_get_context(task->target.device, client);
+	upload = best->data;
+	g_queue_delete_link(queue, best);
 
-	cb_data->proxy = context->cds.proxy;
+	return upload;
+}
 
-	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
-				  (gpointer *)&cb_data->proxy);
+/* Starts queued uploads until the device runs g_max_concurrent_uploads
+ * of them.
+ */
+static void prv_upload_schedule(dls_device_t *device)
+{
+	dls_device_upload_t *upload;
 
-	cb_data->action = gupnp_service_proxy_begin_action(
-			cb_data->proxy, "Search",
-			prv_search_cb,
-			cb_data,
-			"ContainerID", G_TYPE_STRING, task->target.id,
-			"SearchCriteria", G_TYPE_STRING, upnp_query,
-			"Filter", G_TYPE_STRING, upnp_filter,
-			"StartingIndex", G_TYPE_INT, task->ut.search.start,
-			"RequestedCount", G_TYPE_INT, task->ut.search.count,
-			"SortCriteria", G_TYPE_STRING, sort_by,
-			NULL);
+	while ((device->uploads_in_flight < g_max_concurrent_uploads) &&
+	       !g_queue_is_empty(&device->upload_queue)) {
+		upload = prv_upload_queue_pop(&device->upload_queue);
+		upload->status = DLS_UPLOAD_STATUS_IN_PROGRESS;
+		device->uploads_in_flight++;
 
-	cb_data->cancel_id = g_cancellable_connect(
-					cb_data->cancellable,
-					G_CALLBACK(dls_async_task_cancelled_cb),
-					cb_data, NULL);
+		DLEYNA_LOG_DEBUG("Starting Upload %d", upload->job->upload_id);
 
-	DLEYNA_LOG_DEBUG("Exit");
+		soup_session_queue_message(upload->soup_session, upload->msg,
+					   prv_post_finished, upload->job);
+		g_object_ref(upload->msg);
+
+		prv_generate_upload_update(upload->job, upload);
+	}
 }
 
-static void prv_get_resource(GUPnPDIDLLiteParser *parser,
-			     GUPnPDIDLLiteObject *object,
-			     gpointer user_data)
+static gboolean prv_upload_is_transient(guint status)
 {
-	dls_async_task_t *cb_data = user_data;
-	dls_task_t *task = &cb_data->task;
-	dls_task_get_resource_t *task_data = &task->ut.resource;
-	dls_async_get_all_t *cb_task_data = &cb_data->ut.get_all;
-
-	DLEYNA_LOG_DEBUG("Enter");
-
-	dls_props_add_resource(cb_task_data->vb, object,
-			       cb_task_data->filter_mask,
-			       task_data->protocol_info);
+	switch (status) {
+	case SOUP_STATUS_CANT_RESOLVE:
+	case SOUP_STATUS_CANT_CONNECT:
+	case SOUP_STATUS_IO_ERROR:
+	case SOUP_STATUS_REQUEST_TIMEOUT:
+	case SOUP_STATUS_BAD_GATEWAY:
+	case SOUP_STATUS_SERVICE_UNAVAILABLE:
+	case SOUP_STATUS_GATEWAY_TIMEOUT:
+		return TRUE;
+	default:
+		return FALSE;
+	}
 }
 
-static void prv_browse_objects_add_error_result(dls_async_browse_objects_t *bo,
-						const gchar *path,
-						GError *error)
+/* Sends a new request for the upload, which keeps its slot meanwhile.
+ * A POST carries the part of the file that starts at offset.
+ */
+static void prv_upload_send(dls_device_upload_t *upload, const char *method,
+			    guint64 offset)
 {
-	GVariantBuilder evb;
-	GVariant *gv_result;
+	SoupMessage *msg;
 
-	DLEYNA_LOG_WARNING("%s: %s", path, error->message);
+	msg = soup_message_new_from_uri(method,
+					soup_message_get_uri(upload->msg));
+	if (!strcmp(method, SOUP_METHOD_POST))
+		prv_upload_prepare_post(upload, msg, offset);
+	g_object_unref(upload->msg);
+	upload->msg = msg;
+	upload->probing = FALSE;
+	upload->verifying = FALSE;
 
-	g_variant_builder_init(&evb, G_VARIANT_TYPE("a{sv}"));
+	soup_session_queue_message(upload->soup_session, msg,
+				   prv_post_finished, upload->job);
+	g_object_ref(msg);
+}
 
-	if (bo->get_all.filter_mask & DLS_UPNP_MASK_PROP_PATH)
-		g_variant_builder_add(
-			&evb, "{sv}", DLS_INTERFACE_PROP_PATH,
-			g_variant_new_object_path(path));
+/* Asks the server, with a HEAD request on the import URI, how much of the
+ * file it already holds.  Servers already known not to resume uploads get
+ * the whole file again straight away.
+ */
+static gboolean prv_upload_probe(gpointer user_data)
+{
+	dls_device_upload_t *upload = user_data;
 
-	gv_result = dls_props_get_error_prop(error);
+	upload->retry_id = 0;
 
-	g_variant_builder_add(&evb, "{sv}",
-			      DLS_INTERFACE_PROP_ERROR, gv_result);
+	if (upload->resume_unsupported) {
+		DLEYNA_LOG_DEBUG("Restarting Upload %d",
+				 upload->job->upload_id);
+
+		prv_upload_send(upload, SOUP_METHOD_POST, 0);
+	} else {
+		DLEYNA_LOG_DEBUG("Probing Upload %d", upload->job->upload_id);
 
-	gv_result = g_variant_builder_end(&evb);
+		prv_upload_send(upload, SOUP_METHOD_HEAD, 0);
+		upload->probing = TRUE;
+	}
 
-	g_variant_builder_add(bo->avb, "@a{sv}", gv_result);
+	return FALSE;
 }
 
-static void prv_get_child_count_end_action_cb(GUPnPServiceProxy *proxy,
-					      GUPnPServiceProxyAction *action,
-					      gpointer user_data)
+/* Schedules a new attempt of an upload that failed with status, after a
+ * delay that doubles with every retry.
+ */
+static gboolean prv_upload_retry(dls_device_upload_t *upload, guint status)
 {
-	GError *error = NULL;
-	const gchar *message;
-	guint count = G_MAXUINT32;
-	gboolean end;
-	dls_async_browse_objects_t *cb_task_data;
-	dls_async_task_t *cb_data = user_data;
+	guint delay;
 
-	DLEYNA_LOG_DEBUG("Enter");
-
-	end = gupnp_service_proxy_end_action(proxy, action, &error,
-					     "TotalMatches", G_TYPE_UINT,
-					     &count, NULL);
+	if (upload->retries >= g_upload_max_retries || upload->read_error ||
+	    !prv_upload_is_transient(status))
+		return FALSE;
 
-	cb_task_data = &((dls_async_task_t *)user_data)->ut.browse_objects;
+	if (upload->resume_id) {
+		(void) g_source_remove(upload->resume_id);
+		upload->resume_id = 0;
+	}
 
-	if (!end || (count == G_MAXUINT32)) {
-		message = (error != NULL) ? error->message : "Invalid result";
-		DLEYNA_LOG_WARNING("Browse operation failed: %s", message);
+	delay = DLS_UPLOAD_RETRY_MAX_DELAY;
+	if (upload->retries < 16)
+		delay = MIN(delay, DLS_UPLOAD_RETRY_DELAY << upload->retries);
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "Browse operation failed: %s",
-					     message);
-		goto on_complete;
-	}
+	upload->retries++;
 
-	g_variant_builder_add(cb_task_data->get_all.vb, "{sv}",
-			      DLS_INTERFACE_PROP_CHILD_COUNT,
-			      g_variant_new_uint32(count));
+	DLEYNA_LOG_WARNING("Upload %d failed with %u, retry %u in %u ms",
+			   upload->job->upload_id, status, upload->retries,
+			   delay);
 
-	g_variant_builder_add(cb_task_data->avb, "@a{sv}",
-			      g_variant_builder_end(cb_task_data->get_all.vb));
+	upload->retry_id = g_timeout_add(delay, prv_upload_probe, upload);
 
-	DLEYNA_LOG_DEBUG("Child Count: %u", count);
+	return TRUE;
+}
 
-on_complete:
+/* Neither UPnP nor DLNA define how to resume a POST, so the length
+ * reported in response to the probe is only taken as the number of bytes
+ * the server holds when the server also advertises byte ranges.  Other
+ * servers get the whole file again.
+ */
+static guint64 prv_upload_resume_offset(dls_device_upload_t *upload)
+{
+	SoupMessageHeaders *headers = upload->msg->response_headers;
+	guint64 offset = 0;
 
-	if (cb_data->error != NULL) {
-		message = cb_task_data->objects_id[cb_task_data->index - 1];
-		prv_browse_objects_add_error_result(cb_task_data, message,
-						    cb_data->error);
-		g_error_free(cb_data->error);
-		cb_data->error = NULL;
+	if (!SOUP_STATUS_IS_SUCCESSFUL(upload->msg->status_code) ||
+	    !soup_message_headers_header_contains(headers, "Accept-Ranges",
+						  "bytes") ||
+	    (soup_message_headers_get_encoding(headers) !=
+						SOUP_ENCODING_CONTENT_LENGTH)) {
+		upload->resume_unsupported = TRUE;
+		goto on_exit;
 	}
 
-	if (cb_task_data->get_all.vb != NULL) {
-		g_variant_builder_unref(cb_task_data->get_all.vb);
-		cb_task_data->get_all.vb = NULL;
-	}
+	offset = soup_message_headers_get_content_length(headers);
+	if (offset >= upload->bytes_to_upload)
+		offset = 0;
 
-	if (cb_task_data->index < cb_task_data->object_count)
-		dleyna_service_task_add(cb_task_data->queue_id,
-					prv_browse_objects_begin_action_cb,
-					proxy,
-					prv_browse_objects_end_action_cb,
-					NULL, user_data);
+on_exit:
 
-	if (error)
-		g_error_free(error);
+	return offset;
+}
 
-	DLEYNA_LOG_DEBUG("Exit");
+/* A resumed upload only completes once a HEAD request shows that the
+ * server holds the whole file, as a server that ignored the Content-Range
+ * header of the POST keeps only the end of the file.
+ */
+static gboolean prv_upload_verified(dls_device_upload_t *upload)
+{
+	SoupMessageHeaders *headers = upload->msg->response_headers;
+
+	return SOUP_STATUS_IS_SUCCESSFUL(upload->msg->status_code) &&
+		(soup_message_headers_get_encoding(headers) ==
+						SOUP_ENCODING_CONTENT_LENGTH) &&
+		(soup_message_headers_get_content_length(headers) ==
+						upload->bytes_to_upload);
 }
 
-static GUPnPServiceProxyAction *prv_get_child_count_begin_action_cb(
-						dleyna_service_task_t *task,
-						GUPnPServiceProxy *proxy,
-						gboolean *failed)
+static void prv_post_finished(SoupSession *session, SoupMessage *msg,
+			      gpointer user_data)
 {
-	GUPnPServiceProxyAction *action;
-	dls_task_t *user_data;
-	const gchar *path;
-	gchar *root_path = NULL;
-	gchar *id = NULL;
-	dls_async_browse_objects_t *cb_task_data;
-	GError *error = NULL;
+	dls_device_upload_job_t *upload_job = user_data;
+	dls_device_upload_t *upload;
+	dls_device_t *device;
+	guint64 offset;
 
 	DLEYNA_LOG_DEBUG("Enter");
 
-	user_data = (dls_task_t *)dleyna_service_task_get_user_data(task);
-	cb_task_data = &((dls_async_task_t *)user_data)->ut.browse_objects;
-	path = cb_task_data->objects_id[cb_task_data->index - 1];
+	DLEYNA_LOG_DEBUG("Upload %u finished.  Code %u Message %s",
+			 upload_job->upload_id, msg->status_code,
+			 msg->reason_phrase);
 
-	/* Should never fail. Error already managed in previous browse */
-	(void) dls_path_get_path_and_id(path, &root_path, &id, &error);
+	/* This is clumsy but we need to distinguish between two cases:
+	   1. We cancel because the process is exitting.
+	   2. We cancel because a client has called CancelUpload.
 
-	if (error != NULL)
-		goto exit;
+	   We could use custom SOUP error messages to distinguish the cases
+	   but device->shutting_down seemed less hacky.
 
-	action =  gupnp_service_proxy_begin_action(
-			proxy, "Browse",
-			dleyna_service_task_begin_action_cb, task,
-			"ObjectID", G_TYPE_STRING, id,
-			"BrowseFlag", G_TYPE_STRING, "BrowseDirectChildren",
-			"Filter", G_TYPE_STRING, "",
-			"StartingIndex", G_TYPE_INT, 0,
-			"RequestedCount", G_TYPE_INT, 1,
-			"SortCriteria", G_TYPE_STRING, "",
-			NULL);
+	   We need this check as if we are shutting down it is
+	   dangerous to manipulate uploads as we are being called from its
+	   destructor.
+	*/
 
-	g_free(root_path);
-	g_free(id);
+	if (upload_job->device->shutting_down) {
+		DLEYNA_LOG_DEBUG("Device shutting down. Cancelling Upload");
+		goto on_error;
+	}
 
-exit:
-	*failed = FALSE;
+	device = upload_job->device;
 
-	if (error != NULL) {
-		DLEYNA_LOG_WARNING("%s: %s", path, error->message);
-		action = NULL;
+	upload = g_hash_table_lookup(device->uploads, &upload_job->upload_id);
+	if (upload) {
+		if (upload->probing &&
+		    !SOUP_STATUS_IS_TRANSPORT_ERROR(msg->status_code)) {
+			offset = prv_upload_resume_offset(upload);
 
-		prv_browse_objects_add_error_result(cb_task_data, path, error);
+			DLEYNA_LOG_DEBUG("Resuming Upload %d at %"
+					 G_GUINT64_FORMAT,
+					 upload_job->upload_id, offset);
 
-		if (cb_task_data->get_all.vb != NULL) {
-			g_variant_builder_unref(cb_task_data->get_all.vb);
-			cb_task_data->get_all.vb = NULL;
+			prv_upload_send(upload, SOUP_METHOD_POST, offset);
+			goto on_exit;
 		}
 
-		if (cb_task_data->index < cb_task_data->object_count)
-			dleyna_service_task_add(
-					cb_task_data->queue_id,
-					prv_browse_objects_begin_action_cb,
-					proxy,
-					prv_browse_objects_end_action_cb,
-					NULL, user_data);
-		g_error_free(error);
-	}
+		if (upload->verifying &&
+		    !SOUP_STATUS_IS_TRANSPORT_ERROR(msg->status_code) &&
+		    !prv_upload_verified(upload)) {
+			DLEYNA_LOG_WARNING("Upload %d not resumed by server",
+					   upload_job->upload_id);
 
-	return action;
-}
+			upload->resume_unsupported = TRUE;
+			prv_upload_send(upload, SOUP_METHOD_POST, 0);
+			goto on_exit;
+		}
 
-static void prv_browse_objects_end_action_cb(GUPnPServiceProxy *proxy,
-					     GUPnPServiceProxyAction *action,
-					     gpointer user_data)
-{
-	GError *error = NULL;
-	dls_async_task_t *cb_data = user_data;
-	dls_async_browse_objects_t *cb_task_data = &cb_data->ut.browse_objects;
-	dls_async_get_all_t *cb_all_data = &cb_data->ut.browse_objects.get_all;
-	GUPnPDIDLLiteParser *parser = NULL;
-	gchar *result = NULL;
-	const gchar *message;
-	gboolean end;
+		if (!upload->verifying && upload->start_offset &&
+		    SOUP_STATUS_IS_SUCCESSFUL(msg->status_code)) {
+			prv_upload_send(upload, SOUP_METHOD_HEAD, 0);
+			upload->verifying = TRUE;
+			goto on_exit;
+		}
 
-	DLEYNA_LOG_DEBUG("Enter");
+		if (prv_upload_retry(upload, msg->status_code))
+			goto on_exit;
+	}
 
-	end = gupnp_service_proxy_end_action(proxy, action, &error,
-					     "Result", G_TYPE_STRING, &result,
-					     NULL);
+	device->uploads_in_flight--;
 
-	if (!end || (result == NULL)) {
-		message = (error != NULL) ? error->message : "Invalid result";
-		DLEYNA_LOG_WARNING("Browse Object operation failed: %s",
-				   message);
+	if (upload) {
+		if (SOUP_STATUS_IS_SUCCESSFUL(msg->status_code)) {
+			upload->status = DLS_UPLOAD_STATUS_COMPLETED;
+			upload->bytes_uploaded = upload->bytes_to_upload;
+		} else if (msg->status_code == SOUP_STATUS_CANCELLED) {
+			upload->status = DLS_UPLOAD_STATUS_CANCELLED;
+		} else {
+			upload->status = DLS_UPLOAD_STATUS_ERROR;
+		}
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "Browse operation failed: %s",
-					     message);
-		goto on_exit;
+		prv_upload_finished(upload_job, upload);
+		upload_job = NULL;
 	}
 
-	DLEYNA_LOG_DEBUG_NL();
-	DLEYNA_LOG_DEBUG("Result: %s", result);
-	DLEYNA_LOG_DEBUG_NL();
+	prv_upload_schedule(device);
 
-	cb_all_data->vb = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+on_error:
 
-	parser = gupnp_didl_lite_parser_new();
+	prv_upload_job_delete(upload_job);
 
-	g_signal_connect(parser, "object-available",
-			 G_CALLBACK(prv_get_all),
-			 cb_data);
+on_exit:
 
-	if (!gupnp_didl_lite_parser_parse_didl(parser, result, &error)) {
-		if (error->code == GUPNP_XML_ERROR_EMPTY_NODE) {
-			DLEYNA_LOG_WARNING("Property not defined for object");
+	DLEYNA_LOG_DEBUG("Exit");
+}
 
-			cb_data->error = g_error_new(
-						DLEYNA_SERVER_ERROR,
-						DLEYNA_ERROR_UNKNOWN_PROPERTY,
-						"Property not defined for object");
-		} else {
-			DLEYNA_LOG_WARNING(
-					"Unable to parse results of browse: %s",
-					error->message);
+static void prv_upload_delete(gpointer up)
+{
+	dls_device_upload_t *upload = up;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	if (upload) {
+		if (upload->resume_id)
+			(void) g_source_remove(upload->resume_id);
+
+		/* Queued uploads and uploads waiting for a retry own their
+		 * job, as no message of theirs is in the session.
+		 */
+		if (upload->retry_id) {
+			(void) g_source_remove(upload->retry_id);
+			upload->job->device->uploads_in_flight--;
+			prv_upload_job_delete(upload->job);
+			g_object_unref(upload->msg);
+		} else if (upload->msg &&
+			   !strcmp(upload->status, DLS_UPLOAD_STATUS_QUEUED)) {
+			prv_upload_job_delete(upload->job);
+			g_object_unref(upload->msg);
+		} else if (upload->msg) {
+			soup_session_cancel_message(upload->soup_session,
+						    upload->msg,
+						    SOUP_STATUS_CANCELLED);
+			g_object_unref(upload->msg);
+		}
+
+		if (upload->soup_session)
+			g_object_unref(upload->soup_session);
+
+		if (upload->mapped_file)
+			g_mapped_file_unref(upload->mapped_file);
+		else if (upload->body)
+			g_free(upload->body);
 
-			cb_data->error = g_error_new(
-						DLEYNA_SERVER_ERROR,
-						DLEYNA_ERROR_OPERATION_FAILED,
-						"Unable to parse results of browse: %s",
-						error->message);
-		}
+		if (upload->fd >= 0)
+			(void) close(upload->fd);
 
-		goto on_exit;
+		g_free(upload->mime_type);
+		g_free(upload);
 	}
 
-	if (cb_all_data->need_child_count &&
-	    (cb_all_data->filter_mask & DLS_UPNP_MASK_PROP_CHILD_COUNT)) {
-		DLEYNA_LOG_DEBUG("Need Child Count");
-		dleyna_service_task_add(cb_task_data->queue_id,
-					prv_get_child_count_begin_action_cb,
-					cb_data->proxy,
-					prv_get_child_count_end_action_cb,
-					NULL, cb_data);
-		goto no_complete;
-	}
+	DLEYNA_LOG_DEBUG("Exit");
+}
 
-	g_variant_builder_add(cb_task_data->avb, "@a{sv}",
-			      g_variant_builder_end(cb_all_data->vb));
+static gboolean prv_upload_resume(gpointer user_data);
 
-on_exit:
+static gboolean prv_upload_write_chunk(dls_device_upload_t *upload)
+{
+	gsize length;
+	guint delay;
+	gchar *chunk;
+	ssize_t read_length;
 
-	if (cb_data->error != NULL) {
-		message = cb_task_data->objects_id[cb_task_data->index - 1];
-		prv_browse_objects_add_error_result(cb_task_data, message,
-						    cb_data->error);
-		g_error_free(cb_data->error);
-		cb_data->error = NULL;
-	}
+	length = upload->bytes_to_upload - upload->offset;
+	if (!length)
+		return FALSE;
+
+	if (g_upload_rate_limit)
+		length = MIN(length, MIN(DLS_UPLOAD_CHUNK_SIZE,
+					 g_upload_rate_limit));
+	else
+		length = MIN(length, DLS_UPLOAD_CHUNK_SIZE);
 
-	if (cb_all_data->vb != NULL) {
-		g_variant_builder_unref(cb_all_data->vb);
-		cb_all_data->vb = NULL;
+	delay = dls_rate_limit_reserve(&upload->job->device->upload_budget,
+				       g_upload_rate_limit, length,
+				       g_get_monotonic_time());
+	if (delay) {
+		upload->resume_id = g_timeout_add(delay, prv_upload_resume,
+						  upload);
+		return FALSE;
 	}
 
-	if (cb_task_data->index < cb_task_data->object_count)
-		dleyna_service_task_add(cb_task_data->queue_id,
-					prv_browse_objects_begin_action_cb,
-					cb_data->proxy,
-					prv_browse_objects_end_action_cb,
-					NULL, cb_data);
-no_complete:
+	if (upload->fd < 0) {
+		soup_message_body_append(upload->msg->request_body,
+					 SOUP_MEMORY_STATIC,
+					 upload->data + upload->offset, length);
+		upload->offset += length;
 
-	if (parser)
-		g_object_unref(parser);
+		return TRUE;
+	}
 
-	if (error)
-		g_error_free(error);
+	/* Chunks read from the descriptor are freed once written, so memory
+	 * use does not grow with the size of the file.
+	 */
+	chunk = g_malloc(length);
+	read_length = pread(upload->fd, chunk, length, upload->offset);
+	if (read_length <= 0) {
+		DLEYNA_LOG_WARNING("Unable to read upload %d data",
+				   upload->job->upload_id);
 
-	g_free(result);
+		g_free(chunk);
+		upload->read_error = TRUE;
+		soup_session_cancel_message(upload->soup_session, upload->msg,
+					    SOUP_STATUS_IO_ERROR);
+		return FALSE;
+	}
 
-	DLEYNA_LOG_DEBUG("Exit");
+	soup_message_body_append(upload->msg->request_body, SOUP_MEMORY_TAKE,
+				 chunk, read_length);
+	upload->offset += read_length;
+
+	return TRUE;
 }
 
-static GUPnPServiceProxyAction *prv_browse_objects_begin_action_cb(
-						dleyna_service_task_t *task,
-						GUPnPServiceProxy *proxy,
-						gboolean *failed)
+static gboolean prv_upload_resume(gpointer user_data)
 {
-	GUPnPServiceProxyAction *action;
-	dls_task_t *user_data;
-	dls_async_browse_objects_t *cb_task_data;
-	const gchar *path;
-	gchar *root_path = NULL;
-	gchar *id = NULL;
-	GError *error = NULL;
+	dls_device_upload_t *upload = user_data;
 
-	DLEYNA_LOG_DEBUG("Enter called");
+	upload->resume_id = 0;
 
-	user_data = (dls_task_t *)dleyna_service_task_get_user_data(task);
-	cb_task_data = &((dls_async_task_t *)user_data)->ut.browse_objects;
-	path = cb_task_data->objects_id[cb_task_data->index];
+	if (prv_upload_write_chunk(upload))
+		soup_session_unpause_message(upload->soup_session,
+					     upload->msg);
 
-	/* Reset dynamic field. */
-	cb_task_data->get_all.need_child_count = FALSE;
+	return FALSE;
+}
 
-	/* Process anyway. We will add an entry with error */
-	(void) dls_path_get_path_and_id(path, &root_path, &id, &error);
+/* Connected to wrote-headers and wrote-chunk.  When no chunk is
+ * appended the session pauses the message until prv_upload_resume
+ * appends one.
+ */
+static void prv_post_write_next(SoupMessage *msg, gpointer user_data)
+{
+	dls_device_upload_t *upload = user_data;
 
-	if (error != NULL)
-		goto exit;
+	if (!upload->resume_id)
+		(void) prv_upload_write_chunk(upload);
+}
 
-	DLEYNA_LOG_DEBUG("Browse Metadata for path [id]: %s [%s]", path, id);
+static void prv_post_restarted(SoupMessage *msg, gpointer user_data)
+{
+	dls_device_upload_t *upload = user_data;
 
-	action = gupnp_service_proxy_begin_action(
-			proxy, "Browse",
-			dleyna_service_task_begin_action_cb, task,
-			"ObjectID", G_TYPE_STRING, id,
-			"BrowseFlag", G_TYPE_STRING, "BrowseMetadata",
-			"Filter", G_TYPE_STRING, cb_task_data->upnp_filter,
-			"StartingIndex", G_TYPE_INT, 0,
-			"RequestedCount", G_TYPE_INT, 0,
-			"SortCriteria", G_TYPE_STRING, "", NULL);
+	if (upload->resume_id) {
+		(void) g_source_remove(upload->resume_id);
+		upload->resume_id = 0;
+	}
 
-	g_free(root_path);
-	g_free(id);
+	soup_message_body_truncate(msg->request_body);
+	upload->offset = upload->start_offset;
+	upload->bytes_uploaded = upload->start_offset;
+	upload->bytes_reported = MIN(upload->bytes_reported,
+				     upload->start_offset);
+}
 
-exit:
-	*failed = FALSE;
+/* Reports, in a single UploadProgress signal, every upload of the device
+ * that moved by at least g_upload_progress_step bytes since it was last
+ * reported.
+ */
+static gboolean prv_upload_progress_cb(gpointer user_data)
+{
+	dls_device_t *device = user_data;
+	dls_device_upload_t *upload;
+	GVariantBuilder vb;
+	GHashTableIter iter;
+	gpointer value;
+	guint64 step = MAX(g_upload_progress_step, 1);
+	guint count = 0;
 
-	/* It's the ONLY place where index is incremented */
-	cb_task_data->index++;
+	device->upload_progress_id = 0;
 
-	if (error != NULL) {
-		DLEYNA_LOG_WARNING("%s: %s", path, error->message);
+	g_variant_builder_init(&vb, G_VARIANT_TYPE("a(ustt)"));
 
-		prv_browse_objects_add_error_result(cb_task_data, path, error);
-		action = NULL;
-		g_error_free(error);
+	g_hash_table_iter_init(&iter, device->uploads);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		upload = value;
 
-		if (cb_task_data->index < cb_task_data->object_count)
-			dleyna_service_task_add(
-					cb_task_data->queue_id,
-					prv_browse_objects_begin_action_cb,
-					proxy,
-					prv_browse_objects_end_action_cb,
-					NULL, user_data);
+		if (!upload->msg ||
+		    upload->bytes_uploaded < upload->bytes_reported + step)
+			continue;
+
+		g_variant_builder_add(&vb, "(ustt)", upload->job->upload_id,
+				      upload->status, upload->bytes_uploaded,
+				      upload->bytes_to_upload);
+		upload->bytes_reported = upload->bytes_uploaded;
+		count++;
 	}
 
-	return action;
-}
+	if (!count) {
+		g_variant_builder_clear(&vb);
+		goto on_exit;
+	}
 
-static void prv_browse_objects_chain_cancelled(GCancellable *cancellable,
-					       gpointer user_data)
-{
-	dls_async_task_t *cb_data = user_data;
+	DLEYNA_LOG_DEBUG("Emitting: %s (%u uploads) on %s",
+			 DLS_INTERFACE_UPLOAD_PROGRESS, count, device->path);
 
-	DLEYNA_LOG_DEBUG("Enter");
+	(void) dls_server_get_connector()->notify(
+					device->connection,
+					device->path,
+					DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE,
+					DLS_INTERFACE_UPLOAD_PROGRESS,
+					g_variant_new("(@a(ustt))",
+						      g_variant_builder_end(&vb)),
+					NULL);
 
-	dleyna_task_processor_cancel_queue(cb_data->ut.browse_objects.queue_id);
-	dls_async_task_cancelled_cb(cancellable, user_data);
+on_exit:
 
-	DLEYNA_LOG_DEBUG("Exit");
+	return FALSE;
 }
 
-static void prv_browse_objects_chain_end(gboolean cancelled, gpointer data)
+static void prv_post_bytes_written(SoupMessage *msg, SoupBuffer *chunk,
+				   gpointer user_data)
 {
-	dls_task_t *task = (dls_task_t *)data;
-	dls_async_task_t *cb_data = (dls_async_task_t *)task;
-	dls_async_browse_objects_t *cb_task_data = &cb_data->ut.browse_objects;
+	dls_device_upload_t *upload = user_data;
+	dls_device_t *device = upload->job->device;
 
-	DLEYNA_LOG_DEBUG("Enter");
+	upload->bytes_uploaded += chunk->length;
+	if (upload->bytes_uploaded > upload->bytes_to_upload)
+		upload->bytes_uploaded = upload->bytes_to_upload;
 
-	if (!cancelled)
-		cb_data->task.result = g_variant_ref_sink(
-						g_variant_builder_end(
-							cb_task_data->avb));
-	else if (cb_data->error == NULL)
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_CANCELLED,
-					     "Operation cancelled.");
+	if (g_upload_progress_interval && !device->upload_progress_id)
+		device->upload_progress_id = g_timeout_add(
+						g_upload_progress_interval,
+						prv_upload_progress_cb,
+						device);
+}
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
-	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+/* Sets msg up to POST the upload from offset onwards.  A POST that does
+ * not start at the beginning of the file carries a Content-Range header.
+ */
+static void prv_upload_prepare_post(dls_device_upload_t *upload,
+				    SoupMessage *msg, guint64 offset)
+{
+	soup_message_headers_set_expectations(msg->request_headers,
+					      SOUP_EXPECTATION_CONTINUE);
+	soup_message_headers_set_content_type(msg->request_headers,
+					      upload->mime_type, NULL);
+	soup_message_headers_set_content_length(
+					msg->request_headers,
+					upload->bytes_to_upload - offset);
+	if (offset)
+		soup_message_headers_set_content_range(
+					msg->request_headers, offset,
+					upload->bytes_to_upload - 1,
+					upload->bytes_to_upload);
+	soup_message_body_set_accumulate(msg->request_body, FALSE);
+
+	g_signal_connect(msg, "wrote-headers",
+			 G_CALLBACK(prv_post_write_next), upload);
+	g_signal_connect(msg, "wrote-chunk",
+			 G_CALLBACK(prv_post_write_next), upload);
+	g_signal_connect(msg, "restarted",
+			 G_CALLBACK(prv_post_restarted), upload);
+	g_signal_connect(msg, "wrote-body-data",
+			 G_CALLBACK(prv_post_bytes_written), upload);
 
-	DLEYNA_LOG_DEBUG("Exit");
+	upload->start_offset = offset;
+	upload->offset = offset;
+	upload->bytes_uploaded = offset;
+	upload->bytes_reported = MIN(upload->bytes_reported, offset);
 }
 
-void dls_device_browse_objects(dls_client_t *client, dls_task_t *task)
+static dls_device_upload_t *prv_upload_data_new(SoupSession *session,
+						const gchar *file_path,
+						gint fd,
+						gchar *body,
+						gsize body_length,
+						const gchar *import_uri,
+						const gchar *mime_type,
+						GError **error)
 {
-	const dleyna_task_queue_key_t *queue_id;
-	dls_async_task_t *cb_data = (dls_async_task_t *)task;
-	dls_async_browse_objects_t *cb_task_data;
-	dls_device_context_t *context;
-	const gchar **objs;
-	gsize length;
-	guint i;
-	gboolean path_ok;
-	const char *message;
-
-	DLEYNA_LOG_DEBUG("Root Path %s", task->target.root_path)
+	dls_device_upload_t *upload = NULL;
+	GMappedFile *mapped_file = NULL;
+	gchar *up_body = body;
+	gsize up_body_length = body_length;
+	gint up_fd = -1;
+	struct stat buf;
 
-	objs = g_variant_get_objv(task->ut.browse_objects.objects, &length);
+	DLEYNA_LOG_DEBUG("Enter");
 
-	path_ok = (length > 0);
+	if (fd >= 0) {
+		up_fd = dup(fd);
+		if (up_fd < 0 || fstat(up_fd, &buf)) {
+			DLEYNA_LOG_WARNING("Unable to read uploaded file");
 
-	for (i = 0; (i < length) && path_ok; i++)
-		path_ok = g_str_has_prefix(objs[i], task->target.root_path);
+			*error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_IO,
+					     "Unable to read uploaded file");
+			if (up_fd >= 0)
+				(void) close(up_fd);
+			goto on_error;
+		}
 
-	if (!path_ok) {
-		g_free(objs);
+		up_body = NULL;
+		up_body_length = buf.st_size;
+	} else if (file_path) {
+		mapped_file = g_mapped_file_new(file_path, FALSE, NULL);
+		if (!mapped_file) {
+			DLEYNA_LOG_WARNING("Unable to map %s into memory",
+					   file_path);
 
-		message = (length > 0) ? "At least one root path is invalid."
-				       : "Object path array is empty";
+			*error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_IO,
+					     "Unable to map %s into memory",
+					     file_path);
+			goto on_error;
+		}
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_BAD_PATH,
-					     "%s", message);
-		goto on_error;
+		up_body = g_mapped_file_get_contents(mapped_file);
+		up_body_length = g_mapped_file_get_length(mapped_file);
 	}
 
-	queue_id = dleyna_task_processor_add_queue(
-			dls_server_get_task_processor(),
-			dleyna_service_task_create_source(),
-			DLS_SERVER_SINK,
-			DLEYNA_TASK_QUEUE_FLAG_AUTO_REMOVE,
-			dleyna_service_task_process_cb,
-			dleyna_service_task_cancel_cb,
-			dleyna_service_task_delete_cb);
+	upload = g_new0(dls_device_upload_t, 1);
 
-	dleyna_task_queue_set_finally(queue_id, prv_browse_objects_chain_end);
-	dleyna_task_queue_set_user_data(queue_id, task);
+	upload->soup_session = g_object_ref(session);
+	upload->msg = soup_message_new("POST", import_uri);
+	upload->fd = up_fd;
+	upload->mapped_file = mapped_file;
+	upload->body = body;
+	upload->body_length = body_length;
 
-	context = dls_device_get_context(task->target.device, client);
-	cb_data->proxy = context->cds.proxy;
+	if (!upload->msg) {
+		DLEYNA_LOG_WARNING("Invalid URI %s", import_uri);
 
-	cb_task_data = &cb_data->ut.browse_objects;
-	cb_task_data->queue_id = queue_id;
-	cb_task_data->avb = g_variant_builder_new(G_VARIANT_TYPE("aa{sv}"));
-	cb_task_data->objects_id = objs;
-	cb_task_data->object_count = length;
+		*error = g_error_new(DLEYNA_SERVER_ERROR,
+				     DLEYNA_ERROR_BAD_RESULT,
+				     "Invalid URI %s", import_uri);
+		goto on_error;
+	}
 
-	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
-				  (gpointer *)&cb_data->proxy);
+	upload->status = DLS_UPLOAD_STATUS_QUEUED;
+	upload->mime_type = g_strdup(mime_type);
+	upload->data = up_body;
+	upload->bytes_to_upload = up_body_length;
 
-	cb_data->cancel_id = g_cancellable_connect(
-				cb_data->cancellable,
-				G_CALLBACK(prv_browse_objects_chain_cancelled),
-				cb_data, NULL);
+	prv_upload_prepare_post(upload, upload->msg, 0);
 
-	dleyna_service_task_add(queue_id,
-				prv_browse_objects_begin_action_cb,
-				cb_data->proxy,
-				prv_browse_objects_end_action_cb,
-				NULL, cb_data);
+	DLEYNA_LOG_DEBUG("Exit with Success");
 
-	dleyna_task_queue_start(queue_id);
+	return upload;
 
 on_error:
 
-	if (cb_data->error != NULL)
-		(void) g_idle_add(dls_async_task_complete, cb_data);
-}
-
-void dls_device_get_resource(dls_client_t *client,
-			     dls_task_t *task,
-			     const gchar *upnp_filter)
-{
-	dls_async_task_t *cb_data = (dls_async_task_t *)task;
-	dls_async_get_all_t *cb_task_data;
-	dls_device_context_t *context;
-
-	context = dls_device_get_context(task->target.device, client);
-	cb_task_data = &cb_data->ut.get_all;
-
-	cb_task_data->vb = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
-	cb_task_data->prop_func = G_CALLBACK(prv_get_resource);
-	cb_task_data->device_object = FALSE;
-	cb_task_data->proxy = context->ems.proxy;
-
-	cb_data->proxy = context->cds.proxy;
-
-	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
-				  (gpointer *)&cb_data->proxy);
-
-	cb_data->action = gupnp_service_proxy_begin_action(
-				cb_data->proxy, "Browse",
-				prv_get_all_ms2spec_props_cb, cb_data,
-				"ObjectID", G_TYPE_STRING, task->target.id,
-				"BrowseFlag", G_TYPE_STRING, "BrowseMetadata",
-				"Filter", G_TYPE_STRING, upnp_filter,
-				"StartingIndex", G_TYPE_INT, 0,
-				"RequestedCount", G_TYPE_INT, 0,
-				"SortCriteria", G_TYPE_STRING,
-				"", NULL);
+	prv_upload_delete(upload);
 
-	cb_data->cancel_id = g_cancellable_connect(
-					cb_data->cancellable,
-					G_CALLBACK(dls_async_task_cancelled_cb),
-					cb_data, NULL);
+	DLEYNA_LOG_WARNING("Exit with Fail");
 
-	DLEYNA_LOG_DEBUG("Exit");
+	return NULL;
 }
 
-static gchar *prv_create_new_container_didl(const gchar *parent_id,
-					    dls_task_t *task)
+static void prv_create_container_cb(GUPnPServiceProxy *proxy,
+		 GUPnPServiceProxyAction *action,
+		 gpointer user_data)
 {
-	GUPnPDIDLLiteWriter *writer;
-	GUPnPDIDLLiteObject *item;
-	GUPnPDIDLLiteContainer *container;
-	GVariantIter iter;
-	GVariant *child_type;
-	gchar *actual_type;
-	GUPnPOCMFlags flags;
-	gchar *retval = NULL;
-
-	actual_type = dls_props_media_spec_ex_to_upnp_class(
-						task->ut.create_container.type);
-	if (!actual_type)
-		goto on_error;
-
-	writer = gupnp_didl_lite_writer_new(NULL);
-	item = GUPNP_DIDL_LITE_OBJECT(
-				gupnp_didl_lite_writer_add_container(writer));
-	container = GUPNP_DIDL_LITE_CONTAINER(item);
+	dls_async_task_t *cb_data = user_data;
+	const gchar *message;
+	GError *error = NULL;
+	gchar *result = NULL;
+	gchar *object_id = NULL;
+	gchar *object_path;
+	gboolean end;
 
-	gupnp_didl_lite_object_set_id(item, "");
-	gupnp_didl_lite_object_set_title(
-					item,
-					task->ut.create_container.display_name);
-	gupnp_didl_lite_object_set_parent_id(item, parent_id);
-	gupnp_didl_lite_object_set_upnp_class(item, actual_type);
-	g_free(actual_type);
-	gupnp_didl_lite_object_set_restricted(item, FALSE);
+	DLEYNA_LOG_DEBUG("Enter");
 
-	flags = GUPNP_OCM_FLAGS_UPLOAD |
-		GUPNP_OCM_FLAGS_CREATE_CONTAINER |
-		GUPNP_OCM_FLAGS_DESTROYABLE |
-		GUPNP_OCM_FLAGS_UPLOAD_DESTROYABLE |
-		GUPNP_OCM_FLAGS_CHANGE_METADATA;
+	end = gupnp_service_proxy_end_action(cb_data->proxy, cb_data->action,
+					     &error, "ObjectID",
+					     G_TYPE_STRING, &object_id,
+					     "Result", G_TYPE_STRING, &result,
+					     NULL);
 
-	gupnp_didl_lite_object_set_dlna_managed(item, flags);
+	if (!end || (object_id == NULL)) {
+		message = (error != NULL) ? error->message : "Invalid result";
+		DLEYNA_LOG_WARNING("Create Object operation failed: %s",
+				   message);
 
-	g_variant_iter_init(&iter, task->ut.create_container.child_types);
-	while ((child_type = g_variant_iter_next_value(&iter))) {
-		actual_type = dls_props_media_spec_ex_to_upnp_class(
-					g_variant_get_string(child_type, NULL));
-		if (actual_type != NULL) {
-			gupnp_didl_lite_container_add_create_class(container,
-								   actual_type);
-			g_free(actual_type);
-		}
-		g_variant_unref(child_type);
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_OPERATION_FAILED,
+					     "Create Object operation failed: %s",
+					     message);
+		goto on_error;
 	}
 
-	retval = gupnp_didl_lite_writer_get_string(writer);
-
-	g_object_unref(item);
-	g_object_unref(writer);
+	object_path = dls_path_from_id(cb_data->task.target.root_path,
+				       object_id);
+	cb_data->task.result = g_variant_ref_sink(g_variant_new_object_path(
+								object_path));
+	g_free(object_path);
 
 on_error:
 
-	return retval;
+	dls_async_task_complete_in_idle(cb_data);
+	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+
+	g_free(object_id);
+	g_free(result);
+
+	if (error)
+		g_error_free(error);
+
+	DLEYNA_LOG_DEBUG("Exit");
 }
 
-static const gchar *prv_get_dlna_profile_name(const gchar *filename)
+/* Parses the result of the CreateObject action issued for an upload and
+ * queues the transfer of the file to the import URI of the new object.
+ * On failure, *object_id is only set if the object needs to be destroyed.
+ */
+static gboolean prv_upload_start(dls_device_t *device,
+				 GUPnPServiceProxy *proxy,
+				 GUPnPServiceProxyAction *action,
+				 const gchar *file_path,
+				 gint fd,
+				 gchar *body,
+				 gsize body_length,
+				 const gchar *mime_type,
+				 gchar **object_id,
+				 guint *upload_id,
+				 GError **error)
 {
-	gchar *uri;
-	GError *error = NULL;
-	const gchar *profile_name = NULL;
-	GUPnPDLNAProfile *profile;
-	GUPnPDLNAProfileGuesser *guesser;
-	gboolean relaxed_mode = TRUE;
-	gboolean extended_mode = TRUE;
-
-	guesser = gupnp_dlna_profile_guesser_new(relaxed_mode, extended_mode);
+	gchar *result = NULL;
+	gchar *import_uri = NULL;
+	const gchar *message;
+	GError *upnp_error = NULL;
+	gboolean end;
+	gboolean retval = FALSE;
+	gint *key;
+	GUPnPDIDLLiteParser *parser = NULL;
+	dls_device_upload_t *upload;
+	dls_device_upload_job_t *upload_job;
 
-	uri = g_filename_to_uri(filename, NULL, &error);
-	if (uri == NULL) {
-		DLEYNA_LOG_WARNING("Unable to convert filename: %s", filename);
+	end = gupnp_service_proxy_end_action(proxy, action, &upnp_error,
+					     "ObjectID",
+					     G_TYPE_STRING, object_id,
+					     "Result", G_TYPE_STRING, &result,
+					     NULL);
 
-		if (error) {
-			DLEYNA_LOG_WARNING("Error: %s", error->message);
+	if (!end || (*object_id == NULL) || (result == NULL)) {
+		message = (upnp_error != NULL) ? upnp_error->message :
+							"Invalid result";
+		DLEYNA_LOG_WARNING("Create Object operation failed: %s",
+				   message);
 
-			g_error_free(error);
-		}
+		*error = g_error_new(DLEYNA_SERVER_ERROR,
+				     DLEYNA_ERROR_OPERATION_FAILED,
+				     "Create Object operation failed: %s",
+				     message);
 
+		g_free(*object_id);
+		*object_id = NULL;
 		goto on_error;
 	}
 
-	profile = gupnp_dlna_profile_guesser_guess_profile_sync(guesser,
-								uri,
-								5000,
-								NULL,
-								&error);
-	if (profile == NULL) {
-		DLEYNA_LOG_WARNING("Unable to guess profile for URI: %s", uri);
+	DLEYNA_LOG_DEBUG_NL();
+	DLEYNA_LOG_DEBUG("Create Object Result: %s", result);
+	DLEYNA_LOG_DEBUG_NL();
 
-		if (error) {
-			DLEYNA_LOG_WARNING("Error: %s", error->message);
+	parser = gupnp_didl_lite_parser_new();
 
-			g_error_free(error);
-		}
+	g_signal_connect(parser, "object-available" ,
+			 G_CALLBACK(prv_extract_import_uri), &import_uri);
+
+	if (!gupnp_didl_lite_parser_parse_didl(parser, result, &upnp_error) &&
+	    upnp_error->code != GUPNP_XML_ERROR_EMPTY_NODE) {
+		DLEYNA_LOG_WARNING(
+				"Unable to parse results of CreateObject: %s",
+				upnp_error->message);
 
+		*error = g_error_new(DLEYNA_SERVER_ERROR,
+				     DLEYNA_ERROR_OPERATION_FAILED,
+				     "Unable to parse results of CreateObject: %s",
+				     upnp_error->message);
 		goto on_error;
 	}
 
-	profile_name = gupnp_dlna_profile_get_name(profile);
+	if (!import_uri) {
+		DLEYNA_LOG_WARNING("Missing Import URI");
 
-on_error:
-	g_object_unref(guesser);
+		*error = g_error_new(DLEYNA_SERVER_ERROR,
+				     DLEYNA_ERROR_OPERATION_FAILED,
+				     "Missing Import URI");
+		goto on_error;
+	}
 
-	g_free(uri);
+	DLEYNA_LOG_DEBUG("Import URI %s", import_uri);
 
-	return profile_name;
-}
+	upload = prv_upload_data_new(prv_get_http_session(device),
+				     file_path, fd, body, body_length,
+				     import_uri, mime_type, error);
 
-static gchar *prv_create_upload_didl(const gchar *parent_id, dls_task_t *task,
-				     const gchar *object_class,
-				     const gchar *mime_type)
-{
-	GUPnPDIDLLiteWriter *writer;
-	GUPnPDIDLLiteObject *item;
-	gchar *retval;
-	GUPnPProtocolInfo *protocol_info;
-	GUPnPDIDLLiteResource *res;
-	const gchar *profile;
+	if (!upload)
+		goto on_error;
 
-	writer = gupnp_didl_lite_writer_new(NULL);
-	item = GUPNP_DIDL_LITE_OBJECT(gupnp_didl_lite_writer_add_item(writer));
+	upload_job = g_new0(dls_device_upload_job_t, 1);
+	upload_job->device = device;
+	upload_job->upload_id = (gint) device->upload_id;
+	upload->job = upload_job;
 
-	gupnp_didl_lite_object_set_id(item, "");
-	gupnp_didl_lite_object_set_title(item, task->ut.upload.display_name);
-	gupnp_didl_lite_object_set_parent_id(item, parent_id);
-	gupnp_didl_lite_object_set_upnp_class(item, object_class);
-	gupnp_didl_lite_object_set_restricted(item, FALSE);
+	key = g_new(gint, 1);
+	*key = upload_job->upload_id;
+	g_hash_table_insert(device->uploads, key, upload);
 
-	protocol_info = gupnp_protocol_info_new();
-	gupnp_protocol_info_set_mime_type(protocol_info, mime_type);
-	gupnp_protocol_info_set_protocol(protocol_info, "*");
-	gupnp_protocol_info_set_network(protocol_info, "*");
+	g_queue_push_tail(&device->upload_queue, upload);
+	prv_upload_schedule(device);
 
-	profile = prv_get_dlna_profile_name(task->ut.upload.file_path);
-	if (profile != NULL)
-		gupnp_protocol_info_set_dlna_profile(protocol_info, profile);
+	*upload_id = upload_job->upload_id;
 
-	res = gupnp_didl_lite_object_add_resource(item);
-	gupnp_didl_lite_resource_set_protocol_info(res, protocol_info);
+	++device->upload_id;
+	if (device->upload_id > G_MAXINT)
+		device->upload_id = 0;
 
-	retval = gupnp_didl_lite_writer_get_string(writer);
+	DLEYNA_LOG_DEBUG("Upload ID %u", *upload_id);
+	DLEYNA_LOG_DEBUG("Object ID %s", *object_id);
 
-	g_object_unref(res);
-	g_object_unref(protocol_info);
-	g_object_unref(item);
-	g_object_unref(writer);
+	retval = TRUE;
 
-	return retval;
-}
+on_error:
 
-static void prv_extract_import_uri(GUPnPDIDLLiteParser *parser,
-				   GUPnPDIDLLiteObject *object,
-				   gpointer user_data)
-{
-	gchar **import_uri = user_data;
-	GList *resources;
-	GList *ptr;
-	GUPnPDIDLLiteResource *res;
-	const gchar *uri;
+	g_free(import_uri);
 
-	if (!*import_uri) {
-		resources = gupnp_didl_lite_object_get_resources(object);
-		ptr = resources;
-		while (ptr) {
-			res = ptr->data;
-			if (!*import_uri) {
-				uri = gupnp_didl_lite_resource_get_import_uri(
-					res);
-				if (uri)
-					*import_uri = g_strdup(uri);
-			}
-			g_object_unref(res);
-			ptr = ptr->next;
-		}
+	if (parser)
+		g_object_unref(parser);
 
-		g_list_free(resources);
-	}
+	g_free(result);
+
+	if (upnp_error)
+		g_error_free(upnp_error);
+
+	return retval;
 }
 
-static void prv_upload_delete_cb(GUPnPServiceProxy *proxy,
-				 GUPnPServiceProxyAction *action,
-				 gpointer user_data)
+static void prv_generic_upload_cb(dls_async_task_t *cb_data,
+				  char *file_path,
+				  gint fd,
+				  gchar *body,
+				  gsize body_length,
+				  const gchar *mime_type)
 {
-	dls_async_task_t *cb_data = user_data;
+	gchar *object_id = NULL;
+	gchar *object_path;
+	guint upload_id;
+	GVariant *out_p[2];
 
 	DLEYNA_LOG_DEBUG("Enter");
 
-	(void) gupnp_service_proxy_end_action(cb_data->proxy, cb_data->action,
-					      NULL, NULL);
-	(void) g_idle_add(dls_async_task_complete, cb_data);
-	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+	if (!prv_upload_start(cb_data->task.target.device, cb_data->proxy,
+			      cb_data->action, file_path, fd, body,
+			      body_length, mime_type, &object_id, &upload_id,
+			      &cb_data->error))
+		goto on_error;
 
-	DLEYNA_LOG_DEBUG("Exit");
-}
+	object_path = dls_path_from_id(cb_data->task.target.root_path,
+				       object_id);
 
-static void prv_upload_job_delete(gpointer up_job)
-{
-	dls_device_upload_job_t *upload_job = up_job;
+	DLEYNA_LOG_DEBUG("Object Path %s", object_path);
 
-	if (up_job) {
-		if (upload_job->remove_idle)
-			(void) g_source_remove(upload_job->remove_idle);
+	out_p[0] = g_variant_new_uint32(upload_id);
+	out_p[1] = g_variant_new_object_path(object_path);
+	cb_data->task.result = g_variant_ref_sink(g_variant_new_tuple(out_p,
+								      2));
 
-		g_free(upload_job);
-	}
-}
+	g_free(object_path);
 
-static gboolean prv_remove_update_job(gpointer user_data)
-{
-	dls_device_upload_job_t *upload_job = user_data;
-	dls_device_upload_t *upload;
+on_error:
 
-	upload = g_hash_table_lookup(upload_job->device->uploads,
-				     &upload_job->upload_id);
-	if (upload) {
-		g_hash_table_remove(upload_job->device->uploads,
-				    &upload_job->upload_id);
+	if (cb_data->error && object_id) {
+		DLEYNA_LOG_WARNING(
+			"Upload failed deleting created object with id %s",
+			object_id);
 
-		DLEYNA_LOG_DEBUG("Removing Upload Object: %d",
-				 upload_job->upload_id);
+		cb_data->action = gupnp_service_proxy_begin_action(
+					cb_data->proxy, "DestroyObject",
+					prv_upload_delete_cb, cb_data,
+					"ObjectID", G_TYPE_STRING, object_id,
+					NULL);
+	} else {
+		dls_async_task_complete_in_idle(cb_data);
+		g_cancellable_disconnect(cb_data->cancellable,
+					 cb_data->cancel_id);
 	}
 
-	upload_job->remove_idle = 0;
-	g_hash_table_remove(upload_job->device->upload_jobs,
-			    &upload_job->upload_id);
+	g_free(object_id);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_create_object_upload_cb(GUPnPServiceProxy *proxy,
+					GUPnPServiceProxyAction *action,
+					gpointer user_data)
+{
+	dls_async_task_t *cb_data = user_data;
+	dls_task_upload_t *upload = &cb_data->task.ut.upload;
 
-	return FALSE;
+	prv_generic_upload_cb(cb_data, upload->file_path,
+			      upload->file_path ? -1 : upload->fd, NULL, 0,
+			      cb_data->ut.upload.mime_type);
 }
 
-static void prv_generate_upload_update(dls_device_upload_job_t *upload_job,
-				       dls_device_upload_t *upload)
+static void prv_upload_create_object(dls_async_task_t *cb_data,
+				     const gchar *profile)
 {
-	GVariant *args;
+	dls_async_upload_t *cb_task_data = &cb_data->ut.upload;
+	gchar *didl;
 
-	args = g_variant_new("(ustt)", upload_job->upload_id, upload->status,
-			     upload->bytes_uploaded, upload->bytes_to_upload);
+	didl = prv_create_upload_didl(cb_task_data->parent_id,
+				      cb_data->task.ut.upload.display_name,
+				      cb_task_data->object_class,
+				      cb_task_data->mime_type, profile);
 
-	DLEYNA_LOG_DEBUG(
-		"Emitting: %s (%u %s %"G_GUINT64_FORMAT" %"G_GUINT64_FORMAT")"
-		" on %s",
-		DLS_INTERFACE_UPLOAD_UPDATE, upload_job->upload_id,
-		upload->status, upload->bytes_uploaded,
-		upload->bytes_to_upload, upload_job->device->path);
+	DLEYNA_LOG_DEBUG_NL();
+	DLEYNA_LOG_DEBUG("DIDL: %s", didl);
+	DLEYNA_LOG_DEBUG_NL();
 
-	(void) dls_server_get_connector()->notify(
-					upload_job->device->connection,
-					upload_job->device->path,
-					DLEYNA_SERVER_INTERFACE_MEDIA_DEVICE,
-					DLS_INTERFACE_UPLOAD_UPDATE,
-					args,
-					NULL);
+	cb_data->action = gupnp_service_proxy_begin_action(
+				cb_data->proxy, "CreateObject",
+				prv_create_object_upload_cb, cb_data,
+				"ContainerID", G_TYPE_STRING,
+				cb_task_data->parent_id,
+				"Elements", G_TYPE_STRING, didl,
+				NULL);
+
+	cb_data->cancel_id = g_cancellable_connect(
+					cb_data->cancellable,
+					G_CALLBACK(dls_async_task_cancelled_cb),
+					cb_data, NULL);
+
+	g_free(didl);
 }
 
-static void prv_post_finished(SoupSession *session, SoupMessage *msg,
-			      gpointer user_data)
+static void prv_guess_profile_cb(GObject *source_object, GAsyncResult *res,
+				 gpointer user_data)
 {
-	dls_device_upload_job_t *upload_job = user_data;
-	dls_device_upload_t *upload;
-	gint *upload_id;
+	dls_async_task_t *cb_data = user_data;
+	dls_async_upload_t *cb_task_data = &cb_data->ut.upload;
+	GError *error = NULL;
+	gchar *profile;
 
 	DLEYNA_LOG_DEBUG("Enter");
 
-	DLEYNA_LOG_DEBUG("Upload %u finished.  Code %u Message %s",
-			 upload_job->upload_id, msg->status_code,
-			 msg->reason_phrase);
-
-	/* This is clumsy but we need to distinguish between two cases:
-	   1. We cancel because the process is exitting.
-	   2. We cancel because a client has called CancelUpload.
+	profile = g_task_propagate_pointer(G_TASK(res), &error);
 
-	   We could use custom SOUP error messages to distinguish the cases
-	   but device->shutting_down seemed less hacky.
+	/* The only error is a cancellation, reported once a running guess
+	 * ends; a lost device cancels its tasks too.
+	 */
+	if (error || !cb_data->proxy) {
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_CANCELLED,
+					     "Operation cancelled.");
+		dls_async_task_complete_in_idle(cb_data);
+		goto on_exit;
+	}
 
-	   We need this check as if we are shutting down it is
-	   dangerous to manipulate uploads as we are being called from its
-	   destructor.
-	*/
+	DLEYNA_LOG_DEBUG("DLNA profile %s", profile ? profile : "(none)");
 
-	if (upload_job->device->shutting_down) {
-		DLEYNA_LOG_DEBUG("Device shutting down. Cancelling Upload");
-		goto on_error;
-	}
+	if (cb_task_data->profile_key)
+		dls_string_cache_insert(g_profile_cache,
+					cb_task_data->profile_key,
+					profile ? profile : "");
 
-	upload = g_hash_table_lookup(upload_job->device->uploads,
-				     &upload_job->upload_id);
-	if (upload) {
-		upload_job->remove_idle =
-			g_timeout_add(30000, prv_remove_update_job, user_data);
+	prv_upload_create_object(cb_data, profile);
 
-		if (SOUP_STATUS_IS_SUCCESSFUL(msg->status_code)) {
-			upload->status = DLS_UPLOAD_STATUS_COMPLETED;
-			upload->bytes_uploaded = upload->bytes_to_upload;
-		} else if (msg->status_code == SOUP_STATUS_CANCELLED) {
-			upload->status = DLS_UPLOAD_STATUS_CANCELLED;
-		} else {
-			upload->status = DLS_UPLOAD_STATUS_ERROR;
-		}
+on_exit:
 
-		DLEYNA_LOG_DEBUG("Upload Status: %s", upload->status);
+	g_free(profile);
 
-		prv_generate_upload_update(upload_job, upload);
+	if (error)
+		g_error_free(error);
 
-		g_object_unref(upload->msg);
-		upload->msg = NULL;
+	DLEYNA_LOG_DEBUG("Exit");
+}
 
-		g_object_unref(upload->soup_session);
-		upload->soup_session = NULL;
+void dls_device_upload(dls_client_t *client,
+		       dls_task_t *task, const gchar *parent_id)
+{
+	dls_async_task_t *cb_data = (dls_async_task_t *)task;
+	dls_device_context_t *context;
+	dls_async_upload_t *cb_task_data;
+	const gchar *profile;
 
-		g_mapped_file_unref(upload->mapped_file);
-		upload->mapped_file = NULL;
+	DLEYNA_LOG_DEBUG("Enter");
+	DLEYNA_LOG_DEBUG("Uploading file to %s", parent_id);
 
-		g_free(upload->body);
-		upload->body = NULL;
+	context = dls_device_get_context(task->target.device, client);
+	cb_task_data = &cb_data->ut.upload;
+	cb_task_data->parent_id = parent_id;
 
-		upload_id = g_new(gint, 1);
-		*upload_id = upload_job->upload_id;
+	cb_data->proxy = context->cds.proxy;
 
-		g_hash_table_insert(upload_job->device->upload_jobs, upload_id,
-				    upload_job);
+	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
+				  (gpointer *)&cb_data->proxy);
 
-		upload_job = NULL;
+	/* Files sent by descriptor have no name to guess a profile from */
+	if (!task->ut.upload.file_path) {
+		prv_upload_create_object(cb_data, NULL);
+		goto on_exit;
 	}
 
-on_error:
-
-	prv_upload_job_delete(upload_job);
+	cb_task_data->profile_key =
+			prv_profile_cache_key(task->ut.upload.file_path);
+	profile = prv_profile_cache_lookup(cb_task_data->profile_key);
 
-	DLEYNA_LOG_DEBUG("Exit");
-}
+	if (profile) {
+		DLEYNA_LOG_DEBUG("Cached DLNA profile %s", profile);
 
-static void prv_upload_delete(gpointer up)
-{
-	dls_device_upload_t *upload = up;
+		prv_upload_create_object(cb_data, profile);
+	} else {
+		prv_guess_profile(task->ut.upload.file_path,
+				  cb_data->cancellable, prv_guess_profile_cb,
+				  cb_data);
+	}
 
-	DLEYNA_LOG_DEBUG("Enter");
+on_exit:
 
-	if (upload) {
-		if (upload->msg) {
-			soup_session_cancel_message(upload->soup_session,
-						    upload->msg,
-						    SOUP_STATUS_CANCELLED);
-			g_object_unref(upload->msg);
-		}
+	DLEYNA_LOG_DEBUG("Exit");
+}
 
-		if (upload->soup_session)
-			g_object_unref(upload->soup_session);
+static void prv_upload_many_next(dls_async_task_t *cb_data);
 
-		if (upload->mapped_file)
-			g_mapped_file_unref(upload->mapped_file);
-		else if (upload->body)
-			g_free(upload->body);
+/* Has no effect on uploads that have already finished */
+static void prv_upload_cancel(dls_device_t *device,
+			      dls_device_upload_t *upload)
+{
+	guint upload_id = upload->job->upload_id;
 
-		g_free(upload);
+	if (upload->msg && !strcmp(upload->status, DLS_UPLOAD_STATUS_QUEUED)) {
+		g_queue_remove(&device->upload_queue, upload);
+		upload->status = DLS_UPLOAD_STATUS_CANCELLED;
+		prv_upload_finished(upload->job, upload);
+		DLEYNA_LOG_DEBUG("Cancelling queued Upload %u ", upload_id);
+	} else if (upload->retry_id) {
+		device->uploads_in_flight--;
+		upload->status = DLS_UPLOAD_STATUS_CANCELLED;
+		prv_upload_finished(upload->job, upload);
+		prv_upload_schedule(device);
+		DLEYNA_LOG_DEBUG("Cancelling retried Upload %u ", upload_id);
+	} else if (upload->msg) {
+		soup_session_cancel_message(upload->soup_session, upload->msg,
+					    SOUP_STATUS_CANCELLED);
+		DLEYNA_LOG_DEBUG("Cancelling Upload %u ", upload_id);
 	}
+}
 
-	DLEYNA_LOG_DEBUG("Exit");
+static void prv_upload_request_delete(dls_device_upload_request_t *request)
+{
+	g_free(request->profile_key);
+	g_free(request);
 }
 
-static void prv_post_bytes_written(SoupMessage *msg, SoupBuffer *chunk,
-				   gpointer user_data)
+static void prv_upload_request_done(dls_device_upload_request_t *request)
 {
-	dls_device_upload_t *upload = user_data;
+	dls_async_task_t *cb_data = request->cb_data;
+	dls_async_upload_many_t *cb_task_data = &cb_data->ut.upload_many;
 
-	upload->bytes_uploaded += chunk->length;
-	if (upload->bytes_uploaded > upload->bytes_to_upload)
-		upload->bytes_uploaded = upload->bytes_to_upload;
+	cb_task_data->requests = g_list_remove(cb_task_data->requests,
+					       request);
+	prv_upload_request_delete(request);
 }
 
-static dls_device_upload_t *prv_upload_data_new(const gchar *file_path,
-						gchar *body,
-						gsize body_length,
-						const gchar *import_uri,
-						const gchar *mime_type,
-						GError **error)
+/* Profiling threads cannot be interrupted, so their requests are left for
+ * prv_upload_many_profile_cb to release.
+ */
+static void prv_upload_many_abort(dls_async_task_t *cb_data)
 {
-	dls_device_upload_t *upload = NULL;
-	GMappedFile *mapped_file = NULL;
-	gchar *up_body = body;
-	gsize up_body_length = body_length;
-
-	DLEYNA_LOG_DEBUG("Enter");
+	dls_async_upload_many_t *cb_task_data = &cb_data->ut.upload_many;
+	dls_device_upload_request_t *request;
+	GList *next;
+	GList *ptr;
 
-	if (file_path) {
-		mapped_file = g_mapped_file_new(file_path, FALSE, NULL);
-		if (!mapped_file) {
-			DLEYNA_LOG_WARNING("Unable to map %s into memory",
-					   file_path);
+	for (ptr = cb_task_data->requests; ptr; ptr = next) {
+		next = ptr->next;
+		request = ptr->data;
 
-			*error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_IO,
-					     "Unable to map %s into memory",
-					     file_path);
-			goto on_error;
-		}
+		if (!request->action)
+			continue;
 
-		up_body = g_mapped_file_get_contents(mapped_file);
-		up_body_length = g_mapped_file_get_length(mapped_file);
+		if (cb_data->proxy)
+			gupnp_service_proxy_cancel_action(cb_data->proxy,
+							  request->action);
+		prv_upload_request_done(request);
 	}
 
-	upload = g_new0(dls_device_upload_t, 1);
+	cb_task_data->index = cb_task_data->file_count;
+}
 
-	upload->soup_session = soup_session_async_new();
-	upload->msg = soup_message_new("POST", import_uri);
-	upload->mapped_file = mapped_file;
-	upload->body = body;
-	upload->body_length = body_length;
+/* The IDs of the uploads already started are never returned to the
+ * client, so they are cancelled along with the task.
+ */
+static void prv_upload_many_cancel_uploads(dls_async_task_t *cb_data)
+{
+	dls_async_upload_many_t *cb_task_data = &cb_data->ut.upload_many;
+	dls_device_t *device = cb_data->task.target.device;
+	dls_device_upload_t *upload;
+	guint upload_id;
+	guint i;
 
-	if (!upload->msg) {
-		DLEYNA_LOG_WARNING("Invalid URI %s", import_uri);
+	for (i = 0; i < cb_task_data->file_count; ++i) {
+		if (!cb_task_data->files[i].result ||
+		    !g_variant_lookup(cb_task_data->files[i].result,
+				      DLS_INTERFACE_UPLOAD_ID, "u",
+				      &upload_id))
+			continue;
 
-		*error = g_error_new(DLEYNA_SERVER_ERROR,
-				     DLEYNA_ERROR_BAD_RESULT,
-				     "Invalid URI %s", import_uri);
-		goto on_error;
+		upload = g_hash_table_lookup(device->uploads, &upload_id);
+		if (upload)
+			prv_upload_cancel(device, upload);
 	}
+}
 
-	upload->status = DLS_UPLOAD_STATUS_IN_PROGRESS;
-	upload->bytes_to_upload = up_body_length;
-
-	soup_message_headers_set_expectations(upload->msg->request_headers,
-					      SOUP_EXPECTATION_CONTINUE);
-
-	soup_message_set_request(upload->msg, mime_type, SOUP_MEMORY_STATIC,
-				 up_body, up_body_length);
-	g_signal_connect(upload->msg, "wrote-body-data",
-			 G_CALLBACK(prv_post_bytes_written), upload);
-
-	DLEYNA_LOG_DEBUG("Exit with Success");
+static void prv_upload_many_cancelled(GCancellable *cancellable,
+				      gpointer user_data)
+{
+	dls_async_task_t *cb_data = user_data;
 
-	return upload;
+	DLEYNA_LOG_DEBUG("Enter");
 
-on_error:
+	prv_upload_many_abort(cb_data);
+	prv_upload_many_cancel_uploads(cb_data);
 
-	prv_upload_delete(upload);
+	if (!cb_data->error)
+		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+					     DLEYNA_ERROR_CANCELLED,
+					     "Operation cancelled.");
 
-	DLEYNA_LOG_WARNING("Exit with Fail");
+	if (!cb_data->ut.upload_many.requests)
+		dls_async_task_complete_in_idle(cb_data);
 
-	return NULL;
+	DLEYNA_LOG_DEBUG("Exit");
 }
 
-static void prv_create_container_cb(GUPnPServiceProxy *proxy,
-		 GUPnPServiceProxyAction *action,
-		 gpointer user_data)
+static void prv_upload_many_end(dls_async_task_t *cb_data)
 {
-	dls_async_task_t *cb_data = user_data;
-	const gchar *message;
-	GError *error = NULL;
-	gchar *result = NULL;
-	gchar *object_id = NULL;
-	gchar *object_path;
-	gboolean end;
+	dls_async_upload_many_t *cb_task_data = &cb_data->ut.upload_many;
+	dls_async_upload_file_t *file;
+	GVariantBuilder vb;
+	GVariantBuilder evb;
+	guint i;
 
 	DLEYNA_LOG_DEBUG("Enter");
 
-	end = gupnp_service_proxy_end_action(cb_data->proxy, cb_data->action,
-					     &error, "ObjectID",
-					     G_TYPE_STRING, &object_id,
-					     "Result", G_TYPE_STRING, &result,
-					     NULL);
-
-	if (!end || (object_id == NULL)) {
-		message = (error != NULL) ? error->message : "Invalid result";
-		DLEYNA_LOG_WARNING("Create Object operation failed: %s",
-				   message);
-
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "Create Object operation failed: %s",
-					     message);
-		goto on_error;
-	}
-
-	object_path = dls_path_from_id(cb_data->task.target.root_path,
-				       object_id);
-	cb_data->task.result = g_variant_ref_sink(g_variant_new_object_path(
-								object_path));
-	g_free(object_path);
+	g_variant_builder_init(&vb, G_VARIANT_TYPE("aa{sv}"));
 
-on_error:
+	for (i = 0; i < cb_task_data->file_count; ++i) {
+		file = &cb_task_data->files[i];
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
-	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+		if (file->result) {
+			g_variant_builder_add(&vb, "@a{sv}", file->result);
+			continue;
+		}
 
-	g_free(object_id);
-	g_free(result);
+		g_variant_builder_init(&evb, G_VARIANT_TYPE("a{sv}"));
+		g_variant_builder_add(&evb, "{sv}", DLS_INTERFACE_PROP_ERROR,
+				      dls_props_get_error_prop(file->error));
+		g_variant_builder_add(&vb, "@a{sv}",
+				      g_variant_builder_end(&evb));
+	}
 
-	if (error)
-		g_error_free(error);
+	cb_data->task.result = g_variant_ref_sink(g_variant_builder_end(&vb));
+
+	dls_async_task_complete_in_idle(cb_data);
+	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
 
 	DLEYNA_LOG_DEBUG("Exit");
 }
 
-static void prv_generic_upload_cb(dls_async_task_t *cb_data,
-				  char *file_path,
-				  gchar *body,
-				  gsize body_length,
-				  const gchar *mime_type)
+static void prv_upload_many_delete_cb(GUPnPServiceProxy *proxy,
+				      GUPnPServiceProxyAction *action,
+				      gpointer user_data)
+{
+	(void) gupnp_service_proxy_end_action(proxy, action, NULL, NULL);
+}
+
+static void prv_upload_many_create_cb(GUPnPServiceProxy *proxy,
+				      GUPnPServiceProxyAction *action,
+				      gpointer user_data)
 {
+	dls_device_upload_request_t *request = user_data;
+	dls_async_task_t *cb_data = request->cb_data;
+	dls_async_upload_file_t *file;
+	GVariantBuilder vb;
 	gchar *object_id = NULL;
-	gchar *result = NULL;
-	gchar *import_uri = NULL;
 	gchar *object_path;
-	const gchar *message;
-	GError *error = NULL;
-	gboolean delete_needed = FALSE;
-	gboolean end;
-	gint *upload_id;
-	GUPnPDIDLLiteParser *parser = NULL;
-	GVariant *out_p[2];
-	dls_device_upload_t *upload;
-	dls_device_upload_job_t *upload_job;
+	guint upload_id;
 
 	DLEYNA_LOG_DEBUG("Enter");
 
-	end = gupnp_service_proxy_end_action(cb_data->proxy, cb_data->action,
-					     &error, "ObjectID",
-					     G_TYPE_STRING, &object_id,
-					     "Result", G_TYPE_STRING, &result,
-					     NULL);
+	file = &cb_data->ut.upload_many.files[request->file];
 
-	if (!end || (object_id == NULL) || (result == NULL)) {
-		message = (error != NULL) ? error->message : "Invalid result";
-		DLEYNA_LOG_WARNING("Create Object operation failed: %s",
-				   message);
+	if (!prv_upload_start(cb_data->task.target.device, proxy, action,
+			      file->file_path, -1, NULL, 0, file->mime_type,
+			      &object_id, &upload_id, &file->error)) {
+		if (object_id) {
+			DLEYNA_LOG_WARNING(
+				"Upload failed deleting created object with id %s",
+				object_id);
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "Create Object operation failed: %s",
-					     message);
-		goto on_error;
-	}
+			(void) gupnp_service_proxy_begin_action(
+					proxy, "DestroyObject",
+					prv_upload_many_delete_cb, NULL,
+					"ObjectID", G_TYPE_STRING, object_id,
+					NULL);
+		}
 
-	DLEYNA_LOG_DEBUG_NL();
-	DLEYNA_LOG_DEBUG("Create Object Result: %s", result);
-	DLEYNA_LOG_DEBUG_NL();
+		goto on_exit;
+	}
 
-	delete_needed = TRUE;
+	object_path = dls_path_from_id(cb_data->task.target.root_path,
+				       object_id);
 
-	parser = gupnp_didl_lite_parser_new();
+	g_variant_builder_init(&vb, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add(&vb, "{sv}", DLS_INTERFACE_UPLOAD_ID,
+			      g_variant_new_uint32(upload_id));
+	g_variant_builder_add(&vb, "{sv}", DLS_INTERFACE_PROP_PATH,
+			      g_variant_new_object_path(object_path));
+	file->result = g_variant_ref_sink(g_variant_builder_end(&vb));
 
-	g_signal_connect(parser, "object-available" ,
-			 G_CALLBACK(prv_extract_import_uri), &import_uri);
+	g_free(object_path);
 
-	if (!gupnp_didl_lite_parser_parse_didl(parser, result, &error) &&
-	    error->code != GUPNP_XML_ERROR_EMPTY_NODE) {
-		DLEYNA_LOG_WARNING(
-				"Unable to parse results of CreateObject: %s",
-				error->message);
+on_exit:
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "Unable to parse results of CreateObject: %s",
-					     error->message);
-		goto on_error;
-	}
+	g_free(object_id);
 
-	if (!import_uri) {
-		DLEYNA_LOG_WARNING("Missing Import URI");
+	prv_upload_request_done(request);
+	prv_upload_many_next(cb_data);
 
-		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
-					     DLEYNA_ERROR_OPERATION_FAILED,
-					     "Missing Import URI");
-		goto on_error;
-	}
+	DLEYNA_LOG_DEBUG("Exit");
+}
 
-	DLEYNA_LOG_DEBUG("Import URI %s", import_uri);
+static void prv_upload_many_create_object(dls_device_upload_request_t *request,
+					  const gchar *profile)
+{
+	dls_async_task_t *cb_data = request->cb_data;
+	dls_async_upload_many_t *cb_task_data = &cb_data->ut.upload_many;
+	dls_async_upload_file_t *file = &cb_task_data->files[request->file];
+	gchar *didl;
 
-	upload = prv_upload_data_new(file_path, body, body_length,
-				     import_uri, mime_type, &cb_data->error);
+	didl = prv_create_upload_didl(cb_task_data->parent_id,
+				      file->display_name, file->object_class,
+				      file->mime_type, profile);
 
-	if (!upload)
-		goto on_error;
+	DLEYNA_LOG_DEBUG_NL();
+	DLEYNA_LOG_DEBUG("DIDL: %s", didl);
+	DLEYNA_LOG_DEBUG_NL();
 
-	upload_job = g_new0(dls_device_upload_job_t, 1);
-	upload_job->device = cb_data->task.target.device;
-	upload_job->upload_id = (gint) cb_data->task.target.device->upload_id;
+	request->action = gupnp_service_proxy_begin_action(
+				cb_data->proxy, "CreateObject",
+				prv_upload_many_create_cb, request,
+				"ContainerID", G_TYPE_STRING,
+				cb_task_data->parent_id,
+				"Elements", G_TYPE_STRING, didl,
+				NULL);
 
-	soup_session_queue_message(upload->soup_session, upload->msg,
-				   prv_post_finished, upload_job);
-	g_object_ref(upload->msg);
+	g_free(didl);
+}
 
-	upload_id = g_new(gint, 1);
-	*upload_id = upload_job->upload_id;
-	g_hash_table_insert(cb_data->task.target.device->uploads, upload_id,
-			    upload);
+static void prv_upload_many_profile_cb(GObject *source_object,
+				       GAsyncResult *res,
+				       gpointer user_data)
+{
+	dls_device_upload_request_t *request = user_data;
+	dls_async_task_t *cb_data = request->cb_data;
+	GError *error = NULL;
+	gchar *profile;
 
-	object_path = dls_path_from_id(cb_data->task.target.root_path,
-				       object_id);
+	DLEYNA_LOG_DEBUG("Enter");
 
-	DLEYNA_LOG_DEBUG("Upload ID %u", *upload_id);
-	DLEYNA_LOG_DEBUG("Object ID %s", object_id);
-	DLEYNA_LOG_DEBUG("Object Path %s", object_path);
+	profile = g_task_propagate_pointer(G_TASK(res), &error);
 
-	out_p[0] = g_variant_new_uint32(*upload_id);
-	out_p[1] = g_variant_new_object_path(object_path);
-	cb_data->task.result = g_variant_ref_sink(g_variant_new_tuple(out_p,
-								      2));
+	if (error || !cb_data->proxy || cb_data->error) {
+		prv_upload_request_done(request);
 
-	++cb_data->task.target.device->upload_id;
-	if (cb_data->task.target.device->upload_id > G_MAXINT)
-		cb_data->task.target.device->upload_id = 0;
+		if (!cb_data->error) {
+			cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
+						     DLEYNA_ERROR_CANCELLED,
+						     "Operation cancelled.");
+			prv_upload_many_abort(cb_data);
+		}
 
-	g_free(object_path);
+		if (!cb_data->ut.upload_many.requests) {
+			dls_async_task_complete_in_idle(cb_data);
+			g_cancellable_disconnect(cb_data->cancellable,
+						 cb_data->cancel_id);
+		}
 
-on_error:
+		goto on_exit;
+	}
 
-	if (cb_data->error && delete_needed) {
-		DLEYNA_LOG_WARNING(
-			"Upload failed deleting created object with id %s",
-			object_id);
+	DLEYNA_LOG_DEBUG("DLNA profile %s", profile ? profile : "(none)");
 
-		cb_data->action = gupnp_service_proxy_begin_action(
-					cb_data->proxy, "DestroyObject",
-					prv_upload_delete_cb, cb_data,
-					"ObjectID", G_TYPE_STRING, object_id,
-					NULL);
-	} else {
-		(void) g_idle_add(dls_async_task_complete, cb_data);
-		g_cancellable_disconnect(cb_data->cancellable,
-					 cb_data->cancel_id);
-	}
+	if (request->profile_key)
+		dls_string_cache_insert(g_profile_cache, request->profile_key,
+					profile ? profile : "");
 
-	g_free(object_id);
-	g_free(import_uri);
+	prv_upload_many_create_object(request, profile);
 
-	if (parser)
-		g_object_unref(parser);
+on_exit:
 
-	g_free(result);
+	g_free(profile);
 
 	if (error)
 		g_error_free(error);
@@ -4831,80 +8401,135 @@ on_error:
 	DLEYNA_LOG_DEBUG("Exit");
 }
 
-static void prv_create_object_upload_cb(GUPnPServiceProxy *proxy,
-					GUPnPServiceProxyAction *action,
-					gpointer user_data)
+/* Keeps up to DLS_UPLOAD_MANY_MAX_IN_FLIGHT files being profiled or created
+ * on the server.  Each created object is queued for upload straight away,
+ * so that the CreateObject actions for the next files overlap the transfer
+ * of the first ones.
+ */
+static void prv_upload_many_next(dls_async_task_t *cb_data)
 {
-	dls_async_task_t *cb_data = user_data;
+	dls_async_upload_many_t *cb_task_data = &cb_data->ut.upload_many;
+	dls_device_upload_request_t *request;
+	dls_async_upload_file_t *file;
+	const gchar *profile;
 
-	prv_generic_upload_cb(cb_data,
-			      cb_data->task.ut.upload.file_path,
-			      NULL, 0,
-			      cb_data->ut.upload.mime_type);
+	while (cb_task_data->index < cb_task_data->file_count &&
+	       g_list_length(cb_task_data->requests) <
+	       DLS_UPLOAD_MANY_MAX_IN_FLIGHT) {
+		request = g_new0(dls_device_upload_request_t, 1);
+		request->cb_data = cb_data;
+		request->file = cb_task_data->index++;
+
+		file = &cb_task_data->files[request->file];
+		if (file->error) {
+			g_free(request);
+			continue;
+		}
+
+		cb_task_data->requests = g_list_prepend(cb_task_data->requests,
+							request);
+
+		request->profile_key = prv_profile_cache_key(file->file_path);
+		profile = prv_profile_cache_lookup(request->profile_key);
+
+		if (profile) {
+			DLEYNA_LOG_DEBUG("Cached DLNA profile %s", profile);
+
+			prv_upload_many_create_object(request, profile);
+		} else {
+			prv_guess_profile(file->file_path,
+					  cb_data->cancellable,
+					  prv_upload_many_profile_cb, request);
+		}
+	}
+
+	if (cb_task_data->requests == NULL)
+		prv_upload_many_end(cb_data);
 }
 
-void dls_device_upload(dls_client_t *client,
-		       dls_task_t *task, const gchar *parent_id)
+void dls_device_upload_many(dls_client_t *client,
+			    dls_task_t *task, const gchar *parent_id)
 {
 	dls_async_task_t *cb_data = (dls_async_task_t *)task;
 	dls_device_context_t *context;
-	gchar *didl;
-	dls_async_upload_t *cb_task_data;
 
 	DLEYNA_LOG_DEBUG("Enter");
-	DLEYNA_LOG_DEBUG("Uploading file to %s", parent_id);
+	DLEYNA_LOG_DEBUG("Uploading files to %s", parent_id);
 
 	context = dls_device_get_context(task->target.device, client);
-	cb_task_data = &cb_data->ut.upload;
-
-	didl = prv_create_upload_didl(parent_id, task,
-				      cb_task_data->object_class,
-				      cb_task_data->mime_type);
-
-	DLEYNA_LOG_DEBUG_NL();
-	DLEYNA_LOG_DEBUG("DIDL: %s", didl);
-	DLEYNA_LOG_DEBUG_NL();
+	cb_data->ut.upload_many.parent_id = parent_id;
 
 	cb_data->proxy = context->cds.proxy;
 
 	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
 				  (gpointer *)&cb_data->proxy);
 
-	cb_data->action = gupnp_service_proxy_begin_action(
-					cb_data->proxy, "CreateObject",
-					prv_create_object_upload_cb, cb_data,
-					"ContainerID", G_TYPE_STRING, parent_id,
-					"Elements", G_TYPE_STRING, didl,
-					NULL);
-
 	cb_data->cancel_id = g_cancellable_connect(
 					cb_data->cancellable,
-					G_CALLBACK(dls_async_task_cancelled_cb),
+					G_CALLBACK(prv_upload_many_cancelled),
 					cb_data, NULL);
 
-	g_free(didl);
+	if (!cb_data->error)
+		prv_upload_many_next(cb_data);
 
 	DLEYNA_LOG_DEBUG("Exit");
 }
 
-gboolean dls_device_get_upload_status(dls_task_t *task, GError **error)
+/* Returns the 1-based rank at which prv_upload_queue_pop() will start a
+ * queued upload.
+ */
+static guint prv_upload_queue_position(GQueue *queue,
+				       dls_device_upload_t *upload)
+{
+	GList *link;
+	dls_device_upload_t *other;
+	gboolean before = TRUE;
+	guint position = 1;
+
+	if (!g_upload_smallest_first)
+		return g_queue_index(queue, upload) + 1;
+
+	for (link = queue->head; link; link = link->next) {
+		other = link->data;
+		if (other == upload)
+			before = FALSE;
+		else if ((other->bytes_to_upload < upload->bytes_to_upload) ||
+			 (before && (other->bytes_to_upload ==
+				     upload->bytes_to_upload)))
+			position++;
+	}
+
+	return position;
+}
+
+static dls_device_upload_t *prv_upload_lookup(dls_task_t *task,
+					      GError **error)
 {
 	dls_device_upload_t *upload;
-	gboolean retval = FALSE;
-	GVariant *out_params[3];
 	guint upload_id;
 
-	DLEYNA_LOG_DEBUG("Enter");
-
 	upload_id = task->ut.upload_action.upload_id;
 
 	upload = g_hash_table_lookup(task->target.device->uploads, &upload_id);
-	if (!upload) {
+	if (!upload)
 		*error = g_error_new(DLEYNA_SERVER_ERROR,
 				     DLEYNA_ERROR_OBJECT_NOT_FOUND,
 				     "Unknown Upload ID %u ", upload_id);
+
+	return upload;
+}
+
+gboolean dls_device_get_upload_status(dls_task_t *task, GError **error)
+{
+	dls_device_upload_t *upload;
+	gboolean retval = FALSE;
+	GVariant *out_params[3];
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	upload = prv_upload_lookup(task, error);
+	if (!upload)
 		goto on_error;
-	}
 
 	out_params[0] = g_variant_new_string(upload->status);
 	out_params[1] = g_variant_new_uint64(upload->bytes_uploaded);
@@ -4926,19 +8551,93 @@ on_error:
 	return retval;
 }
 
+gboolean dls_device_get_upload_info(dls_task_t *task, GError **error)
+{
+	dls_device_upload_t *upload;
+	gboolean retval = FALSE;
+	GVariantBuilder vb;
+	guint position = 0;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	upload = prv_upload_lookup(task, error);
+	if (!upload)
+		goto on_error;
+
+	if (!strcmp(upload->status, DLS_UPLOAD_STATUS_QUEUED))
+		position = prv_upload_queue_position(
+					&task->target.device->upload_queue,
+					upload);
+
+	g_variant_builder_init(&vb, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add(&vb, "{sv}", DLS_INTERFACE_UPLOAD_STATUS,
+			      g_variant_new_string(upload->status));
+	g_variant_builder_add(&vb, "{sv}", DLS_INTERFACE_LENGTH,
+			      g_variant_new_uint64(upload->bytes_uploaded));
+	g_variant_builder_add(&vb, "{sv}", DLS_INTERFACE_TOTAL,
+			      g_variant_new_uint64(upload->bytes_to_upload));
+	g_variant_builder_add(&vb, "{sv}", DLS_INTERFACE_QUEUE_POSITION,
+			      g_variant_new_uint32(position));
+	g_variant_builder_add(&vb, "{sv}", DLS_INTERFACE_RETRIES,
+			      g_variant_new_uint32(upload->retries));
+
+	DLEYNA_LOG_DEBUG("Upload %u position %u retries %u",
+			 task->ut.upload_action.upload_id, position,
+			 upload->retries);
+
+	task->result = g_variant_ref_sink(g_variant_builder_end(&vb));
+
+	retval = TRUE;
+
+on_error:
+
+	DLEYNA_LOG_DEBUG("Exit");
+
+	return retval;
+}
+
+static void prv_add_upload_id(GVariantBuilder *vb,
+			      dls_device_upload_t *upload)
+{
+	g_variant_builder_add(vb, "u", (guint32) upload->job->upload_id);
+}
+
+/* IDs are returned in scheduling order: running uploads first, then the
+ * queued ones in the order in which they will start, then the finished
+ * ones.
+ */
 void dls_device_get_upload_ids(dls_task_t *task)
 {
+	dls_device_t *device = task->target.device;
 	GVariantBuilder vb;
 	GHashTableIter iter;
+	GQueue *queue;
 	gpointer key;
+	gpointer value;
+	dls_device_upload_t *upload;
 
 	DLEYNA_LOG_DEBUG("Enter");
 
 	g_variant_builder_init(&vb, G_VARIANT_TYPE("au"));
 
-	g_hash_table_iter_init(&iter, task->target.device->uploads);
-	while (g_hash_table_iter_next(&iter, &key, NULL))
-		g_variant_builder_add(&vb, "u", (guint32) (*((gint *)key)));
+	g_hash_table_iter_init(&iter, device->uploads);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		upload = value;
+		if (upload->msg &&
+		    strcmp(upload->status, DLS_UPLOAD_STATUS_QUEUED))
+			prv_add_upload_id(&vb, upload);
+	}
+
+	queue = g_queue_copy(&device->upload_queue);
+	while (!g_queue_is_empty(queue))
+		prv_add_upload_id(&vb, prv_upload_queue_pop(queue));
+	g_queue_free(queue);
+
+	g_hash_table_iter_init(&iter, device->uploads);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+		if (!((dls_device_upload_t *)value)->msg)
+			g_variant_builder_add(&vb, "u",
+					      (guint32) (*((gint *)key)));
 
 	task->result = g_variant_ref_sink(g_variant_builder_end(&vb));
 
@@ -4963,11 +8662,7 @@ gboolean dls_device_cancel_upload(dls_task_t *task, GError **error)
 		goto on_error;
 	}
 
-	if (upload->msg) {
-		soup_session_cancel_message(upload->soup_session, upload->msg,
-					    SOUP_STATUS_CANCELLED);
-		DLEYNA_LOG_DEBUG("Cancelling Upload %u ", upload_id);
-	}
+	prv_upload_cancel(task->target.device, upload);
 
 	retval = TRUE;
 
@@ -4978,6 +8673,60 @@ on_error:
 	return retval;
 }
 
+void dls_device_subscribe_changes(dls_device_t *device, const gchar *client,
+				  GVariant *paths, guint flags)
+{
+	prv_change_subscription_t *sub;
+	GVariantIter iter;
+	gchar *path;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	if (!g_variant_n_children(paths)) {
+		dls_device_unsubscribe_changes(device, client);
+		goto on_exit;
+	}
+
+	sub = g_new0(prv_change_subscription_t, 1);
+	sub->flags = flags ? flags : DLS_INTERFACE_CHANGES_ALL;
+	sub->paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+					   NULL);
+
+	(void) g_variant_iter_init(&iter, paths);
+	while (g_variant_iter_next(&iter, "o", &path))
+		(void) g_hash_table_add(sub->paths, path);
+
+	if (!device->change_subscriptions)
+		device->change_subscriptions = g_hash_table_new_full(
+					g_str_hash, g_str_equal, g_free,
+					prv_change_subscription_delete);
+
+	g_hash_table_replace(device->change_subscriptions, g_strdup(client),
+			     sub);
+
+	DLEYNA_LOG_DEBUG("%s subscribed to %u paths of %s, flags 0x%x",
+			 client, g_hash_table_size(sub->paths), device->path,
+			 sub->flags);
+
+on_exit:
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+void dls_device_unsubscribe_changes(dls_device_t *device,
+				    const gchar *client)
+{
+	if (device->change_subscriptions)
+		(void) g_hash_table_remove(device->change_subscriptions,
+					   client);
+
+	if (device->change_parents &&
+	    !g_hash_table_size(device->change_subscriptions)) {
+		dls_string_cache_delete(device->change_parents);
+		device->change_parents = NULL;
+	}
+}
+
 static void prv_destroy_object_cb(GUPnPServiceProxy *proxy,
 				  GUPnPServiceProxyAction *action,
 				  gpointer user_data)
@@ -4999,7 +8748,7 @@ static void prv_destroy_object_cb(GUPnPServiceProxy *proxy,
 					     upnp_error->message);
 	}
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
+	dls_async_task_complete_in_idle(cb_data);
 	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
 
 	if (upnp_error)
@@ -5018,6 +8767,8 @@ void dls_device_delete_object(dls_client_t *client,
 
 	context = dls_device_get_context(task->target.device, client);
 
+	prv_metadata_cache_remove(task->target.device, task->target.id);
+
 	cb_data->proxy = context->cds.proxy;
 
 	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
@@ -5108,7 +8859,7 @@ static void prv_update_object_update_cb(GUPnPServiceProxy *proxy,
 					     upnp_error->message);
 	}
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
+	dls_async_task_complete_in_idle(cb_data);
 	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
 
 	if (upnp_error)
@@ -5381,7 +9132,7 @@ static void prv_update_object_browse_cb(GUPnPServiceProxy *proxy,
 
 on_error:
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
+	dls_async_task_complete_in_idle(cb_data);
 	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
 
 no_complete:
@@ -5408,6 +9159,8 @@ void dls_device_update_object(dls_client_t *client,
 
 	context = dls_device_get_context(task->target.device, client);
 
+	prv_metadata_cache_remove(task->target.device, task->target.id);
+
 	cb_data->proxy = context->cds.proxy;
 
 	g_object_add_weak_pointer((G_OBJECT(context->cds.proxy)),
@@ -5468,7 +9221,7 @@ static void prv_get_object_metadata_cb(GUPnPServiceProxy *proxy,
 
 on_complete:
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
+	dls_async_task_complete_in_idle(cb_data);
 	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
 
 	if (error)
@@ -5553,7 +9306,7 @@ static void prv_create_reference_cb(GUPnPServiceProxy *proxy,
 
 on_error:
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
+	dls_async_task_complete_in_idle(cb_data);
 	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
 
 	g_free(object_id);
@@ -5676,7 +9429,7 @@ static void prv_get_icon_session_cb(SoupSession *session,
 					     "Failed to GET device icon");
 	}
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
+	dls_async_task_complete_in_idle(cb_data);
 	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
 
 out:
@@ -5712,7 +9465,7 @@ void dls_device_get_icon(dls_client_t *client,
 	}
 
 	download = g_new0(dls_device_download_t, 1);
-	download->session = soup_session_async_new();
+	download->session = g_object_ref(prv_get_http_session(device));
 	download->msg = soup_message_new(SOUP_METHOD_GET, url);
 	download->task = cb_data;
 
@@ -5743,7 +9496,7 @@ void dls_device_get_icon(dls_client_t *client,
 
 end:
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
+	dls_async_task_complete_in_idle(cb_data);
 }
 
 static void prv_free_tcp_data(dls_tcp_wake_t *tcp_data)
@@ -5858,7 +9611,7 @@ on_complete:
 	prv_free_tcp_data(tcp_data);
 
 	if (!g_cancellable_is_cancelled(cb_data->cancellable)) {
-		(void) g_idle_add(dls_async_task_complete, cb_data);
+		dls_async_task_complete_in_idle(cb_data);
 
 		if (cb_data->task.target.device->sleeping_context != NULL)
 			prv_start_wake_on_watcher(cb_data->task.target.device,
@@ -6204,7 +9957,7 @@ on_complete:
 
 	g_free(packet);
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
+	dls_async_task_complete_in_idle(cb_data);
 
 on_exit:
 	g_free(broadcast_ip_address);
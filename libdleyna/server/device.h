@@ -24,13 +24,17 @@
 #define DLS_DEVICE_H__
 
 #include <libgupnp/gupnp-control-point.h>
+#include <libsoup/soup.h>
 
 #include <libdleyna/core/connector.h>
 #include <libdleyna/core/task-processor.h>
 
 #include "async.h"
+#include "cache.h"
+#include "changes.h"
 #include "client.h"
 #include "props.h"
+#include "rate-limit.h"
 
 typedef struct dls_network_if_info_t_ dls_network_if_info_t;
 struct dls_network_if_info_t_ {
@@ -59,8 +63,15 @@ struct dls_device_context_t_ {
 	dls_device_t *device;
 	dls_service_t cds;
 	dls_service_t ems;
+	GHashTable *metadata_cache;
+	GQueue metadata_lru;
+	GQueue browse_windows;
+	guint child_counts_in_flight;
+	GQueue child_count_waiters;
 };
 
+typedef struct dls_device_revalidate_t_ dls_device_revalidate_t;
+
 typedef struct dls_device_icon_t_ dls_device_icon_t;
 struct dls_device_icon_t_ {
 	gchar *mime_type;
@@ -87,9 +98,26 @@ struct dls_device_t_ {
 	gboolean shutting_down;
 	gboolean has_last_change;
 	guint construct_step;
+	dls_device_revalidate_t *revalidate;
 	dls_device_icon_t icon;
 	gboolean sleeping;
 	dls_network_if_info_t *network_if_info;
+	guint64 metadata_cache_hits;
+	guint64 metadata_cache_misses;
+	GHashTable *child_counts;
+	GQueue child_count_lru;
+	SoupSession *http_session;
+	guint http_settings_generation;
+	GQueue upload_queue;
+	guint uploads_in_flight;
+	dls_rate_limit_t upload_budget;
+	guint upload_progress_id;
+	dls_change_queue_t changed_events;
+	dls_change_queue_t container_updates;
+	guint changed_flush_id;
+	GHashTable *change_subscriptions;
+	dls_string_cache_t *change_parents;
+	GHashTable *browse_flights;
 };
 
 dls_device_context_t *dls_device_append_new_context(dls_device_t *device,
@@ -119,8 +147,6 @@ dls_device_t *dls_device_new(
 			const char *udn,
 			const dleyna_task_queue_key_t *queue_id);
 
-dls_device_t *dls_device_from_path(const gchar *path, GHashTable *device_list);
-
 dls_device_context_t *dls_device_get_context(const dls_device_t *device,
 					     dls_client_t *client);
 
@@ -154,10 +180,21 @@ void dls_device_subscribe_to_service_changes(dls_device_t *device);
 void dls_device_upload(dls_client_t *client,
 		       dls_task_t *task, const gchar *parent_id);
 
+void dls_device_upload_many(dls_client_t *client,
+			    dls_task_t *task, const gchar *parent_id);
+
 gboolean dls_device_get_upload_status(dls_task_t *task, GError **error);
 
+gboolean dls_device_get_upload_info(dls_task_t *task, GError **error);
+
 gboolean dls_device_cancel_upload(dls_task_t *task, GError **error);
 
+void dls_device_subscribe_changes(dls_device_t *device, const gchar *client,
+				  GVariant *paths, guint flags);
+
+void dls_device_unsubscribe_changes(dls_device_t *device,
+				    const gchar *client);
+
 void dls_device_get_upload_ids(dls_task_t *task);
 
 void dls_device_delete_object(dls_client_t *client,
@@ -181,6 +218,65 @@ void dls_device_create_reference(dls_client_t *client,
 void dls_device_get_icon(dls_client_t *client,
 			 dls_task_t *task);
 
+void dls_device_get_metadata_cache_stats(guint64 *hits, guint64 *misses);
+
+guint dls_device_get_child_count_max_in_flight(void);
+
+void dls_device_set_child_count_max_in_flight(guint max_in_flight);
+
+guint dls_device_get_browse_objects_max_in_flight(void);
+
+void dls_device_set_browse_objects_max_in_flight(guint max_in_flight);
+
+guint dls_device_get_browse_objects_batch_size(void);
+
+void dls_device_set_browse_objects_batch_size(guint batch_size);
+
+guint dls_device_get_http_max_conns_per_host(void);
+
+void dls_device_set_http_max_conns_per_host(guint max_conns);
+
+guint dls_device_get_http_idle_timeout(void);
+
+void dls_device_set_http_idle_timeout(guint timeout);
+
+void dls_device_get_http_stats(guint64 *requests, guint64 *connections);
+
+guint dls_device_get_max_concurrent_uploads(void);
+
+void dls_device_set_max_concurrent_uploads(guint max_uploads);
+
+guint dls_device_get_upload_rate_limit(void);
+
+void dls_device_set_upload_rate_limit(guint rate_limit);
+
+const gchar *dls_device_get_upload_order(void);
+
+gboolean dls_device_set_upload_order(const gchar *order);
+
+guint dls_device_get_upload_progress_interval(void);
+
+void dls_device_set_upload_progress_interval(guint interval);
+
+guint dls_device_get_upload_progress_step(void);
+
+void dls_device_set_upload_progress_step(guint step);
+
+guint dls_device_get_upload_max_retries(void);
+
+void dls_device_set_upload_max_retries(guint max_retries);
+
+guint dls_device_get_changed_flush_interval(void);
+
+void dls_device_set_changed_flush_interval(guint interval);
+
+guint dls_device_get_changed_max_batch(void);
+
+void dls_device_set_changed_max_batch(guint max_batch);
+
+void dls_device_get_changed_stats(guint64 *received, guint64 *emitted,
+				  guint64 *subscribed);
+
 void dls_device_wake(dls_client_t *client,
 		     dls_task_t *task);
 
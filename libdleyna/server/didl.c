@@ -0,0 +1,307 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <string.h>
+
+#include <libxml/parser.h>
+#include <libgupnp/gupnp-error.h>
+
+#include <libdleyna/core/log.h>
+
+#include "didl.h"
+#include "props.h"
+
+/* Properties that can be computed from the attributes and the simple
+ * child elements of a DIDL-Lite object.  Anything else, resources in
+ * particular, needs the full GUPnPDIDLLiteObject.
+ */
+#define DLS_DIDL_STREAMABLE_MASK (DLS_UPNP_MASK_PROP_PARENT |		\
+				  DLS_UPNP_MASK_PROP_TYPE |		\
+				  DLS_UPNP_MASK_PROP_TYPE_EX |		\
+				  DLS_UPNP_MASK_PROP_PATH |		\
+				  DLS_UPNP_MASK_PROP_DISPLAY_NAME |	\
+				  DLS_UPNP_MASK_PROP_CREATOR |		\
+				  DLS_UPNP_MASK_PROP_RESTRICTED |	\
+				  DLS_UPNP_MASK_PROP_DLNA_MANAGED |	\
+				  DLS_UPNP_MASK_PROP_CHILD_COUNT |	\
+				  DLS_UPNP_MASK_PROP_SEARCHABLE |	\
+				  DLS_UPNP_MASK_PROP_ARTIST |		\
+				  DLS_UPNP_MASK_PROP_ALBUM |		\
+				  DLS_UPNP_MASK_PROP_DATE |		\
+				  DLS_UPNP_MASK_PROP_GENRE |		\
+				  DLS_UPNP_MASK_PROP_TRACK_NUMBER |	\
+				  DLS_UPNP_MASK_PROP_ALBUM_ART_URL |	\
+				  DLS_UPNP_MASK_PROP_REFPATH |		\
+				  DLS_UPNP_MASK_PROP_OBJECT_UPDATE_ID |	\
+				  DLS_UPNP_MASK_PROP_CONTAINER_UPDATE_ID | \
+				  DLS_UPNP_MASK_PROP_TOTAL_DELETED_CHILD_COUNT)
+
+#define DLS_DIDL_DEPTH_ROOT 1
+#define DLS_DIDL_DEPTH_OBJECT 2
+#define DLS_DIDL_DEPTH_PROP 3
+
+#define DLS_DIDL_NS_DC "http://purl.org/dc/elements/1.1/"
+#define DLS_DIDL_NS_UPNP "urn:schemas-upnp-org:metadata-1-0/upnp/"
+#define DLS_DIDL_NS_DLNA "urn:schemas-dlna-org:metadata-1-0/"
+
+typedef struct dls_didl_prop_map_t_ dls_didl_prop_map_t;
+struct dls_didl_prop_map_t_ {
+	const gchar *name;
+	const gchar *ns; /* NULL for unqualified attributes */
+	gboolean attribute;
+	dls_upnp_prop_mask mask; /* 0 means always needed */
+};
+
+typedef struct dls_didl_parser_t_ dls_didl_parser_t;
+struct dls_didl_parser_t_ {
+	dls_upnp_prop_mask filter_mask;
+	dls_didl_object_cb_t cb;
+	gpointer user_data;
+	dls_didl_object_t object;
+	guint depth;
+	gboolean has_root;
+	gboolean in_object;
+	gint prop;
+	GString *text;
+};
+
+static const dls_didl_prop_map_t g_didl_props[DLS_DIDL_PROP_COUNT] = {
+	[DLS_DIDL_PROP_ID] = {"id", NULL, TRUE, 0},
+	[DLS_DIDL_PROP_PARENT_ID] = {"parentID", NULL, TRUE, 0},
+	[DLS_DIDL_PROP_REF_ID] = {"refID", NULL, TRUE,
+				  DLS_UPNP_MASK_PROP_REFPATH},
+	[DLS_DIDL_PROP_RESTRICTED] = {"restricted", NULL, TRUE,
+				      DLS_UPNP_MASK_PROP_RESTRICTED},
+	[DLS_DIDL_PROP_SEARCHABLE] = {"searchable", NULL, TRUE,
+				      DLS_UPNP_MASK_PROP_SEARCHABLE},
+	[DLS_DIDL_PROP_CHILD_COUNT] = {"childCount", NULL, TRUE,
+				       DLS_UPNP_MASK_PROP_CHILD_COUNT},
+	[DLS_DIDL_PROP_DLNA_MANAGED] = {"dlnaManaged", DLS_DIDL_NS_DLNA, TRUE,
+					DLS_UPNP_MASK_PROP_DLNA_MANAGED},
+	[DLS_DIDL_PROP_TITLE] = {"title", DLS_DIDL_NS_DC, FALSE,
+				 DLS_UPNP_MASK_PROP_DISPLAY_NAME},
+	[DLS_DIDL_PROP_CREATOR] = {"creator", DLS_DIDL_NS_DC, FALSE,
+				   DLS_UPNP_MASK_PROP_CREATOR},
+	[DLS_DIDL_PROP_CLASS] = {"class", DLS_DIDL_NS_UPNP, FALSE, 0},
+	[DLS_DIDL_PROP_ARTIST] = {"artist", DLS_DIDL_NS_UPNP, FALSE,
+				  DLS_UPNP_MASK_PROP_ARTIST},
+	[DLS_DIDL_PROP_ALBUM] = {"album", DLS_DIDL_NS_UPNP, FALSE,
+				 DLS_UPNP_MASK_PROP_ALBUM},
+	[DLS_DIDL_PROP_DATE] = {"date", DLS_DIDL_NS_DC, FALSE,
+				DLS_UPNP_MASK_PROP_DATE},
+	[DLS_DIDL_PROP_GENRE] = {"genre", DLS_DIDL_NS_UPNP, FALSE,
+				 DLS_UPNP_MASK_PROP_GENRE},
+	[DLS_DIDL_PROP_TRACK_NUMBER] = {"originalTrackNumber",
+					DLS_DIDL_NS_UPNP, FALSE,
+					DLS_UPNP_MASK_PROP_TRACK_NUMBER},
+	[DLS_DIDL_PROP_ALBUM_ART_URL] = {"albumArtURI", DLS_DIDL_NS_UPNP,
+					 FALSE,
+					 DLS_UPNP_MASK_PROP_ALBUM_ART_URL},
+	[DLS_DIDL_PROP_OBJECT_UPDATE_ID] = {
+				"objectUpdateID", DLS_DIDL_NS_UPNP, FALSE,
+				DLS_UPNP_MASK_PROP_OBJECT_UPDATE_ID},
+	[DLS_DIDL_PROP_CONTAINER_UPDATE_ID] = {
+				"containerUpdateID", DLS_DIDL_NS_UPNP, FALSE,
+				DLS_UPNP_MASK_PROP_CONTAINER_UPDATE_ID},
+	[DLS_DIDL_PROP_TOTAL_DELETED_CHILD_COUNT] = {
+				"totalDeletedChildCount", DLS_DIDL_NS_UPNP,
+				FALSE,
+				DLS_UPNP_MASK_PROP_TOTAL_DELETED_CHILD_COUNT}
+};
+
+static gboolean prv_ns_equal(const gchar *ns, const xmlChar *uri)
+{
+	if (!ns || !uri)
+		return ns == (const gchar *)uri;
+
+	return !strcmp(ns, (const char *)uri);
+}
+
+static gint prv_find_prop(dls_didl_parser_t *parser, const xmlChar *name,
+			  const xmlChar *uri, gboolean attribute)
+{
+	const dls_didl_prop_map_t *map;
+	gint i;
+
+	for (i = 0; i < DLS_DIDL_PROP_COUNT; i++) {
+		map = &g_didl_props[i];
+
+		if ((map->attribute != attribute) ||
+		    strcmp(map->name, (const char *)name) ||
+		    !prv_ns_equal(map->ns, uri))
+			continue;
+
+		/* Unrequested and repeated properties are skipped */
+		if ((map->mask && !(parser->filter_mask & map->mask)) ||
+		    parser->object.props[i])
+			break;
+
+		return i;
+	}
+
+	return -1;
+}
+
+static void prv_object_clear(dls_didl_object_t *object)
+{
+	guint i;
+
+	for (i = 0; i < DLS_DIDL_PROP_COUNT; i++) {
+		g_free(object->props[i]);
+		object->props[i] = NULL;
+	}
+
+	object->container = FALSE;
+}
+
+static void prv_read_attributes(dls_didl_parser_t *parser,
+				int nb_attributes, const xmlChar **attributes)
+{
+	gint prop;
+	int i;
+
+	/* localname, prefix, URI, value, end */
+	for (i = 0; i < nb_attributes; i++, attributes += 5) {
+		prop = prv_find_prop(parser, attributes[0], attributes[2],
+				     TRUE);
+
+		if (prop >= 0)
+			parser->object.props[prop] = g_strndup(
+					(const gchar *)attributes[3],
+					attributes[4] - attributes[3]);
+	}
+}
+
+static void prv_start_element(void *ctx, const xmlChar *localname,
+			      const xmlChar *prefix, const xmlChar *uri,
+			      int nb_namespaces, const xmlChar **namespaces,
+			      int nb_attributes, int nb_defaulted,
+			      const xmlChar **attributes)
+{
+	dls_didl_parser_t *parser = ctx;
+	const char *name = (const char *)localname;
+
+	parser->depth++;
+
+	if (parser->depth == DLS_DIDL_DEPTH_ROOT) {
+		parser->has_root = !strcmp(name, "DIDL-Lite");
+	} else if (parser->depth == DLS_DIDL_DEPTH_OBJECT) {
+		if (!parser->has_root)
+			return;
+
+		parser->object.container = !strcmp(name, "container");
+
+		if (!parser->object.container && strcmp(name, "item"))
+			return;
+
+		parser->in_object = TRUE;
+		prv_read_attributes(parser, nb_attributes, attributes);
+	} else if (parser->depth == DLS_DIDL_DEPTH_PROP && parser->in_object) {
+		parser->prop = prv_find_prop(parser, localname, uri, FALSE);
+		g_string_truncate(parser->text, 0);
+	}
+}
+
+static void prv_end_element(void *ctx, const xmlChar *localname,
+			    const xmlChar *prefix, const xmlChar *uri)
+{
+	dls_didl_parser_t *parser = ctx;
+
+	if (parser->depth == DLS_DIDL_DEPTH_PROP && parser->prop >= 0) {
+		parser->object.props[parser->prop] =
+			g_strndup(parser->text->str, parser->text->len);
+		parser->prop = -1;
+	} else if (parser->depth == DLS_DIDL_DEPTH_OBJECT &&
+		   parser->in_object) {
+		parser->cb(&parser->object, parser->user_data);
+		prv_object_clear(&parser->object);
+		parser->in_object = FALSE;
+	}
+
+	parser->depth--;
+}
+
+static void prv_characters(void *ctx, const xmlChar *ch, int len)
+{
+	dls_didl_parser_t *parser = ctx;
+
+	if (parser->depth == DLS_DIDL_DEPTH_PROP && parser->prop >= 0)
+		g_string_append_len(parser->text, (const gchar *)ch, len);
+}
+
+gboolean dls_didl_can_stream(dls_upnp_prop_mask filter_mask)
+{
+	return !(filter_mask & ~DLS_DIDL_STREAMABLE_MASK);
+}
+
+gboolean dls_didl_parse(const gchar *didl, dls_upnp_prop_mask filter_mask,
+			dls_didl_object_cb_t cb, gpointer user_data,
+			GError **error)
+{
+	xmlSAXHandler handler;
+	xmlParserCtxtPtr ctxt;
+	dls_didl_parser_t parser;
+	gboolean retval = FALSE;
+
+	memset(&handler, 0, sizeof(handler));
+	handler.initialized = XML_SAX2_MAGIC;
+	handler.startElementNs = prv_start_element;
+	handler.endElementNs = prv_end_element;
+	handler.characters = prv_characters;
+
+	memset(&parser, 0, sizeof(parser));
+	parser.filter_mask = filter_mask;
+	parser.cb = cb;
+	parser.user_data = user_data;
+	parser.prop = -1;
+	parser.text = g_string_new(NULL);
+
+	ctxt = xmlCreatePushParserCtxt(&handler, &parser, NULL, 0, NULL);
+	if (!ctxt) {
+		*error = g_error_new(GUPNP_XML_ERROR, GUPNP_XML_ERROR_PARSE,
+				     "Could not create DIDL-Lite parser");
+		goto on_exit;
+	}
+
+	(void) xmlCtxtUseOptions(ctxt, XML_PARSE_NONET | XML_PARSE_NOERROR |
+				 XML_PARSE_NOWARNING);
+	(void) xmlParseChunk(ctxt, didl, strlen(didl), 1);
+
+	if (!ctxt->wellFormed) {
+		DLEYNA_LOG_WARNING("DIDL-Lite parse error: %s",
+				   ctxt->lastError.message ?
+				   ctxt->lastError.message : "");
+		*error = g_error_new(GUPNP_XML_ERROR, GUPNP_XML_ERROR_PARSE,
+				     "Could not parse DIDL-Lite XML");
+	} else if (!parser.has_root)
+		*error = g_error_new(GUPNP_XML_ERROR, GUPNP_XML_ERROR_NO_NODE,
+				     "Missing DIDL-Lite element");
+	else
+		retval = TRUE;
+
+	xmlFreeParserCtxt(ctxt);
+
+on_exit:
+
+	prv_object_clear(&parser.object);
+	(void) g_string_free(parser.text, TRUE);
+
+	return retval;
+}
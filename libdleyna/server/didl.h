@@ -0,0 +1,71 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef DLS_DIDL_H__
+#define DLS_DIDL_H__
+
+#include <glib.h>
+
+#include "async.h"
+
+/* Attributes and elements of a DIDL-Lite object that the streaming parser
+ * knows how to extract.  They are stored as raw strings, and only when
+ * the filter mask asks for them.
+ */
+enum dls_didl_prop_t_ {
+	DLS_DIDL_PROP_ID,
+	DLS_DIDL_PROP_PARENT_ID,
+	DLS_DIDL_PROP_REF_ID,
+	DLS_DIDL_PROP_RESTRICTED,
+	DLS_DIDL_PROP_SEARCHABLE,
+	DLS_DIDL_PROP_CHILD_COUNT,
+	DLS_DIDL_PROP_DLNA_MANAGED,
+	DLS_DIDL_PROP_TITLE,
+	DLS_DIDL_PROP_CREATOR,
+	DLS_DIDL_PROP_CLASS,
+	DLS_DIDL_PROP_ARTIST,
+	DLS_DIDL_PROP_ALBUM,
+	DLS_DIDL_PROP_DATE,
+	DLS_DIDL_PROP_GENRE,
+	DLS_DIDL_PROP_TRACK_NUMBER,
+	DLS_DIDL_PROP_ALBUM_ART_URL,
+	DLS_DIDL_PROP_OBJECT_UPDATE_ID,
+	DLS_DIDL_PROP_CONTAINER_UPDATE_ID,
+	DLS_DIDL_PROP_TOTAL_DELETED_CHILD_COUNT,
+	DLS_DIDL_PROP_COUNT
+};
+typedef enum dls_didl_prop_t_ dls_didl_prop_t;
+
+typedef struct dls_didl_object_t_ dls_didl_object_t;
+struct dls_didl_object_t_ {
+	gboolean container;
+	gchar *props[DLS_DIDL_PROP_COUNT];
+};
+
+typedef void (*dls_didl_object_cb_t)(const dls_didl_object_t *object,
+				     gpointer user_data);
+
+gboolean dls_didl_can_stream(dls_upnp_prop_mask filter_mask);
+
+gboolean dls_didl_parse(const gchar *didl, dls_upnp_prop_mask filter_mask,
+			dls_didl_object_cb_t cb, gpointer user_data,
+			GError **error);
+
+#endif /* DLS_DIDL_H__ */
@@ -52,6 +52,44 @@ enum dls_interface_type_ {
 #define DLS_INTERFACE_PROP_NEVER_QUIT "NeverQuit"
 #define DLS_INTERFACE_PROP_WHITE_LIST_ENTRIES "WhiteListEntries"
 #define DLS_INTERFACE_PROP_WHITE_LIST_ENABLED "WhiteListEnabled"
+#define DLS_INTERFACE_PROP_METADATA_CACHE_HITS "MetadataCacheHits"
+#define DLS_INTERFACE_PROP_METADATA_CACHE_MISSES "MetadataCacheMisses"
+#define DLS_INTERFACE_PROP_MAX_CHILD_COUNT_REQUESTS "MaxChildCountRequests"
+#define DLS_INTERFACE_PROP_MAX_BROWSE_OBJECTS_REQUESTS \
+	"MaxBrowseObjectsRequests"
+#define DLS_INTERFACE_PROP_BROWSE_OBJECTS_BATCH_SIZE \
+	"BrowseObjectsBatchSize"
+#define DLS_INTERFACE_PROP_MAX_HTTP_CONNECTIONS_PER_HOST \
+	"MaxHTTPConnectionsPerHost"
+#define DLS_INTERFACE_PROP_HTTP_IDLE_TIMEOUT "HTTPIdleTimeout"
+#define DLS_INTERFACE_PROP_HTTP_REQUESTS "HTTPRequests"
+#define DLS_INTERFACE_PROP_HTTP_CONNECTIONS "HTTPConnections"
+#define DLS_INTERFACE_PROP_MAX_CONCURRENT_UPLOADS "MaxConcurrentUploads"
+#define DLS_INTERFACE_PROP_UPLOAD_RATE_LIMIT "UploadRateLimit"
+#define DLS_INTERFACE_PROP_UPLOAD_ORDER "UploadOrder"
+#define DLS_INTERFACE_PROP_UPLOAD_PROGRESS_INTERVAL "UploadProgressInterval"
+#define DLS_INTERFACE_PROP_UPLOAD_PROGRESS_STEP "UploadProgressStep"
+#define DLS_INTERFACE_PROP_UPLOAD_MAX_RETRIES "UploadMaxRetries"
+#define DLS_INTERFACE_PROP_CHANGED_FLUSH_INTERVAL "ChangedFlushInterval"
+#define DLS_INTERFACE_PROP_CHANGED_MAX_BATCH "ChangedMaxBatch"
+#define DLS_INTERFACE_PROP_CHANGED_EVENTS_RECEIVED "ChangedEventsReceived"
+#define DLS_INTERFACE_PROP_CHANGED_SIGNALS_EMITTED "ChangedSignalsEmitted"
+#define DLS_INTERFACE_PROP_SUBSCRIBED_CHANGES_EMITTED \
+	"SubscribedChangesEmitted"
+#define DLS_INTERFACE_PROP_MAX_CONCURRENT_READ_TASKS "MaxConcurrentReadTasks"
+#define DLS_INTERFACE_PROP_EXPIRED_TASKS "ExpiredTasks"
+
+/* SubscribeChanges Flags, one bit per ChangeType */
+#define DLS_INTERFACE_CHANGES_ADD 0x01
+#define DLS_INTERFACE_CHANGES_MOD 0x02
+#define DLS_INTERFACE_CHANGES_DEL 0x04
+#define DLS_INTERFACE_CHANGES_DONE 0x08
+#define DLS_INTERFACE_CHANGES_CONTAINER 0x10
+#define DLS_INTERFACE_CHANGES_SYSTEM_UPDATE 0x20
+#define DLS_INTERFACE_CHANGES_ALL 0x3f
+
+#define DLS_INTERFACE_UPLOAD_ORDER_FIFO "FIFO"
+#define DLS_INTERFACE_UPLOAD_ORDER_SMALLEST_FIRST "SmallestFirst"
 
 /* Object Properties */
 #define DLS_INTERFACE_PROP_PATH "Path"
@@ -137,6 +175,7 @@ enum dls_interface_type_ {
 #define DLS_INTERFACE_RELEASE "Release"
 #define DLS_INTERFACE_SET_PROTOCOL_INFO "SetProtocolInfo"
 #define DLS_INTERFACE_PREFER_LOCAL_ADDRESSES "PreferLocalAddresses"
+#define DLS_INTERFACE_SET_REQUEST_TIMEOUT "SetRequestTimeout"
 
 #define DLS_INTERFACE_WHITE_LIST_ENABLE "WhiteListEnable"
 #define DLS_INTERFACE_WHITE_LIST_ADD_ENTRIES "WhiteListAddEntries"
@@ -176,6 +215,7 @@ enum dls_interface_type_ {
 #define DLS_INTERFACE_QUERY "Query"
 #define DLS_INTERFACE_PROTOCOL_INFO "ProtocolInfo"
 #define DLS_INTERFACE_PREFER "Prefer"
+#define DLS_INTERFACE_TIMEOUT "Timeout"
 
 #define DLS_INTERFACE_OFFSET "Offset"
 #define DLS_INTERFACE_MAX "Max"
@@ -199,16 +239,32 @@ enum dls_interface_type_ {
 
 #define DLS_INTERFACE_UPLOAD "Upload"
 #define DLS_INTERFACE_UPLOAD_TO_ANY "UploadToAnyContainer"
+#define DLS_INTERFACE_UPLOAD_MANY "UploadMany"
+#define DLS_INTERFACE_UPLOAD_MANY_TO_ANY "UploadManyToAnyContainer"
+#define DLS_INTERFACE_FILES "Files"
+#define DLS_INTERFACE_UPLOAD_FD "UploadFd"
+#define DLS_INTERFACE_UPLOAD_FD_TO_ANY "UploadFdToAnyContainer"
+#define DLS_INTERFACE_FD "Fd"
 #define DLS_INTERFACE_GET_UPLOAD_STATUS "GetUploadStatus"
+#define DLS_INTERFACE_GET_UPLOAD_INFO "GetUploadInfo"
 #define DLS_INTERFACE_GET_UPLOAD_IDS "GetUploadIDs"
 #define DLS_INTERFACE_CANCEL_UPLOAD "CancelUpload"
+#define DLS_INTERFACE_SUBSCRIBE_CHANGES "SubscribeChanges"
+#define DLS_INTERFACE_SUBSCRIBED_CHANGES "SubscribedChanges"
+#define DLS_INTERFACE_PATHS "Paths"
+#define DLS_INTERFACE_FLAGS "Flags"
 #define DLS_INTERFACE_TOTAL "Total"
 #define DLS_INTERFACE_LENGTH "Length"
+#define DLS_INTERFACE_QUEUE_POSITION "QueuePosition"
+#define DLS_INTERFACE_RETRIES "Retries"
 #define DLS_INTERFACE_FILE_PATH "FilePath"
 #define DLS_INTERFACE_UPLOAD_ID "UploadId"
 #define DLS_INTERFACE_UPLOAD_IDS "UploadIDs"
 #define DLS_INTERFACE_UPLOAD_STATUS "UploadStatus"
+#define DLS_INTERFACE_UPLOAD_INFO "UploadInfo"
 #define DLS_INTERFACE_UPLOAD_UPDATE "UploadUpdate"
+#define DLS_INTERFACE_UPLOAD_PROGRESS "UploadProgress"
+#define DLS_INTERFACE_UPLOADS "Uploads"
 #define DLS_INTERFACE_TO_ADD_UPDATE "ToAddUpdate"
 #define DLS_INTERFACE_TO_DELETE "ToDelete"
 #define DLS_INTERFACE_CANCEL "Cancel"
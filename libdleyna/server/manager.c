@@ -28,9 +28,11 @@
 #include <libdleyna/core/service-task.h>
 #include <libdleyna/core/white-list.h>
 
+#include "device.h"
 #include "interface.h"
 #include "manager.h"
 #include "props.h"
+#include "server.h"
 
 struct dls_manager_t_ {
 	dleyna_connector_id_t connection;
@@ -122,7 +124,7 @@ void dls_manager_get_all_props(dls_manager_t *manager,
 					     "Interface is unknown.");
 	}
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
+	dls_async_task_complete_in_idle(cb_data);
 
 	DLEYNA_LOG_DEBUG("Exit");
 }
@@ -162,7 +164,7 @@ void dls_manager_get_prop(dls_manager_t *manager,
 					     "Interface is unknown.");
 	}
 
-	(void) g_idle_add(dls_async_task_complete, cb_data);
+	dls_async_task_complete_in_idle(cb_data);
 
 	DLEYNA_LOG_DEBUG("Exit");
 }
@@ -265,6 +267,105 @@ exit:
 	DLEYNA_LOG_DEBUG("Exit");
 }
 
+/* Unlike NeverQuit and the white list, which are stored by
+   dleyna_settings, the tunables set through these helpers are process
+   wide and are not saved: they apply to every server and revert to their
+   defaults when the service restarts. */
+
+typedef guint (*dls_manager_get_uint_t)(void);
+typedef void (*dls_manager_set_uint_t)(guint value);
+
+static void prv_set_prop_uint(dls_manager_t *manager,
+			      const gchar *prop_name,
+			      GVariant *param,
+			      dls_manager_get_uint_t get_value,
+			      dls_manager_set_uint_t set_value,
+			      GError **error)
+{
+	guint value;
+
+	DLEYNA_LOG_DEBUG("Enter %s", prop_name);
+
+	if (!g_variant_is_of_type(param, G_VARIANT_TYPE_UINT32)) {
+		DLEYNA_LOG_WARNING("Invalid parameter type. 'u' expected.");
+
+		*error = g_error_new(DLEYNA_SERVER_ERROR,
+				     DLEYNA_ERROR_BAD_QUERY,
+				     "Invalid parameter type. 'u' expected.");
+		goto exit;
+	}
+
+	value = g_variant_get_uint32(param);
+
+	if (value == get_value())
+		goto exit;
+
+	set_value(value);
+
+	prv_wl_notify_prop(manager, prop_name, param);
+
+exit:
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+static void prv_set_prop_non_zero_uint(dls_manager_t *manager,
+				       const gchar *prop_name,
+				       GVariant *param,
+				       dls_manager_get_uint_t get_value,
+				       dls_manager_set_uint_t set_value,
+				       GError **error)
+{
+	if (g_variant_is_of_type(param, G_VARIANT_TYPE_UINT32) &&
+	    g_variant_get_uint32(param) == 0) {
+		DLEYNA_LOG_WARNING("Invalid parameter. Non zero 'u' expected.");
+
+		*error = g_error_new(DLEYNA_SERVER_ERROR,
+				     DLEYNA_ERROR_BAD_QUERY,
+				     "Invalid parameter. Non zero 'u' expected.");
+		return;
+	}
+
+	prv_set_prop_uint(manager, prop_name, param, get_value, set_value,
+			  error);
+}
+
+static void prv_set_prop_upload_order(dls_manager_t *manager,
+				      GVariant *param,
+				      GError **error)
+{
+	const gchar *order;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	if (!g_variant_is_of_type(param, G_VARIANT_TYPE_STRING)) {
+		DLEYNA_LOG_WARNING("Invalid parameter type. 's' expected.");
+
+		*error = g_error_new(DLEYNA_SERVER_ERROR,
+				     DLEYNA_ERROR_BAD_QUERY,
+				     "Invalid parameter type. 's' expected.");
+		goto exit;
+	}
+
+	order = g_variant_get_string(param, NULL);
+
+	if (!strcmp(order, dls_device_get_upload_order()))
+		goto exit;
+
+	if (!dls_device_set_upload_order(order)) {
+		DLEYNA_LOG_WARNING("Unknown upload order %s", order);
+
+		*error = g_error_new(DLEYNA_SERVER_ERROR,
+				     DLEYNA_ERROR_BAD_QUERY,
+				     "Unknown upload order %s", order);
+		goto exit;
+	}
+
+	prv_wl_notify_prop(manager, DLS_INTERFACE_PROP_UPLOAD_ORDER, param);
+
+exit:
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
 void dls_manager_set_prop(dls_manager_t *manager,
 			  dleyna_settings_t *settings,
 			  dls_task_t *task,
@@ -304,6 +405,82 @@ void dls_manager_set_prop(dls_manager_t *manager,
 					&error);
 	else if (!strcmp(name, DLS_INTERFACE_PROP_WHITE_LIST_ENTRIES))
 		prv_set_prop_wl_entries(manager, settings, param, &error);
+	else if (!strcmp(name, DLS_INTERFACE_PROP_MAX_CHILD_COUNT_REQUESTS))
+		prv_set_prop_non_zero_uint(
+				manager, name, param,
+				dls_device_get_child_count_max_in_flight,
+				dls_device_set_child_count_max_in_flight,
+				&error);
+	else if (!strcmp(name, DLS_INTERFACE_PROP_MAX_BROWSE_OBJECTS_REQUESTS))
+		prv_set_prop_non_zero_uint(
+				manager, name, param,
+				dls_device_get_browse_objects_max_in_flight,
+				dls_device_set_browse_objects_max_in_flight,
+				&error);
+	else if (!strcmp(name, DLS_INTERFACE_PROP_BROWSE_OBJECTS_BATCH_SIZE))
+		prv_set_prop_non_zero_uint(
+				manager, name, param,
+				dls_device_get_browse_objects_batch_size,
+				dls_device_set_browse_objects_batch_size,
+				&error);
+	else if (!strcmp(name,
+			 DLS_INTERFACE_PROP_MAX_HTTP_CONNECTIONS_PER_HOST))
+		prv_set_prop_non_zero_uint(
+				manager, name, param,
+				dls_device_get_http_max_conns_per_host,
+				dls_device_set_http_max_conns_per_host,
+				&error);
+	else if (!strcmp(name, DLS_INTERFACE_PROP_HTTP_IDLE_TIMEOUT))
+		prv_set_prop_non_zero_uint(
+				manager, name, param,
+				dls_device_get_http_idle_timeout,
+				dls_device_set_http_idle_timeout,
+				&error);
+	else if (!strcmp(name, DLS_INTERFACE_PROP_MAX_CONCURRENT_UPLOADS))
+		prv_set_prop_non_zero_uint(
+				manager, name, param,
+				dls_device_get_max_concurrent_uploads,
+				dls_device_set_max_concurrent_uploads,
+				&error);
+	else if (!strcmp(name, DLS_INTERFACE_PROP_UPLOAD_RATE_LIMIT))
+		prv_set_prop_uint(manager, name, param,
+				  dls_device_get_upload_rate_limit,
+				  dls_device_set_upload_rate_limit,
+				  &error);
+	else if (!strcmp(name, DLS_INTERFACE_PROP_UPLOAD_ORDER))
+		prv_set_prop_upload_order(manager, param, &error);
+	else if (!strcmp(name, DLS_INTERFACE_PROP_UPLOAD_PROGRESS_INTERVAL))
+		prv_set_prop_uint(manager, name, param,
+				  dls_device_get_upload_progress_interval,
+				  dls_device_set_upload_progress_interval,
+				  &error);
+	else if (!strcmp(name, DLS_INTERFACE_PROP_UPLOAD_PROGRESS_STEP))
+		prv_set_prop_uint(manager, name, param,
+				  dls_device_get_upload_progress_step,
+				  dls_device_set_upload_progress_step,
+				  &error);
+	else if (!strcmp(name, DLS_INTERFACE_PROP_UPLOAD_MAX_RETRIES))
+		prv_set_prop_uint(manager, name, param,
+				  dls_device_get_upload_max_retries,
+				  dls_device_set_upload_max_retries,
+				  &error);
+	else if (!strcmp(name, DLS_INTERFACE_PROP_CHANGED_FLUSH_INTERVAL))
+		prv_set_prop_uint(manager, name, param,
+				  dls_device_get_changed_flush_interval,
+				  dls_device_set_changed_flush_interval,
+				  &error);
+	else if (!strcmp(name, DLS_INTERFACE_PROP_CHANGED_MAX_BATCH))
+		prv_set_prop_non_zero_uint(
+				manager, name, param,
+				dls_device_get_changed_max_batch,
+				dls_device_set_changed_max_batch,
+				&error);
+	else if (!strcmp(name, DLS_INTERFACE_PROP_MAX_CONCURRENT_READ_TASKS))
+		prv_set_prop_non_zero_uint(
+				manager, name, param,
+				dls_server_get_max_concurrent_read_tasks,
+				dls_server_set_max_concurrent_read_tasks,
+				&error);
 	else
 		cb_data->error = g_error_new(DLEYNA_SERVER_ERROR,
 					     DLEYNA_ERROR_UNKNOWN_PROPERTY,
@@ -313,6 +490,6 @@ void dls_manager_set_prop(dls_manager_t *manager,
 		cb_data->error = error;
 
 exit:
-	(void) g_idle_add(dls_async_task_complete, cb_data);
+	dls_async_task_complete_in_idle(cb_data);
 	DLEYNA_LOG_DEBUG("Exit");
 }
@@ -0,0 +1,164 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <libdleyna/core/log.h>
+
+#include "matcher.h"
+
+struct dls_matcher_t_ {
+	GPtrArray *entries;
+	GHashTable *by_mime;
+	GPtrArray *wildcards;
+};
+
+/* MIME types are compared case insensitively by GUPnP, so the index
+ * hashes and compares them the same way.
+ */
+static guint prv_mime_hash(gconstpointer key)
+{
+	const gchar *ptr = key;
+	guint hash = 5381;
+
+	for (; *ptr; ptr++)
+		hash = (hash << 5) + hash + g_ascii_tolower(*ptr);
+
+	return hash;
+}
+
+static gboolean prv_mime_equal(gconstpointer a, gconstpointer b)
+{
+	return !g_ascii_strcasecmp(a, b);
+}
+
+static void prv_add_entry(dls_matcher_t *matcher, GUPnPProtocolInfo *pi)
+{
+	const gchar *mime_type;
+	GPtrArray *bucket;
+
+	g_ptr_array_add(matcher->entries, pi);
+
+	mime_type = gupnp_protocol_info_get_mime_type(pi);
+
+	if (!mime_type || mime_type[0] == '*') {
+		g_ptr_array_add(matcher->wildcards, pi);
+		goto on_exit;
+	}
+
+	bucket = g_hash_table_lookup(matcher->by_mime, mime_type);
+	if (!bucket) {
+		bucket = g_ptr_array_new();
+		g_hash_table_insert(matcher->by_mime, (gpointer)mime_type,
+				    bucket);
+	}
+
+	g_ptr_array_add(bucket, pi);
+
+on_exit:
+
+	return;
+}
+
+dls_matcher_t *dls_matcher_new(const gchar *protocol_info)
+{
+	dls_matcher_t *matcher;
+	GUPnPProtocolInfo *pi;
+	gchar **pi_str_array;
+	unsigned int i;
+
+	matcher = g_new0(dls_matcher_t, 1);
+	matcher->entries = g_ptr_array_new_with_free_func(g_object_unref);
+	matcher->by_mime = g_hash_table_new_full(
+					prv_mime_hash, prv_mime_equal,
+					NULL,
+					(GDestroyNotify)g_ptr_array_unref);
+	matcher->wildcards = g_ptr_array_new();
+
+	pi_str_array = g_strsplit(protocol_info, ",", 0);
+
+	for (i = 0; pi_str_array[i]; ++i) {
+		pi = gupnp_protocol_info_new_from_string(pi_str_array[i],
+							 NULL);
+		if (pi)
+			prv_add_entry(matcher, pi);
+		else
+			DLEYNA_LOG_DEBUG("Ignoring protocol info %s",
+					 pi_str_array[i]);
+	}
+
+	g_strfreev(pi_str_array);
+
+	DLEYNA_LOG_DEBUG("%u protocol info entries, %u MIME types",
+			 matcher->entries->len,
+			 g_hash_table_size(matcher->by_mime));
+
+	return matcher;
+}
+
+void dls_matcher_delete(dls_matcher_t *matcher)
+{
+	if (matcher) {
+		g_hash_table_unref(matcher->by_mime);
+		g_ptr_array_unref(matcher->wildcards);
+		g_ptr_array_unref(matcher->entries);
+		g_free(matcher);
+	}
+}
+
+static gboolean prv_match_any(GPtrArray *entries, GUPnPProtocolInfo *res_pi)
+{
+	unsigned int i;
+
+	for (i = 0; i < entries->len; ++i)
+		if (gupnp_protocol_info_is_compatible(
+					g_ptr_array_index(entries, i), res_pi))
+			return TRUE;
+
+	return FALSE;
+}
+
+gboolean dls_matcher_match(const dls_matcher_t *matcher,
+			   GUPnPDIDLLiteResource *res)
+{
+	GUPnPProtocolInfo *res_pi;
+	const gchar *mime_type;
+	GPtrArray *bucket;
+
+	if (!matcher)
+		return TRUE;
+
+	res_pi = gupnp_didl_lite_resource_get_protocol_info(res);
+	if (!res_pi)
+		return FALSE;
+
+	mime_type = gupnp_protocol_info_get_mime_type(res_pi);
+
+	/* A wildcard MIME type, or LPCM whose MIME type carries parameters,
+	 * may be compatible with entries of any bucket.
+	 */
+	if (!mime_type || mime_type[0] == '*' ||
+	    !g_ascii_strncasecmp(mime_type, "audio/L16", 9))
+		return prv_match_any(matcher->entries, res_pi);
+
+	bucket = g_hash_table_lookup(matcher->by_mime, mime_type);
+	if (bucket && prv_match_any(bucket, res_pi))
+		return TRUE;
+
+	return prv_match_any(matcher->wildcards, res_pi);
+}
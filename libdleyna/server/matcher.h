@@ -0,0 +1,41 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef DLS_MATCHER_H__
+#define DLS_MATCHER_H__
+
+#include <glib.h>
+#include <libgupnp-av/gupnp-av.h>
+
+/* A client protocol info string (a comma separated list of protocol info
+ * entries) parsed once and indexed by MIME type, so that resources can be
+ * matched against it without re-parsing the string for every object.
+ */
+typedef struct dls_matcher_t_ dls_matcher_t;
+
+dls_matcher_t *dls_matcher_new(const gchar *protocol_info);
+
+void dls_matcher_delete(dls_matcher_t *matcher);
+
+/* A NULL matcher accepts every resource */
+gboolean dls_matcher_match(const dls_matcher_t *matcher,
+			   GUPnPDIDLLiteResource *res);
+
+#endif /* DLS_MATCHER_H__ */
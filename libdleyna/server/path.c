@@ -20,7 +20,6 @@
  *
  */
 
-#include <stdio.h>
 #include <string.h>
 
 #include <libdleyna/core/error.h>
@@ -28,6 +27,16 @@
 #include "path.h"
 #include "server.h"
 
+static const gchar g_hex_digits[] = "0123456789abcdef";
+
+/* Hex digit values plus one, so that 0 marks an invalid digit */
+static const guint8 g_hex_values[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+	['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16
+};
+
 gboolean dls_path_get_non_root_id(const gchar *object_path,
 				  const gchar **slash_before_id)
 {
@@ -48,43 +57,39 @@ on_error:
 	return retval;
 }
 
-static gchar *prv_object_name_to_id(const gchar *object_name)
+/* buffer must hold at least strlen(object_name) / 2 + 1 bytes */
+static gboolean prv_path_decode_id(const gchar *object_name, gchar *buffer)
 {
-	gchar *retval = NULL;
-	unsigned int object_len = strlen(object_name);
-	unsigned int i;
-	gint hex;
-	gchar byte;
+	const guint8 *name = (const guint8 *)object_name;
+	guint8 high;
+	guint8 low;
 
-	if (object_len & 1)
-		goto on_error;
+	for (; name[0]; name += 2) {
+		high = g_hex_values[name[0]];
+		low = g_hex_values[name[1]];
 
-	retval = g_malloc((object_len >> 1) + 1);
+		/* Also catches an odd length, as name[1] is then 0 */
+		if (!high || !low)
+			return FALSE;
 
-	for (i = 0; i < object_len; i += 2) {
-		hex = g_ascii_xdigit_value(object_name[i]);
+		*buffer++ = ((high - 1) << 4) | (low - 1);
+	}
 
-		if (hex == -1)
-			goto on_error;
+	*buffer = 0;
 
-		byte = hex << 4;
-		hex = g_ascii_xdigit_value(object_name[i + 1]);
+	return TRUE;
+}
 
-		if (hex == -1)
-			goto on_error;
+static gchar *prv_object_name_to_id(const gchar *object_name)
+{
+	gchar *retval = g_malloc((strlen(object_name) >> 1) + 1);
 
-		byte |= hex;
-		retval[i >> 1] = byte;
+	if (!prv_path_decode_id(object_name, retval)) {
+		g_free(retval);
+		retval = NULL;
 	}
-	retval[i >> 1] = 0;
 
 	return retval;
-
-on_error:
-
-	g_free(retval);
-
-	return NULL;
 }
 
 gboolean dls_path_get_path_and_id(const gchar *object_path, gchar **root_path,
@@ -122,33 +127,74 @@ on_error:
 	return FALSE;
 }
 
-static gchar *prv_id_to_object_name(const gchar *id)
+/* buffer must hold at least 2 * strlen(id) + 1 bytes.  Returns the number
+ * of characters written, excluding the terminating NUL.
+ */
+static gsize prv_path_encode_id(const gchar *id, gchar *buffer)
 {
-	gchar *retval;
-	unsigned int i;
-	unsigned int data_len = strlen(id);
+	const guint8 *data = (const guint8 *)id;
+	gchar *start = buffer;
 
-	retval = g_malloc((data_len << 1) + 1);
-	retval[0] = 0;
+	for (; *data; data++) {
+		*buffer++ = g_hex_digits[*data >> 4];
+		*buffer++ = g_hex_digits[*data & 0xf];
+	}
 
-	for (i = 0; i < data_len; i++)
-		sprintf(&retval[i << 1], "%0x", (guint8) id[i]);
+	*buffer = 0;
 
-	return retval;
+	return buffer - start;
+}
+
+void dls_path_append_id(GString *path, const gchar *id)
+{
+	gsize len;
+
+	if (!strcmp(id, "0"))
+		return;
+
+	len = path->len;
+	g_string_set_size(path, len + 1 + (strlen(id) << 1));
+	path->str[len] = '/';
+	(void) prv_path_encode_id(id, &path->str[len + 1]);
 }
 
 gchar *dls_path_from_id(const gchar *root_path, const gchar *id)
 {
-	gchar *coded_id;
+	gsize root_len;
 	gchar *path;
 
-	if (!strcmp(id, "0")) {
-		path = g_strdup(root_path);
-	} else {
-		coded_id = prv_id_to_object_name(id);
-		path = g_strdup_printf("%s/%s", root_path, coded_id);
-		g_free(coded_id);
-	}
+	if (!strcmp(id, "0"))
+		return g_strdup(root_path);
+
+	root_len = strlen(root_path);
+	path = g_malloc(root_len + 1 + (strlen(id) << 1) + 1);
+
+	memcpy(path, root_path, root_len);
+	path[root_len] = '/';
+	(void) prv_path_encode_id(id, &path[root_len + 1]);
 
 	return path;
 }
+
+gchar **dls_path_from_ids(const gchar *root_path, gchar **ids)
+{
+	GString *path;
+	gsize root_len;
+	gchar **retval;
+	guint i;
+
+	path = g_string_new(root_path);
+	root_len = path->len;
+	retval = g_new(gchar *, g_strv_length(ids) + 1);
+
+	for (i = 0; ids[i]; i++) {
+		g_string_truncate(path, root_len);
+		dls_path_append_id(path, ids[i]);
+		retval[i] = g_strndup(path->str, path->len);
+	}
+
+	retval[i] = NULL;
+	(void) g_string_free(path, TRUE);
+
+	return retval;
+}
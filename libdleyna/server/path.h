@@ -33,4 +33,12 @@ gboolean dls_path_get_path_and_id(const gchar *object_path, gchar **root_path,
 
 gchar *dls_path_from_id(const gchar *root_path, const gchar *id);
 
+/* Appends "/<encoded id>" to path, or nothing for the root container */
+void dls_path_append_id(GString *path, const gchar *id);
+
+/* Returns a NULL terminated array of the paths of ids, to be freed with
+ * g_strfreev().
+ */
+gchar **dls_path_from_ids(const gchar *root_path, gchar **ids);
+
 #endif /* DLS_PATH_H__ */
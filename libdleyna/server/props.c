@@ -31,6 +31,7 @@
 #include "interface.h"
 #include "path.h"
 #include "props.h"
+#include "server.h"
 
 static const gchar gUPnPObject[] = "object";
 static const gchar gUPnPContainer[] = "object.container";
@@ -79,6 +80,23 @@ struct dls_prop_dlna_t_ {
 	const gchar *prop_name;
 };
 
+/* Holds the object paths built for the objects returned to clients, so
+ * that they do not need an allocation each.  Only valid until the next
+ * call to prv_object_path().
+ */
+static GString *g_object_path;
+
+static const gchar *prv_object_path(const gchar *root_path, const gchar *id)
+{
+	if (!g_object_path)
+		g_object_path = g_string_sized_new(128);
+
+	g_string_assign(g_object_path, root_path);
+	dls_path_append_id(g_object_path, id);
+
+	return g_object_path->str;
+}
+
 static const dls_prop_dlna_t g_prop_dlna_ci[] = {
 {GUPNP_DLNA_CONVERSION_TRANSCODED,		"Transcoded"},
 {0,						NULL}
@@ -644,6 +662,14 @@ static void prv_add_int64_prop(GVariantBuilder *vb, const gchar *key,
 	}
 }
 
+static void prv_add_uint64_prop(GVariantBuilder *vb, const gchar *key,
+				guint64 value)
+{
+	DLEYNA_LOG_DEBUG("Prop %s = %"G_GUINT64_FORMAT, key, value);
+
+	g_variant_builder_add(vb, "{sv}", key, g_variant_new_uint64(value));
+}
+
 static void prv_add_list_dlna_str(gpointer data, gpointer user_data)
 {
 	GVariantBuilder *vb = (GVariantBuilder *)user_data;
@@ -808,6 +834,11 @@ void dls_props_add_device(GUPnPDeviceInfo *root_proxy,
 		g_variant_builder_add(vb, "{sv}",
 				      DLS_INTERFACE_PROP_SV_FEATURE_LIST,
 				      device->feature_list);
+
+	prv_add_uint64_prop(vb, DLS_INTERFACE_PROP_METADATA_CACHE_HITS,
+			    device->metadata_cache_hits);
+	prv_add_uint64_prop(vb, DLS_INTERFACE_PROP_METADATA_CACHE_MISSES,
+			    device->metadata_cache_misses);
 }
 
 GVariant *dls_props_get_device_prop(GUPnPDeviceInfo *root_proxy,
@@ -910,6 +941,12 @@ GVariant *dls_props_get_device_prop(GUPnPDeviceInfo *root_proxy,
 			DLEYNA_LOG_DEBUG("Prop %s = %s", prop, copy);
 #endif
 		}
+	} else if (!strcmp(DLS_INTERFACE_PROP_METADATA_CACHE_HITS, prop)) {
+		retval = g_variant_ref_sink(g_variant_new_uint64(
+					device->metadata_cache_hits));
+	} else if (!strcmp(DLS_INTERFACE_PROP_METADATA_CACHE_MISSES, prop)) {
+		retval = g_variant_ref_sink(g_variant_new_uint64(
+					device->metadata_cache_misses));
 	}
 
 	if (!retval) {
@@ -929,72 +966,28 @@ GVariant *dls_props_get_device_prop(GUPnPDeviceInfo *root_proxy,
 	return retval;
 }
 
-static GUPnPDIDLLiteResource *prv_match_resource(GUPnPDIDLLiteResource *res,
-						 gchar **pi_str_array)
-{
-	GUPnPDIDLLiteResource *retval = NULL;
-	GUPnPProtocolInfo *res_pi;
-	GUPnPProtocolInfo *pi;
-	unsigned int i;
-	gboolean match;
-
-	if (!pi_str_array) {
-		retval = res;
-		goto done;
-	}
-
-	res_pi = gupnp_didl_lite_resource_get_protocol_info(res);
-	if (!res_pi)
-		goto done;
-
-	for (i = 0; pi_str_array[i]; ++i) {
-		pi = gupnp_protocol_info_new_from_string(pi_str_array[i],
-			NULL);
-		if (!pi)
-			continue;
-		match = gupnp_protocol_info_is_compatible(pi, res_pi);
-		g_object_unref(pi);
-		if (match) {
-			retval = res;
-			break;
-		}
-	}
-done:
-
-	return retval;
-}
-
 static GUPnPDIDLLiteResource *prv_get_matching_resource
-	(GUPnPDIDLLiteObject *object, const gchar *protocol_info)
+	(GUPnPDIDLLiteObject *object, const dls_matcher_t *protocol_info)
 {
 	GUPnPDIDLLiteResource *retval = NULL;
 	GUPnPDIDLLiteResource *res;
 	GList *resources;
 	GList *ptr;
-	gchar **pi_str_array = NULL;
-
-	if (protocol_info)
-		pi_str_array = g_strsplit(protocol_info, ",", 0);
 
 	resources = gupnp_didl_lite_object_get_resources(object);
 	ptr = resources;
 
 	while (ptr) {
 		res = ptr->data;
-		if (!retval) {
-			retval = prv_match_resource(res, pi_str_array);
-			if (!retval)
-				g_object_unref(res);
-		} else {
+		if (!retval && dls_matcher_match(protocol_info, res))
+			retval = res;
+		else
 			g_object_unref(res);
-		}
 
 		ptr = ptr->next;
 	}
 
 	g_list_free(resources);
-	if (pi_str_array)
-		g_strfreev(pi_str_array);
 
 	return retval;
 }
@@ -1358,7 +1351,6 @@ gboolean dls_props_add_object(GVariantBuilder *item_vb,
 			      const gchar *parent_path,
 			      dls_upnp_prop_mask filter_mask)
 {
-	gchar *path = NULL;
 	const char *id;
 	const char *title;
 	const char *creator;
@@ -1385,7 +1377,6 @@ gboolean dls_props_add_object(GVariantBuilder *item_vb,
 	title = gupnp_didl_lite_object_get_title(object);
 	creator = gupnp_didl_lite_object_get_creator(object);
 	rest = gupnp_didl_lite_object_get_restricted(object);
-	path = dls_path_from_id(root_path, id);
 
 	if (filter_mask & DLS_UPNP_MASK_PROP_DISPLAY_NAME)
 		prv_add_string_prop(item_vb, DLS_INTERFACE_PROP_DISPLAY_NAME,
@@ -1396,7 +1387,8 @@ gboolean dls_props_add_object(GVariantBuilder *item_vb,
 				    creator);
 
 	if (filter_mask & DLS_UPNP_MASK_PROP_PATH)
-		prv_add_path_prop(item_vb, DLS_INTERFACE_PROP_PATH, path);
+		prv_add_path_prop(item_vb, DLS_INTERFACE_PROP_PATH,
+				  prv_object_path(root_path, id));
 
 	if (filter_mask & DLS_UPNP_MASK_PROP_PARENT)
 		prv_add_path_prop(item_vb, DLS_INTERFACE_PROP_PARENT,
@@ -1435,15 +1427,13 @@ gboolean dls_props_add_object(GVariantBuilder *item_vb,
 
 on_error:
 
-	g_free(path);
-
 	return retval;
 }
 
 void dls_props_add_container(GVariantBuilder *item_vb,
 			     GUPnPDIDLLiteContainer *object,
 			     dls_upnp_prop_mask filter_mask,
-			     const gchar *protocol_info,
+			     const dls_matcher_t *protocol_info,
 			     gboolean *have_child_count)
 {
 	int child_count;
@@ -1539,12 +1529,11 @@ void dls_props_add_item(GVariantBuilder *item_vb,
 			GUPnPDIDLLiteObject *object,
 			const gchar *root_path,
 			dls_upnp_prop_mask filter_mask,
-			const gchar *protocol_info)
+			const dls_matcher_t *protocol_info)
 {
 	int track_number;
 	GUPnPDIDLLiteResource *res;
 	const char *str_val;
-	char *path;
 	GList *list;
 
 	if (filter_mask & DLS_UPNP_MASK_PROP_ARTIST)
@@ -1589,12 +1578,9 @@ void dls_props_add_item(GVariantBuilder *item_vb,
 	if (filter_mask & DLS_UPNP_MASK_PROP_REFPATH) {
 		str_val = gupnp_didl_lite_item_get_ref_id(
 						GUPNP_DIDL_LITE_ITEM(object));
-		if (str_val != NULL) {
-			path = dls_path_from_id(root_path, str_val);
+		if (str_val != NULL)
 			prv_add_path_prop(item_vb, DLS_INTERFACE_PROP_REFPATH,
-					  path);
-			g_free(path);
-		}
+					  prv_object_path(root_path, str_val));
 	}
 
 	res = prv_get_matching_resource(object, protocol_info);
@@ -1612,10 +1598,184 @@ void dls_props_add_item(GVariantBuilder *item_vb,
 		prv_add_resources(item_vb, object, filter_mask, TRUE);
 }
 
+static gboolean prv_didl_get_bool(const dls_didl_object_t *object,
+				  dls_didl_prop_t prop)
+{
+	const gchar *value = object->props[prop];
+
+	return value && (!strcmp(value, "1") ||
+			 !g_ascii_strcasecmp(value, "true"));
+}
+
+static gint64 prv_didl_get_int(const dls_didl_object_t *object,
+			       dls_didl_prop_t prop)
+{
+	const gchar *value = object->props[prop];
+
+	return value ? g_ascii_strtoll(value, NULL, 10) : -1;
+}
+
+/* Counterpart of dls_props_add_object() followed by
+ * dls_props_add_container() or dls_props_add_item() for objects produced
+ * by the streaming DIDL-Lite parser.  Only the properties accepted by
+ * dls_didl_can_stream() are supported.
+ */
+gboolean dls_props_add_didl_object(GVariantBuilder *item_vb,
+				   const dls_didl_object_t *object,
+				   const gchar *root_path,
+				   const gchar *parent_path,
+				   dls_upnp_prop_mask filter_mask,
+				   gboolean *have_child_count)
+{
+	const gchar *const *props = (const gchar *const *)object->props;
+	const gchar *media_spec_type;
+	gint64 int_val;
+	guint flags;
+	gboolean retval = FALSE;
+
+	*have_child_count = FALSE;
+
+	if (!props[DLS_DIDL_PROP_ID])
+		goto on_error;
+
+	media_spec_type = dls_props_upnp_class_to_media_spec(
+						props[DLS_DIDL_PROP_CLASS]);
+	if (!media_spec_type)
+		goto on_error;
+
+	if (filter_mask & DLS_UPNP_MASK_PROP_DISPLAY_NAME)
+		prv_add_string_prop(item_vb, DLS_INTERFACE_PROP_DISPLAY_NAME,
+				    props[DLS_DIDL_PROP_TITLE]);
+
+	if (filter_mask & DLS_UPNP_MASK_PROP_CREATOR)
+		prv_add_string_prop(item_vb, DLS_INTERFACE_PROP_CREATOR,
+				    props[DLS_DIDL_PROP_CREATOR]);
+
+	if (filter_mask & DLS_UPNP_MASK_PROP_PATH)
+		prv_add_path_prop(item_vb, DLS_INTERFACE_PROP_PATH,
+				  prv_object_path(root_path,
+						  props[DLS_DIDL_PROP_ID]));
+
+	if (filter_mask & DLS_UPNP_MASK_PROP_PARENT)
+		prv_add_path_prop(item_vb, DLS_INTERFACE_PROP_PARENT,
+				  parent_path);
+
+	if (filter_mask & DLS_UPNP_MASK_PROP_TYPE)
+		prv_add_string_prop(item_vb, DLS_INTERFACE_PROP_TYPE,
+				    media_spec_type);
+
+	if (filter_mask & DLS_UPNP_MASK_PROP_TYPE_EX)
+		prv_add_string_prop(item_vb, DLS_INTERFACE_PROP_TYPE_EX,
+				    dls_props_upnp_class_to_media_spec_ex(
+						props[DLS_DIDL_PROP_CLASS]));
+
+	if (filter_mask & DLS_UPNP_MASK_PROP_RESTRICTED)
+		prv_add_bool_prop(item_vb, DLS_INTERFACE_PROP_RESTRICTED,
+				  prv_didl_get_bool(object,
+						    DLS_DIDL_PROP_RESTRICTED));
+
+	if ((filter_mask & DLS_UPNP_MASK_PROP_DLNA_MANAGED) &&
+	    props[DLS_DIDL_PROP_DLNA_MANAGED]) {
+		flags = g_ascii_strtoull(props[DLS_DIDL_PROP_DLNA_MANAGED],
+					 NULL, 16);
+
+		if (flags != GUPNP_OCM_FLAGS_NONE)
+			prv_add_variant_prop(item_vb,
+					     DLS_INTERFACE_PROP_DLNA_MANAGED,
+					     prv_props_get_dlna_info_dict(
+							flags,
+							g_prop_dlna_ocm));
+	}
+
+	if ((filter_mask & DLS_UPNP_MASK_PROP_OBJECT_UPDATE_ID) &&
+	    props[DLS_DIDL_PROP_OBJECT_UPDATE_ID])
+		prv_add_uint_prop(item_vb, DLS_INTERFACE_PROP_OBJECT_UPDATE_ID,
+				  prv_didl_get_int(object,
+					DLS_DIDL_PROP_OBJECT_UPDATE_ID));
+
+	if (filter_mask & DLS_UPNP_MASK_PROP_ARTIST)
+		prv_add_string_prop(item_vb, DLS_INTERFACE_PROP_ARTIST,
+				    props[DLS_DIDL_PROP_ARTIST]);
+
+	if (filter_mask & DLS_UPNP_MASK_PROP_ALBUM_ART_URL)
+		prv_add_string_prop(item_vb, DLS_INTERFACE_PROP_ALBUM_ART_URL,
+				    props[DLS_DIDL_PROP_ALBUM_ART_URL]);
+
+	if (object->container) {
+		int_val = prv_didl_get_int(object, DLS_DIDL_PROP_CHILD_COUNT);
+
+		if ((filter_mask & DLS_UPNP_MASK_PROP_CHILD_COUNT) &&
+		    (int_val >= 0)) {
+			prv_add_uint_prop(item_vb,
+					  DLS_INTERFACE_PROP_CHILD_COUNT,
+					  (unsigned int) int_val);
+			*have_child_count = TRUE;
+		}
+
+		if (filter_mask & DLS_UPNP_MASK_PROP_SEARCHABLE)
+			prv_add_bool_prop(item_vb,
+					  DLS_INTERFACE_PROP_SEARCHABLE,
+					  prv_didl_get_bool(
+						object,
+						DLS_DIDL_PROP_SEARCHABLE));
+
+		if ((filter_mask & DLS_UPNP_MASK_PROP_CONTAINER_UPDATE_ID) &&
+		    props[DLS_DIDL_PROP_CONTAINER_UPDATE_ID])
+			prv_add_uint_prop(
+				item_vb,
+				DLS_INTERFACE_PROP_CONTAINER_UPDATE_ID,
+				prv_didl_get_int(
+					object,
+					DLS_DIDL_PROP_CONTAINER_UPDATE_ID));
+
+		if ((filter_mask &
+		     DLS_UPNP_MASK_PROP_TOTAL_DELETED_CHILD_COUNT) &&
+		    props[DLS_DIDL_PROP_TOTAL_DELETED_CHILD_COUNT])
+			prv_add_uint_prop(
+				item_vb,
+				DLS_INTERFACE_PROP_TOTAL_DELETED_CHILD_COUNT,
+				prv_didl_get_int(
+				       object,
+				       DLS_DIDL_PROP_TOTAL_DELETED_CHILD_COUNT));
+	} else {
+		if (filter_mask & DLS_UPNP_MASK_PROP_ALBUM)
+			prv_add_string_prop(item_vb, DLS_INTERFACE_PROP_ALBUM,
+					    props[DLS_DIDL_PROP_ALBUM]);
+
+		if (filter_mask & DLS_UPNP_MASK_PROP_DATE)
+			prv_add_string_prop(item_vb, DLS_INTERFACE_PROP_DATE,
+					    props[DLS_DIDL_PROP_DATE]);
+
+		if (filter_mask & DLS_UPNP_MASK_PROP_GENRE)
+			prv_add_string_prop(item_vb, DLS_INTERFACE_PROP_GENRE,
+					    props[DLS_DIDL_PROP_GENRE]);
+
+		if (filter_mask & DLS_UPNP_MASK_PROP_TRACK_NUMBER)
+			prv_add_int_prop(item_vb,
+					 DLS_INTERFACE_PROP_TRACK_NUMBER,
+					 prv_didl_get_int(
+						object,
+						DLS_DIDL_PROP_TRACK_NUMBER));
+
+		if ((filter_mask & DLS_UPNP_MASK_PROP_REFPATH) &&
+		    props[DLS_DIDL_PROP_REF_ID])
+			prv_add_path_prop(item_vb, DLS_INTERFACE_PROP_REFPATH,
+					  prv_object_path(
+						root_path,
+						props[DLS_DIDL_PROP_REF_ID]));
+	}
+
+	retval = TRUE;
+
+on_error:
+
+	return retval;
+}
+
 void dls_props_add_resource(GVariantBuilder *item_vb,
 			    GUPnPDIDLLiteObject *object,
 			    dls_upnp_prop_mask filter_mask,
-			    const gchar *protocol_info)
+			    const dls_matcher_t *protocol_info)
 {
 	GUPnPDIDLLiteResource *res;
 	const char *str_val;
@@ -1764,7 +1924,7 @@ GVariant *dls_props_get_object_prop(const gchar *prop, const gchar *root_path,
 {
 	const char *object_id;
 	const char *parent_id;
-	gchar *path;
+	const gchar *path;
 	const char *upnp_class;
 	const char *media_spec_type;
 	const char *title;
@@ -1788,25 +1948,23 @@ GVariant *dls_props_get_object_prop(const gchar *prop, const gchar *root_path,
 			retval = g_variant_ref_sink(g_variant_new_string(
 							    root_path));
 		} else {
-			path = dls_path_from_id(root_path, parent_id);
+			path = prv_object_path(root_path, parent_id);
 
 			DLEYNA_LOG_DEBUG("Prop %s = %s", prop, path);
 
 			retval = g_variant_ref_sink(g_variant_new_string(
 							    path));
-			g_free(path);
 		}
 	} else if (!strcmp(prop, DLS_INTERFACE_PROP_PATH)) {
 		object_id = gupnp_didl_lite_object_get_id(object);
 		if (!object_id)
 			goto on_error;
 
-		path = dls_path_from_id(root_path, object_id);
+		path = prv_object_path(root_path, object_id);
 
 		DLEYNA_LOG_DEBUG("Prop %s = %s", prop, path);
 
 		retval = g_variant_ref_sink(g_variant_new_string(path));
-		g_free(path);
 	} else if (!strcmp(prop, DLS_INTERFACE_PROP_TYPE)) {
 		upnp_class = gupnp_didl_lite_object_get_upnp_class(object);
 		media_spec_type =
@@ -1874,10 +2032,9 @@ on_error:
 
 GVariant *dls_props_get_item_prop(const gchar *prop, const gchar *root_path,
 				  GUPnPDIDLLiteObject *object,
-				  const gchar *protocol_info)
+				  const dls_matcher_t *protocol_info)
 {
 	const gchar *str;
-	gchar *path;
 	gint track_number;
 	GUPnPDIDLLiteResource *res;
 	GVariant *retval = NULL;
@@ -1959,9 +2116,8 @@ GVariant *dls_props_get_item_prop(const gchar *prop, const gchar *root_path,
 
 		DLEYNA_LOG_DEBUG("Prop %s = %s", prop, str);
 
-		path = dls_path_from_id(root_path, str);
-		retval = g_variant_ref_sink(g_variant_new_string(path));
-		g_free(path);
+		retval = g_variant_ref_sink(g_variant_new_string(
+						prv_object_path(root_path, str)));
 	} else if (!strcmp(prop, DLS_INTERFACE_PROP_RESOURCES)) {
 		retval = g_variant_ref_sink(
 			prv_compute_resources(object, DLS_UPNP_MASK_ALL_PROPS,
@@ -1995,7 +2151,7 @@ on_error:
 
 GVariant *dls_props_get_container_prop(const gchar *prop,
 				       GUPnPDIDLLiteObject *object,
-				       const gchar *protocol_info)
+				       const dls_matcher_t *protocol_info)
 {
 	gint child_count;
 	gboolean searchable;
@@ -2115,6 +2271,14 @@ static GVariant *prv_build_wl_entries(dleyna_settings_t *settings)
 
 void dls_props_add_manager(dleyna_settings_t *settings, GVariantBuilder *vb)
 {
+	guint64 hits;
+	guint64 misses;
+	guint64 requests;
+	guint64 connections;
+	guint64 received;
+	guint64 emitted;
+	guint64 subscribed;
+
 	prv_add_bool_prop(vb, DLS_INTERFACE_PROP_NEVER_QUIT,
 			  dleyna_settings_is_never_quit(settings));
 
@@ -2123,6 +2287,69 @@ void dls_props_add_manager(dleyna_settings_t *settings, GVariantBuilder *vb)
 
 	g_variant_builder_add(vb, "{sv}", DLS_INTERFACE_PROP_WHITE_LIST_ENTRIES,
 			      prv_build_wl_entries(settings));
+
+	dls_device_get_metadata_cache_stats(&hits, &misses);
+	prv_add_uint64_prop(vb, DLS_INTERFACE_PROP_METADATA_CACHE_HITS, hits);
+	prv_add_uint64_prop(vb, DLS_INTERFACE_PROP_METADATA_CACHE_MISSES,
+			    misses);
+
+	prv_add_uint_prop(vb, DLS_INTERFACE_PROP_MAX_CHILD_COUNT_REQUESTS,
+			  dls_device_get_child_count_max_in_flight());
+
+	prv_add_uint_prop(vb, DLS_INTERFACE_PROP_MAX_BROWSE_OBJECTS_REQUESTS,
+			  dls_device_get_browse_objects_max_in_flight());
+
+	prv_add_uint_prop(vb, DLS_INTERFACE_PROP_BROWSE_OBJECTS_BATCH_SIZE,
+			  dls_device_get_browse_objects_batch_size());
+
+	prv_add_uint_prop(vb, DLS_INTERFACE_PROP_MAX_HTTP_CONNECTIONS_PER_HOST,
+			  dls_device_get_http_max_conns_per_host());
+
+	prv_add_uint_prop(vb, DLS_INTERFACE_PROP_HTTP_IDLE_TIMEOUT,
+			  dls_device_get_http_idle_timeout());
+
+	dls_device_get_http_stats(&requests, &connections);
+	prv_add_uint64_prop(vb, DLS_INTERFACE_PROP_HTTP_REQUESTS, requests);
+	prv_add_uint64_prop(vb, DLS_INTERFACE_PROP_HTTP_CONNECTIONS,
+			    connections);
+
+	prv_add_uint_prop(vb, DLS_INTERFACE_PROP_MAX_CONCURRENT_UPLOADS,
+			  dls_device_get_max_concurrent_uploads());
+
+	prv_add_uint_prop(vb, DLS_INTERFACE_PROP_UPLOAD_RATE_LIMIT,
+			  dls_device_get_upload_rate_limit());
+
+	prv_add_string_prop(vb, DLS_INTERFACE_PROP_UPLOAD_ORDER,
+			    dls_device_get_upload_order());
+
+	prv_add_uint_prop(vb, DLS_INTERFACE_PROP_UPLOAD_PROGRESS_INTERVAL,
+			  dls_device_get_upload_progress_interval());
+
+	prv_add_uint_prop(vb, DLS_INTERFACE_PROP_UPLOAD_PROGRESS_STEP,
+			  dls_device_get_upload_progress_step());
+
+	prv_add_uint_prop(vb, DLS_INTERFACE_PROP_UPLOAD_MAX_RETRIES,
+			  dls_device_get_upload_max_retries());
+
+	prv_add_uint_prop(vb, DLS_INTERFACE_PROP_CHANGED_FLUSH_INTERVAL,
+			  dls_device_get_changed_flush_interval());
+
+	prv_add_uint_prop(vb, DLS_INTERFACE_PROP_CHANGED_MAX_BATCH,
+			  dls_device_get_changed_max_batch());
+
+	dls_device_get_changed_stats(&received, &emitted, &subscribed);
+	prv_add_uint64_prop(vb, DLS_INTERFACE_PROP_CHANGED_EVENTS_RECEIVED,
+			    received);
+	prv_add_uint64_prop(vb, DLS_INTERFACE_PROP_CHANGED_SIGNALS_EMITTED,
+			    emitted);
+	prv_add_uint64_prop(vb, DLS_INTERFACE_PROP_SUBSCRIBED_CHANGES_EMITTED,
+			    subscribed);
+
+	prv_add_uint_prop(vb, DLS_INTERFACE_PROP_MAX_CONCURRENT_READ_TASKS,
+			  dls_server_get_max_concurrent_read_tasks());
+
+	prv_add_uint64_prop(vb, DLS_INTERFACE_PROP_EXPIRED_TASKS,
+			    dls_server_get_expired_tasks());
 }
 
 GVariant *dls_props_get_manager_prop(dleyna_settings_t *settings,
@@ -2130,6 +2357,13 @@ GVariant *dls_props_get_manager_prop(dleyna_settings_t *settings,
 {
 	GVariant *retval = NULL;
 	gboolean b_value;
+	guint64 hits;
+	guint64 misses;
+	guint64 requests;
+	guint64 connections;
+	guint64 received;
+	guint64 emitted;
+	guint64 subscribed;
 #if DLEYNA_LOG_LEVEL & DLEYNA_LOG_LEVEL_DEBUG
 	gchar *prop_str;
 #endif
@@ -2142,6 +2376,81 @@ GVariant *dls_props_get_manager_prop(dleyna_settings_t *settings,
 		retval = g_variant_ref_sink(g_variant_new_boolean(b_value));
 	} else if (!strcmp(prop, DLS_INTERFACE_PROP_WHITE_LIST_ENTRIES)) {
 		retval = g_variant_ref_sink(prv_build_wl_entries(settings));
+	} else if (!strcmp(prop, DLS_INTERFACE_PROP_METADATA_CACHE_HITS)) {
+		dls_device_get_metadata_cache_stats(&hits, &misses);
+		retval = g_variant_ref_sink(g_variant_new_uint64(hits));
+	} else if (!strcmp(prop, DLS_INTERFACE_PROP_METADATA_CACHE_MISSES)) {
+		dls_device_get_metadata_cache_stats(&hits, &misses);
+		retval = g_variant_ref_sink(g_variant_new_uint64(misses));
+	} else if (!strcmp(prop,
+			   DLS_INTERFACE_PROP_MAX_CHILD_COUNT_REQUESTS)) {
+		retval = g_variant_ref_sink(g_variant_new_uint32(
+				dls_device_get_child_count_max_in_flight()));
+	} else if (!strcmp(prop,
+			   DLS_INTERFACE_PROP_MAX_BROWSE_OBJECTS_REQUESTS)) {
+		retval = g_variant_ref_sink(g_variant_new_uint32(
+				dls_device_get_browse_objects_max_in_flight()));
+	} else if (!strcmp(prop,
+			   DLS_INTERFACE_PROP_BROWSE_OBJECTS_BATCH_SIZE)) {
+		retval = g_variant_ref_sink(g_variant_new_uint32(
+				dls_device_get_browse_objects_batch_size()));
+	} else if (!strcmp(prop,
+			   DLS_INTERFACE_PROP_MAX_HTTP_CONNECTIONS_PER_HOST)) {
+		retval = g_variant_ref_sink(g_variant_new_uint32(
+				dls_device_get_http_max_conns_per_host()));
+	} else if (!strcmp(prop, DLS_INTERFACE_PROP_HTTP_IDLE_TIMEOUT)) {
+		retval = g_variant_ref_sink(g_variant_new_uint32(
+				dls_device_get_http_idle_timeout()));
+	} else if (!strcmp(prop, DLS_INTERFACE_PROP_HTTP_REQUESTS)) {
+		dls_device_get_http_stats(&requests, &connections);
+		retval = g_variant_ref_sink(g_variant_new_uint64(requests));
+	} else if (!strcmp(prop, DLS_INTERFACE_PROP_HTTP_CONNECTIONS)) {
+		dls_device_get_http_stats(&requests, &connections);
+		retval = g_variant_ref_sink(g_variant_new_uint64(connections));
+	} else if (!strcmp(prop, DLS_INTERFACE_PROP_MAX_CONCURRENT_UPLOADS)) {
+		retval = g_variant_ref_sink(g_variant_new_uint32(
+				dls_device_get_max_concurrent_uploads()));
+	} else if (!strcmp(prop, DLS_INTERFACE_PROP_UPLOAD_RATE_LIMIT)) {
+		retval = g_variant_ref_sink(g_variant_new_uint32(
+				dls_device_get_upload_rate_limit()));
+	} else if (!strcmp(prop, DLS_INTERFACE_PROP_UPLOAD_ORDER)) {
+		retval = g_variant_ref_sink(g_variant_new_string(
+				dls_device_get_upload_order()));
+	} else if (!strcmp(prop,
+			   DLS_INTERFACE_PROP_UPLOAD_PROGRESS_INTERVAL)) {
+		retval = g_variant_ref_sink(g_variant_new_uint32(
+				dls_device_get_upload_progress_interval()));
+	} else if (!strcmp(prop, DLS_INTERFACE_PROP_UPLOAD_PROGRESS_STEP)) {
+		retval = g_variant_ref_sink(g_variant_new_uint32(
+				dls_device_get_upload_progress_step()));
+	} else if (!strcmp(prop, DLS_INTERFACE_PROP_UPLOAD_MAX_RETRIES)) {
+		retval = g_variant_ref_sink(g_variant_new_uint32(
+				dls_device_get_upload_max_retries()));
+	} else if (!strcmp(prop, DLS_INTERFACE_PROP_CHANGED_FLUSH_INTERVAL)) {
+		retval = g_variant_ref_sink(g_variant_new_uint32(
+				dls_device_get_changed_flush_interval()));
+	} else if (!strcmp(prop, DLS_INTERFACE_PROP_CHANGED_MAX_BATCH)) {
+		retval = g_variant_ref_sink(g_variant_new_uint32(
+				dls_device_get_changed_max_batch()));
+	} else if (!strcmp(prop,
+			   DLS_INTERFACE_PROP_CHANGED_EVENTS_RECEIVED)) {
+		dls_device_get_changed_stats(&received, &emitted, &subscribed);
+		retval = g_variant_ref_sink(g_variant_new_uint64(received));
+	} else if (!strcmp(prop,
+			   DLS_INTERFACE_PROP_CHANGED_SIGNALS_EMITTED)) {
+		dls_device_get_changed_stats(&received, &emitted, &subscribed);
+		retval = g_variant_ref_sink(g_variant_new_uint64(emitted));
+	} else if (!strcmp(prop,
+			   DLS_INTERFACE_PROP_SUBSCRIBED_CHANGES_EMITTED)) {
+		dls_device_get_changed_stats(&received, &emitted, &subscribed);
+		retval = g_variant_ref_sink(g_variant_new_uint64(subscribed));
+	} else if (!strcmp(prop,
+			   DLS_INTERFACE_PROP_MAX_CONCURRENT_READ_TASKS)) {
+		retval = g_variant_ref_sink(g_variant_new_uint32(
+				dls_server_get_max_concurrent_read_tasks()));
+	} else if (!strcmp(prop, DLS_INTERFACE_PROP_EXPIRED_TASKS)) {
+		retval = g_variant_ref_sink(g_variant_new_uint64(
+				dls_server_get_expired_tasks()));
 	}
 
 #if DLEYNA_LOG_LEVEL & DLEYNA_LOG_LEVEL_DEBUG
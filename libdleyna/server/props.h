@@ -29,6 +29,7 @@
 #include <libdleyna/core/settings.h>
 
 #include "async.h"
+#include "didl.h"
 
 #define DLS_UPNP_MASK_PROP_PARENT			(1LL << 0)
 #define DLS_UPNP_MASK_PROP_TYPE				(1LL << 1)
@@ -116,29 +117,36 @@ GVariant *dls_props_get_object_prop(const gchar *prop, const gchar *root_path,
 void dls_props_add_container(GVariantBuilder *item_vb,
 			     GUPnPDIDLLiteContainer *object,
 			     dls_upnp_prop_mask filter_mask,
-			     const gchar *protocol_info,
+			     const dls_matcher_t *protocol_info,
 			     gboolean *have_child_count);
 
 void dls_props_add_child_count(GVariantBuilder *item_vb, gint value);
 
 GVariant *dls_props_get_container_prop(const gchar *prop,
 				       GUPnPDIDLLiteObject *object,
-				       const gchar *protocol_info);
+				       const dls_matcher_t *protocol_info);
+
+gboolean dls_props_add_didl_object(GVariantBuilder *item_vb,
+				   const dls_didl_object_t *object,
+				   const gchar *root_path,
+				   const gchar *parent_path,
+				   dls_upnp_prop_mask filter_mask,
+				   gboolean *have_child_count);
 
 void dls_props_add_resource(GVariantBuilder *item_vb,
 			    GUPnPDIDLLiteObject *object,
 			    dls_upnp_prop_mask filter_mask,
-			    const gchar *protocol_info);
+			    const dls_matcher_t *protocol_info);
 
 void dls_props_add_item(GVariantBuilder *item_vb,
 			GUPnPDIDLLiteObject *object,
 			const gchar *root_path,
 			dls_upnp_prop_mask filter_mask,
-			const gchar *protocol_info);
+			const dls_matcher_t *protocol_info);
 
 GVariant *dls_props_get_item_prop(const gchar *prop, const gchar *root_path,
 				  GUPnPDIDLLiteObject *object,
-				  const gchar *protocol_info);
+				  const dls_matcher_t *protocol_info);
 
 const gchar *dls_props_media_spec_to_upnp_class(const gchar *m2spec_class);
 
@@ -0,0 +1,48 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "rate-limit.h"
+
+/* Returns how many milliseconds to wait before length bytes fit in the
+ * budget of limit, now being a monotonic time in microseconds.  The bytes
+ * are taken from the budget when no wait is needed.  A rate of 0 never
+ * waits.
+ */
+guint dls_rate_limit_reserve(dls_rate_limit_t *limit, guint rate,
+			     gsize length, gint64 now)
+{
+	gint64 elapsed;
+
+	if (!rate)
+		return 0;
+
+	elapsed = MIN(now - limit->time, G_USEC_PER_SEC);
+
+	limit->budget += elapsed * rate / G_USEC_PER_SEC;
+	limit->budget = MIN(limit->budget, (gint64)rate);
+	limit->time = now;
+
+	if (limit->budget < (gint64)length)
+		return ((length - limit->budget) * 1000 / rate) + 1;
+
+	limit->budget -= length;
+
+	return 0;
+}
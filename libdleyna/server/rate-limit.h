@@ -0,0 +1,38 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef DLS_RATE_LIMIT_H__
+#define DLS_RATE_LIMIT_H__
+
+#include <glib.h>
+
+/* A token bucket that refills at a given number of bytes per second and
+ * holds at most one second worth of data.  A zeroed bucket starts full.
+ */
+typedef struct dls_rate_limit_t_ dls_rate_limit_t;
+struct dls_rate_limit_t_ {
+	gint64 budget;
+	gint64 time;
+};
+
+guint dls_rate_limit_reserve(dls_rate_limit_t *limit, guint rate,
+			     gsize length, gint64 now);
+
+#endif /* DLS_RATE_LIMIT_H__ */
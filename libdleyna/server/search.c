@@ -20,6 +20,7 @@
  *
  */
 
+
 #include <string.h>
 
 #include "interface.h"
@@ -27,135 +28,394 @@
 #include "props.h"
 #include "search.h"
 
-gchar *dls_search_translate_search_string(GHashTable *filter_map,
-					  const gchar *search_string)
+/* Guards the recursive descent parser against hostile nesting */
+#define DLS_SEARCH_MAX_DEPTH 32
+
+typedef enum dls_search_token_type_t_ dls_search_token_type_t;
+enum dls_search_token_type_t_ {
+	DLS_SEARCH_TOKEN_END,
+	DLS_SEARCH_TOKEN_OPEN,
+	DLS_SEARCH_TOKEN_CLOSE,
+	DLS_SEARCH_TOKEN_WORD,
+	DLS_SEARCH_TOKEN_STRING,
+	DLS_SEARCH_TOKEN_ERROR
+};
+
+typedef struct dls_search_lexer_t_ dls_search_lexer_t;
+struct dls_search_lexer_t_ {
+	const gchar *pos;
+	dls_search_token_type_t type;
+	const gchar *start;
+	gsize len;
+};
+
+typedef enum dls_search_node_type_t_ dls_search_node_type_t;
+enum dls_search_node_type_t_ {
+	DLS_SEARCH_NODE_REL,
+	DLS_SEARCH_NODE_AND,
+	DLS_SEARCH_NODE_OR
+};
+
+typedef struct dls_search_node_t_ dls_search_node_t;
+struct dls_search_node_t_ {
+	dls_search_node_type_t type;
+	gboolean grouped;
+	dls_search_node_t *left;
+	dls_search_node_t *right;
+	const gchar *prop;
+	const gchar *op;
+	gchar *value;
+	gboolean quoted;
+};
+
+typedef struct dls_search_parser_t_ dls_search_parser_t;
+struct dls_search_parser_t_ {
+	dls_search_lexer_t lexer;
+	GHashTable *filter_map;
+	guint depth;
+};
+
+static const gchar *g_search_ops[] = {
+	"=", "!=", "<", "<=", ">", ">=", "contains", "doesNotContain",
+	"derivedfrom", "exists", NULL
+};
+
+static void prv_lexer_next(dls_search_lexer_t *lexer)
 {
-	GRegex *reg;
-	gchar *retval = NULL;
-	GMatchInfo *match_info = NULL;
-	gchar *prop = NULL;
-	gchar *op = NULL;
-	gchar *value = NULL;
-	const gchar *translated_value;
-	gchar *translated_type_ex;
-	dls_prop_map_t *prop_map;
-	GString *str;
-	gint start_pos;
-	gint end_pos;
-	gint old_end_pos = 0;
-	unsigned int skipped;
-	unsigned int search_string_len = strlen(search_string);
+	const gchar *pos = lexer->pos;
+
+	while (g_ascii_isspace(*pos))
+		pos++;
+
+	lexer->start = pos;
+
+	if (!*pos) {
+		lexer->type = DLS_SEARCH_TOKEN_END;
+	} else if (*pos == '(') {
+		lexer->type = DLS_SEARCH_TOKEN_OPEN;
+		pos++;
+	} else if (*pos == ')') {
+		lexer->type = DLS_SEARCH_TOKEN_CLOSE;
+		pos++;
+	} else if (*pos == '"') {
+		/* start and len exclude the quotes but keep the escapes */
+		lexer->start = ++pos;
+
+		while (*pos && *pos != '"') {
+			if (*pos == '\\' && pos[1])
+				pos++;
+			pos++;
+		}
+
+		if (!*pos) {
+			lexer->type = DLS_SEARCH_TOKEN_ERROR;
+			goto on_exit;
+		}
+
+		lexer->type = DLS_SEARCH_TOKEN_STRING;
+		lexer->len = pos - lexer->start;
+		pos++;
+		goto on_exit;
+	} else {
+		lexer->type = DLS_SEARCH_TOKEN_WORD;
+
+		while (*pos && !g_ascii_isspace(*pos) && *pos != '(' &&
+		       *pos != ')' && *pos != '"')
+			pos++;
+	}
+
+	lexer->len = pos - lexer->start;
+
+on_exit:
+
+	lexer->pos = pos;
+}
+
+static gboolean prv_lexer_is_word(const dls_search_lexer_t *lexer,
+				  const gchar *word)
+{
+	return (lexer->type == DLS_SEARCH_TOKEN_WORD) &&
+		(strlen(word) == lexer->len) &&
+		!strncmp(lexer->start, word, lexer->len);
+}
+
+static gchar *prv_unescape(const gchar *start, gsize len)
+{
+	GString *str = g_string_sized_new(len);
+	const gchar *end = start + len;
+
+	for (; start < end; start++) {
+		if (*start == '\\' && start + 1 < end)
+			start++;
+		g_string_append_c(str, *start);
+	}
+
+	return g_string_free(str, FALSE);
+}
+
+static void prv_append_quoted(GString *str, const gchar *value)
+{
+	g_string_append_c(str, '"');
+
+	for (; *value; value++) {
+		if (*value == '"' || *value == '\\')
+			g_string_append_c(str, '\\');
+		g_string_append_c(str, *value);
+	}
+
+	g_string_append_c(str, '"');
+}
+
+static void prv_node_delete(dls_search_node_t *node)
+{
+	if (node) {
+		prv_node_delete(node->left);
+		prv_node_delete(node->right);
+		g_free(node->value);
+		g_free(node);
+	}
+}
+
+static const gchar *prv_find_op(const dls_search_lexer_t *lexer)
+{
+	guint i;
+
+	if (lexer->type != DLS_SEARCH_TOKEN_WORD)
+		return NULL;
+
+	for (i = 0; g_search_ops[i]; i++)
+		if ((strlen(g_search_ops[i]) == lexer->len) &&
+		    !strncmp(lexer->start, g_search_ops[i], lexer->len))
+			return g_search_ops[i];
+
+	return NULL;
+}
+
+/* Translates the dLeyna values of Type, TypeEx, Parent and Path to their
+ * UPnP counterparts.  Other values are passed through.
+ */
+static gboolean prv_translate_value(const gchar *prop, gchar **value)
+{
+	const gchar *translated;
+	gchar *translated_ex;
 	gchar *root_path;
 	gchar *id;
 
-	reg = g_regex_new("(\\w+)\\s+(=|!=|<|<=|>|>|contains|doesNotContain|"\
-			  "derivedfrom|exists)\\s+"\
-			  "(\"[^\"]*\"|true|false)",
-			  0, 0, NULL);
-	str = g_string_new("");
+	if (!strcmp(prop, DLS_INTERFACE_PROP_TYPE)) {
+		translated = dls_props_media_spec_to_upnp_class(*value);
+		if (!translated)
+			return FALSE;
+		g_free(*value);
+		*value = g_strdup(translated);
+	} else if (!strcmp(prop, DLS_INTERFACE_PROP_TYPE_EX)) {
+		translated_ex = dls_props_media_spec_ex_to_upnp_class(*value);
+		if (!translated_ex)
+			return FALSE;
+		g_free(*value);
+		*value = translated_ex;
+	} else if (!strcmp(prop, DLS_INTERFACE_PROP_PARENT) ||
+		   !strcmp(prop, DLS_INTERFACE_PROP_PATH)) {
+		if (!dls_path_get_path_and_id(*value, &root_path, &id, NULL))
+			return FALSE;
+		g_free(root_path);
+		g_free(*value);
+		*value = id;
+	}
 
-	g_regex_match(reg, search_string, 0, &match_info);
-	while (g_match_info_matches(match_info)) {
-		prop = g_match_info_fetch(match_info, 1);
-		if (!prop)
-			goto on_error;
+	return TRUE;
+}
 
-		op = g_match_info_fetch(match_info, 2);
-		if (!op)
-			goto on_error;
+static dls_search_node_t *prv_parse_or(dls_search_parser_t *parser);
 
-		value = g_match_info_fetch(match_info, 3);
-		if (!value)
-			goto on_error;
+static dls_search_node_t *prv_parse_rel(dls_search_parser_t *parser)
+{
+	dls_search_lexer_t *lexer = &parser->lexer;
+	dls_search_node_t *node;
+	dls_prop_map_t *prop_map;
+	gchar *prop;
 
-		/* Handle special cases where we need to translate
-		   value as well as property name */
-
-		if (!strcmp(prop, DLS_INTERFACE_PROP_TYPE)) {
-			/* Skip the quotes */
-
-			value[strlen(value) - 1] = 0;
-			translated_value = dls_props_media_spec_to_upnp_class(
-				value + 1);
-			if (!translated_value)
-				goto on_error;
-			g_free(value);
-			value = g_strdup_printf("\"%s\"", translated_value);
-		} else if (!strcmp(prop, DLS_INTERFACE_PROP_TYPE_EX)) {
-			/* Skip the quotes */
-
-			value[strlen(value) - 1] = 0;
-			translated_type_ex =
-				dls_props_media_spec_ex_to_upnp_class(
-					value + 1);
-			if (!translated_type_ex)
-				goto on_error;
-			g_free(value);
-			value = g_strdup_printf("\"%s\"", translated_type_ex);
-			g_free(translated_type_ex);
-		} else if (!strcmp(prop, DLS_INTERFACE_PROP_PARENT) ||
-			   !strcmp(prop, DLS_INTERFACE_PROP_PATH)) {
-			value[strlen(value) - 1] = 0;
-			if (!dls_path_get_path_and_id(value + 1, &root_path,
-						      &id, NULL))
-				goto on_error;
-			g_free(root_path);
-			g_free(value);
-			value = g_strdup_printf("\"%s\"", id);
-			g_free(id);
-		}
+	if (lexer->type != DLS_SEARCH_TOKEN_WORD)
+		return NULL;
 
-		prop_map = g_hash_table_lookup(filter_map, prop);
-		if (!prop_map)
-			goto on_error;
+	node = g_new0(dls_search_node_t, 1);
+	node->type = DLS_SEARCH_NODE_REL;
 
-		if (!prop_map->searchable)
-			goto on_error;
+	prop = g_strndup(lexer->start, lexer->len);
+	prop_map = g_hash_table_lookup(parser->filter_map, prop);
 
-		if (!g_match_info_fetch_pos(match_info, 0, &start_pos,
-					    &end_pos))
-			goto on_error;
+	if (!prop_map || !prop_map->searchable)
+		goto on_error;
 
-		skipped = start_pos - old_end_pos;
-		if (skipped > 0)
-			g_string_append_len(str, &search_string[old_end_pos],
-					    skipped);
-		g_string_append_printf(str, "%s %s %s",
-				       prop_map->upnp_prop_name, op, value);
-		old_end_pos = end_pos;
+	node->prop = prop_map->upnp_prop_name;
 
-		g_free(value);
-		g_free(prop);
-		g_free(op);
+	prv_lexer_next(lexer);
+	node->op = prv_find_op(lexer);
+	if (!node->op)
+		goto on_error;
 
-		value = NULL;
-		prop = NULL;
-		op = NULL;
+	prv_lexer_next(lexer);
 
-		g_match_info_next(match_info, NULL);
+	if (lexer->type == DLS_SEARCH_TOKEN_STRING) {
+		node->quoted = TRUE;
+		node->value = prv_unescape(lexer->start, lexer->len);
+
+		if (!prv_translate_value(prop, &node->value))
+			goto on_error;
+	} else if (prv_lexer_is_word(lexer, "true") ||
+		   prv_lexer_is_word(lexer, "false")) {
+		node->value = g_strndup(lexer->start, lexer->len);
+	} else {
+		goto on_error;
 	}
 
-	skipped = search_string_len - old_end_pos;
-	if (skipped > 0)
-		g_string_append_len(str, &search_string[old_end_pos],
-				    skipped);
+	prv_lexer_next(lexer);
+	g_free(prop);
 
-	retval = g_string_free(str, FALSE);
-	str = NULL;
+	return node;
 
 on_error:
 
-	g_free(value);
 	g_free(prop);
-	g_free(op);
+	prv_node_delete(node);
+
+	return NULL;
+}
+
+static dls_search_node_t *prv_parse_primary(dls_search_parser_t *parser)
+{
+	dls_search_lexer_t *lexer = &parser->lexer;
+	dls_search_node_t *node;
+
+	if (lexer->type != DLS_SEARCH_TOKEN_OPEN)
+		return prv_parse_rel(parser);
+
+	if (++parser->depth > DLS_SEARCH_MAX_DEPTH)
+		return NULL;
+
+	prv_lexer_next(lexer);
+
+	node = prv_parse_or(parser);
+	if (!node)
+		return NULL;
+
+	if (lexer->type != DLS_SEARCH_TOKEN_CLOSE) {
+		prv_node_delete(node);
+		return NULL;
+	}
+
+	prv_lexer_next(lexer);
+	parser->depth--;
+	node->grouped = TRUE;
+
+	return node;
+}
+
+static dls_search_node_t *prv_parse_binary(dls_search_parser_t *parser,
+					   dls_search_node_type_t type)
+{
+	dls_search_lexer_t *lexer = &parser->lexer;
+	dls_search_node_t *node;
+	dls_search_node_t *right;
+	dls_search_node_t *parent;
+	const gchar *word;
+
+	/* "and" binds tighter than "or" */
+	if (type == DLS_SEARCH_NODE_OR) {
+		word = "or";
+		node = prv_parse_binary(parser, DLS_SEARCH_NODE_AND);
+	} else {
+		word = "and";
+		node = prv_parse_primary(parser);
+	}
+
+	while (node && prv_lexer_is_word(lexer, word)) {
+		prv_lexer_next(lexer);
+
+		if (type == DLS_SEARCH_NODE_OR)
+			right = prv_parse_binary(parser, DLS_SEARCH_NODE_AND);
+		else
+			right = prv_parse_primary(parser);
+
+		if (!right) {
+			prv_node_delete(node);
+			return NULL;
+		}
+
+		parent = g_new0(dls_search_node_t, 1);
+		parent->type = type;
+		parent->left = node;
+		parent->right = right;
+		node = parent;
+	}
+
+	return node;
+}
+
+static dls_search_node_t *prv_parse_or(dls_search_parser_t *parser)
+{
+	return prv_parse_binary(parser, DLS_SEARCH_NODE_OR);
+}
+
+static void prv_node_to_string(const dls_search_node_t *node, GString *str)
+{
+	if (node->grouped)
+		g_string_append_c(str, '(');
+
+	if (node->type == DLS_SEARCH_NODE_REL) {
+		g_string_append_printf(str, "%s %s ", node->prop, node->op);
+
+		if (node->quoted)
+			prv_append_quoted(str, node->value);
+		else
+			g_string_append(str, node->value);
+	} else {
+		prv_node_to_string(node->left, str);
+		g_string_append(str, (node->type == DLS_SEARCH_NODE_AND) ?
+				" and " : " or ");
+		prv_node_to_string(node->right, str);
+	}
+
+	if (node->grouped)
+		g_string_append_c(str, ')');
+}
 
-	if (match_info)
-		g_match_info_free(match_info);
+gchar *dls_search_translate_search_string(GHashTable *filter_map,
+					  const gchar *search_string)
+{
+	dls_search_parser_t parser;
+	dls_search_node_t *root = NULL;
+	GString *str;
+	gchar *retval = NULL;
+
+	memset(&parser, 0, sizeof(parser));
+	parser.filter_map = filter_map;
+	parser.lexer.pos = search_string;
+
+	prv_lexer_next(&parser.lexer);
+
+	if (parser.lexer.type == DLS_SEARCH_TOKEN_END) {
+		retval = g_strdup("");
+		goto on_exit;
+	}
+
+	if (prv_lexer_is_word(&parser.lexer, "*")) {
+		prv_lexer_next(&parser.lexer);
+		if (parser.lexer.type == DLS_SEARCH_TOKEN_END)
+			retval = g_strdup("*");
+		goto on_exit;
+	}
+
+	root = prv_parse_or(&parser);
+	if (!root || parser.lexer.type != DLS_SEARCH_TOKEN_END)
+		goto on_exit;
+
+	str = g_string_new("");
+	prv_node_to_string(root, str);
+	retval = g_string_free(str, FALSE);
 
-	if (str)
-		g_string_free(str, TRUE);
+on_exit:
 
-	g_regex_unref(reg);
+	prv_node_delete(root);
 
 	return retval;
 }
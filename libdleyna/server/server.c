@@ -22,6 +22,8 @@
  */
 
 #include <glib.h>
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
 #include <string.h>
 
 #include <libdleyna/core/connector.h>
@@ -41,6 +43,8 @@
 #include "server.h"
 #include "upnp.h"
 
+#define DLS_SERVER_DEFAULT_MAX_CONCURRENT_READ_TASKS 4
+
 #ifdef UA_PREFIX
 	#define DLS_PRG_NAME UA_PREFIX " dLeyna/" VERSION
 #else
@@ -58,9 +62,32 @@ struct dls_server_context_t_ {
 	GHashTable *watchers;
 	dls_upnp_t *upnp;
 	dls_manager_t *manager;
+	GHashTable *windows;
+	GHashTable *detached;
+};
+
+/* A dleyna-core queue runs one task at a time.  To let the read-only
+ * tasks of a client on a device overlap, they are detached from their
+ * queue as soon as they start and tracked in a window instead.  Any
+ * other task stays the current task of the queue, held back until the
+ * read-only tasks started before it have completed.  barriers counts
+ * those tasks, queued or running, so that high priority read-only tasks
+ * know when they may skip the queue.
+ */
+typedef struct dls_server_window_t_ dls_server_window_t;
+struct dls_server_window_t_ {
+	const dleyna_task_queue_key_t *queue_id;
+	gchar *source;
+	gchar *sink;
+	GPtrArray *in_flight;
+	dls_task_t *held;
+	guint barriers;
 };
 
 static dls_server_context_t g_context;
+static guint g_max_concurrent_read_tasks =
+				DLS_SERVER_DEFAULT_MAX_CONCURRENT_READ_TASKS;
+static guint64 g_expired_tasks;
 
 static const gchar g_root_introspection[] =
 	"<node>"
@@ -85,6 +112,10 @@ static const gchar g_root_introspection[] =
 	"      <arg type='b' name='"DLS_INTERFACE_PREFER"'"
 	"           direction='in'/>"
 	"    </method>"
+	"    <method name='"DLS_INTERFACE_SET_REQUEST_TIMEOUT"'>"
+	"      <arg type='u' name='"DLS_INTERFACE_TIMEOUT"'"
+	"           direction='in'/>"
+	"    </method>"
 	"    <signal name='"DLS_INTERFACE_FOUND_SERVER"'>"
 	"      <arg type='o' name='"DLS_INTERFACE_PATH"'/>"
 	"    </signal>"
@@ -97,6 +128,59 @@ static const gchar g_root_introspection[] =
 	"       access='readwrite'/>"
 	"    <property type='b' name='"DLS_INTERFACE_PROP_WHITE_LIST_ENABLED"'"
 	"       access='readwrite'/>"
+	"    <property type='t' name='"DLS_INTERFACE_PROP_METADATA_CACHE_HITS"'"
+	"       access='read'/>"
+	"    <property type='t' name='"DLS_INTERFACE_PROP_METADATA_CACHE_MISSES"'"
+	"       access='read'/>"
+	"    <property type='u' name='"DLS_INTERFACE_PROP_MAX_CHILD_COUNT_REQUESTS"'"
+	"       access='readwrite'/>"
+	"    <property type='u' name='"
+	DLS_INTERFACE_PROP_MAX_BROWSE_OBJECTS_REQUESTS"'"
+	"       access='readwrite'/>"
+	"    <property type='u' name='"
+	DLS_INTERFACE_PROP_BROWSE_OBJECTS_BATCH_SIZE"'"
+	"       access='readwrite'/>"
+	"    <property type='u' name='"
+	DLS_INTERFACE_PROP_MAX_HTTP_CONNECTIONS_PER_HOST"'"
+	"       access='readwrite'/>"
+	"    <property type='u' name='"DLS_INTERFACE_PROP_HTTP_IDLE_TIMEOUT"'"
+	"       access='readwrite'/>"
+	"    <property type='t' name='"DLS_INTERFACE_PROP_HTTP_REQUESTS"'"
+	"       access='read'/>"
+	"    <property type='t' name='"DLS_INTERFACE_PROP_HTTP_CONNECTIONS"'"
+	"       access='read'/>"
+	"    <property type='u' name='"DLS_INTERFACE_PROP_MAX_CONCURRENT_UPLOADS"'"
+	"       access='readwrite'/>"
+	"    <property type='u' name='"DLS_INTERFACE_PROP_UPLOAD_RATE_LIMIT"'"
+	"       access='readwrite'/>"
+	"    <property type='s' name='"DLS_INTERFACE_PROP_UPLOAD_ORDER"'"
+	"       access='readwrite'/>"
+	"    <property type='u' name='"
+	DLS_INTERFACE_PROP_UPLOAD_PROGRESS_INTERVAL"'"
+	"       access='readwrite'/>"
+	"    <property type='u' name='"DLS_INTERFACE_PROP_UPLOAD_PROGRESS_STEP"'"
+	"       access='readwrite'/>"
+	"    <property type='u' name='"DLS_INTERFACE_PROP_UPLOAD_MAX_RETRIES"'"
+	"       access='readwrite'/>"
+	"    <property type='u' name='"
+	DLS_INTERFACE_PROP_CHANGED_FLUSH_INTERVAL"'"
+	"       access='readwrite'/>"
+	"    <property type='u' name='"DLS_INTERFACE_PROP_CHANGED_MAX_BATCH"'"
+	"       access='readwrite'/>"
+	"    <property type='t' name='"
+	DLS_INTERFACE_PROP_CHANGED_EVENTS_RECEIVED"'"
+	"       access='read'/>"
+	"    <property type='t' name='"
+	DLS_INTERFACE_PROP_CHANGED_SIGNALS_EMITTED"'"
+	"       access='read'/>"
+	"    <property type='t' name='"
+	DLS_INTERFACE_PROP_SUBSCRIBED_CHANGES_EMITTED"'"
+	"       access='read'/>"
+	"    <property type='u' name='"
+	DLS_INTERFACE_PROP_MAX_CONCURRENT_READ_TASKS"'"
+	"       access='readwrite'/>"
+	"    <property type='t' name='"DLS_INTERFACE_PROP_EXPIRED_TASKS"'"
+	"       access='read'/>"
 	"  </interface>"
 	"  <interface name='"DLS_INTERFACE_PROPERTIES"'>"
 	"    <method name='"DLS_INTERFACE_GET"'>"
@@ -290,6 +374,22 @@ static const gchar g_server_introspection[] =
 	"      <arg type='o' name='"DLS_INTERFACE_PATH"'"
 	"           direction='out'/>"
 	"    </method>"
+	"    <method name='"DLS_INTERFACE_UPLOAD_MANY"'>"
+	"      <arg type='a(ss)' name='"DLS_INTERFACE_FILES"'"
+	"           direction='in'/>"
+	"      <arg type='aa{sv}' name='"DLS_INTERFACE_UPLOADS"'"
+	"           direction='out'/>"
+	"    </method>"
+	"    <method name='"DLS_INTERFACE_UPLOAD_FD"'>"
+	"      <arg type='s' name='"DLS_INTERFACE_PROP_DISPLAY_NAME"'"
+	"           direction='in'/>"
+	"      <arg type='h' name='"DLS_INTERFACE_FD"'"
+	"           direction='in'/>"
+	"      <arg type='u' name='"DLS_INTERFACE_UPLOAD_ID"'"
+	"           direction='out'/>"
+	"      <arg type='o' name='"DLS_INTERFACE_PATH"'"
+	"           direction='out'/>"
+	"    </method>"
 	"    <method name='"DLS_INTERFACE_CREATE_CONTAINER"'>"
 	"      <arg type='s' name='"DLS_INTERFACE_PROP_DISPLAY_NAME"'"
 	"           direction='in'/>"
@@ -413,6 +513,22 @@ static const gchar g_server_introspection[] =
 	"      <arg type='o' name='"DLS_INTERFACE_PATH"'"
 	"           direction='out'/>"
 	"    </method>"
+	"    <method name='"DLS_INTERFACE_UPLOAD_MANY_TO_ANY"'>"
+	"      <arg type='a(ss)' name='"DLS_INTERFACE_FILES"'"
+	"           direction='in'/>"
+	"      <arg type='aa{sv}' name='"DLS_INTERFACE_UPLOADS"'"
+	"           direction='out'/>"
+	"    </method>"
+	"    <method name='"DLS_INTERFACE_UPLOAD_FD_TO_ANY"'>"
+	"      <arg type='s' name='"DLS_INTERFACE_PROP_DISPLAY_NAME"'"
+	"           direction='in'/>"
+	"      <arg type='h' name='"DLS_INTERFACE_FD"'"
+	"           direction='in'/>"
+	"      <arg type='u' name='"DLS_INTERFACE_UPLOAD_ID"'"
+	"           direction='out'/>"
+	"      <arg type='o' name='"DLS_INTERFACE_PATH"'"
+	"           direction='out'/>"
+	"    </method>"
 	"    <method name='"DLS_INTERFACE_GET_UPLOAD_STATUS"'>"
 	"      <arg type='u' name='"DLS_INTERFACE_UPLOAD_ID"'"
 	"           direction='in'/>"
@@ -423,6 +539,12 @@ static const gchar g_server_introspection[] =
 	"      <arg type='t' name='"DLS_INTERFACE_TOTAL"'"
 	"           direction='out'/>"
 	"    </method>"
+	"    <method name='"DLS_INTERFACE_GET_UPLOAD_INFO"'>"
+	"      <arg type='u' name='"DLS_INTERFACE_UPLOAD_ID"'"
+	"           direction='in'/>"
+	"      <arg type='a{sv}' name='"DLS_INTERFACE_UPLOAD_INFO"'"
+	"           direction='out'/>"
+	"    </method>"
 	"    <method name='"DLS_INTERFACE_GET_UPLOAD_IDS"'>"
 	"      <arg type='au' name='"DLS_INTERFACE_TOTAL"'"
 	"           direction='out'/>"
@@ -431,6 +553,12 @@ static const gchar g_server_introspection[] =
 	"      <arg type='u' name='"DLS_INTERFACE_UPLOAD_ID"'"
 	"           direction='in'/>"
 	"    </method>"
+	"    <method name='"DLS_INTERFACE_SUBSCRIBE_CHANGES"'>"
+	"      <arg type='ao' name='"DLS_INTERFACE_PATHS"'"
+	"           direction='in'/>"
+	"      <arg type='u' name='"DLS_INTERFACE_FLAGS"'"
+	"           direction='in'/>"
+	"    </method>"
 	"    <method name='"DLS_INTERFACE_CREATE_CONTAINER_IN_ANY"'>"
 	"      <arg type='s' name='"DLS_INTERFACE_PROP_DISPLAY_NAME"'"
 	"           direction='in'/>"
@@ -512,18 +640,30 @@ static const gchar g_server_introspection[] =
 	"    <property type='s' name='"
 	DLS_INTERFACE_PROP_SV_SERVICE_RESET_TOKEN"'"
 	"       access='read'/>"
+	"    <property type='t' name='"
+	DLS_INTERFACE_PROP_METADATA_CACHE_HITS"'"
+	"       access='read'/>"
+	"    <property type='t' name='"
+	DLS_INTERFACE_PROP_METADATA_CACHE_MISSES"'"
+	"       access='read'/>"
 	"    <signal name='"DLS_INTERFACE_ESV_CONTAINER_UPDATE_IDS"'>"
 	"      <arg type='a(ou)' name='"DLS_INTERFACE_CONTAINER_PATHS_ID"'/>"
 	"    </signal>"
 	"    <signal name='"DLS_INTERFACE_CHANGED_EVENT"'>"
 	"      <arg type='aa{sv}' name='"DLS_INTERFACE_CHANGED_OBJECTS"'/>"
 	"    </signal>"
+	"    <signal name='"DLS_INTERFACE_SUBSCRIBED_CHANGES"'>"
+	"      <arg type='aa{sv}' name='"DLS_INTERFACE_CHANGED_OBJECTS"'/>"
+	"    </signal>"
 	"    <signal name='"DLS_INTERFACE_UPLOAD_UPDATE"'>"
 	"      <arg type='u' name='"DLS_INTERFACE_UPLOAD_ID"'/>"
 	"      <arg type='s' name='"DLS_INTERFACE_UPLOAD_STATUS"'/>"
 	"      <arg type='t' name='"DLS_INTERFACE_LENGTH"'/>"
 	"      <arg type='t' name='"DLS_INTERFACE_TOTAL"'/>"
 	"    </signal>"
+	"    <signal name='"DLS_INTERFACE_UPLOAD_PROGRESS"'>"
+	"      <arg type='a(ustt)' name='"DLS_INTERFACE_UPLOADS"'/>"
+	"    </signal>"
 	"  </interface>"
 	"</node>";
 
@@ -538,11 +678,370 @@ const dleyna_connector_t *dls_server_get_connector(void)
 	return g_context.connector;
 }
 
+/* File descriptors travel out of band, in the file descriptor list of the
+ * D-Bus message, and the handle passed in the arguments only indexes that
+ * list.  The connector API has no notion of them, so this only works with
+ * the D-Bus connector, which identifies method calls by their
+ * GDBusMethodInvocation, and fails with other connectors.  Returns a
+ * duplicate of the descriptor, owned by the caller, or -1 on error.
+ */
+gint dls_server_get_unix_fd(dleyna_connector_msg_id_t invocation,
+			    gint32 handle, GError **error)
+{
+	GDBusMessage *message;
+	GUnixFDList *fd_list;
+	gint fd = -1;
+
+	if (!G_IS_DBUS_METHOD_INVOCATION(invocation)) {
+		DLEYNA_LOG_WARNING("Connector cannot pass file descriptors");
+
+		*error = g_error_new(DLEYNA_SERVER_ERROR,
+				     DLEYNA_ERROR_NOT_SUPPORTED,
+				     "Connector cannot pass file descriptors");
+
+		goto on_error;
+	}
+
+	message = g_dbus_method_invocation_get_message(
+				(GDBusMethodInvocation *)invocation);
+	fd_list = g_dbus_message_get_unix_fd_list(message);
+
+	if (fd_list && handle >= 0 &&
+	    handle < g_unix_fd_list_get_length(fd_list))
+		fd = g_unix_fd_list_get(fd_list, handle, NULL);
+
+	if (fd < 0) {
+		DLEYNA_LOG_WARNING("Invalid file descriptor handle %d", handle);
+
+		*error = g_error_new(DLEYNA_SERVER_ERROR,
+				     DLEYNA_ERROR_BAD_QUERY,
+				     "Invalid file descriptor handle %d",
+				     handle);
+	}
+
+on_error:
+
+	return fd;
+}
+
+/* Same as the notify method of the connector, except that the signal is
+ * only sent to client.  The connector API cannot address a single client,
+ * so this only works with the D-Bus connector, whose connection IDs are
+ * GDBusConnections, and fails with other connectors.
+ */
+gboolean dls_server_notify_client(dleyna_connector_id_t connection,
+				  const gchar *client,
+				  const gchar *object_path,
+				  const gchar *interface_name,
+				  const gchar *notification_name,
+				  GVariant *parameters,
+				  GError **error)
+{
+	if (!G_IS_DBUS_CONNECTION(connection)) {
+		DLEYNA_LOG_WARNING("Connector cannot notify a single client");
+
+		g_variant_unref(g_variant_ref_sink(parameters));
+		*error = g_error_new(DLEYNA_SERVER_ERROR,
+				     DLEYNA_ERROR_NOT_SUPPORTED,
+				     "Connector cannot notify a single client");
+
+		return FALSE;
+	}
+
+	return g_dbus_connection_emit_signal((GDBusConnection *)connection,
+					     client, object_path,
+					     interface_name, notification_name,
+					     parameters, error);
+}
+
 dleyna_task_processor_t *dls_server_get_task_processor(void)
 {
 	return g_context.processor;
 }
 
+guint dls_server_get_max_concurrent_read_tasks(void)
+{
+	return g_max_concurrent_read_tasks;
+}
+
+void dls_server_set_max_concurrent_read_tasks(guint max_tasks)
+{
+	g_max_concurrent_read_tasks = max_tasks;
+}
+
+guint64 dls_server_get_expired_tasks(void)
+{
+	return g_expired_tasks;
+}
+
+static gboolean prv_task_is_read_only(dls_task_t *task)
+{
+	switch (task->type) {
+	case DLS_TASK_GET_CHILDREN:
+	case DLS_TASK_GET_PROP:
+	case DLS_TASK_GET_ALL_PROPS:
+	case DLS_TASK_SEARCH:
+	case DLS_TASK_BROWSE_OBJECTS:
+	case DLS_TASK_GET_RESOURCE:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/* Property reads of a single object are what players wait on, while
+ * searches and bulk browses can take a long time.
+ */
+static dls_task_priority_t prv_task_priority(dls_task_t *task)
+{
+	switch (task->type) {
+	case DLS_TASK_GET_PROP:
+	case DLS_TASK_GET_ALL_PROPS:
+	case DLS_TASK_GET_RESOURCE:
+		return DLS_TASK_PRIORITY_HIGH;
+	case DLS_TASK_SEARCH:
+	case DLS_TASK_BROWSE_OBJECTS:
+		return DLS_TASK_PRIORITY_LOW;
+	default:
+		return DLS_TASK_PRIORITY_NORMAL;
+	}
+}
+
+static void prv_window_delete(dls_server_window_t *window)
+{
+	g_ptr_array_unref(window->in_flight);
+	g_free(window->source);
+	g_free(window->sink);
+	g_free(window);
+}
+
+static dls_server_window_t *prv_window_get(
+					const dleyna_task_queue_key_t *queue_id,
+					const gchar *sink)
+{
+	dls_server_window_t *window;
+
+	window = g_hash_table_lookup(g_context.windows, queue_id);
+	if (!window) {
+		window = g_new0(dls_server_window_t, 1);
+		window->queue_id = queue_id;
+		window->source = g_strdup(
+				dleyna_task_queue_get_source(queue_id));
+		window->sink = g_strdup(sink);
+		window->in_flight = g_ptr_array_new();
+		g_hash_table_insert(g_context.windows, (gpointer)queue_id,
+				    window);
+	}
+
+	return window;
+}
+
+static void prv_window_add(dls_task_t *task, const gchar *sink)
+{
+	dls_server_window_t *window;
+
+	window = prv_window_get(task->atom.queue_id, sink);
+	g_ptr_array_add(window->in_flight, task);
+	g_hash_table_insert(g_context.detached, task, window);
+}
+
+static void prv_window_release(dls_server_window_t *window)
+{
+	if (window->in_flight->len || window->held ||
+	    (window->queue_id && window->barriers))
+		goto on_exit;
+
+	if (window->queue_id)
+		(void) g_hash_table_remove(g_context.windows,
+					   window->queue_id);
+
+	prv_window_delete(window);
+
+on_exit:
+
+	return;
+}
+
+static gboolean prv_window_may_start(dls_server_window_t *window,
+				     dls_task_t *task)
+{
+	guint limit = g_max_concurrent_read_tasks;
+
+	if (!window)
+		return TRUE;
+
+	if (!prv_task_is_read_only(task))
+		return window->in_flight->len == 0;
+
+	/* Keep a slot free for tasks of a higher priority */
+	if (task->priority == DLS_TASK_PRIORITY_LOW && limit > 1)
+		limit--;
+
+	return window->in_flight->len < limit;
+}
+
+static gboolean prv_window_may_skip_queue(dls_server_window_t *window,
+					  dls_task_t *task)
+{
+	if (task->priority != DLS_TASK_PRIORITY_HIGH || task->synchronous ||
+	    g_max_concurrent_read_tasks < 2 || !prv_task_is_read_only(task))
+		return FALSE;
+
+	if (!window)
+		return TRUE;
+
+	return !window->barriers &&
+		window->in_flight->len < g_max_concurrent_read_tasks;
+}
+
+static void prv_window_cancel(dls_server_window_t *window)
+{
+	GPtrArray *tasks;
+	guint i;
+
+	/* Cancelling may complete a task, and so shrink in_flight */
+	tasks = g_ptr_array_sized_new(window->in_flight->len);
+	for (i = 0; i < window->in_flight->len; ++i)
+		g_ptr_array_add(tasks, g_ptr_array_index(window->in_flight, i));
+
+	for (i = 0; i < tasks->len; ++i)
+		dls_task_cancel(g_ptr_array_index(tasks, i));
+
+	g_ptr_array_unref(tasks);
+}
+
+/* Called once the queues of source, or of sink, have been removed */
+static void prv_windows_orphan(const gchar *source, const gchar *sink)
+{
+	GHashTableIter iter;
+	gpointer value;
+	dls_server_window_t *window;
+	GPtrArray *orphans;
+	guint i;
+
+	if (!g_context.windows)
+		goto on_exit;
+
+	orphans = g_ptr_array_new();
+
+	g_hash_table_iter_init(&iter, g_context.windows);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		window = value;
+
+		if ((source && !strcmp(window->source, source)) ||
+		    (sink && !strcmp(window->sink, sink))) {
+			window->queue_id = NULL;
+			g_hash_table_iter_remove(&iter);
+			g_ptr_array_add(orphans, window);
+		}
+	}
+
+	/* The windows left are freed as their tasks complete */
+	for (i = 0; i < orphans->len; ++i) {
+		window = g_ptr_array_index(orphans, i);
+		if (window->in_flight->len)
+			prv_window_cancel(window);
+		else
+			prv_window_delete(window);
+	}
+
+	g_ptr_array_unref(orphans);
+
+on_exit:
+
+	return;
+}
+
+/* Queues must only be removed through here, so that no window outlives
+ * the queue whose address keys it.
+ */
+static void prv_remove_queues(const gchar *source, const gchar *sink)
+{
+	if (source)
+		dleyna_task_processor_remove_queues_for_source(
+							g_context.processor,
+							source);
+	else
+		dleyna_task_processor_remove_queues_for_sink(
+							g_context.processor,
+							sink);
+
+	prv_windows_orphan(source, sink);
+}
+
+void dls_server_remove_queues_for_sink(const gchar *sink)
+{
+	prv_remove_queues(NULL, sink);
+}
+
+static void prv_run_task(dls_task_t *task);
+
+static void prv_window_resume(dls_server_window_t *window)
+{
+	dls_task_t *task = window->held;
+
+	if (task && window->queue_id && prv_window_may_start(window, task)) {
+		window->held = NULL;
+		prv_run_task(task);
+	}
+
+	prv_window_release(window);
+}
+
+static gboolean prv_held_task_cancelled_cb(gpointer user_data)
+{
+	dls_task_t *task = user_data;
+
+	dleyna_task_queue_task_completed(task->atom.queue_id);
+
+	return FALSE;
+}
+
+/* A task that has started is cancelled through its GCancellable, with
+ * the expiry as its error.  Otherwise its caller gets the error now and
+ * the task is dropped when its queue reaches it.
+ */
+static gboolean prv_task_deadline_cb(gpointer user_data)
+{
+	dls_task_t *task = user_data;
+	dls_async_task_t *async_task = (dls_async_task_t *)task;
+	dls_server_window_t *window;
+	GError *error;
+
+	DLEYNA_LOG_WARNING("Task deadline exceeded");
+
+	task->deadline_id = 0;
+	task->expired = TRUE;
+	g_expired_tasks++;
+
+	error = g_error_new(G_DBUS_ERROR, G_DBUS_ERROR_TIMEOUT,
+			    "Deadline exceeded.");
+
+	if (!task->synchronous && async_task->cancellable) {
+		if (!async_task->error)
+			async_task->error = error;
+		else
+			g_error_free(error);
+
+		dls_async_task_cancel(async_task);
+		goto on_exit;
+	}
+
+	dls_task_fail(task, error);
+	g_error_free(error);
+
+	window = g_hash_table_lookup(g_context.windows, task->atom.queue_id);
+	if (window && window->held == task) {
+		window->held = NULL;
+		(void) g_idle_add(prv_held_task_cancelled_cb, task);
+		prv_window_release(window);
+	}
+
+on_exit:
+
+	return FALSE;
+}
+
 static void prv_process_sync_task(dls_task_t *task)
 {
 	dls_client_t *client;
@@ -566,14 +1065,12 @@ static void prv_process_sync_task(dls_task_t *task)
 		client_name = dleyna_task_queue_get_source(task->atom.queue_id);
 		client = g_hash_table_lookup(g_context.watchers, client_name);
 		if (client) {
-			g_free(client->protocol_info);
-			if (task->ut.protocol_info.protocol_info[0]) {
-				client->protocol_info =
-					task->ut.protocol_info.protocol_info;
-				task->ut.protocol_info.protocol_info = NULL;
-			} else {
+			dls_matcher_delete(client->protocol_info);
+			if (task->ut.protocol_info.protocol_info[0])
+				client->protocol_info = dls_matcher_new(
+					task->ut.protocol_info.protocol_info);
+			else
 				client->protocol_info = NULL;
-			}
 		}
 		dls_task_complete(task);
 		break;
@@ -586,7 +1083,16 @@ static void prv_process_sync_task(dls_task_t *task)
 		}
 		dls_task_complete(task);
 		break;
+	case DLS_TASK_SET_REQUEST_TIMEOUT:
+		client_name = dleyna_task_queue_get_source(task->atom.queue_id);
+		client = g_hash_table_lookup(g_context.watchers, client_name);
+		if (client)
+			client->request_timeout =
+					task->ut.request_timeout.timeout;
+		dls_task_complete(task);
+		break;
 	case DLS_TASK_GET_UPLOAD_STATUS:
+	case DLS_TASK_GET_UPLOAD_INFO:
 		dls_upnp_get_upload_status(g_context.upnp, task);
 		break;
 	case DLS_TASK_GET_UPLOAD_IDS:
@@ -595,6 +1101,10 @@ static void prv_process_sync_task(dls_task_t *task)
 	case DLS_TASK_CANCEL_UPLOAD:
 		dls_upnp_cancel_upload(g_context.upnp, task);
 		break;
+	case DLS_TASK_SUBSCRIBE_CHANGES:
+		client_name = dleyna_task_queue_get_source(task->atom.queue_id);
+		dls_upnp_subscribe_changes(g_context.upnp, client_name, task);
+		break;
 	default:
 		goto finished;
 		break;
@@ -608,6 +1118,8 @@ finished:
 
 static void prv_async_task_complete(dls_task_t *task, GError *error)
 {
+	dls_server_window_t *window;
+
 	DLEYNA_LOG_DEBUG("Enter");
 
 	if (!error) {
@@ -617,22 +1129,40 @@ static void prv_async_task_complete(dls_task_t *task, GError *error)
 		g_error_free(error);
 	}
 
-	dleyna_task_queue_task_completed(task->atom.queue_id);
+	window = g_hash_table_lookup(g_context.detached, task);
+	if (!window) {
+		dleyna_task_queue_task_completed(task->atom.queue_id);
+		goto on_exit;
+	}
+
+	(void) g_hash_table_remove(g_context.detached, task);
+	(void) g_ptr_array_remove_fast(window->in_flight, task);
+	dls_task_delete(task);
+
+	prv_window_resume(window);
+
+on_exit:
 
 	DLEYNA_LOG_DEBUG("Exit");
 }
 
-static void prv_process_async_task(dls_task_t *task)
+static dls_client_t *prv_task_client(dls_task_t *task)
+{
+	return g_hash_table_lookup(
+			g_context.watchers,
+			dleyna_task_queue_get_source(task->atom.queue_id));
+}
+
+/* client is resolved by the caller, as a detached task may no longer
+ * hold its queue.
+ */
+static void prv_process_async_task(dls_task_t *task, dls_client_t *client)
 {
 	dls_async_task_t *async_task = (dls_async_task_t *)task;
-	dls_client_t *client;
-	const gchar *client_name;
 
 	DLEYNA_LOG_DEBUG("Enter");
 
 	async_task->cancellable = g_cancellable_new();
-	client_name = dleyna_task_queue_get_source(task->atom.queue_id);
-	client = g_hash_table_lookup(g_context.watchers, client_name);
 
 	switch (task->type) {
 	case DLS_TASK_MANAGER_GET_PROP:
@@ -672,13 +1202,20 @@ static void prv_process_async_task(dls_task_t *task)
 				      prv_async_task_complete);
 		break;
 	case DLS_TASK_UPLOAD_TO_ANY:
+	case DLS_TASK_UPLOAD_FD_TO_ANY:
 		dls_upnp_upload_to_any(g_context.upnp, client, task,
 				       prv_async_task_complete);
 		break;
 	case DLS_TASK_UPLOAD:
+	case DLS_TASK_UPLOAD_FD:
 		dls_upnp_upload(g_context.upnp, client, task,
 				prv_async_task_complete);
 		break;
+	case DLS_TASK_UPLOAD_MANY_TO_ANY:
+	case DLS_TASK_UPLOAD_MANY:
+		dls_upnp_upload_many(g_context.upnp, client, task,
+				     prv_async_task_complete);
+		break;
 	case DLS_TASK_DELETE_OBJECT:
 		dls_upnp_delete_object(g_context.upnp, client, task,
 				       prv_async_task_complete);
@@ -718,24 +1255,95 @@ static void prv_process_async_task(dls_task_t *task)
 	DLEYNA_LOG_DEBUG("Exit");
 }
 
+static void prv_detach_task(dls_task_t *task)
+{
+	prv_window_add(task, task->target.device->path);
+
+	/* The queue moves on, prv_delete_task leaves the task alone */
+	dleyna_task_queue_task_completed(task->atom.queue_id);
+}
+
+static void prv_run_task(dls_task_t *task)
+{
+	dls_client_t *client;
+
+	if (task->synchronous) {
+		prv_process_sync_task(task);
+	} else {
+		client = prv_task_client(task);
+
+		if (g_max_concurrent_read_tasks > 1 &&
+		    prv_task_is_read_only(task))
+			prv_detach_task(task);
+
+		prv_process_async_task(task, client);
+	}
+}
+
 static void prv_process_task(dleyna_task_atom_t *task, gpointer user_data)
 {
 	dls_task_t *client_task = (dls_task_t *)task;
+	dls_server_window_t *window;
 
-	if (client_task->synchronous)
-		prv_process_sync_task(client_task);
-	else
-		prv_process_async_task(client_task);
+	if (client_task->expired) {
+		dleyna_task_queue_task_completed(task->queue_id);
+		goto on_exit;
+	}
+
+	window = g_hash_table_lookup(g_context.windows, task->queue_id);
+
+	if (!prv_window_may_start(window, client_task)) {
+		DLEYNA_LOG_DEBUG("Task waits for %u read-only tasks",
+				 window->in_flight->len);
+		window->held = client_task;
+		goto on_exit;
+	}
+
+	prv_run_task(client_task);
+
+on_exit:
+
+	return;
 }
 
 static void prv_cancel_task(dleyna_task_atom_t *task, gpointer user_data)
 {
-	dls_task_cancel((dls_task_t *)task);
+	dls_task_t *client_task = (dls_task_t *)task;
+	dls_server_window_t *window;
+
+	dls_task_cancel(client_task);
+
+	/* A held task never started, so nothing else will complete it */
+	window = g_hash_table_lookup(g_context.windows, task->queue_id);
+	if (window && window->held == client_task) {
+		window->held = NULL;
+		(void) g_idle_add(prv_held_task_cancelled_cb, client_task);
+		prv_window_release(window);
+	}
 }
 
 static void prv_delete_task(dleyna_task_atom_t *task, gpointer user_data)
 {
-	dls_task_delete((dls_task_t *)task);
+	dls_task_t *client_task = (dls_task_t *)task;
+	dls_server_window_t *window;
+
+	if (g_hash_table_contains(g_context.detached, task))
+		goto on_exit;
+
+	if (!prv_task_is_read_only(client_task)) {
+		window = g_hash_table_lookup(g_context.windows,
+					     task->queue_id);
+		if (window) {
+			window->barriers--;
+			prv_window_release(window);
+		}
+	}
+
+	dls_task_delete(client_task);
+
+on_exit:
+
+	return;
 }
 
 static void prv_manager_root_method_call(dleyna_connector_id_t conn,
@@ -813,8 +1421,10 @@ static const dleyna_connector_dispatch_cb_t
 
 static void prv_remove_client(const gchar *name)
 {
-	dleyna_task_processor_remove_queues_for_source(g_context.processor,
-						       name);
+	prv_remove_queues(name, NULL);
+
+	if (g_context.upnp)
+		dls_upnp_unsubscribe_changes(g_context.upnp, name);
 
 	(void) g_hash_table_remove(g_context.watchers, name);
 
@@ -835,8 +1445,10 @@ static void prv_add_task(dls_task_t *task, const gchar *source,
 {
 	dls_client_t *client;
 	const dleyna_task_queue_key_t *queue_id;
+	dls_server_window_t *window;
 
-	if (!g_hash_table_lookup(g_context.watchers, source)) {
+	client = g_hash_table_lookup(g_context.watchers, source);
+	if (!client) {
 		client = g_new0(dls_client_t, 1);
 		client->prefer_local_addresses = TRUE;
 		g_context.connector->watch_client(source);
@@ -844,6 +1456,12 @@ static void prv_add_task(dls_task_t *task, const gchar *source,
 				    client);
 	}
 
+	task->priority = prv_task_priority(task);
+
+	if (client->request_timeout && task->invocation)
+		task->deadline_id = g_timeout_add(client->request_timeout,
+						  prv_task_deadline_cb, task);
+
 	queue_id = dleyna_task_processor_lookup_queue(g_context.processor,
 						      source, sink);
 	if (!queue_id)
@@ -856,7 +1474,26 @@ static void prv_add_task(dls_task_t *task, const gchar *source,
 					prv_cancel_task,
 					prv_delete_task);
 
+	window = g_hash_table_lookup(g_context.windows, queue_id);
+
+	if (prv_window_may_skip_queue(window, task)) {
+		DLEYNA_LOG_DEBUG("High priority task skips its queue");
+
+		task->atom.queue_id = queue_id;
+		prv_window_add(task, sink);
+		prv_process_async_task(task, client);
+
+		goto on_exit;
+	}
+
+	if (!prv_task_is_read_only(task))
+		prv_window_get(queue_id, sink)->barriers++;
+
 	dleyna_task_queue_add_task(queue_id, &task->atom);
+
+on_exit:
+
+	return;
 }
 
 static void prv_manager_root_method_call(
@@ -884,6 +1521,9 @@ static void prv_manager_root_method_call(
 	} else if (!strcmp(method, DLS_INTERFACE_PREFER_LOCAL_ADDRESSES)) {
 		task = dls_task_prefer_local_addresses_new(invocation,
 							   parameters);
+	} else if (!strcmp(method, DLS_INTERFACE_SET_REQUEST_TIMEOUT)) {
+		task = dls_task_set_request_timeout_new(invocation,
+							parameters);
 	} else {
 		goto finished;
 	}
@@ -945,14 +1585,7 @@ gboolean dls_server_get_object_info(const gchar *object_path,
 		goto on_error;
 	}
 
-	*device = dls_device_from_path(*root_path,
-				dls_upnp_get_device_udn_map(g_context.upnp));
-
-	if (*device == NULL) {
-		*device = dls_device_from_path(*root_path,
-				dls_upnp_get_sleeping_device_udn_map(
-							      g_context.upnp));
-	}
+	*device = dls_upnp_get_device_from_path(g_context.upnp, *root_path);
 
 	if (*device == NULL) {
 		DLEYNA_LOG_WARNING("Cannot locate device for %s", *root_path);
@@ -1118,6 +1751,12 @@ static void prv_con_method_call(dleyna_connector_id_t conn,
 	else if (!strcmp(method, DLS_INTERFACE_UPLOAD))
 		task = dls_task_upload_new(invocation, object,
 					   parameters, &error);
+	else if (!strcmp(method, DLS_INTERFACE_UPLOAD_MANY))
+		task = dls_task_upload_many_new(invocation, object,
+						parameters, &error);
+	else if (!strcmp(method, DLS_INTERFACE_UPLOAD_FD))
+		task = dls_task_upload_fd_new(invocation, object,
+					      parameters, &error);
 	else if (!strcmp(method, DLS_INTERFACE_CREATE_CONTAINER))
 		task = dls_task_create_container_new_generic(invocation,
 						DLS_TASK_CREATE_CONTAINER,
@@ -1192,10 +1831,17 @@ static void prv_device_method_call(dleyna_connector_id_t conn,
 	GError *error = NULL;
 	const gchar *device_id;
 	const dleyna_task_queue_key_t *queue_id;
+	dls_server_window_t *window;
 
 	if (!strcmp(method, DLS_INTERFACE_UPLOAD_TO_ANY)) {
 		task = dls_task_upload_to_any_new(invocation,
 						  object, parameters, &error);
+	} else if (!strcmp(method, DLS_INTERFACE_UPLOAD_MANY_TO_ANY)) {
+		task = dls_task_upload_many_to_any_new(invocation, object,
+						       parameters, &error);
+	} else if (!strcmp(method, DLS_INTERFACE_UPLOAD_FD_TO_ANY)) {
+		task = dls_task_upload_fd_to_any_new(invocation, object,
+						     parameters, &error);
 	} else if (!strcmp(method, DLS_INTERFACE_CREATE_CONTAINER_IN_ANY)) {
 		task = dls_task_create_container_new_generic(
 					invocation,
@@ -1205,12 +1851,18 @@ static void prv_device_method_call(dleyna_connector_id_t conn,
 		task = dls_task_get_upload_status_new(invocation,
 						      object, parameters,
 						      &error);
+	} else if (!strcmp(method, DLS_INTERFACE_GET_UPLOAD_INFO)) {
+		task = dls_task_get_upload_info_new(invocation, object,
+						    parameters, &error);
 	} else if (!strcmp(method, DLS_INTERFACE_GET_UPLOAD_IDS)) {
 		task = dls_task_get_upload_ids_new(invocation, object,
 						   &error);
 	} else if (!strcmp(method, DLS_INTERFACE_CANCEL_UPLOAD)) {
 		task = dls_task_cancel_upload_new(invocation, object,
 						  parameters, &error);
+	} else if (!strcmp(method, DLS_INTERFACE_SUBSCRIBE_CHANGES)) {
+		task = dls_task_subscribe_changes_new(invocation, object,
+						      parameters, &error);
 	} else if (!strcmp(method, DLS_INTERFACE_GET_ICON)) {
 		task = dls_task_get_icon_new(invocation, object, parameters,
 					     &error);
@@ -1230,9 +1882,15 @@ static void prv_device_method_call(dleyna_connector_id_t conn,
 							g_context.processor,
 							sender,
 							device_id);
-		if (queue_id)
+		if (queue_id) {
 			dleyna_task_processor_cancel_queue(queue_id);
 
+			window = g_hash_table_lookup(g_context.windows,
+						     queue_id);
+			if (window)
+				prv_window_cancel(window);
+		}
+
 		g_context.connector->return_response(invocation, NULL);
 
 		goto finished;
@@ -1275,7 +1933,7 @@ static void prv_lost_media_server(const gchar *path, void *user_data)
 					   g_variant_new("(o)", path),
 					   NULL);
 
-	dleyna_task_processor_remove_queues_for_sink(g_context.processor, path);
+	prv_remove_queues(NULL, path);
 }
 
 static void prv_unregister_client(gpointer user_data)
@@ -1283,7 +1941,7 @@ static void prv_unregister_client(gpointer user_data)
 	dls_client_t *client = user_data;
 
 	if (client) {
-		g_free(client->protocol_info);
+		dls_matcher_delete(client->protocol_info);
 		g_free(client);
 	}
 }
@@ -1386,6 +2044,8 @@ static void prv_control_point_initialize(const dleyna_connector_t *connector,
 
 	g_context.watchers = g_hash_table_new_full(g_str_hash, g_str_equal,
 						 g_free, prv_unregister_client);
+	g_context.windows = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_context.detached = g_hash_table_new(g_direct_hash, g_direct_equal);
 
 	g_set_prgname(DLS_PRG_NAME);
 }
@@ -1394,6 +2054,12 @@ static void prv_control_point_free(void)
 {
 	if (g_context.watchers)
 		g_hash_table_unref(g_context.watchers);
+
+	if (g_context.windows)
+		g_hash_table_unref(g_context.windows);
+
+	if (g_context.detached)
+		g_hash_table_unref(g_context.detached);
 }
 
 static const gchar *prv_control_point_server_name(void)
@@ -46,6 +46,25 @@ void dls_server_delete_sleeping_device(dls_device_t *dev);
 
 dleyna_task_processor_t *dls_server_get_task_processor(void);
 
+void dls_server_remove_queues_for_sink(const gchar *sink);
+
 const dleyna_connector_t *dls_server_get_connector(void);
 
+gint dls_server_get_unix_fd(dleyna_connector_msg_id_t invocation,
+			    gint32 handle, GError **error);
+
+gboolean dls_server_notify_client(dleyna_connector_id_t connection,
+				  const gchar *client,
+				  const gchar *object_path,
+				  const gchar *interface_name,
+				  const gchar *notification_name,
+				  GVariant *parameters,
+				  GError **error);
+
+guint dls_server_get_max_concurrent_read_tasks(void);
+
+void dls_server_set_max_concurrent_read_tasks(guint max_tasks);
+
+guint64 dls_server_get_expired_tasks(void);
+
 #endif /* DLS_SERVER_H__ */
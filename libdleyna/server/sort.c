@@ -25,74 +25,58 @@
 #include "props.h"
 #include "sort.h"
 
+/* Translates a comma separated list of +Prop/-Prop keys in a single pass.
+ * An empty string is a valid, empty, sort order.
+ */
 gchar *dls_sort_translate_sort_string(GHashTable *filter_map,
 				      const gchar *sort_string)
 {
-	GRegex *reg;
-	gchar *retval = NULL;
-	GMatchInfo *match_info = NULL;
-	gchar *prop = NULL;
-	gchar *op = NULL;
+	const gchar *pos = sort_string;
+	const gchar *start;
+	gchar *prop;
 	dls_prop_map_t *prop_map;
 	GString *str;
 
-	if (!g_regex_match_simple(
-		    "^((\\+|\\-)([^,\\+\\-]+))?(,(\\+|\\-)([^,\\+\\-]+))*$",
-		    sort_string, 0, 0))
-		goto no_free;
-
-	reg = g_regex_new("(\\+|\\-)(\\w+)", 0, 0, NULL);
-	str = g_string_new("");
+	str = g_string_sized_new(strlen(sort_string) + 16);
 
-	g_regex_match(reg, sort_string, 0, &match_info);
-	while (g_match_info_matches(match_info)) {
-		op = g_match_info_fetch(match_info, 1);
-		if (!op)
+	while (*pos) {
+		if ((*pos != '+') && (*pos != '-'))
 			goto on_error;
 
-		prop = g_match_info_fetch(match_info, 2);
-		if (!prop)
-			goto on_error;
+		if (str->len > 0)
+			g_string_append_c(str, ',');
+		g_string_append_c(str, *pos);
 
-		prop_map = g_hash_table_lookup(filter_map, prop);
-		if (!prop_map)
-			goto on_error;
+		start = ++pos;
+		while (*pos && (*pos != ',') && (*pos != '+') && (*pos != '-'))
+			pos++;
 
-		if (!prop_map->searchable)
+		if (pos == start)
 			goto on_error;
 
-		g_string_append_printf(str, "%s%s,", op,
-				       prop_map->upnp_prop_name);
-
+		prop = g_strndup(start, pos - start);
+		prop_map = g_hash_table_lookup(filter_map, prop);
 		g_free(prop);
-		g_free(op);
 
-		prop = NULL;
-		op = NULL;
+		if (!prop_map || !prop_map->searchable)
+			goto on_error;
 
-		g_match_info_next(match_info, NULL);
-	}
+		g_string_append(str, prop_map->upnp_prop_name);
 
-	if (str->len > 0)
-		str = g_string_truncate(str, str->len - 1);
-	retval = g_string_free(str, FALSE);
+		if (*pos == ',') {
+			pos++;
+			if (!*pos)
+				goto on_error;
+		} else if (*pos) {
+			goto on_error;
+		}
+	}
 
-	str = NULL;
+	return g_string_free(str, FALSE);
 
 on_error:
 
-	g_free(prop);
-	g_free(op);
-
-	if (match_info)
-		g_match_info_free(match_info);
-
-	if (str)
-		g_string_free(str, TRUE);
-
-	g_regex_unref(reg);
-
-no_free:
+	(void) g_string_free(str, TRUE);
 
-	return retval;
+	return NULL;
 }
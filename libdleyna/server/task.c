@@ -20,6 +20,8 @@
  *
  */
 
+#include <unistd.h>
+
 #include <libdleyna/core/error.h>
 #include <libdleyna/core/log.h>
 
@@ -67,6 +69,7 @@ static void prv_delete(dls_task_t *task)
 		if (task->ut.resource.filter)
 			g_variant_unref(task->ut.resource.filter);
 		g_free(task->ut.resource.protocol_info);
+		dls_matcher_delete(task->ut.resource.matcher);
 		break;
 	case DLS_TASK_SET_PROTOCOL_INFO:
 		if (task->ut.protocol_info.protocol_info)
@@ -77,6 +80,22 @@ static void prv_delete(dls_task_t *task)
 		g_free(task->ut.upload.display_name);
 		g_free(task->ut.upload.file_path);
 		break;
+	case DLS_TASK_UPLOAD_FD_TO_ANY:
+	case DLS_TASK_UPLOAD_FD:
+		/* fd is only set along with display_name */
+		if (task->ut.upload.display_name && task->ut.upload.fd >= 0)
+			(void) close(task->ut.upload.fd);
+		g_free(task->ut.upload.display_name);
+		break;
+	case DLS_TASK_UPLOAD_MANY_TO_ANY:
+	case DLS_TASK_UPLOAD_MANY:
+		if (task->ut.upload_many.files)
+			g_variant_unref(task->ut.upload_many.files);
+		break;
+	case DLS_TASK_SUBSCRIBE_CHANGES:
+		if (task->ut.subscribe_changes.paths)
+			g_variant_unref(task->ut.subscribe_changes.paths);
+		break;
 	case DLS_TASK_CREATE_CONTAINER:
 	case DLS_TASK_CREATE_CONTAINER_IN_ANY:
 		g_free(task->ut.create_container.display_name);
@@ -447,6 +466,9 @@ dls_task_t *dls_task_get_resource_new(dleyna_connector_msg_id_t invocation,
 		      &task->ut.resource.protocol_info,
 		      &task->ut.resource.filter);
 
+	task->ut.resource.matcher =
+		dls_matcher_new(task->ut.resource.protocol_info);
+
 finished:
 
 	return task;
@@ -488,6 +510,60 @@ finished:
 	return task;
 }
 
+static dls_task_t *prv_upload_fd_new_generic(
+					dls_task_type_t type,
+					dleyna_connector_msg_id_t invocation,
+					const gchar *path,
+					GVariant *parameters,
+					GError **error)
+{
+	dls_task_t *task;
+	gint32 handle;
+
+	task = prv_m2spec_task_new(type, invocation, path,
+				   "(uo)", error, FALSE);
+	if (!task)
+		goto finished;
+
+	task->multiple_retvals = TRUE;
+
+	g_variant_get(parameters, "(sh)", &task->ut.upload.display_name,
+		      &handle);
+
+	task->ut.upload.fd = dls_server_get_unix_fd(invocation, handle, error);
+	if (task->ut.upload.fd < 0) {
+		prv_delete(task);
+		task = NULL;
+
+		goto finished;
+	}
+
+finished:
+
+	return task;
+}
+
+static dls_task_t *prv_upload_many_new_generic(
+					dls_task_type_t type,
+					dleyna_connector_msg_id_t invocation,
+					const gchar *path,
+					GVariant *parameters,
+					GError **error)
+{
+	dls_task_t *task;
+
+	task = prv_m2spec_task_new(type, invocation, path,
+				   "(@aa{sv})", error, FALSE);
+	if (!task)
+		goto finished;
+
+	g_variant_get(parameters, "(@a(ss))", &task->ut.upload_many.files);
+
+finished:
+
+	return task;
+}
+
 dls_task_t *dls_task_prefer_local_addresses_new(
 					dleyna_connector_msg_id_t invocation,
 					GVariant *parameters)
@@ -503,6 +579,20 @@ dls_task_t *dls_task_prefer_local_addresses_new(
 	return task;
 }
 
+dls_task_t *dls_task_set_request_timeout_new(
+					dleyna_connector_msg_id_t invocation,
+					GVariant *parameters)
+{
+	dls_task_t *task = g_new0(dls_task_t, 1);
+
+	task->type = DLS_TASK_SET_REQUEST_TIMEOUT;
+	task->invocation = invocation;
+	task->synchronous = TRUE;
+	g_variant_get(parameters, "(u)", &task->ut.request_timeout.timeout);
+
+	return task;
+}
+
 dls_task_t *dls_task_upload_to_any_new(dleyna_connector_msg_id_t invocation,
 				       const gchar *path, GVariant *parameters,
 				       GError **error)
@@ -519,6 +609,42 @@ dls_task_t *dls_task_upload_new(dleyna_connector_msg_id_t invocation,
 				      path, parameters, error);
 }
 
+dls_task_t *dls_task_upload_fd_to_any_new(dleyna_connector_msg_id_t invocation,
+					  const gchar *path,
+					  GVariant *parameters,
+					  GError **error)
+{
+	return prv_upload_fd_new_generic(DLS_TASK_UPLOAD_FD_TO_ANY, invocation,
+					 path, parameters, error);
+}
+
+dls_task_t *dls_task_upload_fd_new(dleyna_connector_msg_id_t invocation,
+				   const gchar *path, GVariant *parameters,
+				   GError **error)
+{
+	return prv_upload_fd_new_generic(DLS_TASK_UPLOAD_FD, invocation,
+					 path, parameters, error);
+}
+
+dls_task_t *dls_task_upload_many_to_any_new(
+					dleyna_connector_msg_id_t invocation,
+					const gchar *path,
+					GVariant *parameters,
+					GError **error)
+{
+	return prv_upload_many_new_generic(DLS_TASK_UPLOAD_MANY_TO_ANY,
+					   invocation, path, parameters,
+					   error);
+}
+
+dls_task_t *dls_task_upload_many_new(dleyna_connector_msg_id_t invocation,
+				     const gchar *path, GVariant *parameters,
+				     GError **error)
+{
+	return prv_upload_many_new_generic(DLS_TASK_UPLOAD_MANY, invocation,
+					   path, parameters, error);
+}
+
 dls_task_t *dls_task_get_upload_status_new(dleyna_connector_msg_id_t invocation,
 					   const gchar *path,
 					   GVariant *parameters,
@@ -540,6 +666,26 @@ finished:
 	return task;
 }
 
+dls_task_t *dls_task_get_upload_info_new(dleyna_connector_msg_id_t invocation,
+					 const gchar *path,
+					 GVariant *parameters,
+					 GError **error)
+{
+	dls_task_t *task;
+
+	task = prv_m2spec_task_new(DLS_TASK_GET_UPLOAD_INFO, invocation, path,
+				   "(@a{sv})", error, TRUE);
+	if (!task)
+		goto finished;
+
+	g_variant_get(parameters, "(u)",
+		      &task->ut.upload_action.upload_id);
+
+finished:
+
+	return task;
+}
+
 dls_task_t *dls_task_get_upload_ids_new(dleyna_connector_msg_id_t invocation,
 					const gchar *path,
 					GError **error)
@@ -572,6 +718,28 @@ finished:
 	return task;
 }
 
+dls_task_t *dls_task_subscribe_changes_new(
+					dleyna_connector_msg_id_t invocation,
+					const gchar *path,
+					GVariant *parameters,
+					GError **error)
+{
+	dls_task_t *task;
+
+	task = prv_m2spec_task_new(DLS_TASK_SUBSCRIBE_CHANGES, invocation,
+				   path, NULL, error, TRUE);
+	if (!task)
+		goto finished;
+
+	g_variant_get(parameters, "(@aou)",
+		      &task->ut.subscribe_changes.paths,
+		      &task->ut.subscribe_changes.flags);
+
+finished:
+
+	return task;
+}
+
 dls_task_t *dls_task_delete_new(dleyna_connector_msg_id_t invocation,
 				const gchar *path,
 				GError **error)
@@ -776,6 +944,9 @@ void dls_task_delete(dls_task_t *task)
 		g_error_free(error);
 	}
 
+	if (task->deadline_id)
+		(void) g_source_remove(task->deadline_id);
+
 	prv_delete(task);
 
 finished:
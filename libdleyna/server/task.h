@@ -29,6 +29,7 @@
 #include <libdleyna/core/connector.h>
 #include <libdleyna/core/task-atom.h>
 
+#include "matcher.h"
 #include "server.h"
 
 enum dls_task_type_t_ {
@@ -42,12 +43,19 @@ enum dls_task_type_t_ {
 	DLS_TASK_BROWSE_OBJECTS,
 	DLS_TASK_GET_RESOURCE,
 	DLS_TASK_SET_PREFER_LOCAL_ADDRESSES,
+	DLS_TASK_SET_REQUEST_TIMEOUT,
 	DLS_TASK_SET_PROTOCOL_INFO,
 	DLS_TASK_UPLOAD_TO_ANY,
 	DLS_TASK_UPLOAD,
+	DLS_TASK_UPLOAD_MANY_TO_ANY,
+	DLS_TASK_UPLOAD_MANY,
+	DLS_TASK_UPLOAD_FD_TO_ANY,
+	DLS_TASK_UPLOAD_FD,
 	DLS_TASK_GET_UPLOAD_STATUS,
+	DLS_TASK_GET_UPLOAD_INFO,
 	DLS_TASK_GET_UPLOAD_IDS,
 	DLS_TASK_CANCEL_UPLOAD,
+	DLS_TASK_SUBSCRIBE_CHANGES,
 	DLS_TASK_DELETE_OBJECT,
 	DLS_TASK_CREATE_CONTAINER,
 	DLS_TASK_CREATE_CONTAINER_IN_ANY,
@@ -62,6 +70,13 @@ enum dls_task_type_t_ {
 };
 typedef enum dls_task_type_t_ dls_task_type_t;
 
+enum dls_task_priority_t_ {
+	DLS_TASK_PRIORITY_LOW,
+	DLS_TASK_PRIORITY_NORMAL,
+	DLS_TASK_PRIORITY_HIGH
+};
+typedef enum dls_task_priority_t_ dls_task_priority_t;
+
 typedef void (*dls_cancel_task_t)(void *handle);
 
 typedef struct dls_task_get_children_t_ dls_task_get_children_t;
@@ -110,6 +125,7 @@ struct dls_task_browse_objects_t_ {
 typedef struct dls_task_get_resource_t_ dls_task_get_resource_t;
 struct dls_task_get_resource_t_ {
 	gchar *protocol_info;
+	dls_matcher_t *matcher;
 	GVariant *filter;
 };
 
@@ -119,15 +135,30 @@ struct dls_task_set_prefer_local_addresses_t_ {
 	gboolean prefer;
 };
 
+typedef struct dls_task_set_request_timeout_t_
+					dls_task_set_request_timeout_t;
+struct dls_task_set_request_timeout_t_ {
+	guint timeout;
+};
+
 typedef struct dls_task_set_protocol_info_t_ dls_task_set_protocol_info_t;
 struct dls_task_set_protocol_info_t_ {
 	gchar *protocol_info;
 };
 
 typedef struct dls_task_upload_t_ dls_task_upload_t;
+/* Files sent by descriptor have no file_path and are read from fd, which
+ * the task owns.
+ */
 struct dls_task_upload_t_ {
 	gchar *display_name;
 	gchar *file_path;
+	gint fd;
+};
+
+typedef struct dls_task_upload_many_t_ dls_task_upload_many_t;
+struct dls_task_upload_many_t_ {
+	GVariant *files;
 };
 
 typedef struct dls_task_upload_action_t_ dls_task_upload_action_t;
@@ -135,6 +166,12 @@ struct dls_task_upload_action_t_ {
 	guint upload_id;
 };
 
+typedef struct dls_task_subscribe_changes_t_ dls_task_subscribe_changes_t;
+struct dls_task_subscribe_changes_t_ {
+	GVariant *paths;
+	guint flags;
+};
+
 typedef struct dls_task_create_container_t_ dls_task_create_container_t;
 struct dls_task_create_container_t_ {
 	gchar *display_name;
@@ -177,6 +214,9 @@ struct dls_task_t_ {
 	dleyna_connector_msg_id_t invocation;
 	gboolean synchronous;
 	gboolean multiple_retvals;
+	dls_task_priority_t priority;
+	guint deadline_id;
+	gboolean expired;
 	union {
 		dls_task_get_children_t get_children;
 		dls_task_get_props_t get_props;
@@ -185,9 +225,12 @@ struct dls_task_t_ {
 		dls_task_search_t search;
 		dls_task_get_resource_t resource;
 		dls_task_set_prefer_local_addresses_t prefer_local_addresses;
+		dls_task_set_request_timeout_t request_timeout;
 		dls_task_set_protocol_info_t protocol_info;
 		dls_task_upload_t upload;
+		dls_task_upload_many_t upload_many;
 		dls_task_upload_action_t upload_action;
+		dls_task_subscribe_changes_t subscribe_changes;
 		dls_task_create_container_t create_container;
 		dls_task_update_t update;
 		dls_task_create_reference_t create_reference;
@@ -244,6 +287,10 @@ dls_task_t *dls_task_prefer_local_addresses_new(
 					dleyna_connector_msg_id_t invocation,
 					GVariant *parameters);
 
+dls_task_t *dls_task_set_request_timeout_new(
+					dleyna_connector_msg_id_t invocation,
+					GVariant *parameters);
+
 dls_task_t *dls_task_upload_to_any_new(dleyna_connector_msg_id_t invocation,
 				       const gchar *path, GVariant *parameters,
 				       GError **error);
@@ -252,11 +299,35 @@ dls_task_t *dls_task_upload_new(dleyna_connector_msg_id_t invocation,
 				const gchar *path, GVariant *parameters,
 				GError **error);
 
+dls_task_t *dls_task_upload_fd_to_any_new(dleyna_connector_msg_id_t invocation,
+					  const gchar *path,
+					  GVariant *parameters,
+					  GError **error);
+
+dls_task_t *dls_task_upload_fd_new(dleyna_connector_msg_id_t invocation,
+				   const gchar *path, GVariant *parameters,
+				   GError **error);
+
+dls_task_t *dls_task_upload_many_to_any_new(
+					dleyna_connector_msg_id_t invocation,
+					const gchar *path,
+					GVariant *parameters,
+					GError **error);
+
+dls_task_t *dls_task_upload_many_new(dleyna_connector_msg_id_t invocation,
+				     const gchar *path, GVariant *parameters,
+				     GError **error);
+
 dls_task_t *dls_task_get_upload_status_new(dleyna_connector_msg_id_t invocation,
 					   const gchar *path,
 					   GVariant *parameters,
 					   GError **error);
 
+dls_task_t *dls_task_get_upload_info_new(dleyna_connector_msg_id_t invocation,
+					 const gchar *path,
+					 GVariant *parameters,
+					 GError **error);
+
 dls_task_t *dls_task_get_upload_ids_new(dleyna_connector_msg_id_t invocation,
 					const gchar *path,
 					GError **error);
@@ -266,6 +337,12 @@ dls_task_t *dls_task_cancel_upload_new(dleyna_connector_msg_id_t invocation,
 				       GVariant *parameters,
 				       GError **error);
 
+dls_task_t *dls_task_subscribe_changes_new(
+					dleyna_connector_msg_id_t invocation,
+					const gchar *path,
+					GVariant *parameters,
+					GError **error);
+
 dls_task_t *dls_task_delete_new(dleyna_connector_msg_id_t invocation,
 				const gchar *path,
 				GError **error);
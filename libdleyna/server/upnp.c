@@ -21,6 +21,8 @@
  */
 
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <libgssdp/gssdp-resource-browser.h>
 #include <libgupnp/gupnp-control-point.h>
@@ -31,7 +33,9 @@
 #include <libdleyna/core/service-task.h>
 
 #include "async.h"
+#include "cache.h"
 #include "device.h"
+#include "device-index.h"
 #include "interface.h"
 #include "path.h"
 #include "search.h"
@@ -39,6 +43,9 @@
 #include "upnp.h"
 
 #define DLS_DMS_DEVICE_TYPE "urn:schemas-upnp-org:device:MediaServer:"
+#define DLS_UPNP_SEARCH_CACHE_MAX_ENTRIES 64
+#define DLS_UPNP_SORT_CACHE_MAX_ENTRIES 32
+#define DLS_UPNP_CONTENT_SAMPLE_SIZE 4096
 
 struct dls_upnp_t_ {
 	dleyna_connector_id_t connection;
@@ -51,7 +58,10 @@ struct dls_upnp_t_ {
 	void *user_data;
 	GHashTable *device_udn_map;
 	GHashTable *sleeping_device_udn_map;
+	dls_device_index_t *device_path_map;
 	GHashTable *device_uc_map;
+	dls_string_cache_t *search_cache;
+	dls_string_cache_t *sort_cache;
 };
 
 /* Private structure used in service task */
@@ -88,6 +98,7 @@ static void prv_device_chain_end(gboolean cancelled, gpointer data)
 	DLEYNA_LOG_DEBUG("Notify new server available: %s", device->path);
 	g_hash_table_insert(priv_t->upnp->device_udn_map, g_strdup(priv_t->udn),
 			    device);
+	dls_upnp_index_device(priv_t->upnp, device);
 	priv_t->upnp->found_server(device->path, priv_t->upnp->user_data);
 
 on_clear:
@@ -407,13 +418,12 @@ static void prv_device_unavailable_cb(GUPnPControlPoint *cp,
 				upnp->lost_server(device->path,
 						  upnp->user_data);
 
+				dls_upnp_unindex_device(upnp, device);
 				g_hash_table_remove(upnp->device_udn_map, udn);
 			} else {
 				DLEYNA_LOG_DEBUG("Persist sleeping device.");
 
-				dleyna_task_processor_remove_queues_for_sink(
-						dls_server_get_task_processor(),
-						device->path);
+				dls_server_remove_queues_for_sink(device->path);
 
 				g_hash_table_insert(
 						upnp->sleeping_device_udn_map,
@@ -530,11 +540,19 @@ dls_upnp_t *dls_upnp_new(dleyna_connector_id_t connection,
 						g_free,
 						dls_device_delete);
 
+	/* Indexes the devices of both udn maps, which own them */
+	upnp->device_path_map = dls_device_index_new();
+
 	upnp->device_uc_map = g_hash_table_new_full(g_str_hash, g_str_equal,
 						    g_free, NULL);
 
 	dls_prop_maps_new(&upnp->property_map, &upnp->filter_map);
 
+	upnp->search_cache = dls_string_cache_new(
+					DLS_UPNP_SEARCH_CACHE_MAX_ENTRIES);
+	upnp->sort_cache = dls_string_cache_new(
+					DLS_UPNP_SORT_CACHE_MAX_ENTRIES);
+
 	upnp->context_manager = gupnp_context_manager_create(port);
 
 	g_signal_connect(upnp->context_manager, "context-available",
@@ -553,9 +571,12 @@ void dls_upnp_delete(dls_upnp_t *upnp)
 		g_object_unref(upnp->context_manager);
 		g_hash_table_unref(upnp->property_map);
 		g_hash_table_unref(upnp->filter_map);
+		dls_device_index_delete(upnp->device_path_map);
 		g_hash_table_unref(upnp->device_udn_map);
 		g_hash_table_unref(upnp->sleeping_device_udn_map);
 		g_hash_table_unref(upnp->device_uc_map);
+		dls_string_cache_delete(upnp->search_cache);
+		dls_string_cache_delete(upnp->sort_cache);
 		g_free(upnp);
 	}
 }
@@ -603,6 +624,22 @@ GHashTable *dls_upnp_get_sleeping_device_udn_map(dls_upnp_t *upnp)
 	return upnp->sleeping_device_udn_map;
 }
 
+dls_device_t *dls_upnp_get_device_from_path(dls_upnp_t *upnp,
+					    const gchar *path)
+{
+	return dls_device_index_lookup(upnp->device_path_map, path);
+}
+
+void dls_upnp_index_device(dls_upnp_t *upnp, dls_device_t *device)
+{
+	dls_device_index_add(upnp->device_path_map, device->path, device);
+}
+
+void dls_upnp_unindex_device(dls_upnp_t *upnp, dls_device_t *device)
+{
+	dls_device_index_remove(upnp->device_path_map, device->path);
+}
+
 void dls_upnp_delete_sleeping_device(dls_upnp_t *upnp, dls_device_t *device)
 {
 	const char *udn;
@@ -612,9 +649,49 @@ void dls_upnp_delete_sleeping_device(dls_upnp_t *upnp, dls_device_t *device)
 
 	upnp->lost_server(device->path, upnp->user_data);
 
+	dls_upnp_unindex_device(upnp, device);
 	g_hash_table_remove(upnp->sleeping_device_udn_map, udn);
 }
 
+/* Clients tend to issue the same few queries and sort orders over and
+ * over, so their translations are cached.
+ */
+static gchar *prv_translate_search_string(dls_upnp_t *upnp,
+					  const gchar *search_string)
+{
+	gchar *retval;
+
+	retval = g_strdup(dls_string_cache_lookup(upnp->search_cache,
+						  search_string));
+	if (!retval) {
+		retval = dls_search_translate_search_string(upnp->filter_map,
+							    search_string);
+		if (retval)
+			dls_string_cache_insert(upnp->search_cache,
+						search_string, retval);
+	}
+
+	return retval;
+}
+
+static gchar *prv_translate_sort_string(dls_upnp_t *upnp,
+					const gchar *sort_string)
+{
+	gchar *retval;
+
+	retval = g_strdup(dls_string_cache_lookup(upnp->sort_cache,
+						  sort_string));
+	if (!retval) {
+		retval = dls_sort_translate_sort_string(upnp->filter_map,
+							sort_string);
+		if (retval)
+			dls_string_cache_insert(upnp->sort_cache, sort_string,
+						retval);
+	}
+
+	return retval;
+}
+
 void dls_upnp_get_children(dls_upnp_t *upnp, dls_client_t *client,
 			   dls_task_t *task,
 			   dls_upnp_task_complete_t cb)
@@ -641,8 +718,8 @@ void dls_upnp_get_children(dls_upnp_t *upnp, dls_client_t *client,
 	DLEYNA_LOG_DEBUG("Filter Mask 0x%"G_GUINT64_FORMAT"x",
 			 cb_task_data->filter_mask);
 
-	sort_by = dls_sort_translate_sort_string(upnp->filter_map,
-						 task->ut.get_children.sort_by);
+	sort_by = prv_translate_sort_string(upnp,
+					    task->ut.get_children.sort_by);
 	if (!sort_by) {
 		DLEYNA_LOG_WARNING("Invalid Sort Criteria");
 
@@ -661,7 +738,7 @@ void dls_upnp_get_children(dls_upnp_t *upnp, dls_client_t *client,
 on_error:
 
 	if (!cb_data->action)
-		(void) g_idle_add(dls_async_task_complete, cb_data);
+		dls_async_task_complete_in_idle(cb_data);
 
 	g_free(sort_by);
 	g_free(upnp_filter);
@@ -755,8 +832,7 @@ void dls_upnp_search(dls_upnp_t *upnp, dls_client_t *client,
 	DLEYNA_LOG_DEBUG("Filter Mask 0x%"G_GUINT64_FORMAT"x",
 			 cb_task_data->filter_mask);
 
-	upnp_query = dls_search_translate_search_string(upnp->filter_map,
-							task->ut.search.query);
+	upnp_query = prv_translate_search_string(upnp, task->ut.search.query);
 	if (!upnp_query) {
 		DLEYNA_LOG_WARNING("Query string is not valid:%s",
 				   task->ut.search.query);
@@ -769,8 +845,7 @@ void dls_upnp_search(dls_upnp_t *upnp, dls_client_t *client,
 
 	DLEYNA_LOG_DEBUG("UPnP Query %s", upnp_query);
 
-	sort_by = dls_sort_translate_sort_string(upnp->filter_map,
-						 task->ut.search.sort_by);
+	sort_by = prv_translate_sort_string(upnp, task->ut.search.sort_by);
 	if (!sort_by) {
 		DLEYNA_LOG_WARNING("Invalid Sort Criteria");
 
@@ -788,7 +863,7 @@ void dls_upnp_search(dls_upnp_t *upnp, dls_client_t *client,
 on_error:
 
 	if (!cb_data->action)
-		(void) g_idle_add(dls_async_task_complete, cb_data);
+		dls_async_task_complete_in_idle(cb_data);
 
 	g_free(sort_by);
 	g_free(upnp_query);
@@ -855,64 +930,45 @@ void dls_upnp_get_resource(dls_upnp_t *upnp, dls_client_t *client,
 	DLEYNA_LOG_DEBUG("Exit");
 }
 
-static gboolean prv_compute_mime_and_class(dls_task_t *task,
-					   dls_async_upload_t *cb_task_data,
-					   GError **error)
+static gboolean prv_compute_class(const gchar *name,
+				  const gchar *content_type,
+				  const gchar **object_class,
+				  gchar **mime_type,
+				  GError **error)
 {
-	gchar *content_type = NULL;
-
-	if (!g_file_test(task->ut.upload.file_path,
-			 G_FILE_TEST_IS_REGULAR | G_FILE_TEST_EXISTS)) {
-		DLEYNA_LOG_WARNING(
-			"File %s does not exist or is not a regular file",
-			task->ut.upload.file_path);
-
-		*error = g_error_new(DLEYNA_SERVER_ERROR,
-				     DLEYNA_ERROR_OBJECT_NOT_FOUND,
-				     "File %s does not exist or is not a regular file",
-				     task->ut.upload.file_path);
-		goto on_error;
-	}
-
-	content_type = g_content_type_guess(task->ut.upload.file_path, NULL, 0,
-					    NULL);
-
 	if (!content_type) {
 		DLEYNA_LOG_WARNING("Unable to determine Content Type for %s",
-				   task->ut.upload.file_path);
+				   name);
 
 		*error = g_error_new(DLEYNA_SERVER_ERROR, DLEYNA_ERROR_BAD_MIME,
 				     "Unable to determine Content Type for %s",
-				     task->ut.upload.file_path);
+				     name);
 		goto on_error;
 	}
 
-	cb_task_data->mime_type = g_content_type_get_mime_type(content_type);
-	g_free(content_type);
+	*mime_type = g_content_type_get_mime_type(content_type);
 
-	if (!cb_task_data->mime_type) {
+	if (!*mime_type) {
 		DLEYNA_LOG_WARNING("Unable to determine MIME Type for %s",
-				   task->ut.upload.file_path);
+				   name);
 
 		*error = g_error_new(DLEYNA_SERVER_ERROR, DLEYNA_ERROR_BAD_MIME,
 				     "Unable to determine MIME Type for %s",
-				     task->ut.upload.file_path);
+				     name);
 		goto on_error;
 	}
 
-	if (g_content_type_is_a(cb_task_data->mime_type, "image/*")) {
-		cb_task_data->object_class = "object.item.imageItem";
-	} else if (g_content_type_is_a(cb_task_data->mime_type, "audio/*")) {
-		cb_task_data->object_class = "object.item.audioItem";
-	} else if (g_content_type_is_a(cb_task_data->mime_type, "video/*")) {
-		cb_task_data->object_class = "object.item.videoItem";
+	if (g_content_type_is_a(*mime_type, "image/*")) {
+		*object_class = "object.item.imageItem";
+	} else if (g_content_type_is_a(*mime_type, "audio/*")) {
+		*object_class = "object.item.audioItem";
+	} else if (g_content_type_is_a(*mime_type, "video/*")) {
+		*object_class = "object.item.videoItem";
 	} else {
-		DLEYNA_LOG_WARNING("Unsupported MIME Type %s",
-				   cb_task_data->mime_type);
+		DLEYNA_LOG_WARNING("Unsupported MIME Type %s", *mime_type);
 
 		*error = g_error_new(DLEYNA_SERVER_ERROR, DLEYNA_ERROR_BAD_MIME,
-				     "Unsupported MIME Type %s",
-				     cb_task_data->mime_type);
+				     "Unsupported MIME Type %s", *mime_type);
 		goto on_error;
 	}
 
@@ -923,6 +979,97 @@ on_error:
 	return FALSE;
 }
 
+static gboolean prv_compute_mime_and_class(const gchar *file_path,
+					   const gchar **object_class,
+					   gchar **mime_type,
+					   GError **error)
+{
+	gchar *content_type;
+	gboolean retval;
+
+	if (!g_file_test(file_path,
+			 G_FILE_TEST_IS_REGULAR | G_FILE_TEST_EXISTS)) {
+		DLEYNA_LOG_WARNING(
+			"File %s does not exist or is not a regular file",
+			file_path);
+
+		*error = g_error_new(DLEYNA_SERVER_ERROR,
+				     DLEYNA_ERROR_OBJECT_NOT_FOUND,
+				     "File %s does not exist or is not a regular file",
+				     file_path);
+		return FALSE;
+	}
+
+	content_type = g_content_type_guess(file_path, NULL, 0, NULL);
+	retval = prv_compute_class(file_path, content_type, object_class,
+				   mime_type, error);
+	g_free(content_type);
+
+	return retval;
+}
+
+/* The length of the file must be known up front, so only regular files
+ * can be uploaded by descriptor.  Their type is guessed from the display
+ * name and from their first bytes.
+ */
+static gboolean prv_compute_fd_mime_and_class(gint fd,
+					      const gchar *display_name,
+					      const gchar **object_class,
+					      gchar **mime_type,
+					      GError **error)
+{
+	struct stat buf;
+	guchar sample[DLS_UPNP_CONTENT_SAMPLE_SIZE];
+	ssize_t length;
+	gchar *content_type;
+	gboolean retval;
+
+	if (fstat(fd, &buf) || !S_ISREG(buf.st_mode)) {
+		DLEYNA_LOG_WARNING("%s is not a regular file", display_name);
+
+		*error = g_error_new(DLEYNA_SERVER_ERROR,
+				     DLEYNA_ERROR_OBJECT_NOT_FOUND,
+				     "%s is not a regular file",
+				     display_name);
+		return FALSE;
+	}
+
+	length = pread(fd, sample, sizeof(sample), 0);
+	if (length < 0) {
+		DLEYNA_LOG_WARNING("Unable to read %s", display_name);
+
+		*error = g_error_new(DLEYNA_SERVER_ERROR, DLEYNA_ERROR_IO,
+				     "Unable to read %s", display_name);
+		return FALSE;
+	}
+
+	content_type = g_content_type_guess(display_name, sample, length,
+					    NULL);
+	retval = prv_compute_class(display_name, content_type, object_class,
+				   mime_type, error);
+	g_free(content_type);
+
+	return retval;
+}
+
+static gboolean prv_compute_upload_mime_and_class(
+					dls_task_t *task,
+					dls_async_upload_t *cb_task_data,
+					GError **error)
+{
+	dls_task_upload_t *upload = &task->ut.upload;
+
+	if (!upload->file_path)
+		return prv_compute_fd_mime_and_class(
+				upload->fd, upload->display_name,
+				&cb_task_data->object_class,
+				&cb_task_data->mime_type, error);
+
+	return prv_compute_mime_and_class(upload->file_path,
+					  &cb_task_data->object_class,
+					  &cb_task_data->mime_type, error);
+}
+
 void dls_upnp_upload_to_any(dls_upnp_t *upnp, dls_client_t *client,
 			    dls_task_t *task,
 			    dls_upnp_task_complete_t cb)
@@ -947,7 +1094,8 @@ void dls_upnp_upload_to_any(dls_upnp_t *upnp, dls_client_t *client,
 		goto on_error;
 	}
 
-	if (!prv_compute_mime_and_class(task, cb_task_data, &cb_data->error))
+	if (!prv_compute_upload_mime_and_class(task, cb_task_data,
+					       &cb_data->error))
 		goto on_error;
 
 	DLEYNA_LOG_DEBUG("MIME Type %s", cb_task_data->mime_type);
@@ -955,10 +1103,13 @@ void dls_upnp_upload_to_any(dls_upnp_t *upnp, dls_client_t *client,
 
 	dls_device_upload(client, task, "DLNA.ORG_AnyContainer");
 
+	DLEYNA_LOG_DEBUG("Exit");
+
+	return;
+
 on_error:
 
-	if (!cb_data->action)
-		(void) g_idle_add(dls_async_task_complete, cb_data);
+	dls_async_task_complete_in_idle(cb_data);
 
 	DLEYNA_LOG_DEBUG("Exit");
 }
@@ -974,7 +1125,8 @@ void dls_upnp_upload(dls_upnp_t *upnp, dls_client_t *client, dls_task_t *task,
 	cb_data->cb = cb;
 	cb_task_data = &cb_data->ut.upload;
 
-	if (!prv_compute_mime_and_class(task, cb_task_data, &cb_data->error))
+	if (!prv_compute_upload_mime_and_class(task, cb_task_data,
+					       &cb_data->error))
 		goto on_error;
 
 	DLEYNA_LOG_DEBUG("MIME Type %s", cb_task_data->mime_type);
@@ -982,10 +1134,79 @@ void dls_upnp_upload(dls_upnp_t *upnp, dls_client_t *client, dls_task_t *task,
 
 	dls_device_upload(client, task, task->target.id);
 
+	DLEYNA_LOG_DEBUG("Exit");
+
+	return;
+
 on_error:
 
-	if (!cb_data->action)
-		(void) g_idle_add(dls_async_task_complete, cb_data);
+	dls_async_task_complete_in_idle(cb_data);
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+void dls_upnp_upload_many(dls_upnp_t *upnp, dls_client_t *client,
+			  dls_task_t *task,
+			  dls_upnp_task_complete_t cb)
+{
+	dls_async_task_t *cb_data = (dls_async_task_t *)task;
+	dls_async_upload_many_t *cb_task_data;
+	dls_async_upload_file_t *file;
+	const gchar *parent_id = task->target.id;
+	const gchar *file_path;
+	guint i;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	cb_data->cb = cb;
+	cb_task_data = &cb_data->ut.upload_many;
+
+	if (task->type == DLS_TASK_UPLOAD_MANY_TO_ANY) {
+		if (strcmp(task->target.id, "0")) {
+			DLEYNA_LOG_WARNING("Bad path %s", task->target.path);
+
+			cb_data->error =
+				g_error_new(DLEYNA_SERVER_ERROR,
+					    DLEYNA_ERROR_BAD_PATH,
+					    "UploadManyToAnyContainer must be executed on a root path");
+			goto on_error;
+		}
+
+		parent_id = "DLNA.ORG_AnyContainer";
+	}
+
+	/* Files that cannot be uploaded fail on their own, without
+	 * preventing the upload of the others.
+	 */
+	cb_task_data->file_count =
+			g_variant_n_children(task->ut.upload_many.files);
+	cb_task_data->files = g_new0(dls_async_upload_file_t,
+				     cb_task_data->file_count);
+
+	for (i = 0; i < cb_task_data->file_count; ++i) {
+		file = &cb_task_data->files[i];
+
+		g_variant_get_child(task->ut.upload_many.files, i, "(&s&s)",
+				    &file->display_name, &file_path);
+		file->file_path = g_strstrip(g_strdup(file_path));
+
+		(void) prv_compute_mime_and_class(file->file_path,
+						  &file->object_class,
+						  &file->mime_type,
+						  &file->error);
+	}
+
+	DLEYNA_LOG_DEBUG("Uploading %u files", cb_task_data->file_count);
+
+	dls_device_upload_many(client, task, parent_id);
+
+	DLEYNA_LOG_DEBUG("Exit");
+
+	return;
+
+on_error:
+
+	dls_async_task_complete_in_idle(cb_data);
 
 	DLEYNA_LOG_DEBUG("Exit");
 }
@@ -993,6 +1214,7 @@ on_error:
 void dls_upnp_get_upload_status(dls_upnp_t *upnp, dls_task_t *task)
 {
 	GError *error = NULL;
+	gboolean info = (task->type == DLS_TASK_GET_UPLOAD_INFO);
 
 	DLEYNA_LOG_DEBUG("Enter");
 
@@ -1003,11 +1225,16 @@ void dls_upnp_get_upload_status(dls_upnp_t *upnp, dls_task_t *task)
 		DLEYNA_LOG_WARNING("Bad path %s", task->target.path);
 
 		error = g_error_new(DLEYNA_SERVER_ERROR, DLEYNA_ERROR_BAD_PATH,
-				    "GetUploadStatus must be executed on a root path");
+				    "%s must be executed on a root path",
+				    info ? DLS_INTERFACE_GET_UPLOAD_INFO :
+					   DLS_INTERFACE_GET_UPLOAD_STATUS);
 		goto on_error;
 	}
 
-	(void) dls_device_get_upload_status(task, &error);
+	if (info)
+		(void) dls_device_get_upload_info(task, &error);
+	else
+		(void) dls_device_get_upload_status(task, &error);
 
 on_error:
 
@@ -1083,6 +1310,79 @@ on_error:
 	DLEYNA_LOG_DEBUG("Exit");
 }
 
+void dls_upnp_subscribe_changes(dls_upnp_t *upnp, const gchar *client,
+				dls_task_t *task)
+{
+	GError *error = NULL;
+	GVariantIter iter;
+	const gchar *path;
+	gchar *root_path;
+	gchar *id;
+	gboolean same_root;
+
+	DLEYNA_LOG_DEBUG("Enter");
+
+	DLEYNA_LOG_DEBUG("Root Path %s Id %s", task->target.root_path,
+			 task->target.id);
+
+	if (strcmp(task->target.id, "0")) {
+		DLEYNA_LOG_WARNING("Bad path %s", task->target.path);
+
+		error = g_error_new(DLEYNA_SERVER_ERROR, DLEYNA_ERROR_BAD_PATH,
+				    "SubscribeChanges must be executed on a root path");
+		goto on_error;
+	}
+
+	(void) g_variant_iter_init(&iter, task->ut.subscribe_changes.paths);
+	while (g_variant_iter_next(&iter, "&o", &path)) {
+		if (!dls_path_get_path_and_id(path, &root_path, &id, &error))
+			goto on_error;
+
+		same_root = !strcmp(root_path, task->target.root_path);
+		g_free(root_path);
+		g_free(id);
+
+		if (!same_root) {
+			DLEYNA_LOG_WARNING("Bad path %s", path);
+
+			error = g_error_new(DLEYNA_SERVER_ERROR,
+					    DLEYNA_ERROR_BAD_PATH,
+					    "%s does not belong to %s", path,
+					    task->target.root_path);
+			goto on_error;
+		}
+	}
+
+	dls_device_subscribe_changes(task->target.device, client,
+				     task->ut.subscribe_changes.paths,
+				     task->ut.subscribe_changes.flags);
+
+on_error:
+
+	if (error) {
+		dls_task_fail(task, error);
+		g_error_free(error);
+	} else {
+		dls_task_complete(task);
+	}
+
+	DLEYNA_LOG_DEBUG("Exit");
+}
+
+void dls_upnp_unsubscribe_changes(dls_upnp_t *upnp, const gchar *client)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	g_hash_table_iter_init(&iter, upnp->device_udn_map);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+		dls_device_unsubscribe_changes(value, client);
+
+	g_hash_table_iter_init(&iter, upnp->sleeping_device_udn_map);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+		dls_device_unsubscribe_changes(value, client);
+}
+
 void dls_upnp_delete_object(dls_upnp_t *upnp, dls_client_t *client,
 			    dls_task_t *task,
 			    dls_upnp_task_complete_t cb)
@@ -1117,7 +1417,7 @@ void dls_upnp_create_container(dls_upnp_t *upnp, dls_client_t *client,
 	dls_device_create_container(client, task, task->target.id);
 
 	if (!cb_data->action)
-		(void) g_idle_add(dls_async_task_complete, cb_data);
+		dls_async_task_complete_in_idle(cb_data);
 
 	DLEYNA_LOG_DEBUG("Exit");
 }
@@ -1149,7 +1449,7 @@ void dls_upnp_create_container_in_any(dls_upnp_t *upnp, dls_client_t *client,
 on_error:
 
 	if (!cb_data->action)
-		(void) g_idle_add(dls_async_task_complete, cb_data);
+		dls_async_task_complete_in_idle(cb_data);
 
 	DLEYNA_LOG_DEBUG("Exit");
 }
@@ -1207,7 +1507,7 @@ on_error:
 	g_free(upnp_filter);
 
 	if (!cb_data->action)
-		(void) g_idle_add(dls_async_task_complete, cb_data);
+		dls_async_task_complete_in_idle(cb_data);
 
 	DLEYNA_LOG_DEBUG("Exit");
 }
@@ -47,6 +47,16 @@ GHashTable *dls_upnp_get_device_udn_map(dls_upnp_t *upnp);
 
 GHashTable *dls_upnp_get_sleeping_device_udn_map(dls_upnp_t *upnp);
 
+dls_device_t *dls_upnp_get_device_from_path(dls_upnp_t *upnp,
+					    const gchar *path);
+
+/* The path index borrows device->path, so a device must be unindexed
+ * before it is destroyed.
+ */
+void dls_upnp_index_device(dls_upnp_t *upnp, dls_device_t *device);
+
+void dls_upnp_unindex_device(dls_upnp_t *upnp, dls_device_t *device);
+
 void dls_upnp_delete_sleeping_device(dls_upnp_t *upnp, dls_device_t *device);
 
 void dls_upnp_get_children(dls_upnp_t *upnp, dls_client_t *client,
@@ -81,12 +91,21 @@ void dls_upnp_upload(dls_upnp_t *upnp, dls_client_t *client,
 		     dls_task_t *task,
 		     dls_upnp_task_complete_t cb);
 
+void dls_upnp_upload_many(dls_upnp_t *upnp, dls_client_t *client,
+			  dls_task_t *task,
+			  dls_upnp_task_complete_t cb);
+
 void dls_upnp_get_upload_status(dls_upnp_t *upnp, dls_task_t *task);
 
 void dls_upnp_get_upload_ids(dls_upnp_t *upnp, dls_task_t *task);
 
 void dls_upnp_cancel_upload(dls_upnp_t *upnp, dls_task_t *task);
 
+void dls_upnp_subscribe_changes(dls_upnp_t *upnp, const gchar *client,
+				dls_task_t *task);
+
+void dls_upnp_unsubscribe_changes(dls_upnp_t *upnp, const gchar *client);
+
 void dls_upnp_delete_object(dls_upnp_t *upnp, dls_client_t *client,
 			    dls_task_t *task,
 			    dls_upnp_task_complete_t cb);
@@ -177,6 +177,10 @@ class Device(Container):
         print "Length: " + str(length)
         print "Total: " + str(total)
 
+    def get_upload_info(self, id):
+        info = self._deviceIF.GetUploadInfo(id)
+        print_properties(info)
+
     def get_upload_ids(self):
         upload_ids  = self._deviceIF.GetUploadIDs()
         print_properties(upload_ids)
@@ -0,0 +1,245 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include <stdlib.h>
+
+#include <glib.h>
+#include <libgupnp-av/gupnp-av.h>
+
+#include "matcher.h"
+
+/* Micro-benchmark of the protocol info matcher.  It parses a DIDL-Lite
+ * result of BENCH_ITEMS items and reports the cost of selecting a
+ * resource for every item, first by re-parsing the client protocol info
+ * for each resource as props.c used to, then with a dls_matcher_t built
+ * once per request.  Usage: bench-matcher [iterations]
+ */
+
+#define BENCH_ITEMS 1000
+#define BENCH_DEFAULT_ITERATIONS 20
+
+#define BENCH_PROTOCOL_INFO						\
+	"http-get:*:image/png:*,"					\
+	"http-get:*:image/jpeg:DLNA.ORG_PN=JPEG_SM,"			\
+	"http-get:*:audio/mpeg:DLNA.ORG_PN=MP3,"			\
+	"http-get:*:audio/L16:*,"					\
+	"http-get:*:video/mp4:*,"					\
+	"http-get:*:video/mpeg:DLNA.ORG_PN=MPEG_PS_PAL"
+
+static const gchar *g_res_protocol_info[] = {
+	"http-get:*:audio/x-flac:*",
+	"http-get:*:audio/x-ms-wma:DLNA.ORG_PN=WMABASE",
+	"http-get:*:audio/mpeg:DLNA.ORG_PN=MP3",
+	"http-get:*:video/x-matroska:*",
+	"http-get:*:video/mp4:DLNA.ORG_PN=AVC_MP4_BL_CIF15_AAC_520",
+	"http-get:*:image/jpeg:DLNA.ORG_PN=JPEG_SM"
+};
+
+static gchar *prv_build_didl(void)
+{
+	GString *didl;
+	guint i;
+	guint j;
+
+	didl = g_string_new("<DIDL-Lite "
+			    "xmlns=\"urn:schemas-upnp-org:metadata-1-0/"
+			    "DIDL-Lite/\" "
+			    "xmlns:dc=\"http://purl.org/dc/elements/1.1/\" "
+			    "xmlns:upnp=\"urn:schemas-upnp-org:metadata-1-0/"
+			    "upnp/\">");
+
+	for (i = 0; i < BENCH_ITEMS; i++) {
+		g_string_append_printf(didl,
+				       "<item id=\"%u\" parentID=\"0\" "
+				       "restricted=\"1\">"
+				       "<dc:title>Item %u</dc:title>"
+				       "<upnp:class>object.item</upnp:class>",
+				       i, i);
+
+		/* Vary the position of the first compatible resource */
+		for (j = 0; j < G_N_ELEMENTS(g_res_protocol_info); j++)
+			g_string_append_printf(
+				didl,
+				"<res protocolInfo=\"%s\">"
+				"http://127.0.0.1/%u/%u</res>",
+				g_res_protocol_info[
+					(i + j) %
+					G_N_ELEMENTS(g_res_protocol_info)],
+				i, j);
+
+		g_string_append(didl, "</item>");
+	}
+
+	g_string_append(didl, "</DIDL-Lite>");
+
+	return g_string_free(didl, FALSE);
+}
+
+static void prv_found_object(GUPnPDIDLLiteParser *parser,
+			     GUPnPDIDLLiteObject *object,
+			     gpointer user_data)
+{
+	GPtrArray *objects = user_data;
+
+	g_ptr_array_add(objects, g_object_ref(object));
+}
+
+static gboolean prv_match_split(GUPnPDIDLLiteResource *res,
+				gchar **pi_str_array)
+{
+	GUPnPProtocolInfo *res_pi;
+	GUPnPProtocolInfo *pi;
+	gboolean match = FALSE;
+	unsigned int i;
+
+	res_pi = gupnp_didl_lite_resource_get_protocol_info(res);
+	if (!res_pi)
+		goto on_exit;
+
+	for (i = 0; pi_str_array[i] && !match; ++i) {
+		pi = gupnp_protocol_info_new_from_string(pi_str_array[i],
+							 NULL);
+		if (!pi)
+			continue;
+		match = gupnp_protocol_info_is_compatible(pi, res_pi);
+		g_object_unref(pi);
+	}
+
+on_exit:
+
+	return match;
+}
+
+static guint prv_run_split(GPtrArray *objects)
+{
+	GUPnPDIDLLiteObject *object;
+	GList *resources;
+	GList *ptr;
+	gchar **pi_str_array;
+	guint matched = 0;
+	guint i;
+
+	for (i = 0; i < objects->len; i++) {
+		object = g_ptr_array_index(objects, i);
+
+		/* Split per object, as the old per-property code did */
+		pi_str_array = g_strsplit(BENCH_PROTOCOL_INFO, ",", 0);
+		resources = gupnp_didl_lite_object_get_resources(object);
+
+		for (ptr = resources; ptr; ptr = ptr->next)
+			if (prv_match_split(ptr->data, pi_str_array)) {
+				matched++;
+				break;
+			}
+
+		g_list_free_full(resources, g_object_unref);
+		g_strfreev(pi_str_array);
+	}
+
+	return matched;
+}
+
+static guint prv_run_matcher(GPtrArray *objects)
+{
+	GUPnPDIDLLiteObject *object;
+	dls_matcher_t *matcher;
+	GList *resources;
+	GList *ptr;
+	guint matched = 0;
+	guint i;
+
+	matcher = dls_matcher_new(BENCH_PROTOCOL_INFO);
+
+	for (i = 0; i < objects->len; i++) {
+		object = g_ptr_array_index(objects, i);
+		resources = gupnp_didl_lite_object_get_resources(object);
+
+		for (ptr = resources; ptr; ptr = ptr->next)
+			if (dls_matcher_match(matcher, ptr->data)) {
+				matched++;
+				break;
+			}
+
+		g_list_free_full(resources, g_object_unref);
+	}
+
+	dls_matcher_delete(matcher);
+
+	return matched;
+}
+
+static void prv_report(const gchar *name, gint64 start, guint iterations,
+		       guint matched)
+{
+	gint64 elapsed = g_get_monotonic_time() - start;
+
+	g_print("%-8s %10.3f ms/result (%u/%u items matched)\n", name,
+		(double)elapsed / iterations / 1000, matched, BENCH_ITEMS);
+}
+
+int main(int argc, char *argv[])
+{
+	GUPnPDIDLLiteParser *parser;
+	GPtrArray *objects;
+	guint iterations = BENCH_DEFAULT_ITERATIONS;
+	GError *error = NULL;
+	gchar *didl;
+	gint64 start;
+	guint matched = 0;
+	guint i;
+	int retval = EXIT_FAILURE;
+
+	if (argc > 1)
+		iterations = MAX(atoi(argv[1]), 1);
+
+	objects = g_ptr_array_new_with_free_func(g_object_unref);
+	didl = prv_build_didl();
+
+	parser = gupnp_didl_lite_parser_new();
+	g_signal_connect(parser, "object-available",
+			 G_CALLBACK(prv_found_object), objects);
+
+	if (!gupnp_didl_lite_parser_parse_didl(parser, didl, &error)) {
+		g_printerr("Unable to parse DIDL-Lite: %s\n", error->message);
+		g_error_free(error);
+		goto on_exit;
+	}
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < iterations; i++)
+		matched = prv_run_split(objects);
+	prv_report("split", start, iterations, matched);
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < iterations; i++)
+		matched = prv_run_matcher(objects);
+	prv_report("matcher", start, iterations, matched);
+
+	retval = EXIT_SUCCESS;
+
+on_exit:
+
+	g_object_unref(parser);
+	g_free(didl);
+	g_ptr_array_unref(objects);
+
+	return retval;
+}
@@ -0,0 +1,87 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "cache.h"
+#include "props.h"
+#include "search.h"
+
+/* Micro-benchmark of the SearchCriteria translator.  It reports the cost
+ * of a translation and of a hit in the translation cache used by
+ * dls_upnp_t.  Usage: bench-search [iterations]
+ */
+
+#define BENCH_QUERY "Type derivedfrom \"container\" and " \
+	"(DisplayName contains \"abc\" or Artist = \"b\")"
+#define BENCH_DEFAULT_ITERATIONS 200000
+
+static void prv_report(const gchar *name, gint64 start, guint iterations)
+{
+	gint64 elapsed = g_get_monotonic_time() - start;
+
+	g_print("%-12s %8.3f us/query\n", name, (double)elapsed / iterations);
+}
+
+int main(int argc, char *argv[])
+{
+	GHashTable *property_map;
+	GHashTable *filter_map;
+	dls_string_cache_t *cache;
+	guint iterations = BENCH_DEFAULT_ITERATIONS;
+	gchar *translated;
+	gint64 start;
+	guint i;
+
+	if (argc > 1)
+		iterations = MAX(atoi(argv[1]), 1);
+
+	dls_prop_maps_new(&property_map, &filter_map);
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < iterations; i++) {
+		translated = dls_search_translate_search_string(filter_map,
+								BENCH_QUERY);
+		g_free(translated);
+	}
+	prv_report("translate", start, iterations);
+
+	cache = dls_string_cache_new(64);
+	translated = dls_search_translate_search_string(filter_map,
+							BENCH_QUERY);
+	dls_string_cache_insert(cache, BENCH_QUERY, translated);
+	g_free(translated);
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < iterations; i++) {
+		translated = g_strdup(dls_string_cache_lookup(cache,
+							      BENCH_QUERY));
+		g_free(translated);
+	}
+	prv_report("cache hit", start, iterations);
+
+	dls_string_cache_delete(cache);
+	g_hash_table_unref(filter_map);
+	g_hash_table_unref(property_map);
+
+	return 0;
+}
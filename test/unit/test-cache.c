@@ -0,0 +1,86 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <glib.h>
+
+#include "cache.h"
+
+static void test_cache_lookup(void)
+{
+	dls_string_cache_t *cache = dls_string_cache_new(4);
+
+	g_assert(dls_string_cache_lookup(cache, "a") == NULL);
+
+	dls_string_cache_insert(cache, "a", "1");
+	g_assert_cmpstr(dls_string_cache_lookup(cache, "a"), ==, "1");
+
+	dls_string_cache_insert(cache, "a", "2");
+	g_assert_cmpstr(dls_string_cache_lookup(cache, "a"), ==, "2");
+
+	dls_string_cache_delete(cache);
+}
+
+static void test_cache_evict(void)
+{
+	dls_string_cache_t *cache = dls_string_cache_new(2);
+
+	dls_string_cache_insert(cache, "a", "1");
+	dls_string_cache_insert(cache, "b", "2");
+
+	/* Looking a up makes b the least recently used entry */
+	g_assert_cmpstr(dls_string_cache_lookup(cache, "a"), ==, "1");
+	dls_string_cache_insert(cache, "c", "3");
+
+	g_assert(dls_string_cache_lookup(cache, "b") == NULL);
+	g_assert_cmpstr(dls_string_cache_lookup(cache, "a"), ==, "1");
+	g_assert_cmpstr(dls_string_cache_lookup(cache, "c"), ==, "3");
+
+	dls_string_cache_delete(cache);
+}
+
+static void test_cache_remove(void)
+{
+	dls_string_cache_t *cache = dls_string_cache_new(2);
+
+	dls_string_cache_insert(cache, "a", "1");
+	dls_string_cache_insert(cache, "b", "2");
+
+	dls_string_cache_remove(cache, "a");
+	dls_string_cache_remove(cache, "unknown");
+	g_assert(dls_string_cache_lookup(cache, "a") == NULL);
+
+	/* The freed slot is used before anything is evicted */
+	dls_string_cache_insert(cache, "c", "3");
+	g_assert_cmpstr(dls_string_cache_lookup(cache, "b"), ==, "2");
+	g_assert_cmpstr(dls_string_cache_lookup(cache, "c"), ==, "3");
+
+	dls_string_cache_delete(cache);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/cache/lookup", test_cache_lookup);
+	g_test_add_func("/cache/evict", test_cache_evict);
+	g_test_add_func("/cache/remove", test_cache_remove);
+
+	return g_test_run();
+}
@@ -0,0 +1,197 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <glib.h>
+
+#include "changes.h"
+#include "interface.h"
+
+#define TEST_PATH_0 "/com/intel/dLeynaServer/server/0/1"
+#define TEST_PATH_1 "/com/intel/dLeynaServer/server/0/2"
+
+static GVariant *prv_change_new(dls_change_type_t type, const gchar *path,
+				guint update_id)
+{
+	GVariantBuilder vb;
+
+	g_variant_builder_init(&vb, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add(&vb, "{sv}", DLS_INTERFACE_PROP_CHANGE_TYPE,
+			      g_variant_new_uint32(type));
+	g_variant_builder_add(&vb, "{sv}", DLS_INTERFACE_PROP_PATH,
+			      g_variant_new_string(path));
+	g_variant_builder_add(&vb, "{sv}", DLS_INTERFACE_PROP_UPDATE_ID,
+			      g_variant_new_uint32(update_id));
+
+	return g_variant_builder_end(&vb);
+}
+
+static dls_change_t *prv_change_nth(dls_change_queue_t *queue, guint n)
+{
+	return g_queue_peek_nth(&queue->changes, n);
+}
+
+static guint prv_change_update_id(dls_change_t *change)
+{
+	guint update_id = 0;
+
+	g_assert(g_variant_lookup(change->dict, DLS_INTERFACE_PROP_UPDATE_ID,
+				  "u", &update_id));
+
+	return update_id;
+}
+
+static void test_changes_no_coalescing(void)
+{
+	dls_change_queue_t queue = { G_QUEUE_INIT, NULL };
+
+	dls_change_queue_add(&queue, prv_change_new(DLS_CHANGE_MOD,
+						    TEST_PATH_0, 1), FALSE);
+	dls_change_queue_add(&queue, prv_change_new(DLS_CHANGE_MOD,
+						    TEST_PATH_0, 2), FALSE);
+
+	g_assert_cmpuint(g_queue_get_length(&queue.changes), ==, 2);
+	g_assert(queue.index == NULL);
+
+	dls_change_queue_clear(&queue);
+	g_assert(g_queue_is_empty(&queue.changes));
+}
+
+static void test_changes_merge_mods(void)
+{
+	dls_change_queue_t queue = { G_QUEUE_INIT, NULL };
+
+	dls_change_queue_add(&queue, prv_change_new(DLS_CHANGE_MOD,
+						    TEST_PATH_0, 1), TRUE);
+	dls_change_queue_add(&queue, prv_change_new(DLS_CHANGE_MOD,
+						    TEST_PATH_1, 2), TRUE);
+	dls_change_queue_add(&queue, prv_change_new(DLS_CHANGE_MOD,
+						    TEST_PATH_0, 3), TRUE);
+
+	/* The merged modification keeps its place and the latest UpdateID */
+	g_assert_cmpuint(g_queue_get_length(&queue.changes), ==, 2);
+	g_assert_cmpstr(prv_change_nth(&queue, 0)->path, ==, TEST_PATH_0);
+	g_assert_cmpuint(prv_change_update_id(prv_change_nth(&queue, 0)), ==,
+			 3);
+	g_assert_cmpstr(prv_change_nth(&queue, 1)->path, ==, TEST_PATH_1);
+
+	dls_change_queue_clear(&queue);
+}
+
+static void test_changes_fold_mod_into_add(void)
+{
+	dls_change_queue_t queue = { G_QUEUE_INIT, NULL };
+	dls_change_t *change;
+
+	dls_change_queue_add(&queue, prv_change_new(DLS_CHANGE_ADD,
+						    TEST_PATH_0, 1), TRUE);
+	dls_change_queue_add(&queue, prv_change_new(DLS_CHANGE_MOD,
+						    TEST_PATH_0, 2), TRUE);
+
+	g_assert_cmpuint(g_queue_get_length(&queue.changes), ==, 1);
+	change = prv_change_nth(&queue, 0);
+	g_assert_cmpuint(change->type, ==, DLS_CHANGE_ADD);
+	g_assert_cmpuint(prv_change_update_id(change), ==, 2);
+
+	dls_change_queue_clear(&queue);
+}
+
+static void test_changes_collapse_add_del(void)
+{
+	dls_change_queue_t queue = { G_QUEUE_INIT, NULL };
+
+	dls_change_queue_add(&queue, prv_change_new(DLS_CHANGE_ADD,
+						    TEST_PATH_0, 1), TRUE);
+	dls_change_queue_add(&queue, prv_change_new(DLS_CHANGE_MOD,
+						    TEST_PATH_0, 2), TRUE);
+	dls_change_queue_add(&queue, prv_change_new(DLS_CHANGE_DEL,
+						    TEST_PATH_0, 3), TRUE);
+
+	g_assert(g_queue_is_empty(&queue.changes));
+
+	/* The object may be added again in the same window */
+	dls_change_queue_add(&queue, prv_change_new(DLS_CHANGE_ADD,
+						    TEST_PATH_0, 4), TRUE);
+	g_assert_cmpuint(g_queue_get_length(&queue.changes), ==, 1);
+
+	dls_change_queue_clear(&queue);
+}
+
+static void test_changes_mod_then_del(void)
+{
+	dls_change_queue_t queue = { G_QUEUE_INIT, NULL };
+	dls_change_t *change;
+
+	dls_change_queue_add(&queue, prv_change_new(DLS_CHANGE_MOD,
+						    TEST_PATH_0, 1), TRUE);
+	dls_change_queue_add(&queue, prv_change_new(DLS_CHANGE_MOD,
+						    TEST_PATH_1, 2), TRUE);
+	dls_change_queue_add(&queue, prv_change_new(DLS_CHANGE_DEL,
+						    TEST_PATH_0, 3), TRUE);
+
+	/* Only the removal is reported, after the other changes */
+	g_assert_cmpuint(g_queue_get_length(&queue.changes), ==, 2);
+	g_assert_cmpstr(prv_change_nth(&queue, 0)->path, ==, TEST_PATH_1);
+	change = prv_change_nth(&queue, 1);
+	g_assert_cmpstr(change->path, ==, TEST_PATH_0);
+	g_assert_cmpuint(change->type, ==, DLS_CHANGE_DEL);
+
+	dls_change_queue_clear(&queue);
+}
+
+static void test_changes_containers(void)
+{
+	dls_change_queue_t queue = { G_QUEUE_INIT, NULL };
+	dls_change_t *change;
+
+	dls_change_queue_add_container(&queue, TEST_PATH_0, 1, TRUE);
+	dls_change_queue_add_container(&queue, TEST_PATH_1, 2, TRUE);
+	dls_change_queue_add_container(&queue, TEST_PATH_0, 3, TRUE);
+
+	g_assert_cmpuint(g_queue_get_length(&queue.changes), ==, 2);
+	change = prv_change_nth(&queue, 0);
+	g_assert_cmpstr(change->path, ==, TEST_PATH_0);
+	g_assert_cmpuint(change->type, ==, DLS_CHANGE_CONTAINER);
+	g_assert_cmpuint(change->update_id, ==, 3);
+	g_assert(change->dict == NULL);
+
+	dls_change_queue_clear(&queue);
+
+	dls_change_queue_add_container(&queue, TEST_PATH_0, 1, FALSE);
+	dls_change_queue_add_container(&queue, TEST_PATH_0, 2, FALSE);
+	g_assert_cmpuint(g_queue_get_length(&queue.changes), ==, 2);
+
+	dls_change_queue_clear(&queue);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/changes/no-coalescing", test_changes_no_coalescing);
+	g_test_add_func("/changes/merge-mods", test_changes_merge_mods);
+	g_test_add_func("/changes/fold-mod-into-add",
+			test_changes_fold_mod_into_add);
+	g_test_add_func("/changes/collapse-add-del",
+			test_changes_collapse_add_del);
+	g_test_add_func("/changes/mod-then-del", test_changes_mod_then_del);
+	g_test_add_func("/changes/containers", test_changes_containers);
+
+	return g_test_run();
+}
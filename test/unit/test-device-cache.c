@@ -0,0 +1,164 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "device-cache.h"
+
+#define TEST_UDN "uuid:0123-4567"
+#define TEST_CONFIG_ID "42"
+
+static gchar *g_cache_home;
+
+static dls_device_cache_entry_t *prv_entry_new(void)
+{
+	dls_device_cache_entry_t *entry = dls_device_cache_entry_new();
+
+	entry->values[DLS_DEVICE_CACHE_SEARCH_CAPS] =
+					g_strdup("dc:title,upnp:class");
+	entry->values[DLS_DEVICE_CACHE_SORT_CAPS] = g_strdup("");
+	entry->values[DLS_DEVICE_CACHE_FEATURE_LIST] =
+					g_strdup("<Features>\n</Features>");
+
+	return entry;
+}
+
+static gchar *prv_cache_file(const gchar *name)
+{
+	return g_build_filename(g_cache_home, "dleyna-server", "devices",
+				name, NULL);
+}
+
+static void test_device_cache_round_trip(void)
+{
+	dls_device_cache_entry_t *saved = prv_entry_new();
+	dls_device_cache_entry_t *loaded;
+
+	dls_device_cache_save(TEST_UDN, TEST_CONFIG_ID, saved);
+	loaded = dls_device_cache_load(TEST_UDN, TEST_CONFIG_ID);
+
+	g_assert(loaded != NULL);
+	g_assert(dls_device_cache_entry_equal(saved, loaded));
+
+	/* Empty and missing values are kept apart */
+	g_assert_cmpstr(loaded->values[DLS_DEVICE_CACHE_SORT_CAPS], ==, "");
+	g_assert(!loaded->values[DLS_DEVICE_CACHE_SORT_EXT_CAPS]);
+
+	dls_device_cache_entry_delete(loaded);
+	dls_device_cache_entry_delete(saved);
+}
+
+static void test_device_cache_no_config_id(void)
+{
+	dls_device_cache_entry_t *saved = prv_entry_new();
+	dls_device_cache_entry_t *loaded;
+
+	dls_device_cache_save(TEST_UDN, NULL, saved);
+
+	loaded = dls_device_cache_load(TEST_UDN, NULL);
+	g_assert(loaded != NULL);
+	g_assert(dls_device_cache_entry_equal(saved, loaded));
+	dls_device_cache_entry_delete(loaded);
+
+	loaded = dls_device_cache_load(TEST_UDN, TEST_CONFIG_ID);
+	g_assert(loaded == NULL);
+
+	dls_device_cache_entry_delete(saved);
+}
+
+static void test_device_cache_stale(void)
+{
+	dls_device_cache_entry_t *saved = prv_entry_new();
+
+	dls_device_cache_save(TEST_UDN, TEST_CONFIG_ID, saved);
+
+	g_assert(dls_device_cache_load(TEST_UDN, "43") == NULL);
+	g_assert(dls_device_cache_load("uuid:unknown", TEST_CONFIG_ID) ==
+		 NULL);
+
+	dls_device_cache_entry_delete(saved);
+}
+
+static void test_device_cache_file_name(void)
+{
+	dls_device_cache_entry_t *saved = prv_entry_new();
+	dls_device_cache_entry_t *loaded;
+	gchar *file;
+
+	/* A hostile UDN cannot escape the cache directory */
+	dls_device_cache_save("uuid:../x/y", TEST_CONFIG_ID, saved);
+
+	file = prv_cache_file("uuid_.._x_y");
+	g_assert(g_file_test(file, G_FILE_TEST_IS_REGULAR));
+	(void) g_remove(file);
+	g_free(file);
+
+	/* UDNs that share a file name do not share an entry */
+	dls_device_cache_save("uuid:a", TEST_CONFIG_ID, saved);
+	loaded = dls_device_cache_load("uuid/a", TEST_CONFIG_ID);
+	g_assert(loaded == NULL);
+
+	file = prv_cache_file("uuid_a");
+	(void) g_remove(file);
+	g_free(file);
+
+	dls_device_cache_entry_delete(saved);
+}
+
+int main(int argc, char *argv[])
+{
+	gchar *file;
+	int retval;
+
+	g_cache_home = g_dir_make_tmp("dleyna-server-test-XXXXXX", NULL);
+	g_assert(g_cache_home != NULL);
+	(void) g_setenv("XDG_CACHE_HOME", g_cache_home, TRUE);
+
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/device-cache/round-trip",
+			test_device_cache_round_trip);
+	g_test_add_func("/device-cache/no-config-id",
+			test_device_cache_no_config_id);
+	g_test_add_func("/device-cache/stale", test_device_cache_stale);
+	g_test_add_func("/device-cache/file-name",
+			test_device_cache_file_name);
+
+	retval = g_test_run();
+
+	file = prv_cache_file("uuid_0123-4567");
+	(void) g_remove(file);
+	g_free(file);
+
+	file = g_build_filename(g_cache_home, "dleyna-server", "devices",
+				NULL);
+	(void) g_rmdir(file);
+	g_free(file);
+
+	file = g_build_filename(g_cache_home, "dleyna-server", NULL);
+	(void) g_rmdir(file);
+	g_free(file);
+
+	(void) g_rmdir(g_cache_home);
+	g_free(g_cache_home);
+
+	return retval;
+}
@@ -0,0 +1,77 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include <glib.h>
+
+#include "device-index.h"
+
+#define TEST_PATH_0 "/com/intel/dLeynaServer/server/0"
+#define TEST_PATH_1 "/com/intel/dLeynaServer/server/1"
+
+static void test_device_index_lookup(void)
+{
+	dls_device_index_t *index;
+	gchar *path0 = g_strdup(TEST_PATH_0);
+	gchar *path1 = g_strdup(TEST_PATH_1);
+	gint device0;
+	gint device1;
+
+	index = dls_device_index_new();
+
+	g_assert(dls_device_index_lookup(index, TEST_PATH_0) == NULL);
+
+	dls_device_index_add(index, path0, &device0);
+	dls_device_index_add(index, path1, &device1);
+
+	g_assert(dls_device_index_lookup(index, TEST_PATH_0) == &device0);
+	g_assert(dls_device_index_lookup(index, TEST_PATH_1) == &device1);
+
+	/* Object paths below a server do not resolve to it */
+	g_assert(dls_device_index_lookup(index, TEST_PATH_0 "/1") == NULL);
+
+	dls_device_index_remove(index, path0);
+
+	g_assert(dls_device_index_lookup(index, TEST_PATH_0) == NULL);
+	g_assert(dls_device_index_lookup(index, TEST_PATH_1) == &device1);
+
+	/* Indexing again, as when a device comes back, is harmless */
+	dls_device_index_add(index, path1, &device1);
+	g_assert(dls_device_index_lookup(index, TEST_PATH_1) == &device1);
+
+	dls_device_index_remove(index, path1);
+	g_assert(dls_device_index_lookup(index, TEST_PATH_1) == NULL);
+
+	/* Removing an unknown path is harmless too */
+	dls_device_index_remove(index, path1);
+
+	dls_device_index_delete(index);
+	g_free(path1);
+	g_free(path0);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/device-index/lookup", test_device_index_lookup);
+
+	return g_test_run();
+}
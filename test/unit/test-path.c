@@ -0,0 +1,169 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "path.h"
+
+#define TEST_ROOT DLEYNA_SERVER_PATH "/0"
+
+static void test_path_round_trip(void)
+{
+	const gchar *ids[] = {"1", "abc", "64$", "\x01\x7f\xff", "a/b c"};
+	gchar *path;
+	gchar *root_path;
+	gchar *id;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(ids); i++) {
+		path = dls_path_from_id(TEST_ROOT, ids[i]);
+
+		g_assert(g_str_has_prefix(path, TEST_ROOT "/"));
+		g_assert(g_variant_is_object_path(path));
+		g_assert_cmpuint(strlen(path), ==,
+				 strlen(TEST_ROOT) + 1 + 2 * strlen(ids[i]));
+
+		g_assert(dls_path_get_path_and_id(path, &root_path, &id,
+						  NULL));
+		g_assert_cmpstr(root_path, ==, TEST_ROOT);
+		g_assert_cmpstr(id, ==, ids[i]);
+
+		g_free(id);
+		g_free(root_path);
+		g_free(path);
+	}
+}
+
+static void test_path_root(void)
+{
+	gchar *path;
+	gchar *root_path;
+	gchar *id;
+
+	path = dls_path_from_id(TEST_ROOT, "0");
+	g_assert_cmpstr(path, ==, TEST_ROOT);
+
+	g_assert(dls_path_get_path_and_id(path, &root_path, &id, NULL));
+	g_assert_cmpstr(root_path, ==, TEST_ROOT);
+	g_assert_cmpstr(id, ==, "0");
+
+	g_free(id);
+	g_free(root_path);
+	g_free(path);
+}
+
+static void test_path_encode_decode(void)
+{
+	gchar *path;
+	gchar *root_path;
+	gchar *id;
+
+	path = dls_path_from_id(TEST_ROOT, "A\xff");
+	g_assert_cmpstr(path, ==, TEST_ROOT "/41ff");
+	g_free(path);
+
+	/* Upper case digits are accepted on input */
+	g_assert(dls_path_get_path_and_id(TEST_ROOT "/41FF", &root_path, &id,
+					  NULL));
+	g_assert_cmpstr(id, ==, "A\xff");
+	g_free(id);
+	g_free(root_path);
+
+	g_assert(!dls_path_get_path_and_id(TEST_ROOT "/4", &root_path, &id,
+					   NULL));
+	g_assert(!dls_path_get_path_and_id(TEST_ROOT "/zz", &root_path, &id,
+					   NULL));
+}
+
+static void test_path_bad(void)
+{
+	const gchar *paths[] = {
+		"/com/intel/other/0",
+		DLEYNA_SERVER_PATH,
+		DLEYNA_SERVER_PATH "/",
+		TEST_ROOT "/",
+		TEST_ROOT "/abc",
+		TEST_ROOT "/4g"
+	};
+	gchar *root_path;
+	gchar *id;
+	GError *error = NULL;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(paths); i++) {
+		g_assert(!dls_path_get_path_and_id(paths[i], &root_path,
+						   &id, &error));
+		g_assert(error != NULL);
+		g_clear_error(&error);
+	}
+}
+
+static void test_path_append_id(void)
+{
+	GString *path = g_string_new(TEST_ROOT);
+	gsize root_len = path->len;
+	gchar *expected;
+
+	dls_path_append_id(path, "0");
+	g_assert_cmpstr(path->str, ==, TEST_ROOT);
+
+	dls_path_append_id(path, "xyz");
+	expected = dls_path_from_id(TEST_ROOT, "xyz");
+	g_assert_cmpstr(path->str, ==, expected);
+	g_free(expected);
+
+	/* The buffer is reused from the root for the next object */
+	g_string_truncate(path, root_len);
+	dls_path_append_id(path, "1");
+	g_assert_cmpstr(path->str, ==, TEST_ROOT "/31");
+
+	(void) g_string_free(path, TRUE);
+}
+
+static void test_path_from_ids(void)
+{
+	gchar *ids[] = {"0", "1", "ab", NULL};
+	gchar **paths;
+
+	paths = dls_path_from_ids(TEST_ROOT, ids);
+
+	g_assert_cmpuint(g_strv_length(paths), ==, 3);
+	g_assert_cmpstr(paths[0], ==, TEST_ROOT);
+	g_assert_cmpstr(paths[1], ==, TEST_ROOT "/31");
+	g_assert_cmpstr(paths[2], ==, TEST_ROOT "/6162");
+
+	g_strfreev(paths);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/path/round-trip", test_path_round_trip);
+	g_test_add_func("/path/root", test_path_root);
+	g_test_add_func("/path/encode-decode", test_path_encode_decode);
+	g_test_add_func("/path/bad", test_path_bad);
+	g_test_add_func("/path/append-id", test_path_append_id);
+	g_test_add_func("/path/from-ids", test_path_from_ids);
+
+	return g_test_run();
+}
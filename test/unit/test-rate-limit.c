@@ -0,0 +1,99 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <glib.h>
+
+#include "rate-limit.h"
+
+#define TEST_RATE 1000
+#define TEST_START (10 * G_USEC_PER_SEC)
+
+static void test_rate_limit_unlimited(void)
+{
+	dls_rate_limit_t limit = { 0, 0 };
+
+	g_assert_cmpuint(dls_rate_limit_reserve(&limit, 0, 1 << 20,
+						TEST_START), ==, 0);
+	g_assert_cmpuint(limit.budget, ==, 0);
+}
+
+static void test_rate_limit_starts_full(void)
+{
+	dls_rate_limit_t limit = { 0, 0 };
+
+	g_assert_cmpuint(dls_rate_limit_reserve(&limit, TEST_RATE, TEST_RATE,
+						TEST_START), ==, 0);
+
+	/* One byte more waits for one millisecond worth of budget */
+	g_assert_cmpuint(dls_rate_limit_reserve(&limit, TEST_RATE, 1,
+						TEST_START), ==, 2);
+}
+
+static void test_rate_limit_refill(void)
+{
+	dls_rate_limit_t limit = { 0, 0 };
+	gint64 now = TEST_START;
+
+	g_assert_cmpuint(dls_rate_limit_reserve(&limit, TEST_RATE, TEST_RATE,
+						now), ==, 0);
+
+	now += G_USEC_PER_SEC / 2;
+	g_assert_cmpuint(dls_rate_limit_reserve(&limit, TEST_RATE, 400, now),
+			 ==, 0);
+
+	/* A wait leaves the budget untouched */
+	g_assert_cmpuint(dls_rate_limit_reserve(&limit, TEST_RATE, 200, now),
+			 ==, 101);
+	g_assert_cmpuint(limit.budget, ==, 100);
+
+	now += 101 * 1000;
+	g_assert_cmpuint(dls_rate_limit_reserve(&limit, TEST_RATE, 200, now),
+			 ==, 0);
+	g_assert_cmpuint(limit.budget, ==, 1);
+}
+
+static void test_rate_limit_cap(void)
+{
+	dls_rate_limit_t limit = { 0, 0 };
+	gint64 now = TEST_START;
+
+	g_assert_cmpuint(dls_rate_limit_reserve(&limit, TEST_RATE, 1, now),
+			 ==, 0);
+
+	/* An idle bucket holds at most one second worth of data */
+	now += 60 * G_USEC_PER_SEC;
+	g_assert_cmpuint(dls_rate_limit_reserve(&limit, TEST_RATE, TEST_RATE,
+						now), ==, 0);
+	g_assert_cmpuint(dls_rate_limit_reserve(&limit, TEST_RATE, 1, now),
+			 ==, 2);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/rate-limit/unlimited", test_rate_limit_unlimited);
+	g_test_add_func("/rate-limit/starts-full",
+			test_rate_limit_starts_full);
+	g_test_add_func("/rate-limit/refill", test_rate_limit_refill);
+	g_test_add_func("/rate-limit/cap", test_rate_limit_cap);
+
+	return g_test_run();
+}
@@ -0,0 +1,197 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <glib.h>
+
+#include "props.h"
+#include "search.h"
+
+#define TEST_ROOT DLEYNA_SERVER_PATH "/0"
+
+typedef struct test_search_case_t_ test_search_case_t;
+struct test_search_case_t_ {
+	const gchar *query;
+	const gchar *expected;
+};
+
+static GHashTable *g_property_map;
+static GHashTable *g_filter_map;
+
+static void prv_check(const test_search_case_t *cases, guint count)
+{
+	gchar *translated;
+	guint i;
+
+	for (i = 0; i < count; i++) {
+		translated = dls_search_translate_search_string(
+						g_filter_map, cases[i].query);
+		g_assert_cmpstr(translated, ==, cases[i].expected);
+		g_free(translated);
+	}
+}
+
+static void test_search_trivial(void)
+{
+	static const test_search_case_t cases[] = {
+		{"", ""},
+		{"   ", ""},
+		{"*", "*"},
+		{"  *  ", "*"},
+		{"* and *", NULL}
+	};
+
+	prv_check(cases, G_N_ELEMENTS(cases));
+}
+
+static void test_search_operators(void)
+{
+	static const test_search_case_t cases[] = {
+		{"DisplayName = \"a\"", "dc:title = \"a\""},
+		{"DisplayName != \"a\"", "dc:title != \"a\""},
+		{"Date < \"2000\"", "dc:date < \"2000\""},
+		{"Date <= \"2000\"", "dc:date <= \"2000\""},
+		{"Date > \"2000\"", "dc:date > \"2000\""},
+		{"Date >= \"2000\"", "dc:date >= \"2000\""},
+		{"Artist contains \"a\"", "upnp:artist contains \"a\""},
+		{"Artist doesNotContain \"a\"",
+		 "upnp:artist doesNotContain \"a\""},
+		{"Artist exists true", "upnp:artist exists true"},
+		{"Artist exists false", "upnp:artist exists false"},
+		{"DisplayName like \"a\"", NULL},
+		{"DisplayName = a", NULL}
+	};
+
+	prv_check(cases, G_N_ELEMENTS(cases));
+}
+
+static void test_search_values(void)
+{
+	static const test_search_case_t cases[] = {
+		{"Type derivedfrom \"container\"",
+		 "upnp:class derivedfrom \"object.container\""},
+		{"Type = \"music\"",
+		 "upnp:class = \"object.item.audioItem.musicTrack\""},
+		{"Type = \"bogus\"", NULL},
+		{"Path = \"" TEST_ROOT "/6162\"", "@id = \"ab\""},
+		{"Parent = \"" TEST_ROOT "\"", "@parentID = \"0\""},
+		{"Parent = \"/not/a/server\"", NULL},
+		/* Escapes survive the round trip */
+		{"DisplayName = \"a\\\"b\\\\c\"", "dc:title = \"a\\\"b\\\\c\""},
+		{"DisplayName = \"(and)\"", "dc:title = \"(and)\""}
+	};
+
+	prv_check(cases, G_N_ELEMENTS(cases));
+}
+
+static void test_search_grouping(void)
+{
+	static const test_search_case_t cases[] = {
+		{"Artist = \"a\" and Album = \"b\" or Genre = \"c\"",
+		 "upnp:artist = \"a\" and upnp:album = \"b\" or "
+		 "upnp:genre = \"c\""},
+		{"Artist = \"a\" and (Album = \"b\" or Genre = \"c\")",
+		 "upnp:artist = \"a\" and (upnp:album = \"b\" or "
+		 "upnp:genre = \"c\")"},
+		/* Redundant parentheses are collapsed */
+		{"((Artist = \"a\"))", "(upnp:artist = \"a\")"},
+		{"(Artist = \"a\")and(Album = \"b\")",
+		 "(upnp:artist = \"a\") and (upnp:album = \"b\")"}
+	};
+
+	prv_check(cases, G_N_ELEMENTS(cases));
+}
+
+static void test_search_invalid(void)
+{
+	static const test_search_case_t cases[] = {
+		{"Unknown = \"a\"", NULL},
+		/* Known but not searchable */
+		{"URLs = \"a\"", NULL},
+		{"DisplayName = \"a", NULL},
+		{"DisplayName = \"a\")", NULL},
+		{"(DisplayName = \"a\"", NULL},
+		{"DisplayName = \"a\" and", NULL},
+		{"DisplayName = \"a\" xor Artist = \"b\"", NULL},
+		{"DisplayName \"a\"", NULL},
+		{"and DisplayName = \"a\"", NULL}
+	};
+
+	prv_check(cases, G_N_ELEMENTS(cases));
+}
+
+/* Keywords and operators are case sensitive, as in the UPnP grammar */
+static void test_search_case(void)
+{
+	static const test_search_case_t cases[] = {
+		{"Artist = \"a\" AND Album = \"b\"", NULL},
+		{"Artist = \"a\" Or Album = \"b\"", NULL},
+		{"Artist exists TRUE", NULL},
+		{"Artist exists False", NULL},
+		{"Artist CONTAINS \"a\"", NULL},
+		{"Artist doesnotcontain \"a\"", NULL},
+		{"Type derivedFrom \"container\"", NULL},
+		{"artist = \"a\"", NULL}
+	};
+
+	prv_check(cases, G_N_ELEMENTS(cases));
+}
+
+static void test_search_depth(void)
+{
+	GString *query = g_string_new("");
+	gchar *translated;
+	guint i;
+
+	for (i = 0; i < 64; i++)
+		g_string_append_c(query, '(');
+	g_string_append(query, "DisplayName = \"a\"");
+	for (i = 0; i < 64; i++)
+		g_string_append_c(query, ')');
+
+	translated = dls_search_translate_search_string(g_filter_map,
+							query->str);
+	g_assert(translated == NULL);
+
+	(void) g_string_free(query, TRUE);
+}
+
+int main(int argc, char *argv[])
+{
+	int retval;
+
+	g_test_init(&argc, &argv, NULL);
+
+	dls_prop_maps_new(&g_property_map, &g_filter_map);
+
+	g_test_add_func("/search/trivial", test_search_trivial);
+	g_test_add_func("/search/operators", test_search_operators);
+	g_test_add_func("/search/values", test_search_values);
+	g_test_add_func("/search/grouping", test_search_grouping);
+	g_test_add_func("/search/invalid", test_search_invalid);
+	g_test_add_func("/search/case", test_search_case);
+	g_test_add_func("/search/depth", test_search_depth);
+
+	retval = g_test_run();
+
+	g_hash_table_unref(g_filter_map);
+	g_hash_table_unref(g_property_map);
+
+	return retval;
+}
@@ -0,0 +1,99 @@
+/*
+ * dLeyna
+ *
+ * Copyright (C) 2012-2017 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <glib.h>
+
+#include "props.h"
+#include "sort.h"
+
+typedef struct test_sort_case_t_ test_sort_case_t;
+struct test_sort_case_t_ {
+	const gchar *sort_by;
+	const gchar *expected;
+};
+
+static GHashTable *g_property_map;
+static GHashTable *g_filter_map;
+
+static void prv_check(const test_sort_case_t *cases, guint count)
+{
+	gchar *translated;
+	guint i;
+
+	for (i = 0; i < count; i++) {
+		translated = dls_sort_translate_sort_string(g_filter_map,
+							    cases[i].sort_by);
+		g_assert_cmpstr(translated, ==, cases[i].expected);
+		g_free(translated);
+	}
+}
+
+static void test_sort_valid(void)
+{
+	static const test_sort_case_t cases[] = {
+		{"", ""},
+		{"+DisplayName", "+dc:title"},
+		{"-DisplayName", "-dc:title"},
+		{"+Date,-DisplayName", "+dc:date,-dc:title"},
+		{"-Artist,+Album,+TrackNumber",
+		 "-upnp:artist,+upnp:album,+upnp:originalTrackNumber"},
+		{"+Size", "+res@size"}
+	};
+
+	prv_check(cases, G_N_ELEMENTS(cases));
+}
+
+static void test_sort_invalid(void)
+{
+	static const test_sort_case_t cases[] = {
+		{"DisplayName", NULL},
+		{"+", NULL},
+		{"+Date,", NULL},
+		{",+Date", NULL},
+		{"+Date,,-DisplayName", NULL},
+		{"+Date-DisplayName", NULL},
+		{"+Unknown", NULL},
+		/* Known but not searchable */
+		{"+URLs", NULL},
+		/* Property names are case sensitive */
+		{"+displayname", NULL}
+	};
+
+	prv_check(cases, G_N_ELEMENTS(cases));
+}
+
+int main(int argc, char *argv[])
+{
+	int retval;
+
+	g_test_init(&argc, &argv, NULL);
+
+	dls_prop_maps_new(&g_property_map, &g_filter_map);
+
+	g_test_add_func("/sort/valid", test_sort_valid);
+	g_test_add_func("/sort/invalid", test_sort_invalid);
+
+	retval = g_test_run();
+
+	g_hash_table_unref(g_filter_map);
+	g_hash_table_unref(g_property_map);
+
+	return retval;
+}